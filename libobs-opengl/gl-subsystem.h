@@ -562,6 +562,10 @@ struct gs_texture {
 	struct fbo_info *fbo;
 };
 
+/* Uploads to dynamic textures can be this many frames ahead of the GPU
+ * copying them out of the unpack buffer */
+#define NUM_UNPACK_SLOTS 3
+
 struct gs_texture_2d {
 	struct gs_texture base;
 
@@ -569,6 +573,13 @@ struct gs_texture_2d {
 	uint32_t height;
 	bool gen_mipmaps;
 	GLuint unpack_buffer;
+
+	/* With persistent mapping, the unpack buffer is a ring of slots that
+	 * stays mapped, with a fence for the last copy out of each slot */
+	uint8_t *unpack_ptr;
+	GLsizeiptr unpack_slot_size;
+	uint32_t unpack_slot;
+	GLsync unpack_fences[NUM_UNPACK_SLOTS];
 };
 
 struct gs_texture_3d {
@@ -638,6 +649,7 @@ static inline void fbo_info_destroy(struct fbo_info *fbo)
 struct gs_device {
 	struct gl_platform *plat;
 	enum copy_type copy_type;
+	bool persistent_mapping;
 
 	GLuint empty_vao;
 	gs_samplerstate_t *raw_load_sampler;
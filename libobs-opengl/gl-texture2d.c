@@ -45,6 +45,37 @@ static bool upload_texture_2d(struct gs_texture_2d *tex, const uint8_t **data)
 	return success;
 }
 
+#define UNPACK_MAP_FLAGS \
+	(GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+/* Keeps the unpack buffer mapped for good, so that uploads neither map nor
+ * wait on the GPU, and the texture is updated in place rather than being
+ * respecified.  Compressed formats keep to the plain buffer. */
+static bool create_unpack_ring(struct gs_texture_2d *tex, GLsizeiptr size)
+{
+	GLsizeiptr slot_size = (size + 255) & ~(GLsizeiptr)255;
+
+	if (!tex->base.device->persistent_mapping ||
+	    gs_is_compressed_format(tex->base.format))
+		return false;
+
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, slot_size * NUM_UNPACK_SLOTS,
+			NULL, UNPACK_MAP_FLAGS);
+	if (!gl_success("glBufferStorage"))
+		return false;
+
+	tex->unpack_ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+					   slot_size * NUM_UNPACK_SLOTS,
+					   UNPACK_MAP_FLAGS);
+	if (!gl_success("glMapBufferRange") || !tex->unpack_ptr) {
+		tex->unpack_ptr = NULL;
+		return false;
+	}
+
+	tex->unpack_slot_size = slot_size;
+	return true;
+}
+
 static bool create_pixel_unpack_buffer(struct gs_texture_2d *tex)
 {
 	GLsizeiptr size;
@@ -66,6 +97,21 @@ static bool create_pixel_unpack_buffer(struct gs_texture_2d *tex)
 		size /= 8;
 	}
 
+	if (create_unpack_ring(tex, size)) {
+		gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return true;
+	}
+
+	/* Buffer storage is immutable, so a failed ring needs a new buffer */
+	if (tex->base.device->persistent_mapping) {
+		gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		gl_delete_buffers(1, &tex->unpack_buffer);
+		if (!gl_gen_buffers(1, &tex->unpack_buffer))
+			return false;
+		if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex->unpack_buffer))
+			return false;
+	}
+
 	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, 0, GL_DYNAMIC_DRAW);
 	if (!gl_success("glBufferData"))
 		success = false;
@@ -146,6 +192,10 @@ void gs_texture_destroy(gs_texture_t *tex)
 		if (tex->type == GS_TEXTURE_2D) {
 			struct gs_texture_2d *tex2d =
 				(struct gs_texture_2d *)tex;
+			for (size_t i = 0; i < NUM_UNPACK_SLOTS; i++) {
+				if (tex2d->unpack_fences[i])
+					glDeleteSync(tex2d->unpack_fences[i]);
+			}
 			if (tex2d->unpack_buffer)
 				gl_delete_buffers(1, &tex2d->unpack_buffer);
 		} else if (tex->type == GS_TEXTURE_3D) {
@@ -188,6 +238,51 @@ enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
 	return tex->format;
 }
 
+/* Only waits if the GPU is still copying out of the slot from
+ * NUM_UNPACK_SLOTS uploads ago, which it practically never is */
+static uint8_t *map_unpack_slot(struct gs_texture_2d *tex2d)
+{
+	GLsync *fence = &tex2d->unpack_fences[tex2d->unpack_slot];
+
+	if (*fence) {
+		GLenum ret = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+					      1000000000ULL);
+		if (ret == GL_TIMEOUT_EXPIRED || ret == GL_WAIT_FAILED)
+			blog(LOG_WARNING, "gs_texture_map (GL): Timed out "
+					  "waiting for previous upload");
+
+		glDeleteSync(*fence);
+		*fence = NULL;
+	}
+
+	return tex2d->unpack_ptr +
+	       tex2d->unpack_slot * tex2d->unpack_slot_size;
+}
+
+static bool unmap_unpack_slot(struct gs_texture_2d *tex2d)
+{
+	gs_texture_t *tex = &tex2d->base;
+	GLintptr offset = tex2d->unpack_slot * tex2d->unpack_slot_size;
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex2d->unpack_buffer))
+		return false;
+	if (!gl_bind_texture(GL_TEXTURE_2D, tex->texture))
+		return false;
+
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tex2d->width, tex2d->height,
+			tex->gl_format, tex->gl_type, (const void *)offset);
+	if (!gl_success("glTexSubImage2D"))
+		return false;
+
+	tex2d->unpack_fences[tex2d->unpack_slot] =
+		glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!gl_success("glFenceSync"))
+		return false;
+
+	tex2d->unpack_slot = (tex2d->unpack_slot + 1) % NUM_UNPACK_SLOTS;
+	return true;
+}
+
 bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 {
 	struct gs_texture_2d *tex2d = (struct gs_texture_2d *)tex;
@@ -200,6 +295,11 @@ bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 		goto fail;
 	}
 
+	if (tex2d->unpack_ptr) {
+		*ptr = map_unpack_slot(tex2d);
+		goto mapped;
+	}
+
 	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex2d->unpack_buffer))
 		goto fail;
 
@@ -209,6 +309,7 @@ bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 
 	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
+mapped:
 	*linesize = tex2d->width * gs_get_format_bpp(tex->format) / 8;
 	*linesize = (*linesize + 3) & 0xFFFFFFFC;
 	return true;
@@ -224,6 +325,15 @@ void gs_texture_unmap(gs_texture_t *tex)
 	if (!is_texture_2d(tex, "gs_texture_unmap"))
 		goto failed;
 
+	if (tex2d->unpack_ptr) {
+		if (!unmap_unpack_slot(tex2d))
+			goto failed;
+
+		gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		gl_bind_texture(GL_TEXTURE_2D, 0);
+		return;
+	}
+
 	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex2d->unpack_buffer))
 		goto failed;
 
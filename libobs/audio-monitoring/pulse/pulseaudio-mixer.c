@@ -0,0 +1,253 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "util/bmem.h"
+#include "util/util_uint64.h"
+#include "pulseaudio-mixer.h"
+
+#include <math.h>
+
+/* Rate correction per second of sink latency error.  Clock drift is well
+ * below the limit, which keeps the pitch change inaudible. */
+#define DRIFT_RESPONSE 0.4
+#define DRIFT_MAX_CORRECTION 0.002
+
+/* Weight of a new sink latency measurement, they jump by whole writes */
+#define LATENCY_SMOOTHING 0.125
+
+void monitor_mixer_init(struct monitor_mixer *mixer, uint32_t samples_per_sec,
+			size_t channels, uint64_t latency)
+{
+	memset(mixer, 0, sizeof(*mixer));
+	mixer->samples_per_sec = samples_per_sec;
+	mixer->channels = channels;
+	mixer->hold = latency / 2;
+	mixer->sink_target = latency - mixer->hold;
+	mixer->ratio = 1.0;
+}
+
+void monitor_mixer_free(struct monitor_mixer *mixer)
+{
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+		bfree(mixer->buf[c]);
+		bfree(mixer->out[c]);
+	}
+}
+
+/* Rounded to the nearest frame, timestamps are truncated to whole ns */
+static inline uint64_t ns_to_frames(const struct monitor_mixer *mixer,
+				    uint64_t ns)
+{
+	uint64_t half_frame = 500000000ULL / mixer->samples_per_sec;
+	return util_mul_div64(ns + half_frame, mixer->samples_per_sec,
+			      1000000000ULL);
+}
+
+static inline uint64_t mix_start_ts(const struct monitor_mixer *mixer)
+{
+	return mixer->epoch_ts + util_mul_div64(mixer->consumed, 1000000000ULL,
+						mixer->samples_per_sec);
+}
+
+static void reserve(float **bufs, size_t channels, size_t *capacity,
+		    size_t frames)
+{
+	if (frames <= *capacity)
+		return;
+
+	if (frames < *capacity * 2)
+		frames = *capacity * 2;
+
+	for (size_t c = 0; c < channels; c++)
+		bufs[c] = brealloc(bufs[c], frames * sizeof(float));
+	*capacity = frames;
+}
+
+void monitor_mixer_add(struct monitor_mixer *mixer,
+		       const struct audio_data *audio, float vol)
+{
+	size_t frames = audio->frames;
+	size_t skip = 0;
+	size_t offset = 0;
+	uint64_t start;
+
+	if (!frames)
+		return;
+
+	if (!mixer->epoch_ts) {
+		mixer->epoch_ts = audio->timestamp;
+		mixer->consumed = 0;
+	}
+
+	start = mix_start_ts(mixer);
+
+	if (audio->timestamp < start) {
+		skip = (size_t)ns_to_frames(mixer, start - audio->timestamp);
+		if (skip >= frames) {
+			mixer->late_frames += frames;
+			return;
+		}
+		mixer->late_frames += skip;
+	} else {
+		offset = (size_t)ns_to_frames(mixer, audio->timestamp - start);
+
+		/* A source whose timestamps run that far ahead of the others
+		 * would only hold the mix up */
+		if (offset > mixer->samples_per_sec) {
+			mixer->late_frames += frames;
+			return;
+		}
+	}
+
+	size_t end = offset + frames - skip;
+
+	reserve(mixer->buf, mixer->channels, &mixer->capacity, end);
+
+	if (end > mixer->len) {
+		for (size_t c = 0; c < mixer->channels; c++)
+			memset(mixer->buf[c] + mixer->len, 0,
+			       (end - mixer->len) * sizeof(float));
+		mixer->len = end;
+	}
+
+	for (size_t c = 0; c < mixer->channels; c++) {
+		const float *src = (const float *)audio->data[c];
+		float *dst = mixer->buf[c] + offset;
+
+		if (!src)
+			continue;
+
+		src += skip;
+		for (size_t i = 0; i < frames - skip; i++)
+			dst[i] += src[i] * vol;
+	}
+}
+
+static void update_ratio(struct monitor_mixer *mixer, uint64_t age,
+			 int64_t sink_latency)
+{
+	uint64_t latency = age + (uint64_t)sink_latency;
+	double correction;
+
+	mixer->latency_total += latency;
+	mixer->latency_count++;
+	if (latency > mixer->latency_max)
+		mixer->latency_max = latency;
+
+	if (mixer->latency_count == 1)
+		mixer->sink_latency = (double)sink_latency;
+	else
+		mixer->sink_latency += ((double)sink_latency -
+					mixer->sink_latency) *
+				       LATENCY_SMOOTHING;
+
+	/* Too much queued in the sink means the sink is slower than the OBS
+	 * clock, so the mix has to be played back faster and vice versa */
+	correction = (mixer->sink_latency - (double)mixer->sink_target) /
+		     1000000000.0 * DRIFT_RESPONSE;
+	if (correction > DRIFT_MAX_CORRECTION)
+		correction = DRIFT_MAX_CORRECTION;
+	else if (correction < -DRIFT_MAX_CORRECTION)
+		correction = -DRIFT_MAX_CORRECTION;
+
+	mixer->ratio = 1.0 + correction;
+	if (fabs(correction) > mixer->max_correction)
+		mixer->max_correction = fabs(correction);
+}
+
+/* Cubic Hermite interpolation between x1 and x2 */
+static inline float interpolate(float x0, float x1, float x2, float x3,
+				float t)
+{
+	float c1 = 0.5f * (x2 - x0);
+	float c2 = x0 - 2.5f * x1 + 2.0f * x2 - 0.5f * x3;
+	float c3 = 0.5f * (x3 - x0) + 1.5f * (x1 - x2);
+
+	return ((c3 * t + c2) * t + c1) * t + x1;
+}
+
+size_t monitor_mixer_take(struct monitor_mixer *mixer, uint64_t now,
+			  int64_t sink_latency, const float *out[])
+{
+	uint64_t start = mix_start_ts(mixer);
+	uint64_t due;
+	size_t frames;
+	size_t count = 0;
+	size_t used;
+	double next;
+
+	if (!mixer->epoch_ts || now < start + mixer->hold)
+		return 0;
+
+	due = ns_to_frames(mixer, now - mixer->hold - start);
+	frames = due < mixer->len ? (size_t)due : mixer->len;
+
+	if (sink_latency >= 0)
+		update_ratio(mixer,
+			     now - start -
+				     util_mul_div64(frames, 1000000000ULL,
+						    mixer->samples_per_sec),
+			     sink_latency);
+
+	/* Each output frame needs the input frame before and the two after
+	 * its position, the last two frames wait for the next take */
+	while ((size_t)(mixer->phase + (double)count * mixer->ratio) + 2 <
+	       frames)
+		count++;
+
+	next = mixer->phase + (double)count * mixer->ratio;
+	used = (size_t)next;
+
+	reserve(mixer->out, mixer->channels, &mixer->out_capacity, count);
+
+	for (size_t c = 0; c < mixer->channels; c++) {
+		const float *src = mixer->buf[c];
+		float *dst = mixer->out[c];
+
+		for (size_t k = 0; k < count; k++) {
+			double pos = mixer->phase + (double)k * mixer->ratio;
+			size_t i = (size_t)pos;
+			float t = (float)(pos - (double)i);
+			float x0 = i ? src[i - 1] : mixer->prev[c];
+
+			dst[k] = interpolate(x0, src[i], src[i + 1],
+					     src[i + 2], t);
+		}
+
+		if (used) {
+			mixer->prev[c] = src[used - 1];
+			memmove(mixer->buf[c], mixer->buf[c] + used,
+				(mixer->len - used) * sizeof(float));
+		}
+		out[c] = dst;
+	}
+
+	mixer->phase = next - (double)used;
+	mixer->len -= used;
+	mixer->consumed += used;
+
+	/* Nothing was mixed for a while; restart the mix at the present so
+	 * the next source isn't taken as being ahead */
+	if (due > frames) {
+		mixer->epoch_ts = now - mixer->hold -
+				  util_mul_div64(mixer->len, 1000000000ULL,
+						 mixer->samples_per_sec);
+		mixer->consumed = 0;
+	}
+
+	return count;
+}
@@ -0,0 +1,84 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "media-io/audio-io.h"
+
+/*
+ * Premix of all sources monitored on one device.
+ *
+ * Sources add their audio at the position given by its timestamp, so that
+ * audio of different sources that belongs together is played together.  A
+ * frame is handed to the sink once it is hold old, which gives every source
+ * that long to contribute to it.  The rest of the latency is left to the
+ * sink, so that the two add up to the configured latency.
+ *
+ * The sink consumes frames by its own clock, which drifts against the OBS
+ * clock the timestamps come from.  The sink latency passed to
+ * monitor_mixer_take() is kept at sink_target by playing the mix back at a
+ * slightly adjusted rate, rather than dropping or repeating frames.
+ */
+
+struct monitor_mixer {
+	uint32_t samples_per_sec;
+	size_t channels;
+	uint64_t hold;
+	uint64_t sink_target;
+
+	/* Frames not yet taken; the first one is consumed frames after
+	 * epoch_ts.  Beyond len the buffers are uninitialized. */
+	float *buf[MAX_AUDIO_CHANNELS];
+	size_t len;
+	size_t capacity;
+	uint64_t epoch_ts;
+	uint64_t consumed;
+
+	/* Rate adjustment: input frames per output frame, the position of
+	 * the next output frame relative to buf, and the last frame before
+	 * buf for interpolating across takes */
+	double ratio;
+	double phase;
+	float prev[MAX_AUDIO_CHANNELS];
+	double sink_latency;
+
+	float *out[MAX_AUDIO_CHANNELS];
+	size_t out_capacity;
+
+	/* Statistics */
+	uint64_t late_frames;
+	double max_correction;
+	uint64_t latency_total;
+	uint64_t latency_max;
+	uint64_t latency_count;
+};
+
+extern void monitor_mixer_init(struct monitor_mixer *mixer,
+			       uint32_t samples_per_sec, size_t channels,
+			       uint64_t latency);
+extern void monitor_mixer_free(struct monitor_mixer *mixer);
+
+/* Mixes audio in at its timestamp, scaled by vol.  Audio that arrives after
+ * its frames were taken is dropped. */
+extern void monitor_mixer_add(struct monitor_mixer *mixer,
+			      const struct audio_data *audio, float vol);
+
+/* Takes the frames that are due at now.  sink_latency is the time audio
+ * written to the sink now takes to be heard, or negative if unknown.
+ * Returns the number of frames written to out. */
+extern size_t monitor_mixer_take(struct monitor_mixer *mixer, uint64_t now,
+				 int64_t sink_latency, const float *out[]);
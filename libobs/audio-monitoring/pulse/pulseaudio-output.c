@@ -1,13 +1,24 @@
 #include "obs-internal.h"
 #include "pulseaudio-wrapper.h"
+#include "pulseaudio-mixer.h"
 
-#define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
+#define PULSE_DATA(voidptr) struct monitor_engine *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
 
-struct audio_monitor {
-	obs_source_t *source;
-	pa_stream *stream;
+/* All sources monitored on the same device are premixed into one stream */
+struct monitor_engine {
+	struct monitor_engine *next;
+	char *id;
+	long refs;
+	bool listed;
+
+	pthread_mutex_t mutex;
+	struct monitor_mixer mixer;
+	audio_resampler_t *resampler;
+	struct deque new_data;
+
 	char *device;
+	pa_stream *stream;
 	pa_buffer_attr attr;
 	enum speaker_layout speakers;
 	pa_sample_format_t format;
@@ -17,14 +28,17 @@ struct audio_monitor {
 
 	uint_fast32_t packets;
 	uint_fast64_t frames;
+};
 
-	struct deque new_data;
-	audio_resampler_t *resampler;
-
+struct audio_monitor {
+	obs_source_t *source;
+	struct monitor_engine *engine;
 	bool ignore;
-	pthread_mutex_t playback_mutex;
 };
 
+static pthread_mutex_t engines_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct monitor_engine *engines = NULL;
+
 static enum speaker_layout
 pulseaudio_channels_to_obs_speakers(uint_fast32_t channels)
 {
@@ -122,75 +136,11 @@ static pa_channel_map pulseaudio_channel_map(enum speaker_layout layout)
 	return ret;
 }
 
-static void process_byte(void *p, size_t frames, size_t channels, float vol)
-{
-	register uint8_t *cur = (uint8_t *)p;
-	register uint8_t *end = cur + frames * channels;
-
-	for (; cur < end; cur++)
-		*cur = ((int)*cur - 128) * vol + 128;
-}
-
-static void process_s16(void *p, size_t frames, size_t channels, float vol)
-{
-	register int16_t *cur = (int16_t *)p;
-	register int16_t *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
-
-static void process_s32(void *p, size_t frames, size_t channels, float vol)
+static void do_stream_write(struct monitor_engine *data)
 {
-	register int32_t *cur = (int32_t *)p;
-	register int32_t *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
-
-static void process_float(void *p, size_t frames, size_t channels, float vol)
-{
-	register float *cur = (float *)p;
-	register float *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
-
-void process_volume(const struct audio_monitor *monitor, float vol,
-		    uint8_t *const *resample_data, uint32_t resample_frames)
-{
-	switch (monitor->format) {
-	case PA_SAMPLE_U8:
-		process_byte(resample_data[0], resample_frames,
-			     monitor->channels, vol);
-		break;
-	case PA_SAMPLE_S16LE:
-		process_s16(resample_data[0], resample_frames,
-			    monitor->channels, vol);
-		break;
-	case PA_SAMPLE_S32LE:
-		process_s32(resample_data[0], resample_frames,
-			    monitor->channels, vol);
-		break;
-	case PA_SAMPLE_FLOAT32LE:
-		process_float(resample_data[0], resample_frames,
-			      monitor->channels, vol);
-		break;
-	default:
-		// just ignore
-		break;
-	}
-}
-
-static void do_stream_write(void *param)
-{
-	PULSE_DATA(param);
 	uint8_t *buffer = NULL;
 
 	pulseaudio_lock();
-	pthread_mutex_lock(&data->playback_mutex);
 
 	// If we have grown a large buffer internally, grow the pulse buffer to match so we can write our data out.
 	if (data->new_data.size > data->attr.tlength * 2) {
@@ -232,54 +182,74 @@ static void do_stream_write(void *param)
 	}
 
 finish:
-	pthread_mutex_unlock(&data->playback_mutex);
 	pulseaudio_unlock();
 }
 
-static void on_audio_playback(void *param, obs_source_t *source,
-			      const struct audio_data *audio_data, bool muted)
+/* Time until audio written now is heard, or -1 if not known yet */
+static int64_t engine_sink_latency(struct monitor_engine *data)
 {
-	struct audio_monitor *monitor = param;
-	float vol = source->user_volume;
-	size_t bytes;
+	uint64_t queued = data->new_data.size / data->bytes_per_frame;
+	int64_t latency = -1;
+	pa_usec_t usec;
+	int negative;
+
+	pulseaudio_lock();
+	if (pa_stream_get_latency(data->stream, &usec, &negative) == 0)
+		latency = negative ? 0 : (int64_t)usec * 1000;
+	pulseaudio_unlock();
+
+	if (latency < 0)
+		return -1;
 
+	return latency + (int64_t)util_mul_div64(queued, 1000000000ULL,
+						 data->samples_per_sec);
+}
+
+static void engine_output(struct monitor_engine *data)
+{
+	const float *mixed[MAX_AUDIO_CHANNELS];
 	uint8_t *resample_data[MAX_AV_PLANES];
 	uint32_t resample_frames;
 	uint64_t ts_offset;
-	bool success;
+	uint64_t now = os_gettime_ns();
+	size_t frames;
 
-	if (pthread_mutex_trylock(&monitor->playback_mutex) != 0)
+	frames = monitor_mixer_take(&data->mixer, now,
+				    engine_sink_latency(data), mixed);
+	if (!frames)
 		return;
 
-	if (os_atomic_load_long(&source->activate_refs) == 0)
-		goto unlock;
+	if (!audio_resampler_resample(data->resampler, resample_data,
+				      &resample_frames, &ts_offset,
+				      (const uint8_t *const *)mixed,
+				      (uint32_t)frames))
+		return;
 
-	success = audio_resampler_resample(
-		monitor->resampler, resample_data, &resample_frames, &ts_offset,
-		(const uint8_t *const *)audio_data->data,
-		(uint32_t)audio_data->frames);
+	deque_push_back(&data->new_data, resample_data[0],
+			data->bytes_per_frame * resample_frames);
+	data->packets++;
+	data->frames += resample_frames;
 
-	if (!success)
-		goto unlock;
+	do_stream_write(data);
+}
 
-	bytes = monitor->bytes_per_frame * resample_frames;
+static void on_audio_playback(void *param, obs_source_t *source,
+			      const struct audio_data *audio_data, bool muted)
+{
+	struct audio_monitor *monitor = param;
+	struct monitor_engine *engine = monitor->engine;
 
-	if (muted) {
-		memset(resample_data[0], 0, bytes);
-	} else {
-		if (!close_float(vol, 1.0f, EPSILON)) {
-			process_volume(monitor, vol, resample_data,
-				       resample_frames);
-		}
-	}
+	if (os_atomic_load_long(&source->activate_refs) == 0)
+		return;
+
+	pthread_mutex_lock(&engine->mutex);
 
-	deque_push_back(&monitor->new_data, resample_data[0], bytes);
-	monitor->packets++;
-	monitor->frames += resample_frames;
+	if (!muted)
+		monitor_mixer_add(&engine->mixer, audio_data,
+				  source->user_volume);
+	engine_output(engine);
 
-unlock:
-	pthread_mutex_unlock(&monitor->playback_mutex);
-	do_stream_write(param);
+	pthread_mutex_unlock(&engine->mutex);
 }
 
 static void pulseaudio_server_info(pa_context *c, const pa_server_info *i,
@@ -340,149 +310,267 @@ skip:
 	pulseaudio_signal(0);
 }
 
-static void pulseaudio_stop_playback(struct audio_monitor *monitor)
+static void pulseaudio_stop_playback(struct monitor_engine *engine)
 {
-	if (monitor->stream) {
+	if (engine->stream) {
 		/* Stop the stream */
 		pulseaudio_lock();
-		pa_stream_disconnect(monitor->stream);
+		pa_stream_disconnect(engine->stream);
 		pulseaudio_unlock();
 
 		/* Remove the callbacks, to ensure we no longer try to do anything
 		 * with this stream object */
-		pulseaudio_write_callback(monitor->stream, NULL, NULL);
+		pulseaudio_write_callback(engine->stream, NULL, NULL);
 
 		/* Unreference the stream and drop it. PA will free it when it can. */
 		pulseaudio_lock();
-		pa_stream_unref(monitor->stream);
+		pa_stream_unref(engine->stream);
 		pulseaudio_unlock();
-		monitor->stream = NULL;
+		engine->stream = NULL;
 	}
+}
+
+static void log_engine_stats(struct monitor_engine *engine)
+{
+	const struct monitor_mixer *mixer = &engine->mixer;
+	uint64_t avg = mixer->latency_count
+			       ? mixer->latency_total / mixer->latency_count
+			       : 0;
 
-	blog(LOG_INFO, "Stopped Monitoring in '%s'", monitor->device);
+	blog(LOG_INFO, "Stopped Monitoring in '%s'", engine->device);
 	blog(LOG_INFO,
 	     "Got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames",
-	     monitor->packets, monitor->frames);
-
-	monitor->packets = 0;
-	monitor->frames = 0;
+	     engine->packets, engine->frames);
+	blog(LOG_INFO,
+	     "Latency: %.1f ms average, %.1f ms peak; drift compensation "
+	     "up to %.0f ppm, %" PRIu64 " frames arrived too late to be mixed",
+	     (double)avg / 1000000.0, (double)mixer->latency_max / 1000000.0,
+	     mixer->max_correction * 1000000.0, mixer->late_frames);
 }
 
-static bool audio_monitor_init(struct audio_monitor *monitor,
-			       obs_source_t *source)
+static bool engine_init_sink(struct monitor_engine *engine,
+			     const struct audio_output_info *info)
 {
-	pthread_mutex_init_value(&monitor->playback_mutex);
-
-	monitor->source = source;
-
-	const char *id = obs->audio.monitoring_device_id;
-	if (!id)
-		return false;
-
-	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
-		obs_data_t *s = obs_source_get_settings(source);
-		const char *s_dev_id = obs_data_get_string(s, "device_id");
-		bool match = devices_match(s_dev_id, id);
-		obs_data_release(s);
-
-		if (match) {
-			monitor->ignore = true;
-			blog(LOG_INFO, "Prevented feedback-loop in '%s'",
-			     s_dev_id);
-			return true;
-		}
-	}
-
-	pulseaudio_init();
-
-	if (strcmp(id, "default") == 0)
-		get_default_id(&monitor->device);
+	if (strcmp(engine->id, "default") == 0)
+		get_default_id(&engine->device);
 	else
-		monitor->device = bstrdup(id);
+		engine->device = bstrdup(engine->id);
 
-	if (!monitor->device)
+	if (!engine->device)
 		return false;
 
 	if (pulseaudio_get_server_info(pulseaudio_server_info,
-				       (void *)monitor) < 0) {
+				       (void *)engine) < 0) {
 		blog(LOG_ERROR, "Unable to get server info !");
 		return false;
 	}
 
-	if (pulseaudio_get_sink_info(pulseaudio_sink_info, monitor->device,
-				     (void *)monitor) < 0) {
+	if (pulseaudio_get_sink_info(pulseaudio_sink_info, engine->device,
+				     (void *)engine) < 0) {
 		blog(LOG_ERROR, "Unable to get sink info !");
 		return false;
 	}
-	if (monitor->format == PA_SAMPLE_INVALID) {
+	if (engine->format == PA_SAMPLE_INVALID) {
 		blog(LOG_ERROR,
 		     "An error occurred while getting the source info!");
 		return false;
 	}
 
+	return true;
+}
+
+static bool engine_init(struct monitor_engine *engine)
+{
+	const struct audio_output_info *info =
+		audio_output_get_info(obs->audio.audio);
+	uint64_t latency = obs->audio.monitoring_latency_ms * 1000000ULL;
+
+	pulseaudio_init();
+
+	pthread_mutex_init_value(&engine->mutex);
+	if (pthread_mutex_init(&engine->mutex, NULL) != 0)
+		return false;
+
+	monitor_mixer_init(&engine->mixer, info->samples_per_sec,
+			   get_audio_channels(info->speakers), latency);
+
+	if (!engine_init_sink(engine, info))
+		return false;
+
 	pa_sample_spec spec;
-	spec.format = monitor->format;
-	spec.rate = (uint32_t)monitor->samples_per_sec;
-	spec.channels = monitor->channels;
+	spec.format = engine->format;
+	spec.rate = (uint32_t)engine->samples_per_sec;
+	spec.channels = engine->channels;
 
 	if (!pa_sample_spec_valid(&spec)) {
 		blog(LOG_ERROR, "Sample spec is not valid");
 		return false;
 	}
 
-	const struct audio_output_info *info =
-		audio_output_get_info(obs->audio.audio);
-
 	struct resample_info from = {.samples_per_sec = info->samples_per_sec,
 				     .speakers = info->speakers,
 				     .format = AUDIO_FORMAT_FLOAT_PLANAR};
 	struct resample_info to = {
-		.samples_per_sec = (uint32_t)monitor->samples_per_sec,
+		.samples_per_sec = (uint32_t)engine->samples_per_sec,
 		.speakers =
-			pulseaudio_channels_to_obs_speakers(monitor->channels),
-		.format = pulseaudio_to_obs_audio_format(monitor->format)};
+			pulseaudio_channels_to_obs_speakers(engine->channels),
+		.format = pulseaudio_to_obs_audio_format(engine->format)};
 
-	monitor->resampler = audio_resampler_create(&to, &from);
-	if (!monitor->resampler) {
+	engine->resampler = audio_resampler_create(&to, &from);
+	if (!engine->resampler) {
 		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
 		     "Failed to create resampler");
 		return false;
 	}
 
-	monitor->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
-	monitor->bytes_per_frame = pa_frame_size(&spec);
+	engine->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
+	engine->bytes_per_frame = pa_frame_size(&spec);
 
-	pa_channel_map channel_map = pulseaudio_channel_map(monitor->speakers);
+	pa_channel_map channel_map = pulseaudio_channel_map(engine->speakers);
 
-	monitor->stream = pulseaudio_stream_new(
-		obs_source_get_name(monitor->source), &spec, &channel_map);
-	if (!monitor->stream) {
+	engine->stream = pulseaudio_stream_new("Monitoring", &spec,
+					       &channel_map);
+	if (!engine->stream) {
 		blog(LOG_ERROR, "Unable to create stream");
 		return false;
 	}
 
-	monitor->attr.fragsize = (uint32_t)-1;
-	monitor->attr.maxlength = (uint32_t)-1;
-	monitor->attr.minreq = (uint32_t)-1;
-	monitor->attr.prebuf = (uint32_t)-1;
-	monitor->attr.tlength = pa_usec_to_bytes(25000, &spec);
+	engine->attr.fragsize = (uint32_t)-1;
+	engine->attr.maxlength = (uint32_t)-1;
+	engine->attr.minreq = (uint32_t)-1;
+	engine->attr.prebuf = (uint32_t)-1;
+	engine->attr.tlength =
+		pa_usec_to_bytes(engine->mixer.sink_target / 1000, &spec);
 
 	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
 				  PA_STREAM_AUTO_TIMING_UPDATE |
 				  PA_STREAM_START_CORKED;
 
 	int_fast32_t ret = pulseaudio_connect_playback(
-		monitor->stream, monitor->device, &monitor->attr, flags);
+		engine->stream, engine->device, &engine->attr, flags);
 	if (ret < 0) {
-		pulseaudio_stop_playback(monitor);
+		pulseaudio_stop_playback(engine);
 		blog(LOG_ERROR, "Unable to connect to stream");
 		return false;
 	}
 
-	blog(LOG_INFO, "Started Monitoring in '%s'", monitor->device);
+	blog(LOG_INFO, "Started Monitoring in '%s' with %" PRIu32 " ms latency",
+	     engine->device, obs->audio.monitoring_latency_ms);
 	return true;
 }
 
+static void engine_free(struct monitor_engine *engine)
+{
+	if (engine->stream) {
+		pulseaudio_stop_playback(engine);
+		log_engine_stats(engine);
+	}
+
+	pulseaudio_unref();
+
+	audio_resampler_destroy(engine->resampler);
+	monitor_mixer_free(&engine->mixer);
+	deque_free(&engine->new_data);
+	pthread_mutex_destroy(&engine->mutex);
+
+	bfree(engine->device);
+	bfree(engine->id);
+	bfree(engine);
+}
+
+static struct monitor_engine *engine_acquire(const char *id)
+{
+	struct monitor_engine *engine;
+
+	pthread_mutex_lock(&engines_mutex);
+
+	for (engine = engines; engine; engine = engine->next) {
+		if (strcmp(engine->id, id) == 0)
+			break;
+	}
+
+	if (!engine) {
+		engine = bzalloc(sizeof(*engine));
+		engine->id = bstrdup(id);
+
+		if (engine_init(engine)) {
+			engine->next = engines;
+			engine->listed = true;
+			engines = engine;
+		} else {
+			engine_free(engine);
+			engine = NULL;
+		}
+	}
+
+	if (engine)
+		engine->refs++;
+
+	pthread_mutex_unlock(&engines_mutex);
+	return engine;
+}
+
+static void engine_unlink(struct monitor_engine *engine)
+{
+	struct monitor_engine **prev = &engines;
+
+	if (!engine->listed)
+		return;
+
+	while (*prev != engine)
+		prev = &(*prev)->next;
+	*prev = engine->next;
+	engine->listed = false;
+}
+
+/* Keeps the engine running for the monitors still using it, but makes the
+ * next acquire create a new one with the current device and settings */
+static void engine_retire(struct monitor_engine *engine)
+{
+	pthread_mutex_lock(&engines_mutex);
+	engine_unlink(engine);
+	pthread_mutex_unlock(&engines_mutex);
+}
+
+static void engine_release(struct monitor_engine *engine)
+{
+	pthread_mutex_lock(&engines_mutex);
+
+	if (--engine->refs == 0) {
+		engine_unlink(engine);
+		engine_free(engine);
+	}
+
+	pthread_mutex_unlock(&engines_mutex);
+}
+
+static bool audio_monitor_init(struct audio_monitor *monitor,
+			       obs_source_t *source)
+{
+	monitor->source = source;
+
+	const char *id = obs->audio.monitoring_device_id;
+	if (!id)
+		return false;
+
+	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
+		obs_data_t *s = obs_source_get_settings(source);
+		const char *s_dev_id = obs_data_get_string(s, "device_id");
+		bool match = devices_match(s_dev_id, id);
+		obs_data_release(s);
+
+		if (match) {
+			monitor->ignore = true;
+			blog(LOG_INFO, "Prevented feedback-loop in '%s'",
+			     s_dev_id);
+			return true;
+		}
+	}
+
+	monitor->engine = engine_acquire(id);
+	return monitor->engine != NULL;
+}
+
 static void audio_monitor_init_final(struct audio_monitor *monitor)
 {
 	if (monitor->ignore)
@@ -501,14 +589,9 @@ static inline void audio_monitor_free(struct audio_monitor *monitor)
 		obs_source_remove_audio_capture_callback(
 			monitor->source, on_audio_playback, monitor);
 
-	audio_resampler_destroy(monitor->resampler);
-	deque_free(&monitor->new_data);
-
-	if (monitor->stream)
-		pulseaudio_stop_playback(monitor);
-	pulseaudio_unref();
-
-	bfree(monitor->device);
+	if (monitor->engine)
+		engine_release(monitor->engine);
+	monitor->engine = NULL;
 }
 
 struct audio_monitor *audio_monitor_create(obs_source_t *source)
@@ -537,11 +620,12 @@ void audio_monitor_reset(struct audio_monitor *monitor)
 {
 	struct audio_monitor new_monitor = {0};
 	bool success;
+
+	if (monitor->engine)
+		engine_retire(monitor->engine);
 	audio_monitor_free(monitor);
 
-	pthread_mutex_lock(&monitor->playback_mutex);
 	success = audio_monitor_init(&new_monitor, monitor->source);
-	pthread_mutex_unlock(&monitor->playback_mutex);
 
 	if (success) {
 		*monitor = new_monitor;
@@ -58,6 +58,8 @@ if(ENABLE_PULSEAUDIO)
     libobs
     PRIVATE
       audio-monitoring/pulse/pulseaudio-enum-devices.c
+      audio-monitoring/pulse/pulseaudio-mixer.c
+      audio-monitoring/pulse/pulseaudio-mixer.h
       audio-monitoring/pulse/pulseaudio-monitoring-available.c
       audio-monitoring/pulse/pulseaudio-output.c
       audio-monitoring/pulse/pulseaudio-wrapper.c
@@ -63,6 +63,8 @@ if(ENABLE_PULSEAUDIO)
     libobs
     PRIVATE
       audio-monitoring/pulse/pulseaudio-enum-devices.c
+      audio-monitoring/pulse/pulseaudio-mixer.c
+      audio-monitoring/pulse/pulseaudio-mixer.h
       audio-monitoring/pulse/pulseaudio-monitoring-available.c
       audio-monitoring/pulse/pulseaudio-output.c
       audio-monitoring/pulse/pulseaudio-wrapper.c
@@ -76,6 +78,15 @@ else()
   target_disable_feature(libobs "PulseAudio audio monitoring (Linux)")
 endif()
 
+find_package(Liburing)
+if(Liburing_FOUND)
+  target_compile_definitions(libobs PRIVATE HAVE_LIBURING)
+  target_link_libraries(libobs PRIVATE Liburing::Liburing)
+  target_enable_feature(libobs "io_uring file output backend (Linux)")
+else()
+  target_disable_feature(libobs "io_uring file output backend (Linux)")
+endif()
+
 if(TARGET gio::gio)
   target_sources(libobs PRIVATE util/platform-nix-dbus.c util/platform-nix-portal.c)
   target_link_libraries(libobs PRIVATE gio::gio)
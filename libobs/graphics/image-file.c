@@ -19,6 +19,8 @@
 #include "../util/base.h"
 #include "../util/platform.h"
 #include "../util/dstr.h"
+#include "../util/threading.h"
+#include "../util/darray.h"
 #include "vec4.h"
 
 #define blog(level, format, ...) \
@@ -56,12 +58,6 @@ static void bi_def_bitmap_modified(void *bitmap)
 	UNUSED_PARAMETER(bitmap);
 }
 
-static inline int get_full_decoded_gif_size(gs_image_file_t *image)
-{
-	return image->gif.width * image->gif.height * 4 *
-	       image->gif.frame_count;
-}
-
 static inline void *alloc_mem(gs_image_file_t *image, uint64_t *mem_usage,
 			      size_t size)
 {
@@ -72,13 +68,393 @@ static inline void *alloc_mem(gs_image_file_t *image, uint64_t *mem_usage,
 	return bzalloc(size);
 }
 
+/*
+ * Animated GIFs are decoded ahead into a small ring of frames, so that
+ * neither the tick nor memory use depend on how many frames there are.  All
+ * animated images share one decode thread, which decodes a frame at a time
+ * for whichever images have room in their ring.  Frames are decoded in the
+ * order they play in.  The tick takes the frame the animation is at off the
+ * ring, swapping buffers with the frame being shown, and lets the decoder
+ * know which frame that is.  When the frame after it isn't coming up next
+ * (frames were skipped, or playback was restarted), the decoder drops what
+ * it decoded ahead and carries on from there.
+ *
+ * The decoder parses the file into a gif of its own, so the decode thread
+ * only ever touches the decoder and never the image.  The first frame is
+ * kept, so that a restart shows it right away.
+ */
+
+#define GIF_RING_FRAMES 3
+
+struct gif_ring_frame {
+	uint8_t *data;
+	int frame;
+};
+
+struct gs_gif_decoder {
+	gif_animation gif;
+	gif_bitmap_callback_vt bitmap_callbacks;
+	enum gs_image_alpha_mode alpha_mode;
+	int last_decoded_frame;
+	uint8_t *first_frame;
+	bool registered;
+
+	/* Only changed with gif_worker_mutex held */
+	bool queued;
+
+	pthread_mutex_t mutex;
+	struct gif_ring_frame ring[GIF_RING_FRAMES];
+	size_t head;
+	size_t count;
+	int shown;
+	int want;
+	int next_frame;
+};
+
+static pthread_mutex_t gif_worker_start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t gif_worker_thread;
+static size_t gif_decoders = 0;
+static volatile bool gif_worker_stop = false;
+
+static pthread_mutex_t gif_worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct gs_gif_decoder *) gif_queue = {0};
+static struct gs_gif_decoder *gif_busy = NULL;
+static os_sem_t *gif_worker_sem = NULL;
+static os_event_t *gif_worker_idle = NULL;
+
+static inline void premultiply_frame(uint8_t *data, size_t area,
+				     enum gs_image_alpha_mode alpha_mode)
+{
+	if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB)
+		gs_premultiply_xyza_srgb_loop(data, area);
+	else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY)
+		gs_premultiply_xyza_loop(data, area);
+}
+
+/* Only called from one thread at a time, as the gif keeps the state of the
+ * last frame decoded */
+static bool decode_frame(struct gs_gif_decoder *decoder, int frame,
+			 uint8_t *data)
+{
+	gif_animation *gif = &decoder->gif;
+	const size_t area = (size_t)gif->width * gif->height;
+	int first_frame;
+
+	/* if looped, decode frame 0 */
+	first_frame = (frame < decoder->last_decoded_frame)
+			      ? 0
+			      : decoder->last_decoded_frame + 1;
+
+	/* decode missed frames */
+	for (int i = first_frame; i < frame; i++) {
+		if (gif_decode_frame(gif, i) != GIF_OK)
+			return false;
+	}
+
+	/* decode actual desired frame */
+	if (gif_decode_frame(gif, frame) != GIF_OK)
+		return false;
+
+	/* premultiplied after copying, as the next frame is drawn on top of
+	 * this one */
+	memcpy(data, gif->frame_image, area * 4);
+	premultiply_frame(data, area, decoder->alpha_mode);
+
+	decoder->last_decoded_frame = frame;
+	return true;
+}
+
+/* Call with mutex held */
+static bool frame_queued(struct gs_gif_decoder *decoder, int frame)
+{
+	for (size_t i = 0; i < decoder->count; i++) {
+		size_t idx = (decoder->head + i) % GIF_RING_FRAMES;
+		if (decoder->ring[idx].frame == frame)
+			return true;
+	}
+
+	return false;
+}
+
+/* Decodes the next frame into the ring.  Returns true if there is room for
+ * more. */
+static bool decode_ahead(struct gs_gif_decoder *decoder)
+{
+	int frame_count = (int)decoder->gif.frame_count;
+	struct gif_ring_frame *slot = NULL;
+	uint8_t *data = NULL;
+	bool success;
+	bool more;
+	int target;
+	int frame;
+
+	pthread_mutex_lock(&decoder->mutex);
+	target = decoder->want == decoder->shown
+			 ? (decoder->shown + 1) % frame_count
+			 : decoder->want;
+	if (target != decoder->next_frame &&
+	    !frame_queued(decoder, target)) {
+		decoder->count = 0;
+		decoder->next_frame = target;
+	}
+	if (decoder->count < GIF_RING_FRAMES) {
+		size_t idx = (decoder->head + decoder->count) % GIF_RING_FRAMES;
+		slot = &decoder->ring[idx];
+		data = slot->data;
+	}
+	frame = decoder->next_frame;
+	pthread_mutex_unlock(&decoder->mutex);
+
+	if (!slot)
+		return false;
+
+	success = decode_frame(decoder, frame, data);
+
+	pthread_mutex_lock(&decoder->mutex);
+	decoder->next_frame = (frame + 1) % frame_count;
+	if (success) {
+		slot->frame = frame;
+		decoder->count++;
+	}
+	more = decoder->count < GIF_RING_FRAMES;
+	pthread_mutex_unlock(&decoder->mutex);
+
+	/* broken frames are skipped, but wait for the next tick rather than
+	 * spinning through a file that won't decode */
+	return success && more;
+}
+
+/* Call with gif_worker_mutex held */
+static inline void queue_decoder(struct gs_gif_decoder *decoder)
+{
+	if (!decoder->queued) {
+		decoder->queued = true;
+		da_push_back(gif_queue, &decoder);
+		os_sem_post(gif_worker_sem);
+	}
+}
+
+static void wake_decoder(struct gs_gif_decoder *decoder)
+{
+	pthread_mutex_lock(&gif_worker_mutex);
+	queue_decoder(decoder);
+	pthread_mutex_unlock(&gif_worker_mutex);
+}
+
+/* Takes turns between the decoders, a frame at a time */
+static void *gif_decode_thread(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	os_set_thread_name("gif_decode_thread");
+
+	while (os_sem_wait(gif_worker_sem) == 0) {
+		struct gs_gif_decoder *decoder = NULL;
+
+		if (os_atomic_load_bool(&gif_worker_stop))
+			break;
+
+		pthread_mutex_lock(&gif_worker_mutex);
+		if (gif_queue.num) {
+			decoder = gif_queue.array[0];
+			decoder->queued = false;
+			da_erase(gif_queue, 0);
+		}
+		gif_busy = decoder;
+		pthread_mutex_unlock(&gif_worker_mutex);
+
+		if (!decoder)
+			continue;
+
+		bool more = decode_ahead(decoder);
+
+		pthread_mutex_lock(&gif_worker_mutex);
+		if (more)
+			queue_decoder(decoder);
+		gif_busy = NULL;
+		os_event_signal(gif_worker_idle);
+		pthread_mutex_unlock(&gif_worker_mutex);
+	}
+
+	return NULL;
+}
+
+/* Call with gif_worker_start_mutex held */
+static void stop_gif_worker(void)
+{
+	os_atomic_set_bool(&gif_worker_stop, true);
+	os_sem_post(gif_worker_sem);
+	pthread_join(gif_worker_thread, NULL);
+	os_atomic_set_bool(&gif_worker_stop, false);
+
+	da_free(gif_queue);
+	os_sem_destroy(gif_worker_sem);
+	os_event_destroy(gif_worker_idle);
+	gif_worker_sem = NULL;
+	gif_worker_idle = NULL;
+}
+
+/* Call with gif_worker_start_mutex held */
+static bool start_gif_worker(void)
+{
+	if (os_sem_init(&gif_worker_sem, 0) != 0)
+		return false;
+	if (os_event_init(&gif_worker_idle, OS_EVENT_TYPE_AUTO) != 0) {
+		os_sem_destroy(gif_worker_sem);
+		gif_worker_sem = NULL;
+		return false;
+	}
+	if (pthread_create(&gif_worker_thread, NULL, gif_decode_thread,
+			   NULL) != 0) {
+		os_event_destroy(gif_worker_idle);
+		os_sem_destroy(gif_worker_sem);
+		gif_worker_sem = NULL;
+		gif_worker_idle = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+static void gif_decoder_destroy(struct gs_gif_decoder *decoder)
+{
+	if (!decoder)
+		return;
+
+	if (decoder->registered) {
+		/* make sure the decode thread is done with it, it only puts
+		 * it back in the queue while decoding it */
+		pthread_mutex_lock(&gif_worker_mutex);
+		while (gif_busy == decoder) {
+			pthread_mutex_unlock(&gif_worker_mutex);
+			os_event_wait(gif_worker_idle);
+			pthread_mutex_lock(&gif_worker_mutex);
+		}
+		if (decoder->queued)
+			da_erase_item(gif_queue, &decoder);
+		pthread_mutex_unlock(&gif_worker_mutex);
+
+		pthread_mutex_lock(&gif_worker_start_mutex);
+		if (--gif_decoders == 0)
+			stop_gif_worker();
+		pthread_mutex_unlock(&gif_worker_start_mutex);
+	}
+
+	for (size_t i = 0; i < GIF_RING_FRAMES; i++)
+		bfree(decoder->ring[i].data);
+
+	gif_finalise(&decoder->gif);
+	bfree(decoder->first_frame);
+	pthread_mutex_destroy(&decoder->mutex);
+	bfree(decoder);
+}
+
+/* Decodes frame 0 into animation_frame_data.  The gif data is parsed again
+ * for the decoder's own gif, and is freed with the image after the decoder. */
+static struct gs_gif_decoder *
+gif_decoder_create(gs_image_file_t *image, size_t data_size,
+		   uint64_t *mem_usage, enum gs_image_alpha_mode alpha_mode)
+{
+	struct gs_gif_decoder *decoder = bzalloc(sizeof(*decoder));
+	const size_t size = (size_t)image->cx * image->cy * 4;
+	gif_result result;
+	bool started;
+
+	decoder->bitmap_callbacks = image->bitmap_callbacks;
+	decoder->alpha_mode = alpha_mode;
+	decoder->last_decoded_frame = -1;
+	decoder->next_frame = 1;
+
+	pthread_mutex_init_value(&decoder->mutex);
+	gif_create(&decoder->gif, &decoder->bitmap_callbacks);
+
+	for (size_t i = 0; i < GIF_RING_FRAMES; i++) {
+		decoder->ring[i].data = alloc_mem(image, mem_usage, size);
+		decoder->ring[i].frame = -1;
+	}
+	decoder->first_frame = alloc_mem(image, mem_usage, size);
+
+	/* canvas of the decoder's gif */
+	if (mem_usage)
+		*mem_usage += size;
+
+	do {
+		result = gif_initialise(&decoder->gif, data_size,
+					image->gif_data);
+		if (result < 0)
+			goto fail;
+	} while (result != GIF_OK);
+
+	if (pthread_mutex_init(&decoder->mutex, NULL) != 0)
+		goto fail;
+	if (!decode_frame(decoder, 0, decoder->first_frame))
+		goto fail;
+	memcpy(image->animation_frame_data, decoder->first_frame, size);
+
+	pthread_mutex_lock(&gif_worker_start_mutex);
+	started = gif_decoders || start_gif_worker();
+	if (started)
+		gif_decoders++;
+	pthread_mutex_unlock(&gif_worker_start_mutex);
+
+	if (!started)
+		goto fail;
+
+	decoder->registered = true;
+	wake_decoder(decoder);
+	return decoder;
+
+fail:
+	gif_decoder_destroy(decoder);
+	return NULL;
+}
+
+/* Shows the frame the animation is at if it has been decoded, and lets the
+ * decoder know which frame that is.  Returns true if the frame shown
+ * changed. */
+static bool take_frame(gs_image_file_t *image)
+{
+	struct gs_gif_decoder *decoder = image->gif_decoder;
+	bool taken = false;
+
+	pthread_mutex_lock(&decoder->mutex);
+	decoder->want = image->cur_frame;
+
+	while (decoder->shown != decoder->want && decoder->count) {
+		struct gif_ring_frame *slot = &decoder->ring[decoder->head];
+
+		decoder->head = (decoder->head + 1) % GIF_RING_FRAMES;
+		decoder->count--;
+
+		if (slot->frame == decoder->want) {
+			uint8_t *data = image->animation_frame_data;
+			image->animation_frame_data = slot->data;
+			slot->data = data;
+			decoder->shown = slot->frame;
+			taken = true;
+		}
+	}
+
+	/* restarted, or looped before frame 0 came off the ring */
+	if (decoder->want == 0 && decoder->shown != 0) {
+		memcpy(image->animation_frame_data, decoder->first_frame,
+		       (size_t)image->cx * image->cy * 4);
+		decoder->shown = 0;
+		taken = true;
+	}
+	pthread_mutex_unlock(&decoder->mutex);
+
+	/* the ring has room again, or the frame wanted isn't coming */
+	wake_decoder(decoder);
+	return taken;
+}
+
 static bool init_animated_gif(gs_image_file_t *image, const char *path,
 			      uint64_t *mem_usage,
 			      enum gs_image_alpha_mode alpha_mode)
 {
 	bool is_animated_gif = true;
 	gif_result result;
-	uint64_t max_size;
 	size_t size, size_read;
 	FILE *file;
 
@@ -125,25 +501,8 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 		goto fail;
 	}
 
-	max_size = (uint64_t)image->gif.width * (uint64_t)image->gif.height *
-		   (uint64_t)image->gif.frame_count * 4LLU;
-
-	if ((uint64_t)get_full_decoded_gif_size(image) != max_size) {
-		blog(LOG_WARNING, "Gif '%s' overflowed maximum pointer size",
-		     path);
-		goto fail;
-	}
-
 	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
 	if (image->is_animated_gif) {
-		gif_decode_frame(&image->gif, 0);
-
-		image->animation_frame_cache =
-			alloc_mem(image, mem_usage,
-				  image->gif.frame_count * sizeof(uint8_t *));
-		image->animation_frame_data = alloc_mem(
-			image, mem_usage, get_full_decoded_gif_size(image));
-
 		for (unsigned int i = 0; i < image->gif.frame_count; i++) {
 			if (gif_decode_frame(&image->gif, i) != GIF_OK)
 				blog(LOG_WARNING,
@@ -152,24 +511,24 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 				     i, path);
 		}
 
-		gif_decode_frame(&image->gif, 0);
-
 		image->cx = (uint32_t)image->gif.width;
 		image->cy = (uint32_t)image->gif.height;
 		image->format = GS_RGBA;
 
+		image->animation_frame_data = alloc_mem(
+			image, mem_usage, (size_t)4 * image->cx * image->cy);
+
 		if (mem_usage) {
 			*mem_usage += (size_t)4 * image->cx * image->cy;
 			*mem_usage += size;
 		}
 
-		if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
-			gs_premultiply_xyza_srgb_loop(image->gif.frame_image,
-						      (size_t)image->cx *
-							      image->cy);
-		} else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY) {
-			gs_premultiply_xyza_loop(image->gif.frame_image,
-						 (size_t)image->cx * image->cy);
+		image->gif_decoder =
+			gif_decoder_create(image, size, mem_usage, alpha_mode);
+		if (!image->gif_decoder) {
+			blog(LOG_WARNING,
+			     "Failed to create gif decoder for '%s'", path);
+			goto fail;
 		}
 	} else {
 		gif_finalise(&image->gif);
@@ -242,16 +601,16 @@ void gs_image_file_free(gs_image_file_t *image)
 	if (!image)
 		return;
 
+	gif_decoder_destroy(image->gif_decoder);
+
 	if (image->loaded) {
-		if (image->is_animated_gif) {
+		if (image->is_animated_gif)
 			gif_finalise(&image->gif);
-			bfree(image->animation_frame_cache);
-			bfree(image->animation_frame_data);
-		}
 
 		gs_texture_destroy(image->texture);
 	}
 
+	bfree(image->animation_frame_data);
 	bfree(image->texture_data);
 	bfree(image->gif_data);
 	memset(image, 0, sizeof(*image));
@@ -291,7 +650,8 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 	if (image->is_animated_gif) {
 		image->texture = gs_texture_create(
 			image->cx, image->cy, image->format, 1,
-			(const uint8_t **)&image->gif.frame_image, GS_DYNAMIC);
+			(const uint8_t **)&image->animation_frame_data,
+			GS_DYNAMIC);
 
 	} else {
 		image->texture = gs_texture_create(
@@ -335,52 +695,8 @@ static inline int calculate_new_frame(gs_image_file_t *image,
 	return new_frame;
 }
 
-static void decode_new_frame(gs_image_file_t *image, int new_frame,
-			     enum gs_image_alpha_mode alpha_mode)
-{
-	if (!image->animation_frame_cache[new_frame]) {
-		int last_frame;
-
-		/* if looped, decode frame 0 */
-		last_frame = (new_frame < image->last_decoded_frame)
-				     ? 0
-				     : image->last_decoded_frame + 1;
-
-		/* decode missed frames */
-		for (int i = last_frame; i < new_frame; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
-				return;
-		}
-
-		/* decode actual desired frame */
-		if (gif_decode_frame(&image->gif, new_frame) == GIF_OK) {
-			const size_t area =
-				(size_t)image->gif.width * image->gif.height;
-			size_t pos = new_frame * area * 4;
-			image->animation_frame_cache[new_frame] =
-				image->animation_frame_data + pos;
-
-			if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
-				gs_premultiply_xyza_srgb_loop(
-					image->gif.frame_image, area);
-			} else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY) {
-				gs_premultiply_xyza_loop(image->gif.frame_image,
-							 area);
-			}
-
-			memcpy(image->animation_frame_cache[new_frame],
-			       image->gif.frame_image, area * 4);
-
-			image->last_decoded_frame = new_frame;
-		}
-	}
-
-	image->cur_frame = new_frame;
-}
-
 static bool gs_image_file_tick_internal(gs_image_file_t *image,
-					uint64_t elapsed_time_ns,
-					enum gs_image_alpha_mode alpha_mode)
+					uint64_t elapsed_time_ns)
 {
 	int loops;
 
@@ -391,75 +707,61 @@ static bool gs_image_file_tick_internal(gs_image_file_t *image,
 	if (loops >= 0xFFFF)
 		loops = 0;
 
-	if (!loops || image->cur_loop < loops) {
-		int new_frame =
+	if (!loops || image->cur_loop < loops)
+		image->cur_frame =
 			calculate_new_frame(image, elapsed_time_ns, loops);
 
-		if (new_frame != image->cur_frame) {
-			decode_new_frame(image, new_frame, alpha_mode);
-			return true;
-		}
-	}
-
-	return false;
+	/* a frame that wasn't decoded in time is shown once it is */
+	return take_frame(image);
 }
 
 bool gs_image_file_tick(gs_image_file_t *image, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(image, elapsed_time_ns, false);
+	return gs_image_file_tick_internal(image, elapsed_time_ns);
 }
 
 bool gs_image_file2_tick(gs_image_file2_t *if2, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(&if2->image, elapsed_time_ns, false);
+	return gs_image_file_tick_internal(&if2->image, elapsed_time_ns);
 }
 
 bool gs_image_file3_tick(gs_image_file3_t *if3, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(&if3->image2.image, elapsed_time_ns,
-					   if3->alpha_mode);
+	return gs_image_file_tick_internal(&if3->image2.image, elapsed_time_ns);
 }
 
 bool gs_image_file4_tick(gs_image_file4_t *if4, uint64_t elapsed_time_ns)
 {
 	return gs_image_file_tick_internal(&if4->image3.image2.image,
-					   elapsed_time_ns,
-					   if4->image3.alpha_mode);
+					   elapsed_time_ns);
 }
 
-static void
-gs_image_file_update_texture_internal(gs_image_file_t *image,
-				      enum gs_image_alpha_mode alpha_mode)
+static void gs_image_file_update_texture_internal(gs_image_file_t *image)
 {
 	if (!image->is_animated_gif || !image->loaded)
 		return;
 
-	if (!image->animation_frame_cache[image->cur_frame])
-		decode_new_frame(image, image->cur_frame, alpha_mode);
-
-	gs_texture_set_image(image->texture,
-			     image->animation_frame_cache[image->cur_frame],
+	take_frame(image);
+	gs_texture_set_image(image->texture, image->animation_frame_data,
 			     image->gif.width * 4, false);
 }
 
 void gs_image_file_update_texture(gs_image_file_t *image)
 {
-	gs_image_file_update_texture_internal(image, false);
+	gs_image_file_update_texture_internal(image);
 }
 
 void gs_image_file2_update_texture(gs_image_file2_t *if2)
 {
-	gs_image_file_update_texture_internal(&if2->image, false);
+	gs_image_file_update_texture_internal(&if2->image);
 }
 
 void gs_image_file3_update_texture(gs_image_file3_t *if3)
 {
-	gs_image_file_update_texture_internal(&if3->image2.image,
-					      if3->alpha_mode);
+	gs_image_file_update_texture_internal(&if3->image2.image);
 }
 
 void gs_image_file4_update_texture(gs_image_file4_t *if4)
 {
-	gs_image_file_update_texture_internal(&if4->image3.image2.image,
-					      if4->image3.alpha_mode);
+	gs_image_file_update_texture_internal(&if4->image3.image2.image);
 }
@@ -24,6 +24,8 @@
 extern "C" {
 #endif
 
+struct gs_gif_decoder;
+
 struct gs_image_file {
 	gs_texture_t *texture;
 	enum gs_color_format format;
@@ -35,7 +37,9 @@ struct gs_image_file {
 
 	gif_animation gif;
 	uint8_t *gif_data;
-	uint8_t **animation_frame_cache;
+	/* owned by the image, decodes on a thread shared by all animated
+	 * images using its own copy of the gif */
+	struct gs_gif_decoder *gif_decoder;
 	uint8_t *animation_frame_data;
 	uint64_t cur_time;
 	int cur_frame;
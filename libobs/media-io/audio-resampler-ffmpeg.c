@@ -17,12 +17,14 @@
 
 #include "../util/bmem.h"
 #include "audio-resampler.h"
+#include "audio-resampler-polyphase.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
 struct audio_resampler {
+	struct polyphase_resampler *polyphase;
 	struct SwrContext *context;
 	bool opened;
 
@@ -103,6 +105,12 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	struct audio_resampler *rs = bzalloc(sizeof(struct audio_resampler));
 	int errcode;
 
+	/* Common rate pairs don't need a swresample context of their own */
+	if (polyphase_resampler_supported(dst, src)) {
+		rs->polyphase = polyphase_resampler_create(dst, src);
+		return rs;
+	}
+
 	rs->opened = false;
 	rs->input_freq = src->samples_per_sec;
 	rs->input_format = convert_audio_format(src->format);
@@ -181,6 +189,7 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 void audio_resampler_destroy(audio_resampler_t *rs)
 {
 	if (rs) {
+		polyphase_resampler_destroy(rs->polyphase);
 		if (rs->context)
 			swr_free(&rs->context);
 		if (rs->output_buffer[0])
@@ -197,6 +206,11 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 	if (!rs)
 		return false;
 
+	if (rs->polyphase)
+		return polyphase_resampler_resample(rs->polyphase, output,
+						    out_frames, ts_offset,
+						    input, in_frames);
+
 	struct SwrContext *context = rs->context;
 	int ret;
 
@@ -0,0 +1,386 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+
+#include "../util/bmem.h"
+#include "../util/threading.h"
+#include "../util/sse-intrin.h"
+#include "audio-resampler-polyphase.h"
+
+/* Same filter length and cutoff as the swresample defaults, with a Kaiser
+ * window.  When downsampling, the filter is widened by the decimation
+ * ratio so the stopband stays where it was. */
+#define HALF_TAPS 16
+#define CUTOFF 0.97
+#define KAISER_BETA 9.0
+
+struct polyphase_filter {
+	struct polyphase_filter *next;
+	long refs;
+
+	uint32_t up;
+	uint32_t down;
+	uint32_t taps;
+
+	/* up rows of taps coefficients, one row per output phase */
+	float *coeffs;
+};
+
+static pthread_mutex_t filters_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct polyphase_filter *filters = NULL;
+
+struct polyphase_resampler {
+	struct polyphase_filter *filter;
+
+	uint32_t in_freq;
+	enum audio_format in_format;
+	enum audio_format out_format;
+	uint32_t channels;
+
+	/* Input not yet consumed by the filter.  The next output sample is at
+	 * pos + phase / up in this history. */
+	float *history[MAX_AUDIO_CHANNELS];
+	size_t history_len;
+	size_t history_size;
+	size_t pos;
+	uint32_t phase;
+
+	float *output[MAX_AUDIO_CHANNELS];
+	size_t output_size;
+};
+
+static inline uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+bool polyphase_resampler_supported(const struct resample_info *dst,
+				   const struct resample_info *src)
+{
+	uint32_t lo = src->samples_per_sec;
+	uint32_t hi = dst->samples_per_sec;
+
+	if (lo > hi) {
+		uint32_t t = lo;
+		lo = hi;
+		hi = t;
+	}
+
+	if (!(lo == 44100 && hi == 48000) && !(lo == 48000 && hi == 96000))
+		return false;
+	if (dst->format != AUDIO_FORMAT_FLOAT &&
+	    dst->format != AUDIO_FORMAT_FLOAT_PLANAR)
+		return false;
+
+	return src->format != AUDIO_FORMAT_UNKNOWN &&
+	       src->speakers != SPEAKERS_UNKNOWN &&
+	       src->speakers == dst->speakers;
+}
+
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (int k = 1; k < 32; k++) {
+		double f = x / (2.0 * k);
+		term *= f * f;
+		sum += term;
+	}
+
+	return sum;
+}
+
+static struct polyphase_filter *filter_create(uint32_t up, uint32_t down)
+{
+	struct polyphase_filter *f = bzalloc(sizeof(*f));
+	double fc = CUTOFF * (up < down ? (double)up / (double)down : 1.0);
+
+	/* Keep rows a multiple of 8 taps for the SSE dot product */
+	uint32_t half = (uint32_t)ceil(HALF_TAPS / fc);
+	half = (half + 3) & ~3;
+
+	f->up = up;
+	f->down = down;
+	f->taps = half * 2;
+	f->coeffs = bmalloc(sizeof(float) * up * f->taps);
+
+	for (uint32_t p = 0; p < up; p++) {
+		float *row = f->coeffs + p * f->taps;
+		double frac = (double)p / (double)up;
+		double sum = 0.0;
+
+		for (uint32_t j = 0; j < f->taps; j++) {
+			double t = (double)j - (double)half + 1.0 - frac;
+			double x = t / (double)half;
+			double w = 0.0;
+			double s = 1.0;
+
+			if (fabs(x) < 1.0)
+				w = bessel_i0(KAISER_BETA * sqrt(1.0 - x * x)) /
+				    bessel_i0(KAISER_BETA);
+			if (t != 0.0)
+				s = sin(M_PI * fc * t) / (M_PI * fc * t);
+
+			row[j] = (float)(fc * s * w);
+			sum += row[j];
+		}
+
+		/* Unity gain at DC for every phase */
+		for (uint32_t j = 0; j < f->taps; j++)
+			row[j] = (float)(row[j] / sum);
+	}
+
+	return f;
+}
+
+static struct polyphase_filter *filter_acquire(uint32_t up, uint32_t down)
+{
+	struct polyphase_filter *f;
+
+	pthread_mutex_lock(&filters_mutex);
+
+	for (f = filters; f; f = f->next) {
+		if (f->up == up && f->down == down)
+			break;
+	}
+
+	if (!f) {
+		f = filter_create(up, down);
+		f->next = filters;
+		filters = f;
+	}
+
+	f->refs++;
+
+	pthread_mutex_unlock(&filters_mutex);
+	return f;
+}
+
+static void filter_release(struct polyphase_filter *f)
+{
+	pthread_mutex_lock(&filters_mutex);
+
+	if (--f->refs == 0) {
+		struct polyphase_filter **prev = &filters;
+		while (*prev != f)
+			prev = &(*prev)->next;
+		*prev = f->next;
+
+		bfree(f->coeffs);
+		bfree(f);
+	}
+
+	pthread_mutex_unlock(&filters_mutex);
+}
+
+static void resize_history(struct polyphase_resampler *prs, size_t size)
+{
+	if (size <= prs->history_size)
+		return;
+
+	for (uint32_t c = 0; c < prs->channels; c++)
+		prs->history[c] =
+			brealloc(prs->history[c], size * sizeof(float));
+	prs->history_size = size;
+}
+
+struct polyphase_resampler *
+polyphase_resampler_create(const struct resample_info *dst,
+			   const struct resample_info *src)
+{
+	struct polyphase_resampler *prs;
+	uint32_t div;
+
+	if (!polyphase_resampler_supported(dst, src))
+		return NULL;
+
+	div = gcd(dst->samples_per_sec, src->samples_per_sec);
+
+	prs = bzalloc(sizeof(*prs));
+	prs->filter = filter_acquire(dst->samples_per_sec / div,
+				     src->samples_per_sec / div);
+	prs->in_freq = src->samples_per_sec;
+	prs->in_format = src->format;
+	prs->out_format = dst->format;
+	prs->channels = get_audio_channels(src->speakers);
+
+	/* Prime the history with silence so that the first output sample
+	 * lines up with the first input sample */
+	prs->history_len = prs->filter->taps / 2 - 1;
+	prs->pos = prs->history_len;
+	resize_history(prs, prs->filter->taps * 4);
+	for (uint32_t c = 0; c < prs->channels; c++)
+		memset(prs->history[c], 0, prs->history_len * sizeof(float));
+
+	return prs;
+}
+
+void polyphase_resampler_destroy(struct polyphase_resampler *prs)
+{
+	if (!prs)
+		return;
+
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+		bfree(prs->history[c]);
+		bfree(prs->output[c]);
+	}
+
+	filter_release(prs->filter);
+	bfree(prs);
+}
+
+#define CONVERT_INPUT(type, expr)                               \
+	do {                                                    \
+		const type *in = (const type *)plane + offset;  \
+		for (uint32_t i = 0; i < frames; i++) {         \
+			type v = in[i * step];                  \
+			dst[i] = (expr);                        \
+		}                                               \
+	} while (false)
+
+static void append_input(struct polyphase_resampler *prs,
+			 const uint8_t *const input[], uint32_t frames)
+{
+	bool planar = is_audio_planar(prs->in_format);
+	size_t step = planar ? 1 : prs->channels;
+
+	resize_history(prs, prs->history_len + frames);
+
+	for (uint32_t c = 0; c < prs->channels; c++) {
+		const uint8_t *plane = planar ? input[c] : input[0];
+		size_t offset = planar ? 0 : c;
+		float *dst = prs->history[c] + prs->history_len;
+
+		switch (prs->in_format) {
+		case AUDIO_FORMAT_U8BIT:
+		case AUDIO_FORMAT_U8BIT_PLANAR:
+			CONVERT_INPUT(uint8_t, ((float)v - 128.0f) / 128.0f);
+			break;
+		case AUDIO_FORMAT_16BIT:
+		case AUDIO_FORMAT_16BIT_PLANAR:
+			CONVERT_INPUT(int16_t, (float)v / 32768.0f);
+			break;
+		case AUDIO_FORMAT_32BIT:
+		case AUDIO_FORMAT_32BIT_PLANAR:
+			CONVERT_INPUT(int32_t, (float)v / 2147483648.0f);
+			break;
+		case AUDIO_FORMAT_FLOAT:
+		case AUDIO_FORMAT_FLOAT_PLANAR:
+			CONVERT_INPUT(float, v);
+			break;
+		case AUDIO_FORMAT_UNKNOWN:
+			break;
+		}
+	}
+
+	prs->history_len += frames;
+}
+
+static inline float dot_product(const float *x, const float *h, size_t taps)
+{
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	for (size_t i = 0; i < taps; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(x + i),
+						   _mm_load_ps(h + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(x + i + 4),
+						   _mm_load_ps(h + i + 4)));
+	}
+
+	sum0 = _mm_add_ps(sum0, sum1);
+	sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+	sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 0x55));
+	return _mm_cvtss_f32(sum0);
+}
+
+bool polyphase_resampler_resample(struct polyphase_resampler *prs,
+				  uint8_t *output[], uint32_t *out_frames,
+				  uint64_t *ts_offset,
+				  const uint8_t *const input[],
+				  uint32_t in_frames)
+{
+	const struct polyphase_filter *f = prs->filter;
+	const size_t half = f->taps / 2;
+	bool planar = is_audio_planar(prs->out_format);
+	size_t step = planar ? 1 : prs->channels;
+	size_t estimated;
+	size_t frames = 0;
+	size_t pos = 0;
+	uint32_t phase = 0;
+
+	/* Time from the next output sample to the end of the input so far */
+	*ts_offset = util_mul_div64(
+		(uint64_t)(prs->history_len - prs->pos) * f->up - prs->phase,
+		1000000000ULL, (uint64_t)prs->in_freq * f->up);
+
+	append_input(prs, input, in_frames);
+
+	estimated = (prs->history_len - prs->pos) * f->up / f->down + 1;
+	if (estimated > prs->output_size) {
+		size_t planes = planar ? prs->channels : 1;
+		for (size_t c = 0; c < planes; c++)
+			prs->output[c] = brealloc(prs->output[c],
+						  estimated * step *
+							  sizeof(float));
+		prs->output_size = estimated;
+	}
+
+	for (uint32_t c = 0; c < prs->channels; c++) {
+		const float *history = prs->history[c] + 1;
+		float *out = planar ? prs->output[c] : prs->output[0] + c;
+
+		pos = prs->pos;
+		phase = prs->phase;
+		frames = 0;
+
+		while (pos + half < prs->history_len) {
+			const float *row = f->coeffs + phase * f->taps;
+
+			out[frames * step] =
+				dot_product(history + pos - half, row, f->taps);
+			frames++;
+
+			phase += f->down;
+			pos += phase / f->up;
+			phase %= f->up;
+		}
+	}
+
+	/* Drop the input that no later output sample reaches back to */
+	size_t drop = pos + 1 - half;
+	for (uint32_t c = 0; c < prs->channels; c++)
+		memmove(prs->history[c], prs->history[c] + drop,
+			(prs->history_len - drop) * sizeof(float));
+
+	prs->history_len -= drop;
+	prs->pos = pos - drop;
+	prs->phase = phase;
+
+	for (size_t c = 0; c < (planar ? prs->channels : 1); c++)
+		output[c] = (uint8_t *)prs->output[c];
+
+	*out_frames = (uint32_t)frames;
+	return true;
+}
@@ -0,0 +1,54 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "audio-resampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Native polyphase resampler for the rate pairs that come up all the time,
+ * 44.1 <-> 48 kHz and 48 <-> 96 kHz, to float output without remixing.
+ *
+ * The filter tables only depend on the rate pair, so every resampler of the
+ * same pair shares one refcounted table.  Per resampler there is only the
+ * input history of each channel.
+ */
+
+struct polyphase_resampler;
+
+extern bool polyphase_resampler_supported(const struct resample_info *dst,
+					  const struct resample_info *src);
+
+extern struct polyphase_resampler *
+polyphase_resampler_create(const struct resample_info *dst,
+			   const struct resample_info *src);
+extern void polyphase_resampler_destroy(struct polyphase_resampler *prs);
+
+extern bool polyphase_resampler_resample(struct polyphase_resampler *prs,
+					 uint8_t *output[],
+					 uint32_t *out_frames,
+					 uint64_t *ts_offset,
+					 const uint8_t *const input[],
+					 uint32_t in_frames);
+
+#ifdef __cplusplus
+}
+#endif
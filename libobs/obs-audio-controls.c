@@ -61,9 +61,29 @@ struct meter_cb {
 	void *param;
 };
 
+/* Levels of one source, computed once per audio block and shared by all
+ * volmeters attached to that source */
+struct obs_audio_meter {
+	pthread_mutex_t mutex;
+	obs_source_t *source;
+	long refs;
+
+	DARRAY(struct obs_volmeter *) volmeters;
+	/* Copy of volmeters the levels are handed to, only used on the audio
+	 * thread */
+	DARRAY(struct obs_volmeter *) dispatch;
+
+	float prev_samples[MAX_AUDIO_CHANNELS][4];
+
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float sample_peak[MAX_AUDIO_CHANNELS];
+	float true_peak[MAX_AUDIO_CHANNELS];
+};
+
 struct obs_volmeter {
 	pthread_mutex_t mutex;
 	obs_source_t *source;
+	struct obs_audio_meter *meter;
 	enum obs_fader_type type;
 	float cur_db;
 
@@ -72,10 +92,6 @@ struct obs_volmeter {
 
 	enum obs_peak_meter_type peak_meter_type;
 	unsigned int update_ms;
-	float prev_samples[MAX_AUDIO_CHANNELS][4];
-
-	float magnitude[MAX_AUDIO_CHANNELS];
-	float peak[MAX_AUDIO_CHANNELS];
 };
 
 static float cubic_def_to_db(const float def)
@@ -318,13 +334,17 @@ static int get_nr_channels_from_audio_data(const struct audio_data *data)
  * The four samples have location t=-1.5, -0.5, +0.5, +1.5
  * The oversamples are taken at locations t=-0.3, -0.1, +0.1, +0.3
  *
+ * The sample peak falls out of the same pass, so it is returned as well for
+ * sources that are shown with both kinds of meter.
+ *
  * @param previous_samples  Last 4 samples from the previous iteration.
  * @param samples           The samples to find the peak in.
  * @param nr_samples        Number of sets of 4 samples.
+ * @param sample_peak       Receives the sample peak of the samples.
  * @returns 5 times oversampled true-peak from the set of samples.
  */
 static float get_true_peak(__m128 previous_samples, const float *samples,
-			   size_t nr_samples)
+			   size_t nr_samples, float *sample_peak)
 {
 	/* These are normalized-sinc parameters for interpolating over sample
 	 * points which are located at x-coords: -1.5, -0.5, +0.5, +1.5.
@@ -340,13 +360,13 @@ static float get_true_peak(__m128 previous_samples, const float *samples,
 
 	__m128 work = previous_samples;
 	__m128 peak = previous_samples;
+	__m128 s_peak = previous_samples;
 	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
 		__m128 new_work = _mm_load_ps(&samples[i]);
 		__m128 intrp_samples;
 
 		/* Include the actual sample values in the peak. */
-		__m128 abs_new_work = abs_ps(new_work);
-		peak = _mm_max_ps(peak, abs_new_work);
+		s_peak = _mm_max_ps(s_peak, abs_ps(new_work));
 
 		/* Shift in the next point. */
 		SHIFT_RIGHT_2PS(new_work, work);
@@ -367,7 +387,8 @@ static float get_true_peak(__m128 previous_samples, const float *samples,
 	}
 
 	float r;
-	hmax_ps(r, peak);
+	hmax_ps(*sample_peak, s_peak);
+	hmax_ps(r, _mm_max_ps(peak, s_peak));
 	return r;
 }
 
@@ -388,10 +409,12 @@ static float get_sample_peak(__m128 previous_samples, const float *samples,
 	return r;
 }
 
-static void volmeter_process_peak_last_samples(obs_volmeter_t *volmeter,
-					       int channel_nr, float *samples,
-					       size_t nr_samples)
+static void audio_meter_process_last_samples(struct obs_audio_meter *meter,
+					     int channel_nr, float *samples,
+					     size_t nr_samples)
 {
+	float *prev = meter->prev_samples[channel_nr];
+
 	/* Take the last 4 samples that need to be used for the next peak
 	 * calculation. If there are less than 4 samples in total the new
 	 * samples shift out the old samples. */
@@ -400,40 +423,34 @@ static void volmeter_process_peak_last_samples(obs_volmeter_t *volmeter,
 	case 0:
 		break;
 	case 1:
-		volmeter->prev_samples[channel_nr][0] =
-			volmeter->prev_samples[channel_nr][1];
-		volmeter->prev_samples[channel_nr][1] =
-			volmeter->prev_samples[channel_nr][2];
-		volmeter->prev_samples[channel_nr][2] =
-			volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
+		prev[0] = prev[1];
+		prev[1] = prev[2];
+		prev[2] = prev[3];
+		prev[3] = samples[nr_samples - 1];
 		break;
 	case 2:
-		volmeter->prev_samples[channel_nr][0] =
-			volmeter->prev_samples[channel_nr][2];
-		volmeter->prev_samples[channel_nr][1] =
-			volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
+		prev[0] = prev[2];
+		prev[1] = prev[3];
+		prev[2] = samples[nr_samples - 2];
+		prev[3] = samples[nr_samples - 1];
 		break;
 	case 3:
-		volmeter->prev_samples[channel_nr][0] =
-			volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][1] = samples[nr_samples - 3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
+		prev[0] = prev[3];
+		prev[1] = samples[nr_samples - 3];
+		prev[2] = samples[nr_samples - 2];
+		prev[3] = samples[nr_samples - 1];
 		break;
 	default:
-		volmeter->prev_samples[channel_nr][0] = samples[nr_samples - 4];
-		volmeter->prev_samples[channel_nr][1] = samples[nr_samples - 3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
+		prev[0] = samples[nr_samples - 4];
+		prev[1] = samples[nr_samples - 3];
+		prev[2] = samples[nr_samples - 2];
+		prev[3] = samples[nr_samples - 1];
 	}
 }
 
-static void volmeter_process_peak(obs_volmeter_t *volmeter,
-				  const struct audio_data *data,
-				  int nr_channels)
+static void audio_meter_process_peak(struct obs_audio_meter *meter,
+				     const struct audio_data *data,
+				     int nr_channels, bool true_peak)
 {
 	int nr_samples = data->frames;
 	int channel_nr = 0;
@@ -446,47 +463,44 @@ static void volmeter_process_peak(obs_volmeter_t *volmeter,
 			printf("Audio plane %i is not aligned %p skipping "
 			       "peak volume measurement.\n",
 			       plane_nr, samples);
-			volmeter->peak[channel_nr] = 1.0;
+			meter->sample_peak[channel_nr] = 1.0;
+			meter->true_peak[channel_nr] = 1.0;
 			channel_nr++;
 			continue;
 		}
 
-		/* volmeter->prev_samples may not be aligned to 16 bytes;
+		/* meter->prev_samples may not be aligned to 16 bytes;
 		 * use unaligned load. */
 		__m128 previous_samples =
-			_mm_loadu_ps(volmeter->prev_samples[channel_nr]);
-
-		float peak;
-		switch (volmeter->peak_meter_type) {
-		case TRUE_PEAK_METER:
-			peak = get_true_peak(previous_samples, samples,
-					     nr_samples);
-			break;
-
-		case SAMPLE_PEAK_METER:
-		default:
-			peak = get_sample_peak(previous_samples, samples,
-					       nr_samples);
-			break;
+			_mm_loadu_ps(meter->prev_samples[channel_nr]);
+
+		/* The true peak is only worth its cost while a volmeter
+		 * shows it; it is left stale otherwise. */
+		if (true_peak) {
+			meter->true_peak[channel_nr] = get_true_peak(
+				previous_samples, samples, nr_samples,
+				&meter->sample_peak[channel_nr]);
+		} else {
+			meter->sample_peak[channel_nr] = get_sample_peak(
+				previous_samples, samples, nr_samples);
 		}
 
-		volmeter_process_peak_last_samples(volmeter, channel_nr,
-						   samples, nr_samples);
-
-		volmeter->peak[channel_nr] = peak;
+		audio_meter_process_last_samples(meter, channel_nr, samples,
+						 nr_samples);
 
 		channel_nr++;
 	}
 
 	/* Clear the peak of the channels that have not been handled. */
 	for (; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
-		volmeter->peak[channel_nr] = 0.0;
+		meter->sample_peak[channel_nr] = 0.0;
+		meter->true_peak[channel_nr] = 0.0;
 	}
 }
 
-static void volmeter_process_magnitude(obs_volmeter_t *volmeter,
-				       const struct audio_data *data,
-				       int nr_channels)
+static void audio_meter_process_magnitude(struct obs_audio_meter *meter,
+					  const struct audio_data *data,
+					  int nr_channels)
 {
 	size_t nr_samples = data->frames;
 
@@ -502,26 +516,17 @@ static void volmeter_process_magnitude(obs_volmeter_t *volmeter,
 			float sample = samples[i];
 			sum += sample * sample;
 		}
-		volmeter->magnitude[channel_nr] = sqrtf(sum / nr_samples);
+		meter->magnitude[channel_nr] = sqrtf(sum / nr_samples);
 
 		channel_nr++;
 	}
 }
 
-static void volmeter_process_audio_data(obs_volmeter_t *volmeter,
-					const struct audio_data *data)
+static void volmeter_levels_received(struct obs_volmeter *volmeter,
+				     const struct obs_audio_meter *meter,
+				     bool muted)
 {
-	int nr_channels = get_nr_channels_from_audio_data(data);
-
-	volmeter_process_peak(volmeter, data, nr_channels);
-	volmeter_process_magnitude(volmeter, data, nr_channels);
-}
-
-static void volmeter_source_data_received(void *vptr, obs_source_t *source,
-					  const struct audio_data *data,
-					  bool muted)
-{
-	struct obs_volmeter *volmeter = (struct obs_volmeter *)vptr;
+	const float *levels;
 	float mul;
 	float magnitude[MAX_AUDIO_CHANNELS];
 	float peak[MAX_AUDIO_CHANNELS];
@@ -529,21 +534,22 @@ static void volmeter_source_data_received(void *vptr, obs_source_t *source,
 
 	pthread_mutex_lock(&volmeter->mutex);
 
-	volmeter_process_audio_data(volmeter, data);
+	levels = volmeter->peak_meter_type == TRUE_PEAK_METER
+			 ? meter->true_peak
+			 : meter->sample_peak;
 
 	// Adjust magnitude/peak based on the volume level set by the user.
 	// And convert to dB.
-	mul = muted && !obs_source_muted(source) ? 0.0f
-						 : db_to_mul(volmeter->cur_db);
+	mul = muted ? 0.0f : db_to_mul(volmeter->cur_db);
 	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS;
 	     channel_nr++) {
 		magnitude[channel_nr] =
-			mul_to_db(volmeter->magnitude[channel_nr] * mul);
-		peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr] * mul);
+			mul_to_db(meter->magnitude[channel_nr] * mul);
+		peak[channel_nr] = mul_to_db(levels[channel_nr] * mul);
 
 		/* The input-peak is NOT adjusted with volume, so that the user
 		 * can check the input-gain. */
-		input_peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr]);
+		input_peak[channel_nr] = mul_to_db(levels[channel_nr]);
 	}
 
 	pthread_mutex_unlock(&volmeter->mutex);
@@ -551,6 +557,111 @@ static void volmeter_source_data_received(void *vptr, obs_source_t *source,
 	signal_levels_updated(volmeter, magnitude, peak, input_peak);
 }
 
+static bool audio_meter_wants_true_peak(struct obs_audio_meter *meter)
+{
+	bool true_peak = false;
+
+	for (size_t i = 0; i < meter->volmeters.num; i++) {
+		struct obs_volmeter *volmeter = meter->volmeters.array[i];
+
+		pthread_mutex_lock(&volmeter->mutex);
+		if (volmeter->peak_meter_type == TRUE_PEAK_METER)
+			true_peak = true;
+		pthread_mutex_unlock(&volmeter->mutex);
+	}
+
+	return true_peak;
+}
+
+static void audio_meter_data_received(void *vptr, obs_source_t *source,
+				      const struct audio_data *data, bool muted)
+{
+	struct obs_audio_meter *meter = vptr;
+	int nr_channels = get_nr_channels_from_audio_data(data);
+
+	muted = muted && !obs_source_muted(source);
+
+	pthread_mutex_lock(&meter->mutex);
+
+	if (meter->volmeters.num) {
+		audio_meter_process_peak(meter, data, nr_channels,
+					 audio_meter_wants_true_peak(meter));
+		audio_meter_process_magnitude(meter, data, nr_channels);
+	}
+
+	da_copy(meter->dispatch, meter->volmeters);
+
+	pthread_mutex_unlock(&meter->mutex);
+
+	/* Levels are only written on the audio thread, and detaching waits
+	 * for this callback to return (see volmeter_detach_wait()), so the
+	 * callbacks of the volmeters can run without holding the mutex. */
+	for (size_t i = meter->dispatch.num; i > 0; i--)
+		volmeter_levels_received(meter->dispatch.array[i - 1], meter,
+					 muted);
+}
+
+/* Audio capture callbacks run with audio_cb_mutex held, once this returns
+ * the levels of the current block are no longer handed to a volmeter that
+ * was just removed from the meter. */
+static inline void volmeter_detach_wait(obs_source_t *source)
+{
+	pthread_mutex_lock(&source->audio_cb_mutex);
+	pthread_mutex_unlock(&source->audio_cb_mutex);
+}
+
+/* Returns the meter of a source, creating it and hooking it into the audio
+ * of the source for the first volmeter attached to it. */
+static struct obs_audio_meter *audio_meter_acquire(obs_source_t *source)
+{
+	struct obs_audio_meter *meter;
+
+	pthread_mutex_lock(&source->audio_meter_mutex);
+
+	meter = source->audio_meter;
+	if (!meter) {
+		meter = bzalloc(sizeof(*meter));
+		pthread_mutex_init(&meter->mutex, NULL);
+		meter->source = source;
+		source->audio_meter = meter;
+
+		obs_source_add_audio_capture_callback(
+			source, audio_meter_data_received, meter);
+	}
+
+	meter->refs++;
+
+	pthread_mutex_unlock(&source->audio_meter_mutex);
+	return meter;
+}
+
+static void audio_meter_release(struct obs_audio_meter *meter)
+{
+	obs_source_t *source = meter->source;
+	bool destroy;
+
+	pthread_mutex_lock(&source->audio_meter_mutex);
+
+	destroy = --meter->refs == 0;
+	if (destroy) {
+		source->audio_meter = NULL;
+
+		/* Once removed, the callback is guaranteed to no longer be
+		 * running on the audio thread. */
+		obs_source_remove_audio_capture_callback(
+			source, audio_meter_data_received, meter);
+	}
+
+	pthread_mutex_unlock(&source->audio_meter_mutex);
+
+	if (destroy) {
+		da_free(meter->volmeters);
+		da_free(meter->dispatch);
+		pthread_mutex_destroy(&meter->mutex);
+		bfree(meter);
+	}
+}
+
 obs_fader_t *obs_fader_create(enum obs_fader_type type)
 {
 	struct obs_fader *fader = bzalloc(sizeof(struct obs_fader));
@@ -801,6 +912,7 @@ void obs_volmeter_destroy(obs_volmeter_t *volmeter)
 
 bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 {
+	struct obs_audio_meter *meter;
 	signal_handler_t *sh;
 	float vol;
 
@@ -814,22 +926,27 @@ bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 			       volmeter);
 	signal_handler_connect(sh, "destroy", volmeter_source_destroyed,
 			       volmeter);
-	obs_source_add_audio_capture_callback(
-		source, volmeter_source_data_received, volmeter);
+	meter = audio_meter_acquire(source);
 	vol = obs_source_get_volume(source);
 
 	pthread_mutex_lock(&volmeter->mutex);
 
 	volmeter->source = source;
+	volmeter->meter = meter;
 	volmeter->cur_db = mul_to_db(vol);
 
 	pthread_mutex_unlock(&volmeter->mutex);
 
+	pthread_mutex_lock(&meter->mutex);
+	da_push_back(meter->volmeters, &volmeter);
+	pthread_mutex_unlock(&meter->mutex);
+
 	return true;
 }
 
 void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 {
+	struct obs_audio_meter *meter;
 	signal_handler_t *sh;
 	obs_source_t *source;
 
@@ -838,7 +955,9 @@ void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 
 	pthread_mutex_lock(&volmeter->mutex);
 	source = volmeter->source;
+	meter = volmeter->meter;
 	volmeter->source = NULL;
+	volmeter->meter = NULL;
 	pthread_mutex_unlock(&volmeter->mutex);
 
 	if (!source)
@@ -849,8 +968,13 @@ void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 				  volmeter);
 	signal_handler_disconnect(sh, "destroy", volmeter_source_destroyed,
 				  volmeter);
-	obs_source_remove_audio_capture_callback(
-		source, volmeter_source_data_received, volmeter);
+
+	pthread_mutex_lock(&meter->mutex);
+	da_erase_item(meter->volmeters, &volmeter);
+	pthread_mutex_unlock(&meter->mutex);
+
+	volmeter_detach_wait(source);
+	audio_meter_release(meter);
 }
 
 void obs_volmeter_set_peak_meter_type(obs_volmeter_t *volmeter,
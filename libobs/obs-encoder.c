@@ -53,6 +53,7 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 	pthread_mutex_init_value(&encoder->outputs_mutex);
 	pthread_mutex_init_value(&encoder->pause.mutex);
 	pthread_mutex_init_value(&encoder->roi_mutex);
+	pthread_mutex_init_value(&encoder->video_queue_mutex);
 
 	if (!obs_context_data_init(&encoder->context, OBS_OBJ_TYPE_ENCODER,
 				   settings, name, NULL, hotkey_data, false))
@@ -67,6 +68,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		return false;
 	if (pthread_mutex_init(&encoder->roi_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->video_queue_mutex, NULL) != 0)
+		return false;
 
 	if (encoder->orig_info.get_defaults) {
 		encoder->orig_info.get_defaults(encoder->context.settings);
@@ -154,6 +157,12 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
 
 static void receive_video(void *param, struct video_data *frame);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
+static void start_video_thread(struct obs_encoder *encoder,
+			       const struct video_scale_info *info);
+static void stop_video_thread(struct obs_encoder *encoder);
+static void start_audio_thread(struct obs_encoder *encoder);
+static void interrupt_audio_thread(struct obs_encoder *encoder);
+static void stop_audio_thread(struct obs_encoder *encoder);
 
 static inline void get_audio_info(const struct obs_encoder *encoder,
 				  struct audio_convert_info *info)
@@ -323,6 +332,7 @@ static void add_connection(struct obs_encoder *encoder)
 		struct audio_convert_info audio_info = {0};
 		get_audio_info(encoder, &audio_info);
 
+		start_audio_thread(encoder);
 		audio_output_connect(encoder->media, encoder->mixer_idx,
 				     &audio_info, receive_audio, encoder);
 	} else {
@@ -332,6 +342,7 @@ static void add_connection(struct obs_encoder *encoder)
 		if (gpu_encode_available(encoder)) {
 			start_gpu_encode(encoder);
 		} else {
+			start_video_thread(encoder, &info);
 			start_raw_video(encoder->media, &info,
 					encoder->frame_rate_divisor,
 					receive_video, encoder);
@@ -355,13 +366,16 @@ void obs_encoder_group_actually_destroy(obs_encoder_group_t *group);
 static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 {
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
+		interrupt_audio_thread(encoder);
 		audio_output_disconnect(encoder->media, encoder->mixer_idx,
 					receive_audio, encoder);
+		stop_audio_thread(encoder);
 	} else {
 		if (gpu_encode_available(encoder)) {
 			stop_gpu_encode(encoder);
 		} else {
 			stop_raw_video(encoder->media, receive_video, encoder);
+			stop_video_thread(encoder);
 		}
 	}
 
@@ -391,6 +405,16 @@ static inline void free_audio_buffers(struct obs_encoder *encoder)
 		bfree(encoder->audio_output_buffer[i]);
 		encoder->audio_output_buffer[i] = NULL;
 	}
+
+	for (size_t i = 0; i < NUM_ENCODE_AUDIO_BLOCKS; i++) {
+		struct encoder_audio_block *block = &encoder->audio_blocks[i];
+
+		for (size_t j = 0; j < MAX_AV_PLANES; j++) {
+			bfree(block->data[j]);
+			block->data[j] = NULL;
+		}
+		block->capacity = 0;
+	}
 }
 
 void obs_encoder_destroy(obs_encoder_t *encoder)
@@ -411,6 +435,9 @@ void obs_encoder_destroy(obs_encoder_t *encoder)
 
 		obs_encoder_set_group(encoder, NULL);
 
+		/* in case an encode thread stopped itself on an error */
+		stop_video_thread(encoder);
+		stop_audio_thread(encoder);
 		free_audio_buffers(encoder);
 
 		if (encoder->context.data)
@@ -423,6 +450,7 @@ void obs_encoder_destroy(obs_encoder_t *encoder)
 		pthread_mutex_destroy(&encoder->outputs_mutex);
 		pthread_mutex_destroy(&encoder->pause.mutex);
 		pthread_mutex_destroy(&encoder->roi_mutex);
+		pthread_mutex_destroy(&encoder->video_queue_mutex);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void *)encoder->info.id);
@@ -864,6 +892,29 @@ uint32_t obs_encoder_get_encoded_frames(const obs_encoder_t *encoder)
 		       : 0;
 }
 
+uint32_t obs_encoder_get_skipped_frames(const obs_encoder_t *encoder)
+{
+	return obs_encoder_valid(encoder, "obs_encoder_get_skipped_frames")
+		       ? (uint32_t)os_atomic_load_long(&encoder->skipped_frames)
+		       : 0;
+}
+
+uint32_t obs_encoder_get_queued_frames(const obs_encoder_t *encoder)
+{
+	return obs_encoder_valid(encoder, "obs_encoder_get_queued_frames")
+		       ? (uint32_t)os_atomic_load_long(
+				 &encoder->video_num_queued)
+		       : 0;
+}
+
+uint32_t obs_encoder_get_pipeline_latency(const obs_encoder_t *encoder)
+{
+	return obs_encoder_valid(encoder, "obs_encoder_get_pipeline_latency")
+		       ? (uint32_t)os_atomic_load_long(
+				 &encoder->pipeline_latency)
+		       : 0;
+}
+
 void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 				 uint32_t height)
 {
@@ -1513,12 +1564,12 @@ bool video_pause_check(struct pause_data *pause, uint64_t timestamp)
 	return ignore_frame;
 }
 
-static const char *receive_video_name = "receive_video";
-static void receive_video(void *param, struct video_data *frame)
+static const char *encode_video_name = "encode_video";
+static void encode_video(struct obs_encoder *encoder,
+			 const struct video_data *frame)
 {
-	profile_start(receive_video_name);
+	profile_start(encode_video_name);
 
-	struct obs_encoder *encoder = param;
 	struct encoder_frame enc_frame;
 
 	if (encoder->encoder_group && !encoder->start_ts) {
@@ -1569,6 +1620,329 @@ static void receive_video(void *param, struct video_data *frame)
 			encoder->timebase_num * encoder->frame_rate_divisor;
 
 wait_for_audio:
+	profile_end(encode_video_name);
+}
+
+/* Copy of a frame of video-io, shared by every encoder that receives that
+ * frame without a conversion of its own, and reused once all of them have
+ * encoded it */
+struct pooled_video_frame {
+	struct video_frame frame;
+	enum video_format format;
+	uint32_t width;
+	uint32_t height;
+
+	const uint8_t *source;
+	uint64_t timestamp;
+	long refs;
+};
+
+static pthread_mutex_t frame_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct pooled_video_frame *) frame_pool;
+static size_t frame_pool_users = 0;
+
+static inline bool pooled_frame_fits(const struct pooled_video_frame *pooled,
+				      const struct obs_encoder *encoder)
+{
+	return pooled->format == encoder->video_format &&
+	       pooled->width == encoder->video_width &&
+	       pooled->height == encoder->video_height;
+}
+
+static struct pooled_video_frame *
+acquire_pooled_frame(struct obs_encoder *encoder,
+		     const struct video_data *frame)
+{
+	struct pooled_video_frame *pooled = NULL;
+	struct video_frame src;
+
+	pthread_mutex_lock(&frame_pool_mutex);
+
+	for (size_t i = 0; i < frame_pool.num; i++) {
+		struct pooled_video_frame *cur = frame_pool.array[i];
+
+		if (!pooled_frame_fits(cur, encoder))
+			continue;
+
+		/* Encoders receive a frame one after the other on the video
+		 * thread, so a copy that is in use is complete */
+		if (cur->refs && cur->source == frame->data[0] &&
+		    cur->timestamp == frame->timestamp) {
+			cur->refs++;
+			pthread_mutex_unlock(&frame_pool_mutex);
+			return cur;
+		}
+
+		if (!cur->refs && !pooled)
+			pooled = cur;
+	}
+
+	if (!pooled) {
+		pooled = bzalloc(sizeof(*pooled));
+		video_frame_init(&pooled->frame, encoder->video_format,
+				 encoder->video_width, encoder->video_height);
+		pooled->format = encoder->video_format;
+		pooled->width = encoder->video_width;
+		pooled->height = encoder->video_height;
+		da_push_back(frame_pool, &pooled);
+	}
+
+	/* Not a match for other encoders until the copy is done */
+	pooled->source = NULL;
+	pooled->refs = 1;
+
+	pthread_mutex_unlock(&frame_pool_mutex);
+
+	memcpy(src.data, frame->data, sizeof(src.data));
+	memcpy(src.linesize, frame->linesize, sizeof(src.linesize));
+	video_frame_copy(&pooled->frame, &src, encoder->video_format,
+			 encoder->video_height);
+
+	pthread_mutex_lock(&frame_pool_mutex);
+	pooled->source = frame->data[0];
+	pooled->timestamp = frame->timestamp;
+	pthread_mutex_unlock(&frame_pool_mutex);
+
+	return pooled;
+}
+
+static void release_pooled_frame(struct pooled_video_frame *pooled)
+{
+	pthread_mutex_lock(&frame_pool_mutex);
+	pooled->refs--;
+	pthread_mutex_unlock(&frame_pool_mutex);
+}
+
+/* Frames stay in the pool while any encode thread is running */
+static void frame_pool_add_user(void)
+{
+	pthread_mutex_lock(&frame_pool_mutex);
+	frame_pool_users++;
+	pthread_mutex_unlock(&frame_pool_mutex);
+}
+
+static void frame_pool_remove_user(void)
+{
+	pthread_mutex_lock(&frame_pool_mutex);
+
+	if (--frame_pool_users == 0) {
+		for (size_t i = 0; i < frame_pool.num; i++) {
+			video_frame_free(&frame_pool.array[i]->frame);
+			bfree(frame_pool.array[i]);
+		}
+		da_free(frame_pool);
+	}
+
+	pthread_mutex_unlock(&frame_pool_mutex);
+}
+
+static void *video_encode_thread(void *param)
+{
+	struct obs_encoder *encoder = param;
+
+	os_set_thread_name("obs video encode thread");
+	const char *video_encode_thread_name = profile_store_name(
+		obs_get_profiler_name_store(), "obs_video_encode_thread(%s)",
+		encoder->context.name);
+	profile_register_root(video_encode_thread_name,
+			      encoder->video_frame_time);
+
+	/* one post per queued frame, and one more to stop once the frames
+	 * queued by then are encoded */
+	while (os_sem_wait(encoder->video_queued_sem) == 0) {
+		struct encoder_video_frame *queued;
+		struct pooled_video_frame *pooled;
+		bool done = false;
+		bool empty;
+		size_t idx;
+
+		pthread_mutex_lock(&encoder->video_queue_mutex);
+		idx = encoder->video_first_queued;
+		empty = !encoder->video_num_queued;
+		pthread_mutex_unlock(&encoder->video_queue_mutex);
+
+		if (empty)
+			break;
+
+		queued = &encoder->video_frames[idx];
+		pooled = queued->frame;
+
+		profile_start(video_encode_thread_name);
+
+		while (!done && !encoder->video_thread_failed) {
+			struct video_data frame = {
+				.timestamp = queued->timestamp,
+			};
+
+			memcpy(frame.data, pooled->frame.data,
+			       sizeof(frame.data));
+			memcpy(frame.linesize, pooled->frame.linesize,
+			       sizeof(frame.linesize));
+
+			encode_video(encoder, &frame);
+
+			pthread_mutex_lock(&encoder->video_queue_mutex);
+			queued->timestamp += encoder->video_frame_time;
+			done = --queued->count == 0;
+			if (done) {
+				queued->frame = NULL;
+				encoder->video_first_queued =
+					(encoder->video_first_queued + 1) %
+					NUM_ENCODE_VIDEO_FRAMES;
+				os_atomic_dec_long(&encoder->video_num_queued);
+			}
+			pthread_mutex_unlock(&encoder->video_queue_mutex);
+		}
+
+		if (done)
+			release_pooled_frame(pooled);
+
+		profile_end(video_encode_thread_name);
+		profile_reenable_thread();
+
+		if (encoder->video_thread_failed)
+			break;
+	}
+
+	return NULL;
+}
+
+static void start_video_thread(struct obs_encoder *encoder,
+			       const struct video_scale_info *info)
+{
+	/* may still be around after stopping itself on an error */
+	stop_video_thread(encoder);
+
+	encoder->video_thread_failed = false;
+	encoder->video_thread_stop = false;
+	encoder->video_first_queued = 0;
+	encoder->video_num_queued = 0;
+	encoder->video_max_queued = 0;
+	encoder->video_frame_time =
+		video_output_get_frame_time(encoder->media) *
+		encoder->frame_rate_divisor;
+	encoder->video_format = info->format;
+	encoder->video_width = info->width;
+	encoder->video_height = info->height;
+	os_atomic_set_long(&encoder->skipped_frames, 0);
+
+	if (os_sem_init(&encoder->video_queued_sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&encoder->video_thread, NULL, video_encode_thread,
+			   encoder) != 0)
+		goto fail;
+
+	frame_pool_add_user();
+	encoder->video_thread_active = true;
+	return;
+
+fail:
+	blog(LOG_WARNING,
+	     "Failed to create video encode thread for '%s', "
+	     "encoding on the video thread instead",
+	     encoder->context.name);
+	os_sem_destroy(encoder->video_queued_sem);
+	encoder->video_queued_sem = NULL;
+}
+
+static void stop_video_thread(struct obs_encoder *encoder)
+{
+	if (!encoder->video_thread_active)
+		return;
+
+	/* An encoding error stops the encoder from its own thread, which
+	 * exits without encoding the rest and is joined later on */
+	if (pthread_equal(pthread_self(), encoder->video_thread)) {
+		encoder->video_thread_failed = true;
+		return;
+	}
+
+	pthread_mutex_lock(&encoder->video_queue_mutex);
+	encoder->video_thread_stop = true;
+	pthread_mutex_unlock(&encoder->video_queue_mutex);
+
+	os_sem_post(encoder->video_queued_sem);
+	pthread_join(encoder->video_thread, NULL);
+
+	long skipped = os_atomic_load_long(&encoder->skipped_frames);
+	if (skipped)
+		blog(LOG_INFO,
+		     "Video encoder '%s': %ld frames skipped due to encoding "
+		     "lag, up to %ld frames were queued",
+		     encoder->context.name, skipped,
+		     encoder->video_max_queued);
+
+	os_sem_destroy(encoder->video_queued_sem);
+	encoder->video_queued_sem = NULL;
+
+	/* left over if the thread stopped itself on an error */
+	for (size_t i = 0; i < NUM_ENCODE_VIDEO_FRAMES; i++) {
+		struct encoder_video_frame *queued = &encoder->video_frames[i];
+
+		if (queued->frame)
+			release_pooled_frame(queued->frame);
+		queued->frame = NULL;
+	}
+	encoder->video_num_queued = 0;
+
+	frame_pool_remove_user();
+	encoder->video_thread_active = false;
+}
+
+static const char *receive_video_name = "receive_video";
+static void receive_video(void *param, struct video_data *frame)
+{
+	profile_start(receive_video_name);
+
+	struct obs_encoder *encoder = param;
+	struct encoder_video_frame *queued;
+
+	if (!encoder->video_thread_active) {
+		encode_video(encoder, frame);
+		goto end;
+	}
+
+	pthread_mutex_lock(&encoder->video_queue_mutex);
+
+	if (encoder->video_thread_stop) {
+		pthread_mutex_unlock(&encoder->video_queue_mutex);
+		goto end;
+	}
+
+	/* Out of frames, the encoder is that far behind.  As video-io does
+	 * for its own frames, the last frame gets encoded once more in place
+	 * of this one, so the frames keep their timing. */
+	if (encoder->video_num_queued == NUM_ENCODE_VIDEO_FRAMES) {
+		size_t last = (encoder->video_first_queued +
+			       NUM_ENCODE_VIDEO_FRAMES - 1) %
+			      NUM_ENCODE_VIDEO_FRAMES;
+
+		encoder->video_frames[last].count++;
+		os_atomic_inc_long(&encoder->skipped_frames);
+		pthread_mutex_unlock(&encoder->video_queue_mutex);
+		goto end;
+	}
+
+	queued = &encoder->video_frames[(encoder->video_first_queued +
+					 encoder->video_num_queued) %
+					NUM_ENCODE_VIDEO_FRAMES];
+
+	pthread_mutex_unlock(&encoder->video_queue_mutex);
+
+	/* Only this thread queues frames, so the free slot stays free */
+	queued->frame = acquire_pooled_frame(encoder, frame);
+	queued->timestamp = frame->timestamp;
+	queued->count = 1;
+
+	pthread_mutex_lock(&encoder->video_queue_mutex);
+	long num = os_atomic_inc_long(&encoder->video_num_queued);
+	if (num > encoder->video_max_queued)
+		encoder->video_max_queued = num;
+	pthread_mutex_unlock(&encoder->video_queue_mutex);
+
+	os_sem_post(encoder->video_queued_sem);
+
+end:
 	profile_end(receive_video_name);
 }
 
@@ -1781,12 +2155,12 @@ bool audio_pause_check(struct pause_data *pause, struct audio_data *data,
 	return ignore_audio;
 }
 
-static const char *receive_audio_name = "receive_audio";
-static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
+static const char *encode_audio_name = "encode_audio";
+static void encode_audio(struct obs_encoder *encoder,
+			 const struct audio_data *in)
 {
-	profile_start(receive_audio_name);
+	profile_start(encode_audio_name);
 
-	struct obs_encoder *encoder = param;
 	struct audio_data audio = *in;
 
 	if (!encoder->first_received) {
@@ -1808,9 +2182,169 @@ static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
 		}
 	}
 
-	UNUSED_PARAMETER(mix_idx);
+end:
+	profile_end(encode_audio_name);
+}
+
+static void *audio_encode_thread(void *param)
+{
+	struct obs_encoder *encoder = param;
+	uint64_t interval =
+		audio_frames_to_ns(encoder->samplerate, AUDIO_OUTPUT_FRAMES);
+
+	os_set_thread_name("obs audio encode thread");
+	const char *audio_encode_thread_name = profile_store_name(
+		obs_get_profiler_name_store(), "obs_audio_encode_thread(%s)",
+		encoder->context.name);
+	profile_register_root(audio_encode_thread_name, interval);
+
+	/* one post per queued block, and one more to stop once the blocks
+	 * queued by then are encoded */
+	while (os_sem_wait(encoder->audio_queued_sem) == 0) {
+		if (!os_atomic_load_long(&encoder->audio_queued))
+			break;
+
+		struct encoder_audio_block *block =
+			&encoder->audio_blocks[encoder->audio_read_idx];
+		struct audio_data audio = {
+			.frames = block->frames,
+			.timestamp = block->timestamp,
+		};
+
+		for (size_t i = 0; i < encoder->planes; i++)
+			audio.data[i] = block->data[i];
+
+		profile_start(audio_encode_thread_name);
+		encode_audio(encoder, &audio);
+		profile_end(audio_encode_thread_name);
+		profile_reenable_thread();
+
+		encoder->audio_read_idx =
+			(encoder->audio_read_idx + 1) % NUM_ENCODE_AUDIO_BLOCKS;
+		os_atomic_dec_long(&encoder->audio_queued);
+		os_sem_post(encoder->audio_free_sem);
+
+		if (encoder->audio_thread_failed)
+			break;
+	}
+
+	return NULL;
+}
+
+static void start_audio_thread(struct obs_encoder *encoder)
+{
+	/* may still be around after stopping itself on an error */
+	stop_audio_thread(encoder);
+
+	encoder->audio_thread_failed = false;
+	encoder->audio_thread_stop = false;
+	encoder->audio_queued = 0;
+	encoder->audio_write_idx = 0;
+	encoder->audio_read_idx = 0;
+
+	if (os_sem_init(&encoder->audio_queued_sem, 0) != 0)
+		goto fail;
+	if (os_sem_init(&encoder->audio_free_sem, NUM_ENCODE_AUDIO_BLOCKS) != 0)
+		goto fail;
+	if (pthread_create(&encoder->audio_thread, NULL, audio_encode_thread,
+			   encoder) != 0)
+		goto fail;
+
+	encoder->audio_thread_active = true;
+	return;
+
+fail:
+	blog(LOG_WARNING,
+	     "Failed to create audio encode thread for '%s', "
+	     "encoding on the audio thread instead",
+	     encoder->context.name);
+	os_sem_destroy(encoder->audio_queued_sem);
+	os_sem_destroy(encoder->audio_free_sem);
+	encoder->audio_queued_sem = NULL;
+	encoder->audio_free_sem = NULL;
+}
+
+/* Keeps the audio thread from waiting for a free block any longer, so that
+ * it can be disconnected */
+static void interrupt_audio_thread(struct obs_encoder *encoder)
+{
+	if (!encoder->audio_thread_active)
+		return;
+
+	os_atomic_set_bool(&encoder->audio_thread_stop, true);
+	os_sem_post(encoder->audio_free_sem);
+}
+
+static void stop_audio_thread(struct obs_encoder *encoder)
+{
+	if (!encoder->audio_thread_active)
+		return;
+
+	/* An encoding error stops the encoder from its own thread, which
+	 * exits without encoding the rest and is joined later on.  The audio
+	 * thread drops the audio from then on instead of waiting for it. */
+	if (pthread_equal(pthread_self(), encoder->audio_thread)) {
+		encoder->audio_thread_failed = true;
+		os_atomic_set_bool(&encoder->audio_thread_stop, true);
+		return;
+	}
+
+	os_atomic_set_bool(&encoder->audio_thread_stop, true);
+	os_sem_post(encoder->audio_queued_sem);
+	pthread_join(encoder->audio_thread, NULL);
+
+	os_sem_destroy(encoder->audio_queued_sem);
+	os_sem_destroy(encoder->audio_free_sem);
+	encoder->audio_queued_sem = NULL;
+	encoder->audio_free_sem = NULL;
+	encoder->audio_thread_active = false;
+}
+
+static const char *receive_audio_name = "receive_audio";
+static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
+{
+	profile_start(receive_audio_name);
+
+	struct obs_encoder *encoder = param;
+	struct encoder_audio_block *block;
+	size_t size = in->frames * encoder->blocksize;
+
+	if (!encoder->audio_thread_active) {
+		encode_audio(encoder, in);
+		goto end;
+	}
+
+	/* Only waits if the encoder is a whole ring of blocks behind, which
+	 * keeps the audio that goes into it the same as when encoding right
+	 * here.  The stop flag is checked first, the post that interrupts
+	 * the wait is only good for one call. */
+	if (os_atomic_load_bool(&encoder->audio_thread_stop))
+		goto end;
+	os_sem_wait(encoder->audio_free_sem);
+	if (os_atomic_load_bool(&encoder->audio_thread_stop))
+		goto end;
+
+	block = &encoder->audio_blocks[encoder->audio_write_idx];
+
+	if (block->capacity < size) {
+		for (size_t i = 0; i < encoder->planes; i++)
+			block->data[i] = brealloc(block->data[i], size);
+		block->capacity = size;
+	}
+
+	for (size_t i = 0; i < encoder->planes; i++)
+		memcpy(block->data[i], in->data[i], size);
+
+	block->frames = in->frames;
+	block->timestamp = in->timestamp;
+
+	encoder->audio_write_idx =
+		(encoder->audio_write_idx + 1) % NUM_ENCODE_AUDIO_BLOCKS;
+	os_atomic_inc_long(&encoder->audio_queued);
+	os_sem_post(encoder->audio_queued_sem);
 
 end:
+	UNUSED_PARAMETER(mix_idx);
 	profile_end(receive_audio_name);
 }
 
@@ -2017,6 +2551,14 @@ void obs_encoder_set_last_error(obs_encoder_t *encoder, const char *message)
 		encoder->last_error_message = NULL;
 }
 
+void obs_encoder_set_pipeline_latency(obs_encoder_t *encoder, uint32_t frames)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_pipeline_latency"))
+		return;
+
+	os_atomic_set_long(&encoder->pipeline_latency, (long)frames);
+}
+
 uint64_t obs_encoder_get_pause_offset(const obs_encoder_t *encoder)
 {
 	return encoder ? encoder->pause.ts_offset : 0;
@@ -35,6 +35,7 @@
 
 #include "media-io/audio-resampler.h"
 #include "media-io/video-io.h"
+#include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
 
 #include "obs.h"
@@ -53,6 +54,8 @@
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 10
 #define NUM_ENCODE_TEXTURE_FRAMES_TO_WAIT 1
+#define NUM_ENCODE_AUDIO_BLOCKS 16
+#define NUM_ENCODE_VIDEO_FRAMES 8
 
 static inline int64_t packet_dts_usec(struct encoder_packet *packet)
 {
@@ -397,6 +400,7 @@ struct obs_core_audio {
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
 	char *monitoring_device_id;
+	uint32_t monitoring_latency_ms;
 
 	pthread_mutex_t task_mutex;
 	struct deque tasks;
@@ -667,6 +671,35 @@ struct async_frame {
 	struct obs_source_frame *frame;
 	long unused_count;
 	bool used;
+
+	/* Holds a producer's buffer, which is released rather than reused */
+	bool borrowed;
+};
+
+/* Adaptive jitter buffer for async video, see obs-source-jitter.c */
+struct async_jitter {
+	bool enabled;
+	bool started;
+
+	/* Frames are due at timestamp + offset + delay in render time, with
+	 * the offset moving along with the drift from offset_time on */
+	int64_t offset;
+	uint64_t offset_time;
+	double drift;
+	uint64_t delay;
+
+	uint64_t window_start;
+	int64_t window_min_offset;
+	uint64_t window_min_time;
+	uint64_t window_max_jitter;
+
+	uint64_t frame_interval;
+	uint64_t last_ts;
+	uint64_t shown_ts;
+
+	uint64_t late_frames;
+	uint64_t dropped_frames;
+	uint64_t duplicated_frames;
 };
 
 enum audio_action_type {
@@ -791,6 +824,9 @@ struct obs_source {
 	pthread_mutex_t audio_mutex;
 	pthread_mutex_t audio_cb_mutex;
 	DARRAY(struct audio_cb_info) audio_cb_list;
+	pthread_mutex_t audio_meter_mutex;
+	struct obs_audio_meter *audio_meter;
+	struct obs_sidechain *sidechain;
 	struct obs_audio_data audio_data;
 	size_t audio_storage_size;
 	uint32_t audio_mixers;
@@ -820,10 +856,15 @@ struct obs_source {
 	bool async_update_texture;
 	bool async_unbuffered;
 	bool async_decoupled;
+	struct async_jitter async_jitter;
 	struct obs_source_frame *async_preload_frame;
 	DARRAY(struct async_frame) async_cache;
 	DARRAY(struct obs_source_frame *) async_frames;
 	pthread_mutex_t async_mutex;
+
+	/* Borrowed frames let go of while async_mutex was held, whose release
+	 * callbacks are called once it's unlocked */
+	DARRAY(struct borrowed_frame *) released_frames;
 	uint32_t async_width;
 	uint32_t async_height;
 	uint32_t async_cache_width;
@@ -933,6 +974,9 @@ struct audio_monitor *audio_monitor_create(obs_source_t *source);
 void audio_monitor_reset(struct audio_monitor *monitor);
 extern void audio_monitor_destroy(struct audio_monitor *monitor);
 
+/* Called once the audio capture callbacks of a source are gone */
+extern void obs_source_sidechain_detach(obs_source_t *source);
+
 extern obs_source_t *
 obs_source_create_set_last_ver(const char *id, const char *name,
 			       const char *uuid, obs_data_t *settings,
@@ -1053,6 +1097,12 @@ extern bool set_async_texture_size(struct obs_source *source,
 				   const struct obs_source_frame *frame);
 extern void remove_async_frame(obs_source_t *source,
 			       struct obs_source_frame *frame);
+extern void unlock_async_mutex(obs_source_t *source);
+
+extern void async_jitter_reset(obs_source_t *source);
+extern void async_jitter_frame_arrived(obs_source_t *source, uint64_t ts,
+				       uint64_t arrival);
+extern bool async_jitter_ready(obs_source_t *source, uint64_t sys_time);
 
 extern void set_deinterlace_texture_size(obs_source_t *source);
 extern void deinterlace_process_last_frame(obs_source_t *source,
@@ -1275,6 +1325,23 @@ struct obs_encoder_group {
 	uint64_t start_timestamp;
 };
 
+struct pooled_video_frame;
+
+struct encoder_video_frame {
+	struct pooled_video_frame *frame;
+	uint64_t timestamp;
+
+	/* more than once if the frames after it had to be skipped */
+	int count;
+};
+
+struct encoder_audio_block {
+	uint8_t *data[MAX_AV_PLANES];
+	size_t capacity;
+	uint32_t frames;
+	uint64_t timestamp;
+};
+
 struct obs_encoder {
 	struct obs_context_data context;
 	struct obs_encoder_info info;
@@ -1323,6 +1390,26 @@ struct obs_encoder {
 	// Number of frames successfully encoded
 	uint32_t encoded_frames;
 
+	/* raw video is encoded on a thread of its own, which the video thread
+	 * hands copies of its frames to, shared with the other encoders that
+	 * receive the same frames */
+	pthread_t video_thread;
+	bool video_thread_active;
+	bool video_thread_failed;
+	bool video_thread_stop;
+	pthread_mutex_t video_queue_mutex;
+	os_sem_t *video_queued_sem;
+	struct encoder_video_frame video_frames[NUM_ENCODE_VIDEO_FRAMES];
+	size_t video_first_queued;
+	volatile long video_num_queued;
+	long video_max_queued;
+	enum video_format video_format;
+	uint32_t video_width;
+	uint32_t video_height;
+	uint64_t video_frame_time;
+	volatile long skipped_frames;
+	volatile long pipeline_latency;
+
 	/* Regions of interest to prioritize during encoding */
 	pthread_mutex_t roi_mutex;
 	DARRAY(struct obs_encoder_roi) roi;
@@ -1333,6 +1420,19 @@ struct obs_encoder {
 	struct deque audio_input_buffer[MAX_AV_PLANES];
 	uint8_t *audio_output_buffer[MAX_AV_PLANES];
 
+	/* audio is encoded on a thread of its own, which the audio thread
+	 * hands blocks of audio to through a fixed ring of them */
+	pthread_t audio_thread;
+	bool audio_thread_active;
+	bool audio_thread_failed;
+	volatile bool audio_thread_stop;
+	os_sem_t *audio_queued_sem;
+	os_sem_t *audio_free_sem;
+	volatile long audio_queued;
+	struct encoder_audio_block audio_blocks[NUM_ENCODE_AUDIO_BLOCKS];
+	size_t audio_write_idx;
+	size_t audio_read_idx;
+
 	/* if a video encoder is paired with an audio encoder, make it start
 	 * up at the specific timestamp.  if this is the audio encoder,
 	 * it waits until it's ready to sync up with video */
@@ -0,0 +1,335 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+#include "util/util_uint64.h"
+
+/*
+ * The audio of a source goes into one ring per source, which the audio
+ * capture callback of the source is the only writer of.  Every reader keeps
+ * its own read position, so readers neither lock nor wait for each other or
+ * for the writer.
+ *
+ * The writer never waits for readers either.  A reader that falls behind is
+ * moved up to the recent audio before it reads, and copies what it reads out
+ * of the ring.  If the writer got to the frames or to the write entries it
+ * used in the meantime, the read fails rather than returning torn audio.
+ * Handing out pointers into the ring instead would leave the frames open to
+ * being overwritten for as long as the filter uses them, which the writer
+ * can't know about, and reads that wrap around the end of the ring aren't
+ * contiguous anyway.  The copy is one block per read into buffers that are
+ * only reallocated when reads get larger.
+ */
+
+#define SIDECHAIN_FRAMES 16384
+#define SIDECHAIN_MASK (SIDECHAIN_FRAMES - 1)
+#define MAX_READ_FRAMES (SIDECHAIN_FRAMES / 4)
+#define MAX_WRITE_FRAMES (SIDECHAIN_FRAMES / 4)
+
+/* Written blocks that are remembered for the timestamps of their frames,
+ * readers look at no more than half of them */
+#define SIDECHAIN_WRITES 64
+#define WRITES_MASK (SIDECHAIN_WRITES - 1)
+#define TIMESTAMP_WRITES (SIDECHAIN_WRITES / 2)
+
+struct sidechain_write {
+	uint64_t pos;
+	uint64_t frames;
+	uint64_t ts;
+};
+
+struct obs_sidechain {
+	/* NULL once the source is destroyed, under sidechain_mutex */
+	obs_source_t *source;
+	long refs;
+
+	uint32_t samples_per_sec;
+	size_t channels;
+	float *ring[MAX_AUDIO_CHANNELS];
+
+	/* A write is published by incrementing write_count after its frames
+	 * and its entry in writes are in place */
+	struct sidechain_write writes[SIDECHAIN_WRITES];
+	volatile long write_count;
+};
+
+struct obs_sidechain_reader {
+	struct obs_sidechain *sidechain;
+	uint64_t read_pos;
+	bool started;
+
+	float *buf[MAX_AUDIO_CHANNELS];
+	size_t buf_frames;
+};
+
+static pthread_mutex_t sidechain_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint64_t frames_to_ns(const struct obs_sidechain *sc,
+				    uint64_t frames)
+{
+	return util_mul_div64(frames, 1000000000ULL, sc->samples_per_sec);
+}
+
+static inline const struct sidechain_write *
+get_write(const struct obs_sidechain *sc, unsigned long idx)
+{
+	return &sc->writes[idx & WRITES_MASK];
+}
+
+static void copy_to_ring(float *ring, const float *src, uint64_t pos,
+			 size_t frames)
+{
+	size_t idx = (size_t)(pos & SIDECHAIN_MASK);
+	size_t first = SIDECHAIN_FRAMES - idx;
+
+	if (first > frames)
+		first = frames;
+
+	if (src) {
+		memcpy(ring + idx, src, first * sizeof(float));
+		memcpy(ring, src + first, (frames - first) * sizeof(float));
+	} else {
+		memset(ring + idx, 0, first * sizeof(float));
+		memset(ring, 0, (frames - first) * sizeof(float));
+	}
+}
+
+static void sidechain_capture(void *param, obs_source_t *source,
+			      const struct audio_data *audio, bool muted)
+{
+	struct obs_sidechain *sc = param;
+	unsigned long count = (unsigned long)os_atomic_load_long(
+		&sc->write_count);
+	const struct sidechain_write *last = get_write(sc, count - 1);
+	uint64_t pos = count ? last->pos + last->frames : 0;
+	size_t frames = audio->frames;
+	size_t skip = 0;
+
+	UNUSED_PARAMETER(source);
+
+	if (!frames)
+		return;
+
+	/* Only the end of a block this large would survive anyway */
+	if (frames > MAX_WRITE_FRAMES) {
+		skip = frames - MAX_WRITE_FRAMES;
+		frames -= skip;
+	}
+
+	for (size_t c = 0; c < sc->channels; c++) {
+		const float *src = (const float *)audio->data[c];
+		copy_to_ring(sc->ring[c], muted || !src ? NULL : src + skip,
+			     pos, frames);
+	}
+
+	struct sidechain_write *write = &sc->writes[count & WRITES_MASK];
+	write->pos = pos;
+	write->frames = frames;
+	write->ts = audio->timestamp + frames_to_ns(sc, skip);
+
+	os_atomic_inc_long(&sc->write_count);
+}
+
+obs_sidechain_reader_t *obs_sidechain_reader_create(obs_source_t *source)
+{
+	struct obs_sidechain_reader *reader;
+	struct obs_sidechain *sc;
+
+	if (!obs_source_valid(source, "obs_sidechain_reader_create"))
+		return NULL;
+	if (os_atomic_load_long(&source->destroying))
+		return NULL;
+
+	pthread_mutex_lock(&sidechain_mutex);
+
+	sc = source->sidechain;
+	if (!sc) {
+		const struct audio_output_info *aoi =
+			audio_output_get_info(obs->audio.audio);
+
+		sc = bzalloc(sizeof(*sc));
+		sc->source = source;
+		sc->samples_per_sec = aoi->samples_per_sec;
+		sc->channels = get_audio_channels(aoi->speakers);
+		for (size_t c = 0; c < sc->channels; c++)
+			sc->ring[c] = bzalloc(SIDECHAIN_FRAMES * sizeof(float));
+
+		source->sidechain = sc;
+		obs_source_add_audio_capture_callback(source, sidechain_capture,
+						      sc);
+	}
+
+	sc->refs++;
+
+	pthread_mutex_unlock(&sidechain_mutex);
+
+	reader = bzalloc(sizeof(*reader));
+	reader->sidechain = sc;
+	return reader;
+}
+
+void obs_sidechain_reader_destroy(obs_sidechain_reader_t *reader)
+{
+	struct obs_sidechain *sc;
+	bool destroy;
+
+	if (!reader)
+		return;
+
+	sc = reader->sidechain;
+
+	pthread_mutex_lock(&sidechain_mutex);
+
+	destroy = --sc->refs == 0;
+	if (destroy && sc->source) {
+		sc->source->sidechain = NULL;
+		obs_source_remove_audio_capture_callback(
+			sc->source, sidechain_capture, sc);
+	}
+
+	pthread_mutex_unlock(&sidechain_mutex);
+
+	if (destroy) {
+		for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++)
+			bfree(sc->ring[c]);
+		bfree(sc);
+	}
+
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++)
+		bfree(reader->buf[c]);
+	bfree(reader);
+}
+
+void obs_source_sidechain_detach(obs_source_t *source)
+{
+	pthread_mutex_lock(&sidechain_mutex);
+
+	if (source->sidechain) {
+		source->sidechain->source = NULL;
+		source->sidechain = NULL;
+	}
+
+	pthread_mutex_unlock(&sidechain_mutex);
+}
+
+/* Timestamp of the frame at pos, from the last write that starts at or
+ * before it */
+static uint64_t get_timestamp(const struct obs_sidechain *sc,
+			      unsigned long count, uint64_t pos)
+{
+	const struct sidechain_write *write = get_write(sc, count - 1);
+
+	for (unsigned long i = 1; i < count && i < TIMESTAMP_WRITES; i++) {
+		if (write->pos <= pos)
+			break;
+		write = get_write(sc, count - 1 - i);
+	}
+
+	if (write->pos <= pos)
+		return write->ts + frames_to_ns(sc, pos - write->pos);
+
+	return write->ts - frames_to_ns(sc, write->pos - pos);
+}
+
+/* Whether the writer left the frames from read_pos on and the write entries
+ * before count alone while they were read */
+static bool read_intact(struct obs_sidechain *sc, unsigned long count,
+			uint64_t read_pos)
+{
+	const struct sidechain_write *last;
+	long seen = os_atomic_load_long(&sc->write_count);
+	unsigned long now;
+
+	/* A read-modify-write, so that the reads of the ring before can't be
+	 * moved past it */
+	while (!os_atomic_compare_exchange_long(&sc->write_count, &seen, seen))
+		;
+
+	now = (unsigned long)seen;
+	if (now - count >= TIMESTAMP_WRITES)
+		return false;
+
+	/* The write in progress, if any, ends at most this far ahead */
+	last = get_write(sc, now - 1);
+	return last->pos + last->frames + MAX_WRITE_FRAMES - read_pos <=
+	       SIDECHAIN_FRAMES;
+}
+
+bool obs_sidechain_reader_read(obs_sidechain_reader_t *reader,
+			       uint32_t frames, struct obs_sidechain_data *out)
+{
+	struct obs_sidechain *sc;
+	unsigned long count;
+	const struct sidechain_write *last;
+	uint64_t write_pos;
+	size_t idx;
+	size_t first;
+
+	if (!reader || !frames || frames > MAX_READ_FRAMES)
+		return false;
+
+	sc = reader->sidechain;
+	count = (unsigned long)os_atomic_load_long(&sc->write_count);
+	if (!count)
+		return false;
+
+	last = get_write(sc, count - 1);
+	write_pos = last->pos + last->frames;
+
+	/* Start out close to the writer, and catch up to it whenever more
+	 * than two reads are buffered, rather than falling further behind */
+	if (!reader->started) {
+		reader->read_pos = write_pos;
+		reader->started = true;
+	} else if (write_pos - reader->read_pos > (uint64_t)frames * 2) {
+		reader->read_pos = write_pos - (uint64_t)frames * 2;
+	}
+
+	if (write_pos - reader->read_pos < frames)
+		return false;
+
+	idx = (size_t)(reader->read_pos & SIDECHAIN_MASK);
+	first = SIDECHAIN_FRAMES - idx;
+	if (first > frames)
+		first = frames;
+
+	if (reader->buf_frames < frames) {
+		for (size_t c = 0; c < sc->channels; c++)
+			reader->buf[c] = brealloc(reader->buf[c],
+						  frames * sizeof(float));
+		reader->buf_frames = frames;
+	}
+
+	for (size_t c = 0; c < sc->channels; c++) {
+		memcpy(reader->buf[c], sc->ring[c] + idx, first * sizeof(float));
+		memcpy(reader->buf[c] + first, sc->ring[c],
+		       (frames - first) * sizeof(float));
+		out->data[c] = reader->buf[c];
+	}
+
+	for (size_t c = sc->channels; c < MAX_AUDIO_CHANNELS; c++)
+		out->data[c] = NULL;
+
+	out->frames = frames;
+	out->timestamp = get_timestamp(sc, count, reader->read_pos);
+
+	if (!read_intact(sc, count, reader->read_pos))
+		return false;
+
+	reader->read_pos += frames;
+	return true;
+}
@@ -263,7 +263,7 @@ void deinterlace_update_async_video(obs_source_t *source)
 	struct obs_source_frame *frame = source->prev_async_frame;
 	source->prev_async_frame = NULL;
 
-	pthread_mutex_unlock(&source->async_mutex);
+	unlock_async_mutex(source);
 
 	if (frame) {
 		os_atomic_inc_long(&frame->refs);
@@ -465,7 +465,7 @@ static void enable_deinterlacing(obs_source_t *source,
 		remove_async_frame(source, source->prev_async_frame);
 		source->prev_async_frame = NULL;
 	}
-	pthread_mutex_unlock(&source->async_mutex);
+	unlock_async_mutex(source);
 
 	obs_leave_graphics();
 }
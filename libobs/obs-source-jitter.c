@@ -0,0 +1,193 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+
+/*
+ * Jitter buffer for async video.
+ *
+ * Every frame is shown at its timestamp plus an offset plus a delay, in
+ * render clock time.  The offset is how long frames take to arrive at best,
+ * taken from the fastest arrival within each window.  Going from window to
+ * window, it also gives the drift of the source clock against the render
+ * clock, which the offset is moved along with in between.
+ *
+ * The delay covers how much later than that frames arrive.  It goes up as
+ * soon as a frame arrives later than it covers, and comes down slowly over
+ * windows in which frames arrive on time.
+ *
+ * All of it is used with async_mutex held.
+ */
+
+#define JITTER_WINDOW 2000000000ULL
+#define MAX_JITTER_DELAY 250000000ULL
+
+/* Leeway on top of the worst jitter seen, for the time between ticks */
+#define JITTER_MARGIN 2000000ULL
+
+static inline int64_t predicted_offset(const struct async_jitter *j,
+				       uint64_t time)
+{
+	double elapsed = (double)(int64_t)(time - j->offset_time);
+	return j->offset + (int64_t)(j->drift * elapsed);
+}
+
+static inline uint64_t due_time(const struct async_jitter *j, int64_t offset,
+				uint64_t ts)
+{
+	return (uint64_t)((int64_t)ts + offset) + j->delay;
+}
+
+void async_jitter_reset(obs_source_t *source)
+{
+	struct async_jitter *j = &source->async_jitter;
+
+	j->started = false;
+	j->drift = 0.0;
+	j->delay = 0;
+	j->frame_interval = 0;
+	j->last_ts = 0;
+	j->shown_ts = 0;
+}
+
+static void start_window(struct async_jitter *j, uint64_t arrival,
+			 int64_t offset)
+{
+	j->window_start = arrival;
+	j->window_min_offset = offset;
+	j->window_min_time = arrival;
+	j->window_max_jitter = 0;
+}
+
+static void end_window(struct async_jitter *j, uint64_t arrival,
+		       int64_t offset)
+{
+	uint64_t target = j->window_max_jitter + JITTER_MARGIN;
+	int64_t span = (int64_t)(j->window_min_time - j->offset_time);
+
+	if (span > 0) {
+		double drift = (double)(j->window_min_offset - j->offset) /
+			       (double)span;
+		j->drift = j->drift * 0.75 + drift * 0.25;
+	}
+
+	j->offset = j->window_min_offset;
+	j->offset_time = j->window_min_time;
+
+	if (target < j->delay)
+		j->delay -= (j->delay - target) / 4;
+
+	start_window(j, arrival, offset);
+}
+
+void async_jitter_frame_arrived(obs_source_t *source, uint64_t ts,
+				uint64_t arrival)
+{
+	struct async_jitter *j = &source->async_jitter;
+	int64_t offset = (int64_t)(arrival - ts);
+	int64_t jitter;
+
+	if (j->started) {
+		jitter = offset - predicted_offset(j, arrival);
+
+		/* Timestamps jumped, so nothing learned so far applies */
+		if (jitter > (int64_t)MAX_TS_VAR ||
+		    jitter < -(int64_t)MAX_TS_VAR)
+			async_jitter_reset(source);
+	}
+
+	if (!j->started) {
+		j->started = true;
+		j->offset = offset;
+		j->offset_time = arrival;
+		start_window(j, arrival, offset);
+	}
+
+	jitter = offset - predicted_offset(j, arrival);
+
+	if (offset < j->window_min_offset) {
+		j->window_min_offset = offset;
+		j->window_min_time = arrival;
+	}
+
+	if (jitter > 0) {
+		if ((uint64_t)jitter > j->window_max_jitter)
+			j->window_max_jitter = (uint64_t)jitter;
+
+		if ((uint64_t)jitter + JITTER_MARGIN > j->delay) {
+			j->delay = (uint64_t)jitter + JITTER_MARGIN;
+			if (j->delay > MAX_JITTER_DELAY)
+				j->delay = MAX_JITTER_DELAY;
+		}
+	}
+
+	if (j->last_ts && ts > j->last_ts && ts - j->last_ts < MAX_TS_VAR) {
+		uint64_t interval = ts - j->last_ts;
+
+		if (j->frame_interval)
+			interval = (j->frame_interval * 7 + interval) / 8;
+		j->frame_interval = interval;
+	}
+	j->last_ts = ts;
+
+	if (arrival - j->window_start >= JITTER_WINDOW)
+		end_window(j, arrival, offset);
+}
+
+bool async_jitter_ready(obs_source_t *source, uint64_t sys_time)
+{
+	struct async_jitter *j = &source->async_jitter;
+	uint64_t prev_time = source->last_sys_timestamp;
+	int64_t offset = predicted_offset(j, sys_time);
+	size_t due = 0;
+
+	for (size_t i = 0; i < source->async_frames.num; i++) {
+		uint64_t ts = source->async_frames.array[i]->timestamp;
+		uint64_t time = due_time(j, offset, ts);
+
+		if (time > sys_time)
+			break;
+
+		/* Due before the last tick, but wasn't there yet */
+		if (prev_time && time <= prev_time)
+			j->late_frames++;
+		due++;
+	}
+
+	if (!due) {
+		/* The frame on screen stays up past when the next one should
+		 * have replaced it */
+		uint64_t expected = j->shown_ts + j->frame_interval * 3 / 2;
+		if (j->shown_ts && j->frame_interval &&
+		    due_time(j, offset, expected) <= sys_time)
+			j->duplicated_frames++;
+		return false;
+	}
+
+	/* Only the latest frame that is due is shown */
+	while (--due) {
+		struct obs_source_frame *frame = source->async_frames.array[0];
+
+		da_erase(source->async_frames, 0);
+		remove_async_frame(source, frame);
+		j->dropped_frames++;
+	}
+
+	j->shown_ts = source->async_frames.array[0]->timestamp;
+	source->last_frame_ts = j->shown_ts;
+	return true;
+}
@@ -186,6 +186,7 @@ static bool obs_source_init(struct obs_source *source)
 	pthread_mutex_init_value(&source->audio_mutex);
 	pthread_mutex_init_value(&source->audio_buf_mutex);
 	pthread_mutex_init_value(&source->audio_cb_mutex);
+	pthread_mutex_init_value(&source->audio_meter_mutex);
 	pthread_mutex_init_value(&source->caption_cb_mutex);
 	pthread_mutex_init_value(&source->media_actions_mutex);
 
@@ -197,6 +198,8 @@ static bool obs_source_init(struct obs_source *source)
 		return false;
 	if (pthread_mutex_init(&source->audio_cb_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&source->audio_meter_mutex, NULL) != 0)
+		return false;
 	if (pthread_mutex_init(&source->audio_mutex, NULL) != 0)
 		return false;
 	if (pthread_mutex_init_recursive(&source->async_mutex) != 0)
@@ -612,12 +615,52 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
+/* A frame output with obs_source_output_video_borrowed, whose data belongs
+ * to the producer until it is released */
+struct borrowed_frame {
+	struct obs_source_frame frame;
+	struct obs_source *source;
+	obs_source_frame_release_t release;
+	void *param;
+};
+
+/* Call with async_mutex held.  The release callbacks of borrowed frames must
+ * not run with it held, they are deferred to unlock_async_mutex. */
+static void destroy_async_frame(struct obs_source_frame *frame)
+{
+	if (frame && frame->borrowed) {
+		struct borrowed_frame *bf = (struct borrowed_frame *)frame;
+		da_push_back(bf->source->released_frames, &bf);
+	} else {
+		obs_source_frame_destroy(frame);
+	}
+}
+
+void unlock_async_mutex(obs_source_t *source)
+{
+	DARRAY(struct borrowed_frame *) released;
+
+	da_init(released);
+	da_move(released, source->released_frames);
+	pthread_mutex_unlock(&source->async_mutex);
+
+	for (size_t i = 0; i < released.num; i++) {
+		struct borrowed_frame *bf = released.array[i];
+		bf->release(bf->param);
+		bfree(bf);
+	}
+
+	da_free(released);
+}
+
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		destroy_async_frame(frame);
 }
 
+static inline void free_async_cache(struct obs_source *source);
+
 static bool obs_source_filter_remove_refless(obs_source_t *source,
 					     obs_source_t *filter);
 static void obs_source_destroy_defer(struct obs_source *source);
@@ -641,6 +684,8 @@ void obs_source_destroy(struct obs_source *source)
 		pthread_mutex_unlock(&source->audio_cb_mutex);
 	}
 
+	obs_source_sidechain_detach(source);
+
 	pthread_mutex_lock(&source->caption_cb_mutex);
 	da_free(source->caption_cb_list);
 	pthread_mutex_unlock(&source->caption_cb_mutex);
@@ -685,6 +730,11 @@ static void obs_source_destroy_defer(struct obs_source *source)
 
 	obs_source_dosignal(source, "source_destroy", "destroy");
 
+	/* Borrowed frames have to go back to the source while it's there */
+	pthread_mutex_lock(&source->async_mutex);
+	free_async_cache(source);
+	unlock_async_mutex(source);
+
 	if (source->context.data) {
 		source->info.destroy(source->context.data);
 		source->context.data = NULL;
@@ -734,6 +784,7 @@ static void obs_source_destroy_defer(struct obs_source *source)
 	da_free(source->audio_cb_list);
 	da_free(source->caption_cb_list);
 	da_free(source->async_cache);
+	da_free(source->released_frames);
 	da_free(source->async_frames);
 	da_free(source->filters);
 	da_free(source->media_actions);
@@ -741,6 +792,7 @@ static void obs_source_destroy_defer(struct obs_source *source)
 	pthread_mutex_destroy(&source->audio_actions_mutex);
 	pthread_mutex_destroy(&source->audio_buf_mutex);
 	pthread_mutex_destroy(&source->audio_cb_mutex);
+	pthread_mutex_destroy(&source->audio_meter_mutex);
 	pthread_mutex_destroy(&source->audio_mutex);
 	pthread_mutex_destroy(&source->caption_cb_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
@@ -1291,7 +1343,7 @@ static void async_tick(obs_source_t *source)
 		source->async_update_texture =
 			set_async_texture_size(source, source->cur_async_frame);
 
-	pthread_mutex_unlock(&source->async_mutex);
+	unlock_async_mutex(source);
 }
 
 void obs_source_video_tick(obs_source_t *source, float seconds)
@@ -3633,19 +3685,17 @@ static void clean_cache(obs_source_t *source)
 }
 
 #define MAX_ASYNC_FRAMES 30
-//if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
-static inline struct obs_source_frame *
-cache_video(struct obs_source *source, const struct obs_source_frame *frame)
-{
-	struct obs_source_frame *new_frame = NULL;
-
-	pthread_mutex_lock(&source->async_mutex);
 
+/* Call with async_mutex held.  Returns false if the frames have been piling
+ * up, in which case they are all dropped along with the new frame. */
+static bool prepare_async_cache(struct obs_source *source,
+				const struct obs_source_frame *frame)
+{
 	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
 		free_async_cache(source);
 		source->last_frame_ts = 0;
-		pthread_mutex_unlock(&source->async_mutex);
-		return NULL;
+		async_jitter_reset(source);
+		return false;
 	}
 
 	if (async_texture_changed(source, frame)) {
@@ -3654,14 +3704,30 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 		source->async_cache_height = frame->height;
 	}
 
-	const enum video_format format = frame->format;
-	source->async_cache_format = format;
+	source->async_cache_format = frame->format;
 	source->async_cache_full_range = frame->full_range;
 	source->async_cache_trc = frame->trc;
+	return true;
+}
+
+//if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
+static inline struct obs_source_frame *
+cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *new_frame = NULL;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (!prepare_async_cache(source, frame)) {
+		unlock_async_mutex(source);
+		return NULL;
+	}
+
+	const enum video_format format = frame->format;
 
 	for (size_t i = 0; i < source->async_cache.num; i++) {
 		struct async_frame *af = &source->async_cache.array[i];
-		if (!af->used) {
+		if (!af->used && !af->borrowed) {
 			new_frame = af->frame;
 			new_frame->format = format;
 			af->used = true;
@@ -3680,6 +3746,7 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 		new_af.frame = new_frame;
 		new_af.used = true;
 		new_af.unused_count = 0;
+		new_af.borrowed = false;
 		new_frame->refs = 1;
 
 		da_push_back(source->async_cache, &new_af);
@@ -3687,13 +3754,68 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 
 	os_atomic_inc_long(&new_frame->refs);
 
-	pthread_mutex_unlock(&source->async_mutex);
+	unlock_async_mutex(source);
 
 	copy_frame_data(new_frame, frame);
 
 	return new_frame;
 }
 
+/* Same as cache_video, except that the frame keeps the data it was given.
+ * It goes into the cache so it's let go of like any other frame, and its
+ * entry goes away as soon as it's unused. */
+static struct obs_source_frame *
+borrow_video(struct obs_source *source, const struct obs_source_frame *frame,
+	     obs_source_frame_release_t release, void *param)
+{
+	struct borrowed_frame *bf;
+	struct async_frame new_af;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (!prepare_async_cache(source, frame)) {
+		unlock_async_mutex(source);
+		return NULL;
+	}
+
+	clean_cache(source);
+
+	bf = bzalloc(sizeof(*bf));
+	bf->frame = *frame;
+	bf->frame.refs = 2;
+	bf->frame.prev_frame = false;
+	bf->frame.borrowed = true;
+	bf->source = source;
+	bf->release = release;
+	bf->param = param;
+
+	new_af.frame = &bf->frame;
+	new_af.used = true;
+	new_af.unused_count = 0;
+	new_af.borrowed = true;
+	da_push_back(source->async_cache, &new_af);
+
+	unlock_async_mutex(source);
+
+	return &bf->frame;
+}
+
+static void push_async_frame(struct obs_source *source,
+			     struct obs_source_frame *output)
+{
+	pthread_mutex_lock(&source->async_mutex);
+	if (os_atomic_dec_long(&output->refs) == 0) {
+		destroy_async_frame(output);
+	} else {
+		if (source->async_jitter.enabled)
+			async_jitter_frame_arrived(source, output->timestamp,
+						   os_gettime_ns());
+		da_push_back(source->async_frames, &output);
+		source->async_active = true;
+	}
+	unlock_async_mutex(source);
+}
+
 static void
 obs_source_output_video_internal(obs_source_t *source,
 				 const struct obs_source_frame *frame)
@@ -3706,7 +3828,8 @@ obs_source_output_video_internal(obs_source_t *source,
 		source->async_active = false;
 		source->last_frame_ts = 0;
 		free_async_cache(source);
-		pthread_mutex_unlock(&source->async_mutex);
+		async_jitter_reset(source);
+		unlock_async_mutex(source);
 		return;
 	}
 
@@ -3715,17 +3838,8 @@ obs_source_output_video_internal(obs_source_t *source,
 	struct obs_source_frame *output = cache_video(source, frame);
 
 	/* ------------------------------------------- */
-	pthread_mutex_lock(&source->async_mutex);
-	if (output) {
-		if (os_atomic_dec_long(&output->refs) == 0) {
-			obs_source_frame_destroy(output);
-			output = NULL;
-		} else {
-			da_push_back(source->async_frames, &output);
-			source->async_active = true;
-		}
-	}
-	pthread_mutex_unlock(&source->async_mutex);
+	if (output)
+		push_async_frame(source, output);
 }
 
 void obs_source_output_video(obs_source_t *source,
@@ -3784,6 +3898,60 @@ void obs_source_output_video2(obs_source_t *source,
 	obs_source_output_video_internal(source, &new_frame);
 }
 
+/* Async filters can hold on to frames for as long as they like, or write to
+ * them, neither of which the producer's buffers are meant for */
+static bool has_async_filters(obs_source_t *source)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++) {
+		struct obs_source *filter = source->filters.array[i];
+
+		if (filter->enabled && filter->info.filter_video) {
+			found = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return found;
+}
+
+void obs_source_output_video_borrowed(obs_source_t *source,
+				      const struct obs_source_frame *frame,
+				      obs_source_frame_release_t release,
+				      void *param)
+{
+	if (!obs_ptr_valid(release, "obs_source_output_video_borrowed"))
+		return;
+	if (!obs_source_valid(source, "obs_source_output_video_borrowed") ||
+	    !obs_ptr_valid(frame, "obs_source_output_video_borrowed") ||
+	    destroying(source)) {
+		release(param);
+		return;
+	}
+
+	struct obs_source_frame new_frame = *frame;
+	new_frame.full_range =
+		format_is_yuv(frame->format) ? new_frame.full_range : true;
+
+	if (has_async_filters(source)) {
+		obs_source_output_video_internal(source, &new_frame);
+		release(param);
+		return;
+	}
+
+	source_profiler_async_frame_received(source);
+
+	struct obs_source_frame *output =
+		borrow_video(source, &new_frame, release, param);
+	if (output)
+		push_async_frame(source, output);
+	else
+		release(param);
+}
+
 void obs_source_set_async_rotation(obs_source_t *source, long rotation)
 {
 	if (source)
@@ -4038,16 +4206,76 @@ void obs_source_set_video_frame2(obs_source_t *source,
 	obs_source_set_video_frame_internal(source, &new_frame);
 }
 
+/* 128 frames of 8 channels (4 KiB) stay in L1 across a chain of filters */
+#define AUDIO_FILTER_TILE_FRAMES 128
+#define AUDIO_FILTER_MAX_FUSED 16
+
+static inline bool audio_filter_tileable(struct obs_source *filter)
+{
+	return filter->context.data && filter->info.filter_audio &&
+	       (filter->info.output_flags & OBS_SOURCE_AUDIO_TILEABLE) != 0;
+}
+
+/* Runs adjacent tileable filters over small tiles of the block in a single
+ * pass instead of having each filter walk the whole block. The result is the
+ * same as running them one after another because these filters work in place
+ * and do not depend on where blocks start or end. */
+static void filter_async_audio_tiled(struct obs_source **filters,
+				     size_t *count, struct obs_audio_data *in)
+{
+	struct obs_audio_data tile = *in;
+
+	if (*count == 1) {
+		filters[0]->info.filter_audio(filters[0]->context.data, in);
+		*count = 0;
+		return;
+	}
+
+	for (uint32_t offset = 0; offset < in->frames;
+	     offset += AUDIO_FILTER_TILE_FRAMES) {
+		tile.frames = in->frames - offset;
+		if (tile.frames > AUDIO_FILTER_TILE_FRAMES)
+			tile.frames = AUDIO_FILTER_TILE_FRAMES;
+
+		for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+			tile.data[c] = in->data[c] ? in->data[c] +
+							     offset * sizeof(float)
+						   : NULL;
+		}
+
+		for (size_t i = 0; i < *count; i++)
+			filters[i]->info.filter_audio(filters[i]->context.data,
+						      &tile);
+	}
+
+	*count = 0;
+}
+
 static inline struct obs_audio_data *
 filter_async_audio(obs_source_t *source, struct obs_audio_data *in)
 {
+	struct obs_source *tiled[AUDIO_FILTER_MAX_FUSED];
+	size_t tiled_count = 0;
 	size_t i;
+
 	for (i = source->filters.num; i > 0; i--) {
 		struct obs_source *filter = source->filters.array[i - 1];
 
 		if (!filter->enabled)
 			continue;
 
+		if (audio_filter_tileable(filter)) {
+			if (tiled_count == AUDIO_FILTER_MAX_FUSED)
+				filter_async_audio_tiled(tiled, &tiled_count,
+							 in);
+
+			tiled[tiled_count++] = filter;
+			continue;
+		}
+
+		if (tiled_count)
+			filter_async_audio_tiled(tiled, &tiled_count, in);
+
 		if (filter->context.data && filter->info.filter_audio) {
 			in = filter->info.filter_audio(filter->context.data,
 						       in);
@@ -4056,6 +4284,9 @@ filter_async_audio(obs_source_t *source, struct obs_audio_data *in)
 		}
 	}
 
+	if (tiled_count)
+		filter_async_audio_tiled(tiled, &tiled_count, in);
+
 	return in;
 }
 
@@ -4265,7 +4496,12 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 		struct async_frame *f = &source->async_cache.array[i];
 
 		if (f->frame == frame) {
-			f->used = false;
+			if (f->borrowed) {
+				da_erase(source->async_cache, i);
+				obs_source_frame_decref(frame);
+			} else {
+				f->used = false;
+			}
 			break;
 		}
 	}
@@ -4292,6 +4528,9 @@ static bool ready_async_frame(obs_source_t *source, uint64_t sys_time)
 		return true;
 	}
 
+	if (source->async_jitter.enabled)
+		return async_jitter_ready(source, sys_time);
+
 #if DEBUG_ASYNC_FRAMES
 	blog(LOG_DEBUG,
 	     "source->last_frame_ts: %llu, frame_time: %llu, "
@@ -4405,7 +4644,7 @@ struct obs_source_frame *obs_source_get_frame(obs_source_t *source)
 		os_atomic_inc_long(&frame->refs);
 	}
 
-	pthread_mutex_unlock(&source->async_mutex);
+	unlock_async_mutex(source);
 
 	return frame;
 }
@@ -4416,17 +4655,21 @@ void obs_source_release_frame(obs_source_t *source,
 	if (!frame)
 		return;
 
+	/* Borrowed frames know their source, they have to be released there */
+	if (!source && frame->borrowed)
+		source = ((struct borrowed_frame *)frame)->source;
+
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		destroy_async_frame(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			destroy_async_frame(frame);
 		else
 			remove_async_frame(source, frame);
 
-		pthread_mutex_unlock(&source->async_mutex);
+		unlock_async_mutex(source);
 	}
 }
 
@@ -5945,6 +6188,59 @@ bool obs_source_async_unbuffered(const obs_source_t *source)
 		       : false;
 }
 
+void obs_source_set_async_jitter_buffer(obs_source_t *source, bool enabled)
+{
+	if (!obs_source_valid(source, "obs_source_set_async_jitter_buffer"))
+		return;
+
+	/* Audio isn't held back along with the video, it would go out of
+	 * sync by as much as the delay */
+	if (enabled && (source->info.output_flags & OBS_SOURCE_AUDIO) != 0) {
+		blog(LOG_WARNING,
+		     "obs_source_set_async_jitter_buffer: "
+		     "source '%s' has audio, not enabling the jitter buffer",
+		     source->context.name);
+		return;
+	}
+
+	pthread_mutex_lock(&source->async_mutex);
+	if (source->async_jitter.enabled != enabled) {
+		source->async_jitter.enabled = enabled;
+		async_jitter_reset(source);
+	}
+	unlock_async_mutex(source);
+}
+
+bool obs_source_async_jitter_buffer(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_async_jitter_buffer")
+		       ? source->async_jitter.enabled
+		       : false;
+}
+
+bool obs_source_get_async_stats(obs_source_t *source,
+				struct obs_source_async_stats *stats)
+{
+	if (!obs_source_valid(source, "obs_source_get_async_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_source_get_async_stats"))
+		return false;
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC) == 0)
+		return false;
+
+	struct async_jitter *j = &source->async_jitter;
+
+	pthread_mutex_lock(&source->async_mutex);
+	stats->late_frames = j->late_frames;
+	stats->dropped_frames = j->dropped_frames;
+	stats->duplicated_frames = j->duplicated_frames;
+	stats->queued_frames = (uint32_t)source->async_frames.num;
+	stats->target_delay = j->delay;
+	stats->clock_drift_ppm = j->drift * 1000000.0;
+	unlock_async_mutex(source);
+	return true;
+}
+
 obs_data_t *obs_source_get_private_settings(obs_source_t *source)
 {
 	if (!obs_ptr_valid(source, "obs_source_get_private_settings"))
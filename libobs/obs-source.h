@@ -203,6 +203,13 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES (1 << 16)
 
+/**
+ * Audio filter processes audio in place and its output does not depend on
+ * how the audio is split into blocks, which allows running it together with
+ * other such filters over small tiles of a block in a single pass.
+ */
+#define OBS_SOURCE_AUDIO_TILEABLE (1 << 17)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
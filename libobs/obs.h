@@ -51,6 +51,7 @@ struct obs_service;
 struct obs_module;
 struct obs_fader;
 struct obs_volmeter;
+struct obs_sidechain_reader;
 
 typedef struct obs_context_data obs_object_t;
 typedef struct obs_display obs_display_t;
@@ -65,6 +66,7 @@ typedef struct obs_service obs_service_t;
 typedef struct obs_module obs_module_t;
 typedef struct obs_fader obs_fader_t;
 typedef struct obs_volmeter obs_volmeter_t;
+typedef struct obs_sidechain_reader obs_sidechain_reader_t;
 
 typedef struct obs_weak_object obs_weak_object_t;
 typedef struct obs_weak_source obs_weak_source_t;
@@ -282,6 +284,7 @@ struct obs_source_frame {
 	/* used internally by libobs */
 	volatile long refs;
 	bool prev_frame;
+	bool borrowed;
 };
 
 struct obs_source_frame2 {
@@ -824,6 +827,10 @@ EXPORT void obs_enum_audio_monitoring_devices(obs_enum_audio_device_cb cb,
 EXPORT bool obs_set_audio_monitoring_device(const char *name, const char *id);
 EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
 
+/** Sets the latency audio monitoring aims for, if the backend supports it */
+EXPORT void obs_set_audio_monitoring_latency(uint32_t ms);
+EXPORT uint32_t obs_get_audio_monitoring_latency(void);
+
 EXPORT void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 				  void *param);
 EXPORT void obs_remove_tick_callback(void (*tick)(void *param, float seconds),
@@ -1321,6 +1328,36 @@ EXPORT void obs_source_add_audio_capture_callback(
 EXPORT void obs_source_remove_audio_capture_callback(
 	obs_source_t *source, obs_source_audio_capture_t callback, void *param);
 
+/** Block of sidechain audio, valid until the next read */
+struct obs_sidechain_data {
+	float *data[MAX_AUDIO_CHANNELS];
+	uint32_t frames;
+
+	/** Timestamp of the first frame, to align it with other audio */
+	uint64_t timestamp;
+};
+
+/**
+ * Subscribes to the audio of a source, for use as the sidechain of an audio
+ * filter of another source.  All readers of a source share the same audio,
+ * and reading it takes no locks.
+ */
+EXPORT obs_sidechain_reader_t *
+obs_sidechain_reader_create(obs_source_t *source);
+EXPORT void obs_sidechain_reader_destroy(obs_sidechain_reader_t *reader);
+
+/**
+ * Copies the next frames of the source audio into the buffers of the reader.
+ * The source never waits for its readers, so the frames are copied out
+ * rather than pointed to in place, where the source could overwrite them
+ * while the filter still uses them.  Returns false if not that many frames
+ * are available yet, or if the source overwrote them while they were
+ * copied.  A reader that falls behind skips ahead to the recent audio.
+ */
+EXPORT bool obs_sidechain_reader_read(obs_sidechain_reader_t *reader,
+				      uint32_t frames,
+				      struct obs_sidechain_data *out);
+
 typedef void (*obs_source_caption_t)(void *param, obs_source_t *source,
 				     const struct obs_source_cea_708 *captions);
 
@@ -1424,6 +1461,26 @@ EXPORT void obs_source_output_video(obs_source_t *source,
 EXPORT void obs_source_output_video2(obs_source_t *source,
 				     const struct obs_source_frame2 *frame);
 
+typedef void (*obs_source_frame_release_t)(void *param);
+
+/**
+ * Outputs asynchronous video data without copying it.  The data of the frame
+ * has to stay valid and unchanged until release is called, which happens
+ * once the frame has been uploaded or dropped.  release may be called from
+ * any thread, and is called before the source is destroyed.  It is never
+ * called with the source's locks held, but may be called before this
+ * function returns, for this frame or for frames output earlier.
+ *
+ * Sources with async video filters have their frames copied, and released
+ * right away.
+ *
+ * NOTE: Non-YUV formats will always be treated as full range with this
+ * function, as with obs_source_output_video.
+ */
+EXPORT void obs_source_output_video_borrowed(
+	obs_source_t *source, const struct obs_source_frame *frame,
+	obs_source_frame_release_t release, void *param);
+
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
 EXPORT void obs_source_output_cea708(obs_source_t *source,
@@ -1576,6 +1633,39 @@ EXPORT void obs_source_set_async_unbuffered(obs_source_t *source,
 					    bool unbuffered);
 EXPORT bool obs_source_async_unbuffered(const obs_source_t *source);
 
+/** Statistics of the async video queue of a source */
+struct obs_source_async_stats {
+	/** Frames that arrived after they were due */
+	uint64_t late_frames;
+	/** Frames that were due but skipped for a later one */
+	uint64_t dropped_frames;
+	/** Renders that repeated a frame because the next one was missing */
+	uint64_t duplicated_frames;
+	/** Frames waiting to be shown */
+	uint32_t queued_frames;
+	/** Delay the jitter buffer holds frames back by, in nanoseconds */
+	uint64_t target_delay;
+	/** Estimated drift of the source clock against the render clock */
+	double clock_drift_ppm;
+};
+
+/**
+ * Holds async video frames back by the jitter of their arrival, adapting to
+ * it over time, and follows the drift between the clock of the source and
+ * the render clock.  Off by default.  Has no effect when unbuffered.
+ *
+ * Audio isn't delayed along with the video, so it can't be enabled on
+ * sources that output audio.
+ */
+EXPORT void obs_source_set_async_jitter_buffer(obs_source_t *source,
+					       bool enabled);
+EXPORT bool obs_source_async_jitter_buffer(const obs_source_t *source);
+
+/** Gets the statistics of an async source, which are counted while its
+ * jitter buffer is enabled */
+EXPORT bool obs_source_get_async_stats(obs_source_t *source,
+				       struct obs_source_async_stats *stats);
+
 /** Used to decouple audio from video so that audio doesn't attempt to sync up
  * with video.  I.E. Audio acts independently.  Only works when in unbuffered
  * mode. */
@@ -2496,6 +2586,17 @@ EXPORT uint32_t obs_encoder_get_frame_rate_divisor(const obs_encoder_t *encoder)
 /** For video encoders, returns the number of frames encoded */
 EXPORT uint32_t obs_encoder_get_encoded_frames(const obs_encoder_t *encoder);
 
+/** For video encoders, returns the number of frames skipped since starting
+ * because the encoder couldn't keep up */
+EXPORT uint32_t obs_encoder_get_skipped_frames(const obs_encoder_t *encoder);
+
+/** For video encoders, returns the number of frames waiting to be encoded */
+EXPORT uint32_t obs_encoder_get_queued_frames(const obs_encoder_t *encoder);
+
+/** For video encoders, returns the number of frames the encoder holds before
+ * it outputs the packet of a frame, as reported by the encoder */
+EXPORT uint32_t obs_encoder_get_pipeline_latency(const obs_encoder_t *encoder);
+
 /** For audio encoders, returns the sample rate of the audio */
 EXPORT uint32_t obs_encoder_get_sample_rate(const obs_encoder_t *encoder);
 
@@ -2593,6 +2694,11 @@ EXPORT const char *obs_encoder_get_last_error(obs_encoder_t *encoder);
 EXPORT void obs_encoder_set_last_error(obs_encoder_t *encoder,
 				       const char *message);
 
+/** Reports the number of frames the encoder holds before it outputs the
+ * packet of a frame */
+EXPORT void obs_encoder_set_pipeline_latency(obs_encoder_t *encoder,
+					     uint32_t frames);
+
 EXPORT uint64_t obs_encoder_get_pause_offset(const obs_encoder_t *encoder);
 
 /**
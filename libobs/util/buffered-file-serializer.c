@@ -14,6 +14,10 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#ifdef HAVE_LIBURING
+#define _GNU_SOURCE
+#endif
+
 #include "buffered-file-serializer.h"
 
 #include <inttypes.h>
@@ -23,9 +27,84 @@
 #include "deque.h"
 #include "dstr.h"
 
+#ifdef HAVE_LIBURING
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <liburing.h>
+#endif
+
 static const size_t DEFAULT_BUF_SIZE = 256ULL * 1048576ULL; // 256 MiB
 static const size_t DEFAULT_CHUNK_SIZE = 1048576;           // 1 MiB
 
+/* ========================================================================== */
+/* Write latency statistics                                                   */
+
+/* Log-linear histogram with four sub-buckets per power of two, so reported
+ * percentiles are accurate to within 25%. */
+#define LATENCY_SUB_BUCKETS 4
+#define LATENCY_BUCKETS (64 * LATENCY_SUB_BUCKETS)
+
+struct io_latency {
+	uint64_t buckets[LATENCY_BUCKETS];
+	uint64_t count;
+	uint64_t bytes;
+	uint64_t max_ns;
+};
+
+static inline size_t latency_bucket(uint64_t ns)
+{
+	if (ns < LATENCY_SUB_BUCKETS)
+		return (size_t)ns;
+
+	size_t msb = 0;
+	while (ns >> (msb + 1))
+		msb++;
+
+	return msb * LATENCY_SUB_BUCKETS +
+	       (size_t)((ns >> (msb - 2)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+static inline uint64_t latency_bucket_max(size_t idx)
+{
+	if (idx < LATENCY_SUB_BUCKETS)
+		return idx;
+
+	size_t msb = idx / LATENCY_SUB_BUCKETS;
+	uint64_t sub = idx % LATENCY_SUB_BUCKETS;
+
+	return ((LATENCY_SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+static void latency_record(struct io_latency *lat, uint64_t ns, size_t bytes)
+{
+	lat->buckets[latency_bucket(ns)]++;
+	lat->count++;
+	lat->bytes += bytes;
+	if (ns > lat->max_ns)
+		lat->max_ns = ns;
+}
+
+static uint64_t latency_percentile(const struct io_latency *lat, double pct)
+{
+	uint64_t target = (uint64_t)((double)lat->count * pct + 0.5);
+	uint64_t seen = 0;
+
+	if (!target)
+		target = 1;
+
+	for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += lat->buckets[i];
+		if (seen >= target) {
+			uint64_t bucket_max = latency_bucket_max(i);
+			return bucket_max < lat->max_ns ? bucket_max
+							: lat->max_ns;
+		}
+	}
+
+	return lat->max_ns;
+}
+
 /* ========================================================================== */
 /* Buffered writer based on ffmpeg-mux implementation                         */
 
@@ -34,6 +113,42 @@ struct io_header {
 	uint64_t data_length;
 };
 
+#ifdef HAVE_LIBURING
+/* Number of chunks that may be queued to the kernel at the same time */
+#define URING_QUEUE_DEPTH 4
+
+/* Offset and length alignment required for O_DIRECT writes. 4 KiB satisfies
+ * the logical block size of effectively all current storage devices. */
+static const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+struct uring_chunk {
+	unsigned char *data;
+	uint64_t offset;
+	uint64_t submit_time;
+	size_t size;
+	int fd;
+	bool in_flight;
+};
+
+struct uring_writer {
+	struct io_uring ring;
+
+	/* Regular descriptor, used for everything unless O_DIRECT is
+	 * active, in which case it only handles unaligned writes. */
+	int fd;
+	/* O_DIRECT descriptor for aligned writes, -1 if not in use */
+	int direct_fd;
+
+	struct uring_chunk chunks[URING_QUEUE_DEPTH];
+	struct uring_chunk *cur;
+	unsigned in_flight;
+
+	/* Used to detect writes that may overlap in-flight requests */
+	int last_fd;
+	uint64_t next_offset;
+};
+#endif
+
 struct io_buffer {
 	bool active;
 	bool shutdown_requested;
@@ -48,6 +163,14 @@ struct io_buffer {
 
 	size_t buffer_size;
 	size_t chunk_size;
+	uint32_t flags;
+
+#ifdef HAVE_LIBURING
+	struct uring_writer *uring;
+#endif
+
+	/* Only accessed by the I/O thread until it has been joined */
+	struct io_latency latency;
 };
 
 struct file_output_data {
@@ -55,6 +178,298 @@ struct file_output_data {
 	struct io_buffer io;
 };
 
+/* ========================================================================== */
+/* io_uring backend (Linux)                                                   */
+
+#ifdef HAVE_LIBURING
+static bool uring_pwrite_all(int fd, const unsigned char *data, size_t size,
+			     uint64_t offset)
+{
+	while (size) {
+		ssize_t ret = pwrite(fd, data, size, (off_t)offset);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		if (ret == 0) {
+			errno = EIO;
+			return false;
+		}
+
+		data += ret;
+		size -= (size_t)ret;
+		offset += (uint64_t)ret;
+	}
+
+	return true;
+}
+
+static bool uring_reap(struct file_output_data *out)
+{
+	struct uring_writer *w = out->io.uring;
+	struct io_uring_cqe *cqe;
+
+	int ret = io_uring_wait_cqe(&w->ring, &cqe);
+	if (ret < 0) {
+		blog(LOG_ERROR, "io_uring wait for '%s' failed: %s",
+		     out->filename.array, strerror(-ret));
+		return false;
+	}
+
+	struct uring_chunk *chunk = io_uring_cqe_get_data(cqe);
+	int res = cqe->res;
+	io_uring_cqe_seen(&w->ring, cqe);
+
+	chunk->in_flight = false;
+	w->in_flight--;
+
+	if (res < 0) {
+		blog(LOG_ERROR, "Error writing to '%s': %s",
+		     out->filename.array, strerror(-res));
+		return false;
+	}
+
+	/* Short writes are rare enough to just finish them synchronously.
+	 * The rest is no longer block aligned, so it can't go through the
+	 * O_DIRECT descriptor. */
+	if ((size_t)res < chunk->size &&
+	    !uring_pwrite_all(w->fd, chunk->data + res,
+			      chunk->size - (size_t)res,
+			      chunk->offset + (uint64_t)res)) {
+		blog(LOG_ERROR, "Error writing to '%s': %s",
+		     out->filename.array, strerror(errno));
+		return false;
+	}
+
+	latency_record(&out->io.latency, os_gettime_ns() - chunk->submit_time,
+		       chunk->size);
+	return true;
+}
+
+static bool uring_drain(struct file_output_data *out)
+{
+	struct uring_writer *w = out->io.uring;
+
+	while (w->in_flight) {
+		if (!uring_reap(out))
+			return false;
+	}
+
+	return true;
+}
+
+/* io_uring does not order requests against each other, so anything that is
+ * not a sequential continuation on the same descriptor has to wait for the
+ * requests in flight. This only happens when mp4-mux seeks back to rewrite
+ * headers or when switching between the direct and buffered descriptors. */
+static bool uring_order_write(struct file_output_data *out, int fd,
+			      uint64_t offset, size_t size)
+{
+	struct uring_writer *w = out->io.uring;
+	bool sequential = fd == w->last_fd && offset == w->next_offset;
+
+	w->last_fd = fd;
+	w->next_offset = offset + size;
+
+	return sequential || uring_drain(out);
+}
+
+static bool uring_write_sync(struct file_output_data *out,
+			     const unsigned char *data, size_t size,
+			     uint64_t offset)
+{
+	struct uring_writer *w = out->io.uring;
+
+	if (!uring_order_write(out, w->fd, offset, size))
+		return false;
+
+	uint64_t start = os_gettime_ns();
+	if (!uring_pwrite_all(w->fd, data, size, offset)) {
+		blog(LOG_ERROR, "Error writing to '%s': %s",
+		     out->filename.array, strerror(errno));
+		return false;
+	}
+
+	latency_record(&out->io.latency, os_gettime_ns() - start, size);
+	return true;
+}
+
+static bool uring_submit(struct file_output_data *out,
+			 struct uring_chunk *chunk, int fd, uint64_t offset,
+			 size_t size)
+{
+	struct uring_writer *w = out->io.uring;
+
+	if (!uring_order_write(out, fd, offset, size))
+		return false;
+
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&w->ring);
+	if (!sqe) {
+		blog(LOG_ERROR, "io_uring submission queue for '%s' is full",
+		     out->filename.array);
+		return false;
+	}
+
+	chunk->fd = fd;
+	chunk->offset = offset;
+	chunk->size = size;
+	chunk->submit_time = os_gettime_ns();
+
+	io_uring_prep_write(sqe, fd, chunk->data, (unsigned)size, offset);
+	io_uring_sqe_set_data(sqe, chunk);
+
+	int ret = io_uring_submit(&w->ring);
+	if (ret < 0) {
+		blog(LOG_ERROR, "io_uring submit for '%s' failed: %s",
+		     out->filename.array, strerror(-ret));
+		return false;
+	}
+
+	chunk->in_flight = true;
+	w->in_flight++;
+	return true;
+}
+
+static struct uring_chunk *uring_acquire(struct file_output_data *out)
+{
+	struct uring_writer *w = out->io.uring;
+
+	for (;;) {
+		for (size_t i = 0; i < URING_QUEUE_DEPTH; i++) {
+			struct uring_chunk *chunk = &w->chunks[i];
+			if (chunk != w->cur && !chunk->in_flight)
+				return chunk;
+		}
+
+		if (!uring_reap(out))
+			return NULL;
+	}
+}
+
+/* Queues the current chunk and switches to a free one. With O_DIRECT only the
+ * block-aligned part is queued; the unaligned tail is carried over into the
+ * next chunk unless flush_all is set (seeks and shutdown), in which case it
+ * goes through the regular descriptor. */
+static bool uring_write_chunk(struct file_output_data *out, size_t *chunk_used,
+			      uint64_t *write_pos, bool flush_all)
+{
+	struct uring_writer *w = out->io.uring;
+	struct uring_chunk *chunk = w->cur;
+	uint64_t pos = *write_pos;
+	size_t used = *chunk_used;
+	size_t size = used;
+	int fd = w->fd;
+
+	if (w->direct_fd != -1) {
+		size_t mask = DIRECT_IO_ALIGNMENT - 1;
+		size_t head = (DIRECT_IO_ALIGNMENT - (size_t)(pos & mask)) &
+			      mask;
+
+		if (used >= head + DIRECT_IO_ALIGNMENT) {
+			// Only happens for the first chunk after a seek
+			if (head) {
+				if (!uring_write_sync(out, chunk->data, head,
+						      pos))
+					return false;
+
+				memmove(chunk->data, chunk->data + head,
+					used - head);
+				used -= head;
+				pos += head;
+			}
+
+			fd = w->direct_fd;
+			size = used & ~mask;
+		}
+	}
+
+	if (!uring_submit(out, chunk, fd, pos, size))
+		return false;
+
+	struct uring_chunk *next = uring_acquire(out);
+	if (!next)
+		return false;
+
+	size_t tail = used - size;
+	pos += size;
+
+	if (tail && flush_all) {
+		if (!uring_write_sync(out, chunk->data + size, tail, pos))
+			return false;
+		pos += tail;
+		tail = 0;
+	} else if (tail) {
+		memcpy(next->data, chunk->data + size, tail);
+	}
+
+	w->cur = next;
+	*chunk_used = tail;
+	*write_pos = pos;
+	return true;
+}
+
+static void uring_writer_destroy(struct uring_writer *w)
+{
+	if (!w)
+		return;
+
+	io_uring_queue_exit(&w->ring);
+
+	for (size_t i = 0; i < URING_QUEUE_DEPTH; i++)
+		free(w->chunks[i].data);
+
+	if (w->direct_fd != -1)
+		close(w->direct_fd);
+	close(w->fd);
+	bfree(w);
+}
+
+static struct uring_writer *uring_writer_create(const char *path,
+						size_t chunk_capacity,
+						bool direct)
+{
+	struct uring_writer *w = bzalloc(sizeof(*w));
+	w->direct_fd = -1;
+	w->last_fd = -1;
+
+	w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (w->fd == -1) {
+		bfree(w);
+		return NULL;
+	}
+
+	int ret = io_uring_queue_init(URING_QUEUE_DEPTH, &w->ring, 0);
+	if (ret < 0) {
+		blog(LOG_WARNING, "io_uring unavailable: %s", strerror(-ret));
+		close(w->fd);
+		bfree(w);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < URING_QUEUE_DEPTH; i++) {
+		if (posix_memalign((void **)&w->chunks[i].data,
+				   DIRECT_IO_ALIGNMENT, chunk_capacity) != 0) {
+			uring_writer_destroy(w);
+			return NULL;
+		}
+	}
+
+	w->cur = &w->chunks[0];
+
+	if (direct) {
+		w->direct_fd = open(path, O_WRONLY | O_DIRECT | O_CLOEXEC);
+		if (w->direct_fd == -1)
+			blog(LOG_WARNING,
+			     "O_DIRECT not supported for '%s' (%s), "
+			     "falling back to buffered writes",
+			     path, strerror(errno));
+	}
+
+	return w;
+}
+#endif
+
 static void *io_thread(void *opaque)
 {
 	struct file_output_data *out = opaque;
@@ -63,8 +478,19 @@ static void *io_thread(void *opaque)
 	// Chunk collects the writes into a larger batch
 	size_t chunk_used = 0;
 	size_t chunk_size = out->io.chunk_size;
+	unsigned char *chunk = NULL;
+
+#ifdef HAVE_LIBURING
+	// Chunks are owned by the io_uring writer, which also needs room for
+	// the unaligned tail carried over from the previous O_DIRECT write.
+	if (out->io.uring) {
+		chunk = out->io.uring->cur->data;
+		chunk_size += DIRECT_IO_ALIGNMENT;
+	}
+#endif
 
-	unsigned char *chunk = bmalloc(chunk_size);
+	if (!chunk)
+		chunk = bmalloc(chunk_size);
 	if (!chunk) {
 		os_atomic_set_bool(&out->io.output_error, true);
 		fprintf(stderr, "Error allocating memory for output\n");
@@ -74,6 +500,9 @@ static void *io_thread(void *opaque)
 	bool shutting_down;
 	bool want_seek = false;
 	bool force_flush_chunk = false;
+#ifdef HAVE_LIBURING
+	bool discontinuity = false;
+#endif
 
 	// current_seek_position is a virtual position updated as we read from
 	// the buffer, if it becomes discontinuous due to a seek request we
@@ -82,6 +511,9 @@ static void *io_thread(void *opaque)
 	uint64_t current_seek_position = 0;
 	uint64_t next_seek_position;
 
+	// Actual file offset the start of the chunk will be written to
+	uint64_t write_pos = 0;
+
 	for (;;) {
 		// Wait for data to be written to the buffer
 		os_event_wait(out->io.new_data_available_event);
@@ -118,6 +550,9 @@ static void *io_thread(void *opaque)
 					// if we already plan to seek, then seek.
 					if (chunk_used || want_seek) {
 						force_flush_chunk = true;
+#ifdef HAVE_LIBURING
+						discontinuity = true;
+#endif
 						break;
 					}
 
@@ -171,8 +606,12 @@ static void *io_thread(void *opaque)
 
 			// Seek if we need to
 			if (want_seek) {
-				os_fseeki64(out->io.output_file,
-					    next_seek_position, SEEK_SET);
+				if (out->io.output_file)
+					os_fseeki64(out->io.output_file,
+						    next_seek_position,
+						    SEEK_SET);
+
+				write_pos = next_seek_position;
 
 				// Update the next virtual position, making sure to take
 				// into account the size of the chunk we're about to write.
@@ -185,11 +624,33 @@ static void *io_thread(void *opaque)
 				// return to the start of the loop.
 				if (!chunk_used) {
 					force_flush_chunk = false;
+#ifdef HAVE_LIBURING
+					discontinuity = false;
+#endif
 					continue;
 				}
 			}
 
+#ifdef HAVE_LIBURING
+			if (out->io.uring) {
+				if (!uring_write_chunk(out, &chunk_used,
+						       &write_pos,
+						       discontinuity ||
+							       shutting_down)) {
+					os_atomic_set_bool(
+						&out->io.output_error, true);
+					goto error;
+				}
+
+				chunk = out->io.uring->cur->data;
+				force_flush_chunk = false;
+				discontinuity = false;
+				continue;
+			}
+#endif
+
 			// Write the current chunk to the output file
+			uint64_t write_start = os_gettime_ns();
 			size_t bytes_written = fwrite(chunk, 1, chunk_used,
 						      out->io.output_file);
 			if (bytes_written != chunk_used) {
@@ -202,6 +663,11 @@ static void *io_thread(void *opaque)
 				goto error;
 			}
 
+			latency_record(&out->io.latency,
+				       os_gettime_ns() - write_start,
+				       chunk_used);
+
+			write_pos += chunk_used;
 			chunk_used = 0;
 			force_flush_chunk = false;
 		}
@@ -212,6 +678,17 @@ static void *io_thread(void *opaque)
 	}
 
 error:
+#ifdef HAVE_LIBURING
+	if (out->io.uring) {
+		if (!uring_drain(out))
+			os_atomic_set_bool(&out->io.output_error, true);
+
+		uring_writer_destroy(out->io.uring);
+		out->io.uring = NULL;
+		return NULL;
+	}
+#endif
+
 	if (chunk)
 		bfree(chunk);
 
@@ -341,11 +818,53 @@ static int64_t file_output_get_pos(void *opaque)
 bool buffered_file_serializer_init_defaults(struct serializer *s,
 					    const char *path)
 {
-	return buffered_file_serializer_init(s, path, 0, 0);
+	return buffered_file_serializer_init_ex(s, path, 0, 0, 0);
 }
 
 bool buffered_file_serializer_init(struct serializer *s, const char *path,
 				   size_t max_bufsize, size_t chunk_size)
+{
+	return buffered_file_serializer_init_ex(s, path, max_bufsize,
+						chunk_size, 0);
+}
+
+static bool open_output(struct file_output_data *out, const char *path)
+{
+#ifdef HAVE_LIBURING
+	uint32_t uring_flags = BUFFERED_FILE_IO_URING | BUFFERED_FILE_DIRECT_IO;
+
+	if (out->io.flags & uring_flags) {
+		bool direct = (out->io.flags & BUFFERED_FILE_DIRECT_IO) != 0;
+
+		out->io.uring = uring_writer_create(
+			path, out->io.chunk_size + DIRECT_IO_ALIGNMENT, direct);
+		if (out->io.uring) {
+			blog(LOG_INFO,
+			     "Using io_uring%s for writing '%s'",
+			     out->io.uring->direct_fd != -1 ? " with O_DIRECT"
+							     : "",
+			     path);
+			return true;
+		}
+
+		blog(LOG_WARNING,
+		     "Failed to set up io_uring for '%s', "
+		     "falling back to buffered writes",
+		     path);
+	}
+#else
+	if (out->io.flags & (BUFFERED_FILE_IO_URING | BUFFERED_FILE_DIRECT_IO))
+		blog(LOG_WARNING, "io_uring file output is not available, "
+				  "falling back to buffered writes");
+#endif
+
+	out->io.output_file = os_fopen(path, "wb");
+	return out->io.output_file != NULL;
+}
+
+bool buffered_file_serializer_init_ex(struct serializer *s, const char *path,
+				      size_t max_bufsize, size_t chunk_size,
+				      uint32_t flags)
 {
 	struct file_output_data *out;
 
@@ -353,12 +872,15 @@ bool buffered_file_serializer_init(struct serializer *s, const char *path,
 
 	dstr_init_copy(&out->filename, path);
 
-	out->io.output_file = os_fopen(path, "wb");
-	if (!out->io.output_file)
-		return false;
-
 	out->io.buffer_size = max_bufsize ? max_bufsize : DEFAULT_BUF_SIZE;
 	out->io.chunk_size = chunk_size ? chunk_size : DEFAULT_CHUNK_SIZE;
+	out->io.flags = flags;
+
+	if (!open_output(out, path)) {
+		dstr_free(&out->filename);
+		bfree(out);
+		return false;
+	}
 
 	// Start at 1MB, this can grow up to max_bufsize depending
 	// on how fast data is going in and out.
@@ -406,6 +928,19 @@ void buffered_file_serializer_free(struct serializer *s)
 		blog(LOG_DEBUG, "Final buffer capacity: %zu KiB",
 		     out->io.data.capacity / 1024);
 
+		struct io_latency *lat = &out->io.latency;
+		if (lat->count) {
+			blog(LOG_INFO,
+			     "Wrote %" PRIu64 " MiB in %" PRIu64
+			     " writes, latency p50/p90/p99/max: "
+			     "%.2f/%.2f/%.2f/%.2f ms",
+			     lat->bytes / 1048576, lat->count,
+			     (double)latency_percentile(lat, 0.50) / 1e6,
+			     (double)latency_percentile(lat, 0.90) / 1e6,
+			     (double)latency_percentile(lat, 0.99) / 1e6,
+			     (double)lat->max_ns / 1e6);
+		}
+
 		deque_free(&out->io.data);
 	}
 
@@ -22,11 +22,22 @@
 extern "C" {
 #endif
 
+/* Write through io_uring with multiple chunks in flight (Linux only) */
+#define BUFFERED_FILE_IO_URING (1 << 0)
+/* Bypass the page cache with O_DIRECT for block-aligned writes, implies
+ * BUFFERED_FILE_IO_URING */
+#define BUFFERED_FILE_DIRECT_IO (1 << 1)
+
 EXPORT bool buffered_file_serializer_init_defaults(struct serializer *s,
 						   const char *path);
 EXPORT bool buffered_file_serializer_init(struct serializer *s,
 					  const char *path, size_t max_bufsize,
 					  size_t chunk_size);
+/* Unsupported flags fall back to regular buffered writes */
+EXPORT bool buffered_file_serializer_init_ex(struct serializer *s,
+					     const char *path,
+					     size_t max_bufsize,
+					     size_t chunk_size, uint32_t flags);
 EXPORT void buffered_file_serializer_free(struct serializer *s);
 
 #ifdef __cplusplus
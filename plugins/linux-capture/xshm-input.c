@@ -18,11 +18,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <xcb/damage.h>
 #include <xcb/randr.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
 #include <xcb/xinerama.h>
 
+#include <glad/glad.h>
 #include <obs-module.h>
 #include <util/dstr.h>
 #include "xcursor-xcb.h"
@@ -34,6 +36,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define INVALID_DISPLAY (-1)
 
+/* Past this many damaged rectangles, the whole screen is fetched at once */
+#define MAX_DAMAGE_RECTS 32
+
 struct xshm_data {
 	obs_source_t *source;
 
@@ -65,6 +70,17 @@ struct xshm_data {
 	bool use_xinerama;
 	bool use_randr;
 	bool advanced;
+
+	bool use_damage;
+	bool full_damage;
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t damage_region;
+	xcb_rectangle_t damage_rects[MAX_DAMAGE_RECTS];
+	int damage_rect_count;
+
+	uint64_t frames;
+	uint64_t changed_frames;
+	uint64_t fetched_bytes;
 };
 
 /**
@@ -103,6 +119,197 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	return ok;
 }
 
+/**
+ * Start tracking damage to the root window
+ *
+ * Without the Damage extension the whole screen is fetched every tick.
+ *
+ * @note requires XFixes to be initialized, which the cursor does
+ */
+static void xshm_damage_start(struct xshm_data *data)
+{
+	xcb_damage_query_version_cookie_t ver_c;
+	xcb_damage_query_version_reply_t *ver_r;
+
+	data->full_damage = true;
+
+	if (!xcb_get_extension_data(data->xcb, &xcb_damage_id)->present) {
+		blog(LOG_INFO, "Missing Damage extension !");
+		return;
+	}
+
+	ver_c = xcb_damage_query_version_unchecked(data->xcb,
+						   XCB_DAMAGE_MAJOR_VERSION,
+						   XCB_DAMAGE_MINOR_VERSION);
+	ver_r = xcb_damage_query_version_reply(data->xcb, ver_c, NULL);
+	if (!ver_r)
+		return;
+	free(ver_r);
+
+	data->damage = xcb_generate_id(data->xcb);
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			  XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+
+	data->damage_region = xcb_generate_id(data->xcb);
+	xcb_xfixes_create_region(data->xcb, data->damage_region, 0, NULL);
+
+	data->use_damage = true;
+}
+
+/**
+ * Stop tracking damage
+ */
+static void xshm_damage_stop(struct xshm_data *data)
+{
+	if (!data->use_damage)
+		return;
+
+	xcb_damage_destroy(data->xcb, data->damage);
+	xcb_xfixes_destroy_region(data->xcb, data->damage_region);
+	data->use_damage = false;
+}
+
+/**
+ * Collect the damage since the last tick into damage_rects, clipped to the
+ * captured area and relative to it
+ *
+ * @return true if the whole captured area has to be fetched
+ */
+static bool xshm_take_damage(struct xshm_data *data)
+{
+	xcb_xfixes_fetch_region_cookie_t region_c;
+	xcb_xfixes_fetch_region_reply_t *region_r;
+	xcb_generic_event_t *event;
+	xcb_rectangle_t *rects;
+	uint64_t area = 0;
+	bool full = false;
+	int count;
+
+	data->damage_rect_count = 0;
+
+	if (!data->use_damage)
+		return true;
+
+	/* the notify events only say that there is damage, which is fetched
+	 * as a region below */
+	while ((event = xcb_poll_for_event(data->xcb)))
+		free(event);
+
+	if (data->full_damage) {
+		xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+				    XCB_NONE);
+		data->full_damage = false;
+		return true;
+	}
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+			    data->damage_region);
+	region_c = xcb_xfixes_fetch_region_unchecked(data->xcb,
+						     data->damage_region);
+	region_r = xcb_xfixes_fetch_region_reply(data->xcb, region_c, NULL);
+	if (!region_r)
+		return true;
+
+	rects = xcb_xfixes_fetch_region_rectangles(region_r);
+	count = xcb_xfixes_fetch_region_rectangles_length(region_r);
+
+	for (int i = 0; i < count; i++) {
+		int_fast32_t x1 = rects[i].x - data->adj_x_org;
+		int_fast32_t y1 = rects[i].y - data->adj_y_org;
+		int_fast32_t x2 = x1 + rects[i].width;
+		int_fast32_t y2 = y1 + rects[i].height;
+
+		if (x1 < 0)
+			x1 = 0;
+		if (y1 < 0)
+			y1 = 0;
+		if (x2 > data->adj_width)
+			x2 = data->adj_width;
+		if (y2 > data->adj_height)
+			y2 = data->adj_height;
+		if (x2 <= x1 || y2 <= y1)
+			continue;
+
+		if (data->damage_rect_count == MAX_DAMAGE_RECTS) {
+			full = true;
+			break;
+		}
+
+		data->damage_rects[data->damage_rect_count++] =
+			(xcb_rectangle_t){(int16_t)x1, (int16_t)y1,
+					  (uint16_t)(x2 - x1),
+					  (uint16_t)(y2 - y1)};
+		area += (uint64_t)(x2 - x1) * (uint64_t)(y2 - y1);
+	}
+
+	free(region_r);
+
+	/* fetching most of the screen in pieces is slower than all at once */
+	if (area * 4 > (uint64_t)data->adj_width * data->adj_height * 3)
+		full = true;
+
+	return full;
+}
+
+/**
+ * Fetch the damaged rectangles into the shared memory segment, one after
+ * the other
+ *
+ * The rectangles don't overlap and cover less than the captured area, so
+ * they always fit.
+ *
+ * @return number of bytes fetched, 0 on error
+ */
+static size_t xshm_fetch_damage(struct xshm_data *data)
+{
+	xcb_shm_get_image_cookie_t img_c[MAX_DAMAGE_RECTS];
+	xcb_shm_get_image_reply_t *img_r;
+	uint32_t offset = 0;
+	bool success = true;
+
+	for (int i = 0; i < data->damage_rect_count; i++) {
+		xcb_rectangle_t *rect = &data->damage_rects[i];
+
+		img_c[i] = xcb_shm_get_image_unchecked(
+			data->xcb, data->xcb_screen->root,
+			data->adj_x_org + rect->x, data->adj_y_org + rect->y,
+			rect->width, rect->height, ~0,
+			XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, offset);
+		offset += (uint32_t)rect->width * rect->height * 4;
+	}
+
+	for (int i = 0; i < data->damage_rect_count; i++) {
+		img_r = xcb_shm_get_image_reply(data->xcb, img_c[i], NULL);
+		success = success && img_r;
+		free(img_r);
+	}
+
+	return success ? offset : 0;
+}
+
+/**
+ * Upload the rectangles fetched by xshm_fetch_damage
+ *
+ * @note requires to be called within the obs graphics context
+ */
+static void xshm_upload_damage(struct xshm_data *data)
+{
+	GLuint gl_texture = *(GLuint *)gs_texture_get_obj(data->texture);
+	const uint8_t *pixels = data->xshm->data;
+
+	glBindTexture(GL_TEXTURE_2D, gl_texture);
+
+	for (int i = 0; i < data->damage_rect_count; i++) {
+		xcb_rectangle_t *rect = &data->damage_rects[i];
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect->x, rect->y, rect->width,
+				rect->height, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+		pixels += (size_t)rect->width * rect->height * 4;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 /**
  * Update the capture
  *
@@ -190,6 +397,14 @@ static const char *xshm_getname(void *unused)
  */
 static void xshm_capture_stop(struct xshm_data *data)
 {
+	if (data->frames) {
+		blog(LOG_INFO,
+		     "Captured %" PRIu64 " frames, %" PRIu64 " changed, "
+		     "%.1f MB fetched",
+		     data->frames, data->changed_frames,
+		     (double)data->fetched_bytes / (1024.0 * 1024.0));
+	}
+
 	obs_enter_graphics();
 
 	if (data->texture) {
@@ -203,6 +418,8 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
+	xshm_damage_stop(data);
+
 	if (data->xshm) {
 		xshm_xcb_detach(data->xshm);
 		data->xshm = NULL;
@@ -264,6 +481,11 @@ static void xshm_capture_start(struct xshm_data *data)
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->adj_x_org, data->adj_y_org);
 
+	xshm_damage_start(data);
+	data->frames = 0;
+	data->changed_frames = 0;
+	data->fetched_bytes = 0;
+
 	obs_enter_graphics();
 
 	xshm_resize_texture(data);
@@ -497,6 +719,19 @@ static void xshm_destroy(void *vptr)
 	bfree(data);
 }
 
+/**
+ * Get the number of frames captured, how many of them changed, and how
+ * much of the screen was fetched, since the capture started
+ */
+static void xshm_get_capture_stats(void *vptr, calldata_t *cd)
+{
+	XSHM_DATA(vptr);
+
+	calldata_set_int(cd, "frames", (long long)data->frames);
+	calldata_set_int(cd, "changed_frames", (long long)data->changed_frames);
+	calldata_set_int(cd, "fetched_bytes", (long long)data->fetched_bytes);
+}
+
 /**
  * Create the capture
  */
@@ -505,6 +740,12 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 	struct xshm_data *data = bzalloc(sizeof(struct xshm_data));
 	data->source = source;
 
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph,
+			 "void get_capture_stats(out int frames, "
+			 "out int changed_frames, out int fetched_bytes)",
+			 xshm_get_capture_stats, data);
+
 	xshm_update(data, settings);
 
 	return data;
@@ -524,28 +765,46 @@ static void xshm_video_tick(void *vptr, float seconds)
 		return;
 
 	xcb_shm_get_image_cookie_t img_c;
-	xcb_shm_get_image_reply_t *img_r;
-
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-					    data->adj_x_org, data->adj_y_org,
-					    data->adj_width, data->adj_height,
-					    ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
-					    data->xshm->seg, 0);
+	xcb_shm_get_image_reply_t *img_r = NULL;
+	bool full = xshm_take_damage(data);
+	size_t fetched = 0;
+
+	if (full) {
+		img_c = xcb_shm_get_image_unchecked(
+			data->xcb, data->xcb_screen->root, data->adj_x_org,
+			data->adj_y_org, data->adj_width, data->adj_height, ~0,
+			XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, 0);
+
+		img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
+		if (img_r)
+			fetched = (size_t)data->adj_width * data->adj_height * 4;
+	} else if (data->damage_rect_count) {
+		fetched = xshm_fetch_damage(data);
+	}
 
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
+	/* whatever couldn't be fetched is still damaged */
+	if (!fetched && (full || data->damage_rect_count))
+		data->full_damage = true;
 
-	if (!img_r)
-		goto exit;
+	data->frames++;
+	if (fetched) {
+		data->changed_frames++;
+		data->fetched_bytes += fetched;
+	}
 
 	obs_enter_graphics();
 
-	gs_texture_set_image(data->texture, (void *)data->xshm->data,
-			     data->adj_width * 4, false);
+	if (fetched && full)
+		gs_texture_set_image(data->texture, (void *)data->xshm->data,
+				     data->adj_width * 4, false);
+	else if (fetched)
+		xshm_upload_damage(data);
+
+	/* the cursor moves without damaging the screen */
 	xcb_xcursor_update(data->xcb, data->cursor);
 
 	obs_leave_graphics();
 
-exit:
 	free(img_r);
 }
 
@@ -65,6 +65,11 @@ struct spa_meta_videotransform {
 	(sizeof(struct spa_meta_cursor) + sizeof(struct spa_meta_bitmap) + \
 	 width * height * 4)
 
+#define MAX_DAMAGE_REGIONS 16
+#define DAMAGE_META_SIZE(regions) (sizeof(struct spa_meta_region) * regions)
+
+#define MAX_DMABUF_PLANES 4
+
 struct obs_pw_version {
 	int major;
 	int minor;
@@ -77,6 +82,19 @@ struct format_info {
 	DARRAY(uint64_t) modifiers;
 };
 
+struct dmabuf_texture {
+	struct pw_buffer *buffer;
+	gs_texture_t *texture;
+
+	uint32_t width, height;
+	uint32_t drm_format;
+	uint64_t modifier;
+	uint32_t planes;
+	int fds[MAX_DMABUF_PLANES];
+	uint32_t strides[MAX_DMABUF_PLANES];
+	uint32_t offsets[MAX_DMABUF_PLANES];
+};
+
 struct _obs_pipewire {
 	int pipewire_fd;
 
@@ -99,8 +117,20 @@ struct _obs_pipewire_stream {
 	obs_pipewire *obs_pw;
 	obs_source_t *source;
 
+	/* Either the SHM texture, or the texture of the DMA-BUF that was
+	 * last imported */
 	gs_texture_t *texture;
 
+	struct {
+		gs_texture_t *texture;
+		DARRAY(struct spa_region) damage;
+		bool full_damage;
+	} shm;
+
+	/* DMA-BUFs are imported once per PipeWire buffer, and kept until the
+	 * buffer is removed from the stream */
+	DARRAY(struct dmabuf_texture) dmabuf_textures;
+
 	struct pw_stream *stream;
 	struct spa_hook stream_listener;
 	struct spa_source *reneg;
@@ -592,8 +622,42 @@ static void renegotiate_format(void *data, uint64_t expirations)
 
 /* ------------------------------------------------- */
 
-static inline struct pw_buffer *find_latest_buffer(struct pw_stream *stream)
+/* Damage is relative to the buffer before, so it has to be collected from
+ * every buffer, including the ones that are skipped to get to the latest */
+static void add_buffer_damage(obs_pipewire_stream *obs_pw_stream,
+			      struct spa_buffer *buffer)
+{
+	struct spa_meta_region *region;
+	struct spa_meta *damage;
+
+	if (obs_pw_stream->shm.full_damage)
+		return;
+
+	damage = spa_buffer_find_meta(buffer, SPA_META_VideoDamage);
+	if (!damage || buffer->datas[0].type == SPA_DATA_DmaBuf) {
+		obs_pw_stream->shm.full_damage = true;
+		return;
+	}
+
+	spa_meta_for_each(region, damage)
+	{
+		if (!spa_meta_region_is_valid(region))
+			break;
+
+		if (obs_pw_stream->shm.damage.num == MAX_DAMAGE_REGIONS) {
+			obs_pw_stream->shm.full_damage = true;
+			da_resize(obs_pw_stream->shm.damage, 0);
+			break;
+		}
+
+		da_push_back(obs_pw_stream->shm.damage, &region->region);
+	}
+}
+
+static inline struct pw_buffer *
+find_latest_buffer(obs_pipewire_stream *obs_pw_stream, bool track_damage)
 {
+	struct pw_stream *stream = obs_pw_stream->stream;
 	struct pw_buffer *b;
 
 	/* Find the most recent buffer */
@@ -602,6 +666,8 @@ static inline struct pw_buffer *find_latest_buffer(struct pw_stream *stream)
 		struct pw_buffer *aux = pw_stream_dequeue_buffer(stream);
 		if (!aux)
 			break;
+		if (track_damage)
+			add_buffer_damage(obs_pw_stream, aux->buffer);
 		if (b)
 			pw_stream_queue_buffer(stream, b);
 		b = aux;
@@ -610,6 +676,197 @@ static inline struct pw_buffer *find_latest_buffer(struct pw_stream *stream)
 	return b;
 }
 
+static bool get_gl_format(enum gs_color_format format, GLenum *gl_format,
+			  GLenum *gl_type)
+{
+	switch (format) {
+	case GS_BGRA:
+	case GS_BGRX:
+		*gl_format = GL_BGRA;
+		*gl_type = GL_UNSIGNED_BYTE;
+		return true;
+	case GS_RGBA:
+		*gl_format = GL_RGBA;
+		*gl_type = GL_UNSIGNED_BYTE;
+		return true;
+	case GS_R10G10B10A2:
+		*gl_format = GL_RGBA;
+		*gl_type = GL_UNSIGNED_INT_2_10_10_10_REV;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Uploads only the damaged regions of the buffer into the texture, which
+ * holds the buffer before it.  Returns the number of bytes uploaded. */
+static size_t upload_shm_damage(obs_pipewire_stream *obs_pw_stream,
+				const uint8_t *data, uint32_t stride,
+				uint32_t pixel_size, GLenum gl_format,
+				GLenum gl_type)
+{
+	gs_texture_t *texture = obs_pw_stream->shm.texture;
+	GLuint gl_texture = *(GLuint *)gs_texture_get_obj(texture);
+	int32_t width = (int32_t)gs_texture_get_width(texture);
+	int32_t height = (int32_t)gs_texture_get_height(texture);
+	size_t uploaded = 0;
+
+	glBindTexture(GL_TEXTURE_2D, gl_texture);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)(stride / pixel_size));
+
+	for (size_t i = 0; i < obs_pw_stream->shm.damage.num; i++) {
+		struct spa_region *region = &obs_pw_stream->shm.damage.array[i];
+		int32_t x = SPA_CLAMP(region->position.x, 0, width);
+		int32_t y = SPA_CLAMP(region->position.y, 0, height);
+		int32_t right = region->position.x + (int32_t)region->size.width;
+		int32_t bottom =
+			region->position.y + (int32_t)region->size.height;
+
+		right = SPA_MIN(right, width);
+		bottom = SPA_MIN(bottom, height);
+		if (right <= x || bottom <= y)
+			continue;
+
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, right - x, bottom - y,
+				gl_format, gl_type, data);
+
+		uploaded += (size_t)(right - x) * (bottom - y) * pixel_size;
+	}
+
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return uploaded;
+}
+
+static bool update_shm_texture(obs_pipewire_stream *obs_pw_stream,
+			       struct spa_buffer *buffer,
+			       const struct obs_pw_video_format *format)
+{
+	uint32_t width = obs_pw_stream->format.info.raw.size.width;
+	uint32_t height = obs_pw_stream->format.info.raw.size.height;
+	uint32_t pixel_size = gs_get_format_bpp(format->gs_format) / 8;
+	const uint8_t *data = buffer->datas[0].data;
+	int32_t stride = buffer->datas[0].chunk->stride;
+	gs_texture_t *texture = obs_pw_stream->shm.texture;
+	GLenum gl_format, gl_type;
+	size_t uploaded;
+
+	if (stride <= 0)
+		stride = (int32_t)(width * pixel_size);
+
+	if (!texture || gs_texture_get_width(texture) != width ||
+	    gs_texture_get_height(texture) != height ||
+	    gs_texture_get_color_format(texture) != format->gs_format) {
+		if (obs_pw_stream->texture == texture)
+			obs_pw_stream->texture = NULL;
+
+		g_clear_pointer(&obs_pw_stream->shm.texture,
+				gs_texture_destroy);
+		obs_pw_stream->shm.texture = gs_texture_create(
+			width, height, format->gs_format, 1, NULL, GS_DYNAMIC);
+		if (!obs_pw_stream->shm.texture)
+			return false;
+
+		obs_pw_stream->shm.full_damage = true;
+	}
+
+	if (obs_pw_stream->shm.full_damage ||
+	    !get_gl_format(format->gs_format, &gl_format, &gl_type)) {
+		gs_texture_set_image(obs_pw_stream->shm.texture, data,
+				     (uint32_t)stride, false);
+		uploaded = (size_t)stride * height;
+	} else {
+		uploaded = upload_shm_damage(obs_pw_stream, data,
+					     (uint32_t)stride, pixel_size,
+					     gl_format, gl_type);
+	}
+
+#ifdef DEBUG_PIPEWIRE
+	blog(LOG_DEBUG, "[pipewire] Uploaded %zu bytes in %zu regions",
+	     uploaded,
+	     obs_pw_stream->shm.full_damage ? 1
+					    : obs_pw_stream->shm.damage.num);
+#else
+	UNUSED_PARAMETER(uploaded);
+#endif
+
+	obs_pw_stream->shm.full_damage = false;
+	da_resize(obs_pw_stream->shm.damage, 0);
+	return true;
+}
+
+static struct dmabuf_texture *
+find_dmabuf_texture(obs_pipewire_stream *obs_pw_stream, struct pw_buffer *b)
+{
+	for (size_t i = 0; i < obs_pw_stream->dmabuf_textures.num; i++) {
+		struct dmabuf_texture *dmabuf =
+			&obs_pw_stream->dmabuf_textures.array[i];
+		if (dmabuf->buffer == b)
+			return dmabuf;
+	}
+
+	return NULL;
+}
+
+static bool dmabuf_texture_matches(const struct dmabuf_texture *a,
+				   const struct dmabuf_texture *b)
+{
+	size_t planes_size = sizeof(uint32_t) * a->planes;
+
+	return a->width == b->width && a->height == b->height &&
+	       a->drm_format == b->drm_format && a->modifier == b->modifier &&
+	       a->planes == b->planes &&
+	       memcmp(a->fds, b->fds, sizeof(int) * a->planes) == 0 &&
+	       memcmp(a->strides, b->strides, planes_size) == 0 &&
+	       memcmp(a->offsets, b->offsets, planes_size) == 0;
+}
+
+/* Call in graphics context */
+static struct dmabuf_texture *
+import_dmabuf_texture(obs_pipewire_stream *obs_pw_stream,
+		      struct dmabuf_texture *dmabuf, uint64_t *modifiers)
+{
+	size_t idx;
+
+	dmabuf->texture = gs_texture_create_from_dmabuf(
+		dmabuf->width, dmabuf->height, dmabuf->drm_format, GS_BGRX,
+		dmabuf->planes, dmabuf->fds, dmabuf->strides, dmabuf->offsets,
+		modifiers);
+	if (!dmabuf->texture)
+		return NULL;
+
+	idx = da_push_back(obs_pw_stream->dmabuf_textures, dmabuf);
+	return &obs_pw_stream->dmabuf_textures.array[idx];
+}
+
+/* Call in graphics context */
+static void destroy_dmabuf_texture(obs_pipewire_stream *obs_pw_stream,
+				   struct dmabuf_texture *dmabuf)
+{
+	if (obs_pw_stream->texture == dmabuf->texture)
+		obs_pw_stream->texture = NULL;
+
+	gs_texture_destroy(dmabuf->texture);
+	da_erase(obs_pw_stream->dmabuf_textures,
+		 dmabuf - obs_pw_stream->dmabuf_textures.array);
+}
+
+/* Call in graphics context */
+static void clear_textures(obs_pipewire_stream *obs_pw_stream)
+{
+	while (obs_pw_stream->dmabuf_textures.num)
+		destroy_dmabuf_texture(obs_pw_stream,
+				       obs_pw_stream->dmabuf_textures.array);
+
+	g_clear_pointer(&obs_pw_stream->shm.texture, gs_texture_destroy);
+	obs_pw_stream->texture = NULL;
+}
+
 static enum video_colorspace
 video_colorspace_from_spa_color_matrix(enum spa_video_color_matrix matrix)
 {
@@ -672,7 +929,7 @@ static void process_video_async(obs_pipewire_stream *obs_pw_stream)
 	struct pw_buffer *b;
 	bool has_buffer;
 
-	b = find_latest_buffer(obs_pw_stream->stream);
+	b = find_latest_buffer(obs_pw_stream, false);
 	if (!b) {
 		blog(LOG_DEBUG, "[pipewire] Out of buffers!");
 		return;
@@ -729,7 +986,7 @@ static void process_video_sync(obs_pipewire_stream *obs_pw_stream)
 	struct pw_buffer *b;
 	bool has_buffer = true;
 
-	b = find_latest_buffer(obs_pw_stream->stream);
+	b = find_latest_buffer(obs_pw_stream, true);
 	if (!b) {
 		blog(LOG_DEBUG, "[pipewire] Out of buffers!");
 		return;
@@ -755,10 +1012,15 @@ static void process_video_sync(obs_pipewire_stream *obs_pw_stream)
 
 	if (buffer->datas[0].type == SPA_DATA_DmaBuf) {
 		uint32_t planes = buffer->n_datas;
-		uint32_t *offsets = alloca(sizeof(uint32_t) * planes);
-		uint32_t *strides = alloca(sizeof(uint32_t) * planes);
-		uint64_t *modifiers = alloca(sizeof(uint64_t) * planes);
-		int *fds = alloca(sizeof(int) * planes);
+		uint64_t modifiers[MAX_DMABUF_PLANES];
+		struct dmabuf_texture *cached;
+		struct dmabuf_texture dmabuf = {
+			.buffer = b,
+			.width = obs_pw_stream->format.info.raw.size.width,
+			.height = obs_pw_stream->format.info.raw.size.height,
+			.modifier = obs_pw_stream->format.info.raw.modifier,
+			.planes = planes,
+		};
 		bool use_modifiers;
 		bool corrupt = false;
 
@@ -781,10 +1043,21 @@ static void process_video_sync(obs_pipewire_stream *obs_pw_stream)
 			goto read_metadata;
 		}
 
+		if (planes > MAX_DMABUF_PLANES) {
+			blog(LOG_ERROR,
+			     "[pipewire] unsupported DMA buffer plane count: %u",
+			     planes);
+			goto read_metadata;
+		}
+
+		dmabuf.drm_format = obs_pw_video_format.drm_format;
+
 		for (uint32_t plane = 0; plane < planes; plane++) {
-			fds[plane] = buffer->datas[plane].fd;
-			offsets[plane] = buffer->datas[plane].chunk->offset;
-			strides[plane] = buffer->datas[plane].chunk->stride;
+			dmabuf.fds[plane] = buffer->datas[plane].fd;
+			dmabuf.offsets[plane] =
+				buffer->datas[plane].chunk->offset;
+			dmabuf.strides[plane] =
+				buffer->datas[plane].chunk->stride;
 			modifiers[plane] =
 				obs_pw_stream->format.info.raw.modifier;
 			corrupt |= (buffer->datas[plane].chunk->flags &
@@ -797,17 +1070,21 @@ static void process_video_sync(obs_pipewire_stream *obs_pw_stream)
 			goto read_metadata;
 		}
 
-		g_clear_pointer(&obs_pw_stream->texture, gs_texture_destroy);
+		cached = find_dmabuf_texture(obs_pw_stream, b);
+		if (cached && !dmabuf_texture_matches(cached, &dmabuf)) {
+			destroy_dmabuf_texture(obs_pw_stream, cached);
+			cached = NULL;
+		}
 
 		use_modifiers = obs_pw_stream->format.info.raw.modifier !=
 				DRM_FORMAT_MOD_INVALID;
-		obs_pw_stream->texture = gs_texture_create_from_dmabuf(
-			obs_pw_stream->format.info.raw.size.width,
-			obs_pw_stream->format.info.raw.size.height,
-			obs_pw_video_format.drm_format, GS_BGRX, planes, fds,
-			strides, offsets, use_modifiers ? modifiers : NULL);
+		if (!cached)
+			cached = import_dmabuf_texture(
+				obs_pw_stream, &dmabuf,
+				use_modifiers ? modifiers : NULL);
 
-		if (obs_pw_stream->texture == NULL) {
+		if (cached == NULL) {
+			obs_pw_stream->texture = NULL;
 			remove_modifier_from_format(
 				obs_pw_stream,
 				obs_pw_stream->format.info.raw.format,
@@ -817,6 +1094,8 @@ static void process_video_sync(obs_pipewire_stream *obs_pw_stream)
 				obs_pw_stream->reneg);
 			goto read_metadata;
 		}
+
+		obs_pw_stream->texture = cached->texture;
 	} else {
 		blog(LOG_DEBUG, "[pipewire] Buffer has memory texture");
 
@@ -843,12 +1122,11 @@ static void process_video_sync(obs_pipewire_stream *obs_pw_stream)
 			goto read_metadata;
 		}
 
-		g_clear_pointer(&obs_pw_stream->texture, gs_texture_destroy);
-		obs_pw_stream->texture = gs_texture_create(
-			obs_pw_stream->format.info.raw.size.width,
-			obs_pw_stream->format.info.raw.size.height,
-			obs_pw_video_format.gs_format, 1,
-			(const uint8_t **)&buffer->datas[0].data, GS_DYNAMIC);
+		if (!update_shm_texture(obs_pw_stream, buffer,
+					&obs_pw_video_format))
+			goto read_metadata;
+
+		obs_pw_stream->texture = obs_pw_stream->shm.texture;
 	}
 
 	if (obs_pw_video_format.swap_red_blue)
@@ -956,7 +1234,7 @@ static void on_param_changed_cb(void *user_data, uint32_t id,
 	obs_pipewire_stream *obs_pw_stream = user_data;
 	obs_pipewire *obs_pw = obs_pw_stream->obs_pw;
 	struct spa_pod_builder pod_builder;
-	const struct spa_pod *params[5];
+	const struct spa_pod *params[6];
 	const char *format_name;
 	uint32_t n_params = 0;
 	uint32_t buffer_types;
@@ -1028,6 +1306,15 @@ static void on_param_changed_cb(void *user_data, uint32_t id,
 					 CURSOR_META_SIZE(1, 1),
 					 CURSOR_META_SIZE(1024, 1024)));
 
+	/* Video damage */
+	params[n_params++] = spa_pod_builder_add_object(
+		&pod_builder, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+		SPA_PARAM_META_type, SPA_POD_Id(SPA_META_VideoDamage),
+		SPA_PARAM_META_size,
+		SPA_POD_CHOICE_RANGE_Int(DAMAGE_META_SIZE(MAX_DAMAGE_REGIONS),
+					 DAMAGE_META_SIZE(1),
+					 DAMAGE_META_SIZE(MAX_DAMAGE_REGIONS)));
+
 	/* Buffer options */
 	params[n_params++] = spa_pod_builder_add_object(
 		&pod_builder, SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
@@ -1067,10 +1354,25 @@ static void on_state_changed_cb(void *user_data, enum pw_stream_state old,
 	     error ? error : "none");
 }
 
+static void on_remove_buffer_cb(void *user_data, struct pw_buffer *buffer)
+{
+	obs_pipewire_stream *obs_pw_stream = user_data;
+	struct dmabuf_texture *dmabuf;
+
+	dmabuf = find_dmabuf_texture(obs_pw_stream, buffer);
+	if (!dmabuf)
+		return;
+
+	obs_enter_graphics();
+	destroy_dmabuf_texture(obs_pw_stream, dmabuf);
+	obs_leave_graphics();
+}
+
 static const struct pw_stream_events stream_events = {
 	PW_VERSION_STREAM_EVENTS,
 	.state_changed = on_state_changed_cb,
 	.param_changed = on_param_changed_cb,
+	.remove_buffer = on_remove_buffer_cb,
 	.process = on_process_cb,
 };
 
@@ -1428,7 +1730,7 @@ void obs_pipewire_stream_destroy(obs_pipewire_stream *obs_pw_stream)
 
 	obs_enter_graphics();
 	g_clear_pointer(&obs_pw_stream->cursor.texture, gs_texture_destroy);
-	g_clear_pointer(&obs_pw_stream->texture, gs_texture_destroy);
+	clear_textures(obs_pw_stream);
 	obs_leave_graphics();
 
 	pw_thread_loop_lock(obs_pw_stream->obs_pw->thread_loop);
@@ -1438,6 +1740,8 @@ void obs_pipewire_stream_destroy(obs_pipewire_stream *obs_pw_stream)
 	pw_thread_loop_unlock(obs_pw_stream->obs_pw->thread_loop);
 
 	clear_format_info(obs_pw_stream);
+	da_free(obs_pw_stream->dmabuf_textures);
+	da_free(obs_pw_stream->shm.damage);
 	bfree(obs_pw_stream);
 }
 
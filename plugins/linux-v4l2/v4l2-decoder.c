@@ -15,7 +15,11 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <inttypes.h>
 #include <obs-module.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/darray.h>
 #include <linux/videodev2.h>
 
 #include "v4l2-decoder.h"
@@ -23,7 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define blog(level, msg, ...) \
 	blog(level, "v4l2-input: decoder: " msg, ##__VA_ARGS__)
 
-int v4l2_init_decoder(struct v4l2_decoder *decoder, int pixfmt)
+int v4l2_init_decoder(struct v4l2_decoder *decoder, int pixfmt, int threads)
 {
 	if (pixfmt == V4L2_PIX_FMT_MJPEG) {
 		decoder->codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
@@ -49,13 +53,12 @@ int v4l2_init_decoder(struct v4l2_decoder *decoder, int pixfmt)
 		return -1;
 	}
 
-	decoder->frame = av_frame_alloc();
-	if (!decoder->frame) {
-		return -1;
-	}
-
 	decoder->context->flags2 |= AV_CODEC_FLAG2_FAST;
 
+	/* Slice threads only, frame threads would hold frames back */
+	decoder->context->thread_count = threads;
+	decoder->context->thread_type = FF_THREAD_SLICE;
+
 	if (avcodec_open2(decoder->context, decoder->codec, NULL) < 0) {
 		blog(LOG_ERROR, "failed to open codec");
 		return -1;
@@ -69,10 +72,6 @@ int v4l2_init_decoder(struct v4l2_decoder *decoder, int pixfmt)
 void v4l2_destroy_decoder(struct v4l2_decoder *decoder)
 {
 	blog(LOG_DEBUG, "destroying avcodec");
-	if (decoder->frame) {
-		av_frame_free(&decoder->frame);
-	}
-
 	if (decoder->packet) {
 		av_packet_free(&decoder->packet);
 	}
@@ -85,8 +84,8 @@ void v4l2_destroy_decoder(struct v4l2_decoder *decoder)
 	}
 }
 
-int v4l2_decode_frame(struct obs_source_frame *out, uint8_t *data,
-		      size_t length, struct v4l2_decoder *decoder)
+int v4l2_decode_packet(struct v4l2_decoder *decoder, uint8_t *data,
+		       size_t length, AVFrame *frame)
 {
 	decoder->packet->data = data;
 	decoder->packet->size = length;
@@ -95,17 +94,22 @@ int v4l2_decode_frame(struct obs_source_frame *out, uint8_t *data,
 		return -1;
 	}
 
-	if (avcodec_receive_frame(decoder->context, decoder->frame) < 0) {
+	if (avcodec_receive_frame(decoder->context, frame) < 0) {
 		blog(LOG_ERROR, "failed to receive frame from codec");
 		return -1;
 	}
 
+	return 0;
+}
+
+void v4l2_set_decoded_frame(struct obs_source_frame *out, const AVFrame *frame)
+{
 	for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i) {
-		out->data[i] = decoder->frame->data[i];
-		out->linesize[i] = decoder->frame->linesize[i];
+		out->data[i] = frame->data[i];
+		out->linesize[i] = frame->linesize[i];
 	}
 
-	switch (decoder->context->pix_fmt) {
+	switch (frame->format) {
 	case AV_PIX_FMT_GRAY8:
 		out->format = VIDEO_FORMAT_Y800;
 		break;
@@ -124,6 +128,347 @@ int v4l2_decode_frame(struct obs_source_frame *out, uint8_t *data,
 	default:
 		break;
 	}
+}
 
-	return 0;
+/* ------------------------------------------------------------------------- */
+/* decode stage */
+
+#define MAX_DECODE_THREADS 4
+
+/* Frames queued or being decoded per thread before new ones are dropped */
+#define QUEUED_PER_THREAD 2
+
+struct decoded_frame {
+	struct v4l2_decode_stage *stage;
+	AVFrame *frame;
+};
+
+struct decode_job {
+	struct obs_source_frame frame;
+	DARRAY(uint8_t) packet;
+	struct decoded_frame *decoded;
+	bool busy;
+	bool done;
+};
+
+struct decode_thread {
+	struct v4l2_decode_stage *stage;
+	struct v4l2_decoder decoder;
+	pthread_t thread;
+	bool started;
+};
+
+struct v4l2_decode_stage {
+	obs_source_t *source;
+	volatile long refs;
+
+	/* Protects everything below, apart from the decoders */
+	pthread_mutex_t mutex;
+
+	/* Held while outputting frames, to keep them in order */
+	pthread_mutex_t output_mutex;
+
+	os_sem_t *jobs_sem;
+	bool stopping;
+
+	DARRAY(struct decode_job *) queue;
+	DARRAY(struct decode_job *) free_jobs;
+	DARRAY(struct decoded_frame *) free_frames;
+	size_t max_queued;
+	uint64_t dropped;
+
+	size_t num_threads;
+	struct decode_thread threads[MAX_DECODE_THREADS];
+};
+
+static void decode_stage_free(struct v4l2_decode_stage *stage)
+{
+	for (size_t i = 0; i < stage->free_jobs.num; i++) {
+		struct decode_job *job = stage->free_jobs.array[i];
+		da_free(job->packet);
+		bfree(job);
+	}
+
+	for (size_t i = 0; i < stage->free_frames.num; i++) {
+		struct decoded_frame *df = stage->free_frames.array[i];
+		av_frame_free(&df->frame);
+		bfree(df);
+	}
+
+	da_free(stage->queue);
+	da_free(stage->free_jobs);
+	da_free(stage->free_frames);
+	os_sem_destroy(stage->jobs_sem);
+	pthread_mutex_destroy(&stage->output_mutex);
+	pthread_mutex_destroy(&stage->mutex);
+	bfree(stage);
+}
+
+static inline void decode_stage_release(struct v4l2_decode_stage *stage)
+{
+	if (os_atomic_dec_long(&stage->refs) == 0)
+		decode_stage_free(stage);
+}
+
+/* Call with mutex held */
+static inline void recycle_frame(struct v4l2_decode_stage *stage,
+				 struct decoded_frame *df)
+{
+	av_frame_unref(df->frame);
+	da_push_back(stage->free_frames, &df);
+}
+
+/* Called by libobs once it is done with a frame */
+static void release_decoded_frame(void *param)
+{
+	struct decoded_frame *df = param;
+	struct v4l2_decode_stage *stage = df->stage;
+
+	pthread_mutex_lock(&stage->mutex);
+	recycle_frame(stage, df);
+	pthread_mutex_unlock(&stage->mutex);
+
+	decode_stage_release(stage);
+}
+
+/* Call with mutex held */
+static struct decoded_frame *take_frame(struct v4l2_decode_stage *stage)
+{
+	struct decoded_frame *df;
+
+	if (stage->free_frames.num) {
+		df = da_end(stage->free_frames);
+		da_pop_back(stage->free_frames);
+		return df;
+	}
+
+	df = bzalloc(sizeof(*df));
+	df->stage = stage;
+	df->frame = av_frame_alloc();
+	if (!df->frame) {
+		bfree(df);
+		return NULL;
+	}
+	return df;
+}
+
+/* Outputs the frames at the front of the queue that are done.  Frames are
+ * output without the stage mutex held, as libobs may hand them straight
+ * back. */
+static void output_done_jobs(struct v4l2_decode_stage *stage)
+{
+	DARRAY(struct decode_job *) done;
+	da_init(done);
+
+	pthread_mutex_lock(&stage->output_mutex);
+
+	pthread_mutex_lock(&stage->mutex);
+	while (stage->queue.num && stage->queue.array[0]->done) {
+		da_push_back(done, &stage->queue.array[0]);
+		da_erase(stage->queue, 0);
+	}
+	pthread_mutex_unlock(&stage->mutex);
+
+	for (size_t i = 0; i < done.num; i++) {
+		struct decode_job *job = done.array[i];
+
+		if (job->decoded) {
+			os_atomic_inc_long(&stage->refs);
+			obs_source_output_video_borrowed(stage->source,
+							 &job->frame,
+							 release_decoded_frame,
+							 job->decoded);
+			job->decoded = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&stage->output_mutex);
+
+	pthread_mutex_lock(&stage->mutex);
+	da_push_back_array(stage->free_jobs, done.array, done.num);
+	pthread_mutex_unlock(&stage->mutex);
+
+	da_free(done);
+}
+
+static void *decode_thread_loop(void *param)
+{
+	struct decode_thread *thread = param;
+	struct v4l2_decode_stage *stage = thread->stage;
+
+	os_set_thread_name("v4l2: decode");
+
+	while (os_sem_wait(stage->jobs_sem) == 0) {
+		struct decode_job *job = NULL;
+		struct decoded_frame *df;
+
+		pthread_mutex_lock(&stage->mutex);
+		if (stage->stopping) {
+			pthread_mutex_unlock(&stage->mutex);
+			break;
+		}
+
+		for (size_t i = 0; i < stage->queue.num; i++) {
+			if (!stage->queue.array[i]->busy) {
+				job = stage->queue.array[i];
+				job->busy = true;
+				break;
+			}
+		}
+
+		df = job ? take_frame(stage) : NULL;
+		pthread_mutex_unlock(&stage->mutex);
+
+		if (!job)
+			continue;
+
+		if (df && v4l2_decode_packet(&thread->decoder,
+					     job->packet.array,
+					     job->packet.num, df->frame) == 0) {
+			v4l2_set_decoded_frame(&job->frame, df->frame);
+		} else if (df) {
+			blog(LOG_ERROR, "failed to unpack jpeg or h264");
+			pthread_mutex_lock(&stage->mutex);
+			recycle_frame(stage, df);
+			pthread_mutex_unlock(&stage->mutex);
+			df = NULL;
+		}
+
+		pthread_mutex_lock(&stage->mutex);
+		job->decoded = df;
+		job->done = true;
+		pthread_mutex_unlock(&stage->mutex);
+
+		output_done_jobs(stage);
+	}
+
+	return NULL;
+}
+
+struct v4l2_decode_stage *v4l2_decode_stage_create(obs_source_t *source,
+						   int pixfmt)
+{
+	struct v4l2_decode_stage *stage = bzalloc(sizeof(*stage));
+	int cores = os_get_logical_cores();
+	int slice_threads = 1;
+
+	stage->source = source;
+	stage->refs = 1;
+	pthread_mutex_init_value(&stage->mutex);
+	pthread_mutex_init_value(&stage->output_mutex);
+
+	if (pixfmt == V4L2_PIX_FMT_H264) {
+		stage->num_threads = 1;
+		slice_threads = cores < MAX_DECODE_THREADS ? cores
+							   : MAX_DECODE_THREADS;
+	} else {
+		stage->num_threads = cores / 2;
+		if (stage->num_threads > MAX_DECODE_THREADS)
+			stage->num_threads = MAX_DECODE_THREADS;
+		if (stage->num_threads < 1)
+			stage->num_threads = 1;
+	}
+	stage->max_queued = stage->num_threads * QUEUED_PER_THREAD;
+
+	if (pthread_mutex_init(&stage->mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&stage->output_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&stage->jobs_sem, 0) != 0)
+		goto fail;
+
+	for (size_t i = 0; i < stage->num_threads; i++) {
+		struct decode_thread *thread = &stage->threads[i];
+
+		thread->stage = stage;
+		if (v4l2_init_decoder(&thread->decoder, pixfmt,
+				      slice_threads) < 0)
+			goto fail;
+		if (pthread_create(&thread->thread, NULL, decode_thread_loop,
+				   thread) != 0)
+			goto fail;
+		thread->started = true;
+	}
+
+	blog(LOG_INFO, "decoding on %zu thread(s)", stage->num_threads);
+	return stage;
+
+fail:
+	v4l2_decode_stage_destroy(stage);
+	return NULL;
+}
+
+void v4l2_decode_stage_destroy(struct v4l2_decode_stage *stage)
+{
+	if (!stage)
+		return;
+
+	pthread_mutex_lock(&stage->mutex);
+	stage->stopping = true;
+	pthread_mutex_unlock(&stage->mutex);
+
+	for (size_t i = 0; i < stage->num_threads; i++)
+		os_sem_post(stage->jobs_sem);
+
+	for (size_t i = 0; i < stage->num_threads; i++) {
+		struct decode_thread *thread = &stage->threads[i];
+
+		if (thread->started)
+			pthread_join(thread->thread, NULL);
+		v4l2_destroy_decoder(&thread->decoder);
+	}
+
+	for (size_t i = 0; i < stage->queue.num; i++) {
+		struct decode_job *job = stage->queue.array[i];
+
+		if (job->decoded)
+			recycle_frame(stage, job->decoded);
+		da_push_back(stage->free_jobs, &job);
+	}
+	da_resize(stage->queue, 0);
+
+	if (stage->dropped)
+		blog(LOG_INFO, "dropped %" PRIu64 " frames behind decoding",
+		     stage->dropped);
+
+	decode_stage_release(stage);
+}
+
+bool v4l2_decode_stage_push(struct v4l2_decode_stage *stage,
+			    const struct obs_source_frame *frame,
+			    const uint8_t *data, size_t length)
+{
+	struct decode_job *job;
+
+	pthread_mutex_lock(&stage->mutex);
+	if (stage->queue.num >= stage->max_queued) {
+		stage->dropped++;
+		pthread_mutex_unlock(&stage->mutex);
+		return false;
+	}
+
+	if (stage->free_jobs.num) {
+		job = da_end(stage->free_jobs);
+		da_pop_back(stage->free_jobs);
+	} else {
+		job = bzalloc(sizeof(*job));
+	}
+	pthread_mutex_unlock(&stage->mutex);
+
+	job->frame = *frame;
+	job->decoded = NULL;
+	job->busy = false;
+	job->done = false;
+
+	da_resize(job->packet, length + AV_INPUT_BUFFER_PADDING_SIZE);
+	memcpy(job->packet.array, data, length);
+	memset(job->packet.array + length, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+	job->packet.num = length;
+
+	pthread_mutex_lock(&stage->mutex);
+	da_push_back(stage->queue, &job);
+	pthread_mutex_unlock(&stage->mutex);
+
+	os_sem_post(stage->jobs_sem);
+	return true;
 }
@@ -32,7 +32,6 @@ struct v4l2_decoder {
 	const AVCodec *codec;
 	AVCodecContext *context;
 	AVPacket *packet;
-	AVFrame *frame;
 };
 
 /**
@@ -41,9 +40,10 @@ struct v4l2_decoder {
  *
  * @param decoder the decoder structure
  * @param pixfmt which codec is used
+ * @param threads slice threads the codec may use within a frame
  * @return non-zero on failure
  */
-int v4l2_init_decoder(struct v4l2_decoder *decoder, int pixfmt);
+int v4l2_init_decoder(struct v4l2_decoder *decoder, int pixfmt, int threads);
 
 /**
  * Free any data associated with the decoder.
@@ -53,16 +53,71 @@ int v4l2_init_decoder(struct v4l2_decoder *decoder, int pixfmt);
 void v4l2_destroy_decoder(struct v4l2_decoder *decoder);
 
 /**
- * Decode a jpeg or h264 frame into an obs frame
+ * Decode a jpeg or h264 frame into an avcodec frame
  *
- * @param out the obs frame to decode into
- * @param data the codec data
- * @param length length of the data
  * @param decoder the decoder as initialized by v4l2_init_decoder
+ * @param data the codec data, followed by AV_INPUT_BUFFER_PADDING_SIZE
+ *             bytes of padding
+ * @param length length of the data
+ * @param frame the frame to decode into, which must be unreferenced
  * @return non-zero on failure
  */
-int v4l2_decode_frame(struct obs_source_frame *out, uint8_t *data,
-		      size_t length, struct v4l2_decoder *decoder);
+int v4l2_decode_packet(struct v4l2_decoder *decoder, uint8_t *data,
+		       size_t length, AVFrame *frame);
+
+/**
+ * Point an obs frame at the planes of a decoded frame
+ *
+ * @param out the obs frame
+ * @param frame the decoded frame
+ */
+void v4l2_set_decoded_frame(struct obs_source_frame *out,
+			    const AVFrame *frame);
+
+/**
+ * Decode stage, which decodes captured frames on threads of its own and
+ * outputs them to the source in the order they were captured.
+ *
+ * MJPEG frames are decoded by several threads at once, each with its own
+ * decoder.  H264 frames depend on each other, so they are decoded by one
+ * thread, with slice threads within the codec.
+ *
+ * Decoded frames are output to the source without being copied, and come
+ * back to the stage once the source is done with them.
+ */
+struct v4l2_decode_stage;
+
+/**
+ * Create a decode stage and start its threads.
+ *
+ * @param source the source to output decoded frames to
+ * @param pixfmt which codec is used
+ * @return the decode stage, NULL on failure
+ */
+struct v4l2_decode_stage *v4l2_decode_stage_create(obs_source_t *source,
+						   int pixfmt);
+
+/**
+ * Stop the threads of a decode stage and drop any frames not yet decoded.
+ * Frames still held by the source stay valid until it lets go of them.
+ *
+ * @param stage the decode stage
+ */
+void v4l2_decode_stage_destroy(struct v4l2_decode_stage *stage);
+
+/**
+ * Queue a captured frame for decoding.
+ * The data is copied, so the capture buffer can be requeued right away.
+ *
+ * @param stage the decode stage
+ * @param frame the prepared obs frame, with the timestamp set
+ * @param data the codec data
+ * @param length length of the data
+ * @return false if the frame was dropped because decoding fell behind
+ */
+bool v4l2_decode_stage_push(struct v4l2_decode_stage *stage,
+			    const struct obs_source_frame *frame,
+			    const uint8_t *data, size_t length);
 
 #ifdef __cplusplus
 }
@@ -83,7 +83,7 @@ struct v4l2_data {
 	obs_source_t *source;
 	pthread_t thread;
 	os_event_t *event;
-	struct v4l2_decoder decoder;
+	struct v4l2_decode_stage *decode_stage;
 
 	bool framerate_unchanged;
 	bool resolution_unchanged;
@@ -271,19 +271,14 @@ static void *v4l2_thread(void *vptr)
 
 		start = (uint8_t *)data->buffers.info[buf.index].start;
 
-		if (data->pixfmt == V4L2_PIX_FMT_MJPEG ||
-		    data->pixfmt == V4L2_PIX_FMT_H264) {
-			if (v4l2_decode_frame(&out, start, buf.bytesused,
-					      &data->decoder) < 0) {
-				blog(LOG_ERROR,
-				     "failed to unpack jpeg or h264");
-				break;
-			}
+		if (data->decode_stage) {
+			v4l2_decode_stage_push(data->decode_stage, &out, start,
+					       buf.bytesused);
 		} else {
 			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 				out.data[i] = start + plane_offsets[i];
+			obs_source_output_video(data->source, &out);
 		}
-		obs_source_output_video(data->source, &out);
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_ERROR, "%s: failed to enqueue buffer",
@@ -924,10 +919,8 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
-	if (data->pixfmt == V4L2_PIX_FMT_MJPEG ||
-	    data->pixfmt == V4L2_PIX_FMT_H264) {
-		v4l2_destroy_decoder(&data->decoder);
-	}
+	v4l2_decode_stage_destroy(data->decode_stage);
+	data->decode_stage = NULL;
 	v4l2_destroy_mmap(&data->buffers);
 
 	if (data->dev != -1) {
@@ -1050,7 +1043,9 @@ static void v4l2_init(struct v4l2_data *data)
 
 	if (data->pixfmt == V4L2_PIX_FMT_MJPEG ||
 	    data->pixfmt == V4L2_PIX_FMT_H264) {
-		if (v4l2_init_decoder(&data->decoder, data->pixfmt) < 0) {
+		data->decode_stage =
+			v4l2_decode_stage_create(data->source, data->pixfmt);
+		if (!data->decode_stage) {
 			blog(LOG_ERROR, "Failed to initialize decoder");
 			goto fail;
 		}
@@ -348,6 +348,8 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 		};
 
 		s->media = media_playback_create(&info);
+		media_playback_set_visible(s->media,
+					   obs_source_showing(s->source));
 	}
 }
 
@@ -594,6 +596,18 @@ static void get_nb_frames(void *data, calldata_t *cd)
 	calldata_set_int(cd, "num_frames", frames);
 }
 
+static void get_decode_stats(void *data, calldata_t *cd)
+{
+	struct ffmpeg_source *s = data;
+	struct mp_decode_stats stats;
+
+	media_playback_get_decode_stats(s->media, &stats);
+	calldata_set_int(cd, "frames", (long long)stats.frames);
+	calldata_set_int(cd, "avg_latency", (long long)stats.avg_latency_ns);
+	calldata_set_int(cd, "max_latency", (long long)stats.max_latency_ns);
+	calldata_set_int(cd, "avg_wait", (long long)stats.avg_wait_ns);
+}
+
 static bool ffmpeg_source_play_hotkey(void *data, obs_hotkey_pair_id id,
 				      obs_hotkey_t *hotkey, bool pressed)
 {
@@ -688,6 +702,11 @@ static void *ffmpeg_source_create(obs_data_t *settings, obs_source_t *source)
 			 get_duration, s);
 	proc_handler_add(ph, "void get_nb_frames(out int num_frames)",
 			 get_nb_frames, s);
+	proc_handler_add(ph,
+			 "void get_decode_stats(out int frames, "
+			 "out int avg_latency, out int max_latency, "
+			 "out int avg_wait)",
+			 get_decode_stats, s);
 
 	ffmpeg_source_update(s, settings);
 	return s;
@@ -734,6 +753,20 @@ static void ffmpeg_source_deactivate(void *data)
 	}
 }
 
+static void ffmpeg_source_show(void *data)
+{
+	struct ffmpeg_source *s = data;
+
+	media_playback_set_visible(s->media, true);
+}
+
+static void ffmpeg_source_hide(void *data)
+{
+	struct ffmpeg_source *s = data;
+
+	media_playback_set_visible(s->media, false);
+}
+
 static void ffmpeg_source_play_pause(void *data, bool pause)
 {
 	struct ffmpeg_source *s = data;
@@ -856,6 +889,8 @@ struct obs_source_info ffmpeg_source = {
 	.get_properties = ffmpeg_source_getproperties,
 	.activate = ffmpeg_source_activate,
 	.deactivate = ffmpeg_source_deactivate,
+	.show = ffmpeg_source_show,
+	.hide = ffmpeg_source_hide,
 	.video_tick = ffmpeg_source_tick,
 	.missing_files = ffmpeg_source_missingfiles,
 	.update = ffmpeg_source_update,
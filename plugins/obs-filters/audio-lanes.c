@@ -0,0 +1,525 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-lanes.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <util/sse-intrin.h>
+
+#define EQ_EPSILON (1.0f / 4294967295.0f)
+#define EQ_STATE_FIELDS (sizeof(struct eq_channel_state) / sizeof(float))
+
+#define LANES 4
+
+/* ------------------------------------------------------------------------- */
+/* Scalar reference implementations                                          */
+
+static inline float eq_sample(const struct eq_coeffs *eq,
+			      struct eq_channel_state *c, float sample)
+{
+	float l, m, h;
+
+	c->lf_delay0 += eq->lf * (sample - c->lf_delay0) + EQ_EPSILON;
+	c->lf_delay1 += eq->lf * (c->lf_delay0 - c->lf_delay1);
+	c->lf_delay2 += eq->lf * (c->lf_delay1 - c->lf_delay2);
+	c->lf_delay3 += eq->lf * (c->lf_delay2 - c->lf_delay3);
+
+	l = c->lf_delay3;
+
+	c->hf_delay0 += eq->hf * (sample - c->hf_delay0) + EQ_EPSILON;
+	c->hf_delay1 += eq->hf * (c->hf_delay0 - c->hf_delay1);
+	c->hf_delay2 += eq->hf * (c->hf_delay1 - c->hf_delay2);
+	c->hf_delay3 += eq->hf * (c->hf_delay2 - c->hf_delay3);
+
+	h = c->sample_delay3 - c->hf_delay3;
+	m = c->sample_delay3 - (h + l);
+
+	l *= eq->low_gain;
+	m *= eq->mid_gain;
+	h *= eq->high_gain;
+
+	c->sample_delay3 = c->sample_delay2;
+	c->sample_delay2 = c->sample_delay1;
+	c->sample_delay1 = sample;
+
+	return l + m + h;
+}
+
+void eq_process_scalar(const struct eq_coeffs *eq,
+		       struct eq_channel_state *state, float **data,
+		       size_t channels, uint32_t frames)
+{
+	for (size_t c = 0; c < channels; c++) {
+		float *adata = data[c];
+		struct eq_channel_state *channel = &state[c];
+
+		if (!adata)
+			continue;
+
+		for (uint32_t i = 0; i < frames; i++)
+			adata[i] = eq_sample(eq, channel, adata[i]);
+	}
+}
+
+void peak_envelope_scalar(float **data, size_t channels, uint32_t frames,
+			  float attack_gain, float release_gain,
+			  float *envelope, float *env_buf)
+{
+	if (!frames)
+		return;
+
+	memset(env_buf, 0, frames * sizeof(env_buf[0]));
+	for (size_t chan = 0; chan < channels; ++chan) {
+		if (!data[chan])
+			continue;
+
+		float env = *envelope;
+		for (uint32_t i = 0; i < frames; ++i) {
+			const float env_in = fabsf(data[chan][i]);
+			if (env < env_in) {
+				env = env_in + attack_gain * (env - env_in);
+			} else {
+				env = env_in + release_gain * (env - env_in);
+			}
+			env_buf[i] = fmaxf(env_buf[i], env);
+		}
+	}
+	*envelope = env_buf[frames - 1];
+}
+
+void level_detect_scalar(float **data, size_t channels, uint32_t frames,
+			 bool rms, float rmscoef, float *runave,
+			 float **env_buf)
+{
+	if (!frames)
+		return;
+
+	for (size_t chan = 0; chan < channels; ++chan) {
+		const float *samples = data[chan];
+		float *env = env_buf[chan];
+		float ave = runave[chan];
+
+		if (!samples) {
+			memset(env, 0, frames * sizeof(env[0]));
+			continue;
+		}
+
+		if (rms) {
+			for (uint32_t i = 0; i < frames; ++i) {
+				ave = rmscoef * ave +
+				      (1 - rmscoef) * powf(samples[i], 2.0f);
+				env[i] = sqrtf(fmaxf(ave, 0));
+			}
+		} else {
+			for (uint32_t i = 0; i < frames; ++i) {
+				ave = powf(samples[i], 2.0f);
+				env[i] = fabsf(samples[i]);
+			}
+		}
+
+		runave[chan] = ave;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Time-parallel helpers, vectorized along frames                            */
+
+void peak_level(float **data, size_t channels, uint32_t frames, float *level)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	uint32_t i = 0;
+
+	if (!channels) {
+		memset(level, 0, frames * sizeof(level[0]));
+		return;
+	}
+
+	for (; i + LANES <= frames; i += LANES) {
+		__m128 max = _mm_andnot_ps(sign, _mm_loadu_ps(data[0] + i));
+		for (size_t c = 1; c < channels; c++) {
+			__m128 v = _mm_andnot_ps(sign, _mm_loadu_ps(data[c] + i));
+			max = _mm_max_ps(max, v);
+		}
+		_mm_storeu_ps(level + i, max);
+	}
+
+	for (; i < frames; i++) {
+		float max = fabsf(data[0][i]);
+		for (size_t c = 1; c < channels; c++)
+			max = fmaxf(max, fabsf(data[c][i]));
+		level[i] = max;
+	}
+}
+
+void apply_gain(float **data, size_t channels, uint32_t frames,
+		const float *gain)
+{
+	for (size_t c = 0; c < channels; c++) {
+		float *adata = data[c];
+		uint32_t i = 0;
+
+		if (!adata)
+			continue;
+
+		for (; i + LANES <= frames; i += LANES) {
+			__m128 v = _mm_loadu_ps(adata + i);
+			__m128 g = _mm_loadu_ps(gain + i);
+			_mm_storeu_ps(adata + i, _mm_mul_ps(v, g));
+		}
+		for (; i < frames; i++)
+			adata[i] *= gain[i];
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Channel-as-lane implementations                                           */
+
+/* Up to four channels processed together, NULL for unused lanes */
+struct lane_group {
+	float *ptr[LANES];
+	size_t count;
+};
+
+static inline void init_group(struct lane_group *g, float **data,
+			      size_t channels, size_t base)
+{
+	g->count = 0;
+	for (size_t l = 0; l < LANES; l++) {
+		size_t c = base + l;
+		g->ptr[l] = c < channels ? data[c] : NULL;
+		if (g->ptr[l])
+			g->count++;
+	}
+}
+
+static inline __m128 lane_mask(const struct lane_group *g)
+{
+	return _mm_castsi128_ps(_mm_set_epi32(
+		g->ptr[3] ? -1 : 0, g->ptr[2] ? -1 : 0, g->ptr[1] ? -1 : 0,
+		g->ptr[0] ? -1 : 0));
+}
+
+/* Loads n <= 4 frames starting at frame i, so that v[t] holds frame i + t
+ * of every lane. Frames past n and unused lanes read as zero. */
+static inline void load_block(const struct lane_group *g, uint32_t i,
+			      uint32_t n, __m128 v[LANES])
+{
+	__m128 r[LANES];
+
+	for (size_t l = 0; l < LANES; l++) {
+		const float *p = g->ptr[l];
+
+		if (p && n == LANES) {
+			r[l] = _mm_loadu_ps(p + i);
+		} else {
+			float tmp[LANES] = {0};
+			if (p)
+				memcpy(tmp, p + i, n * sizeof(float));
+			r[l] = _mm_loadu_ps(tmp);
+		}
+	}
+
+	_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+
+	for (size_t t = 0; t < LANES; t++)
+		v[t] = r[t];
+}
+
+/* Inverse of load_block, only the first n frames of used lanes are
+ * written */
+static inline void store_block(const struct lane_group *g, uint32_t i,
+			       uint32_t n, const __m128 v[LANES])
+{
+	__m128 r[LANES] = {v[0], v[1], v[2], v[3]};
+
+	_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+
+	for (size_t l = 0; l < LANES; l++) {
+		float *p = g->ptr[l];
+
+		if (!p)
+			continue;
+
+		if (n == LANES) {
+			_mm_storeu_ps(p + i, r[l]);
+		} else {
+			float tmp[LANES];
+			_mm_storeu_ps(tmp, r[l]);
+			memcpy(p + i, tmp, n * sizeof(float));
+		}
+	}
+}
+
+static inline uint32_t block_frames(uint32_t frames, uint32_t i)
+{
+	return frames - i < LANES ? frames - i : LANES;
+}
+
+/* y += coef * (x - y), the EQ band splitting stages */
+static inline __m128 pole(__m128 y, __m128 x, __m128 coef)
+{
+	return _mm_add_ps(y, _mm_mul_ps(coef, _mm_sub_ps(x, y)));
+}
+
+static inline __m128 pole_eps(__m128 y, __m128 x, __m128 coef, __m128 eps)
+{
+	return _mm_add_ps(y, _mm_add_ps(_mm_mul_ps(coef, _mm_sub_ps(x, y)),
+					eps));
+}
+
+void eq_process_lanes(const struct eq_coeffs *eq,
+		      struct eq_channel_state *state, float **data,
+		      size_t channels, uint32_t frames)
+{
+	const __m128 lf = _mm_set1_ps(eq->lf);
+	const __m128 hf = _mm_set1_ps(eq->hf);
+	const __m128 low_gain = _mm_set1_ps(eq->low_gain);
+	const __m128 mid_gain = _mm_set1_ps(eq->mid_gain);
+	const __m128 high_gain = _mm_set1_ps(eq->high_gain);
+	const __m128 epsilon = _mm_set1_ps(EQ_EPSILON);
+
+	for (size_t base = 0; base < channels; base += LANES) {
+		float st[EQ_STATE_FIELDS][LANES] = {{0}};
+		struct lane_group g;
+
+		init_group(&g, data, channels, base);
+		if (!g.count)
+			continue;
+
+		for (size_t l = 0; l < LANES; l++) {
+			float fields[EQ_STATE_FIELDS];
+
+			if (!g.ptr[l])
+				continue;
+
+			memcpy(fields, &state[base + l], sizeof(fields));
+			for (size_t k = 0; k < EQ_STATE_FIELDS; k++)
+				st[k][l] = fields[k];
+		}
+
+		__m128 lf0 = _mm_loadu_ps(st[0]);
+		__m128 lf1 = _mm_loadu_ps(st[1]);
+		__m128 lf2 = _mm_loadu_ps(st[2]);
+		__m128 lf3 = _mm_loadu_ps(st[3]);
+		__m128 hf0 = _mm_loadu_ps(st[4]);
+		__m128 hf1 = _mm_loadu_ps(st[5]);
+		__m128 hf2 = _mm_loadu_ps(st[6]);
+		__m128 hf3 = _mm_loadu_ps(st[7]);
+		__m128 sd1 = _mm_loadu_ps(st[8]);
+		__m128 sd2 = _mm_loadu_ps(st[9]);
+		__m128 sd3 = _mm_loadu_ps(st[10]);
+
+		for (uint32_t i = 0; i < frames; i += LANES) {
+			const uint32_t n = block_frames(frames, i);
+			__m128 v[LANES];
+
+			load_block(&g, i, n, v);
+
+			for (uint32_t t = 0; t < n; t++) {
+				const __m128 s = v[t];
+				__m128 l, m, h;
+
+				lf0 = pole_eps(lf0, s, lf, epsilon);
+				lf1 = pole(lf1, lf0, lf);
+				lf2 = pole(lf2, lf1, lf);
+				lf3 = pole(lf3, lf2, lf);
+
+				l = lf3;
+
+				hf0 = pole_eps(hf0, s, hf, epsilon);
+				hf1 = pole(hf1, hf0, hf);
+				hf2 = pole(hf2, hf1, hf);
+				hf3 = pole(hf3, hf2, hf);
+
+				h = _mm_sub_ps(sd3, hf3);
+				m = _mm_sub_ps(sd3, _mm_add_ps(h, l));
+
+				l = _mm_mul_ps(l, low_gain);
+				m = _mm_mul_ps(m, mid_gain);
+				h = _mm_mul_ps(h, high_gain);
+
+				sd3 = sd2;
+				sd2 = sd1;
+				sd1 = s;
+
+				v[t] = _mm_add_ps(_mm_add_ps(l, m), h);
+			}
+
+			store_block(&g, i, n, v);
+		}
+
+		_mm_storeu_ps(st[0], lf0);
+		_mm_storeu_ps(st[1], lf1);
+		_mm_storeu_ps(st[2], lf2);
+		_mm_storeu_ps(st[3], lf3);
+		_mm_storeu_ps(st[4], hf0);
+		_mm_storeu_ps(st[5], hf1);
+		_mm_storeu_ps(st[6], hf2);
+		_mm_storeu_ps(st[7], hf3);
+		_mm_storeu_ps(st[8], sd1);
+		_mm_storeu_ps(st[9], sd2);
+		_mm_storeu_ps(st[10], sd3);
+
+		for (size_t l = 0; l < LANES; l++) {
+			float fields[EQ_STATE_FIELDS];
+
+			if (!g.ptr[l])
+				continue;
+
+			for (size_t k = 0; k < EQ_STATE_FIELDS; k++)
+				fields[k] = st[k][l];
+			memcpy(&state[base + l], fields, sizeof(fields));
+		}
+	}
+}
+
+void peak_envelope_lanes(float **data, size_t channels, uint32_t frames,
+			 float attack_gain, float release_gain, float *envelope,
+			 float *env_buf)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 attack = _mm_set1_ps(attack_gain);
+	const __m128 release = _mm_set1_ps(release_gain);
+
+	if (!frames)
+		return;
+
+	memset(env_buf, 0, frames * sizeof(env_buf[0]));
+
+	for (size_t base = 0; base < channels; base += LANES) {
+		struct lane_group g;
+
+		init_group(&g, data, channels, base);
+		if (!g.count)
+			continue;
+
+		const __m128 mask = lane_mask(&g);
+		__m128 env = _mm_set1_ps(*envelope);
+
+		for (uint32_t i = 0; i < frames; i += LANES) {
+			const uint32_t n = block_frames(frames, i);
+			__m128 v[LANES];
+
+			load_block(&g, i, n, v);
+
+			for (uint32_t t = 0; t < LANES; t++) {
+				if (t >= n) {
+					v[t] = _mm_setzero_ps();
+					continue;
+				}
+
+				const __m128 env_in = _mm_andnot_ps(sign, v[t]);
+				const __m128 diff = _mm_sub_ps(env, env_in);
+				const __m128 att = _mm_add_ps(
+					env_in, _mm_mul_ps(attack, diff));
+				const __m128 rel = _mm_add_ps(
+					env_in, _mm_mul_ps(release, diff));
+				const __m128 rising = _mm_cmplt_ps(env, env_in);
+
+				env = _mm_or_ps(_mm_and_ps(rising, att),
+						_mm_andnot_ps(rising, rel));
+				v[t] = _mm_and_ps(env, mask);
+			}
+
+			/* Back to one vector per lane, then the maximum of
+			 * all lanes for each of the frames */
+			_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+			__m128 max = _mm_max_ps(_mm_max_ps(v[0], v[1]),
+						_mm_max_ps(v[2], v[3]));
+
+			if (n == LANES) {
+				__m128 cur = _mm_loadu_ps(env_buf + i);
+				_mm_storeu_ps(env_buf + i, _mm_max_ps(cur, max));
+			} else {
+				float tmp[LANES];
+				_mm_storeu_ps(tmp, max);
+				for (uint32_t t = 0; t < n; t++)
+					env_buf[i + t] =
+						fmaxf(env_buf[i + t], tmp[t]);
+			}
+		}
+	}
+
+	*envelope = env_buf[frames - 1];
+}
+
+void level_detect_lanes(float **data, size_t channels, uint32_t frames,
+			bool rms, float rmscoef, float *runave, float **env_buf)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 coef = _mm_set1_ps(rmscoef);
+	const __m128 inv_coef = _mm_set1_ps(1 - rmscoef);
+
+	if (!frames)
+		return;
+
+	for (size_t base = 0; base < channels; base += LANES) {
+		float ave_lanes[LANES] = {0};
+		struct lane_group in;
+		struct lane_group out;
+
+		init_group(&in, data, channels, base);
+
+		for (size_t l = 0; l < LANES; l++) {
+			size_t c = base + l;
+
+			out.ptr[l] = in.ptr[l] ? env_buf[c] : NULL;
+			if (in.ptr[l])
+				ave_lanes[l] = runave[c];
+			else if (c < channels)
+				memset(env_buf[c], 0, frames * sizeof(float));
+		}
+		out.count = in.count;
+
+		if (!in.count)
+			continue;
+
+		__m128 ave = _mm_loadu_ps(ave_lanes);
+
+		for (uint32_t i = 0; i < frames; i += LANES) {
+			const uint32_t n = block_frames(frames, i);
+			__m128 v[LANES];
+
+			load_block(&in, i, n, v);
+
+			for (uint32_t t = 0; t < n; t++) {
+				const __m128 sq = _mm_mul_ps(v[t], v[t]);
+
+				if (rms) {
+					ave = _mm_add_ps(_mm_mul_ps(coef, ave),
+							 _mm_mul_ps(inv_coef,
+								    sq));
+					v[t] = _mm_sqrt_ps(_mm_max_ps(ave, zero));
+				} else {
+					ave = sq;
+					v[t] = _mm_andnot_ps(sign, v[t]);
+				}
+			}
+
+			store_block(&out, i, n, v);
+		}
+
+		_mm_storeu_ps(ave_lanes, ave);
+		for (size_t l = 0; l < LANES; l++) {
+			if (in.ptr[l])
+				runave[base + l] = ave_lanes[l];
+		}
+	}
+}
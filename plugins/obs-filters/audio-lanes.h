@@ -0,0 +1,138 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <util/c99defs.h>
+
+/*
+ * Kernels shared by the built-in audio dynamics and EQ filters.
+ *
+ * The per-sample recurrences of these filters (envelope followers, the EQ
+ * band splitters) cannot be vectorized along time, but every channel runs
+ * the same recurrence independently. The lane versions therefore put one
+ * channel in each SIMD lane and step through time four frames at a time,
+ * transposing blocks of 4x4 samples between the planar buffers and the
+ * lanes. Layouts with more than four channels use several groups of lanes.
+ *
+ * The scalar versions are the reference implementations, and are used for
+ * mono audio where there is nothing to put into the other lanes.
+ */
+
+/* Per-channel state of the 3-band EQ */
+struct eq_channel_state {
+	float lf_delay0;
+	float lf_delay1;
+	float lf_delay2;
+	float lf_delay3;
+
+	float hf_delay0;
+	float hf_delay1;
+	float hf_delay2;
+	float hf_delay3;
+
+	float sample_delay1;
+	float sample_delay2;
+	float sample_delay3;
+};
+
+struct eq_coeffs {
+	float lf;
+	float hf;
+	float low_gain;
+	float mid_gain;
+	float high_gain;
+};
+
+/* 3-band EQ over all channels, in place */
+void eq_process_scalar(const struct eq_coeffs *eq,
+		       struct eq_channel_state *state, float **data,
+		       size_t channels, uint32_t frames);
+void eq_process_lanes(const struct eq_coeffs *eq,
+		      struct eq_channel_state *state, float **data,
+		      size_t channels, uint32_t frames);
+
+/* Peak envelope follower of the compressor and limiter. Every channel
+ * starts from *envelope, env_buf receives the maximum envelope of all
+ * channels per frame and *envelope is set to its last value. NULL channels
+ * are skipped. */
+void peak_envelope_scalar(float **data, size_t channels, uint32_t frames,
+			  float attack_gain, float release_gain,
+			  float *envelope, float *env_buf);
+void peak_envelope_lanes(float **data, size_t channels, uint32_t frames,
+			 float attack_gain, float release_gain, float *envelope,
+			 float *env_buf);
+
+/* Level detector of the expander, one envelope per channel. With rms set,
+ * runave holds the running mean square of each channel across calls and
+ * rmscoef is its decay, otherwise the envelope is the absolute sample
+ * value. env_buf of NULL channels is zeroed. */
+void level_detect_scalar(float **data, size_t channels, uint32_t frames,
+			 bool rms, float rmscoef, float *runave,
+			 float **env_buf);
+void level_detect_lanes(float **data, size_t channels, uint32_t frames,
+			bool rms, float rmscoef, float *runave, float **env_buf);
+
+/* Maximum absolute sample value of all channels per frame */
+void peak_level(float **data, size_t channels, uint32_t frames, float *level);
+
+/* Multiplies every channel by a per-frame gain, NULL channels are skipped */
+void apply_gain(float **data, size_t channels, uint32_t frames,
+		const float *gain);
+
+static inline bool audio_lanes_enabled(size_t channels)
+{
+	return channels > 1;
+}
+
+static inline void eq_process(const struct eq_coeffs *eq,
+			      struct eq_channel_state *state, float **data,
+			      size_t channels, uint32_t frames)
+{
+	if (audio_lanes_enabled(channels))
+		eq_process_lanes(eq, state, data, channels, frames);
+	else
+		eq_process_scalar(eq, state, data, channels, frames);
+}
+
+static inline void peak_envelope(float **data, size_t channels,
+				 uint32_t frames, float attack_gain,
+				 float release_gain, float *envelope,
+				 float *env_buf)
+{
+	if (audio_lanes_enabled(channels))
+		peak_envelope_lanes(data, channels, frames, attack_gain,
+				    release_gain, envelope, env_buf);
+	else
+		peak_envelope_scalar(data, channels, frames, attack_gain,
+				     release_gain, envelope, env_buf);
+}
+
+static inline void level_detect(float **data, size_t channels,
+				uint32_t frames, bool rms, float rmscoef,
+				float *runave, float **env_buf)
+{
+	if (audio_lanes_enabled(channels))
+		level_detect_lanes(data, channels, frames, rms, rmscoef,
+				   runave, env_buf);
+	else
+		level_detect_scalar(data, channels, frames, rms, rmscoef,
+				    runave, env_buf);
+}
@@ -8,6 +8,8 @@
 #include <util/deque.h>
 #include <util/threading.h>
 
+#include "audio-lanes.h"
+
 /* -------------------------------------------------------- */
 
 #define do_log(level, format, ...)                                     \
@@ -88,13 +90,9 @@ struct expander_data {
 	int detector;
 	float runave[MAX_AUDIO_CHANNELS];
 	bool is_gate;
-	float *runaverage[MAX_AUDIO_CHANNELS];
-	size_t runaverage_len;
 	float *gain_db[MAX_AUDIO_CHANNELS];
 	size_t gain_db_len;
 	float gain_db_buf[MAX_AUDIO_CHANNELS];
-	float *env_in;
-	size_t env_in_len;
 	bool is_upwcomp;
 	float knee;
 };
@@ -116,20 +114,6 @@ static void resize_env_buffer(struct expander_data *cd, size_t len)
 				 cd->envelope_buf_len * sizeof(float));
 }
 
-static void resize_runaverage_buffer(struct expander_data *cd, size_t len)
-{
-	cd->runaverage_len = len;
-	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++)
-		cd->runaverage[i] = brealloc(
-			cd->runaverage[i], cd->runaverage_len * sizeof(float));
-}
-
-static void resize_env_in_buffer(struct expander_data *cd, size_t len)
-{
-	cd->env_in_len = len;
-	cd->env_in = brealloc(cd->env_in, cd->env_in_len * sizeof(float));
-}
-
 static void resize_gain_db_buffer(struct expander_data *cd, size_t len)
 {
 	cd->gain_db_len = len;
@@ -236,10 +220,6 @@ static void expander_update(void *data, obs_data_t *s)
 	size_t sample_len = sample_rate * DEFAULT_AUDIO_BUF_MS / MS_IN_S;
 	if (cd->envelope_buf_len == 0)
 		resize_env_buffer(cd, sample_len);
-	if (cd->runaverage_len == 0)
-		resize_runaverage_buffer(cd, sample_len);
-	if (cd->env_in_len == 0)
-		resize_env_in_buffer(cd, sample_len);
 	if (cd->gain_db_len == 0)
 		resize_gain_db_buffer(cd, sample_len);
 }
@@ -281,10 +261,8 @@ static void expander_destroy(void *data)
 
 	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++) {
 		bfree(cd->envelope_buf[i]);
-		bfree(cd->runaverage[i]);
 		bfree(cd->gain_db[i]);
 	}
-	bfree(cd->env_in);
 	bfree(cd);
 }
 
@@ -294,53 +272,18 @@ static void analyze_envelope(struct expander_data *cd, float **samples,
 {
 	if (cd->envelope_buf_len < num_samples)
 		resize_env_buffer(cd, num_samples);
-	if (cd->runaverage_len < num_samples)
-		resize_runaverage_buffer(cd, num_samples);
-	if (cd->env_in_len < num_samples)
-		resize_env_in_buffer(cd, num_samples);
 
 	// 10 ms RMS window
 	const float rmscoef = exp2f(-100.0f / cd->sample_rate);
 
-	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++) {
-		memset(cd->envelope_buf[i], 0,
-		       num_samples * sizeof(cd->envelope_buf[i][0]));
-		memset(cd->runaverage[i], 0,
-		       num_samples * sizeof(cd->runaverage[i][0]));
-	}
-	memset(cd->env_in, 0, num_samples * sizeof(cd->env_in[0]));
+	level_detect(samples, cd->num_channels, num_samples,
+		     cd->detector == RMS_DETECT, rmscoef, cd->runave,
+		     cd->envelope_buf);
 
 	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!samples[chan])
-			continue;
-
-		float *envelope_buf = cd->envelope_buf[chan];
-		float *runave = cd->runaverage[chan];
-		float *env_in = cd->env_in;
-
-		if (cd->detector == RMS_DETECT) {
-			runave[0] =
-				rmscoef * cd->runave[chan] +
-				(1 - rmscoef) * powf(samples[chan][0], 2.0f);
-			env_in[0] = sqrtf(fmaxf(runave[0], 0));
-			for (uint32_t i = 1; i < num_samples; ++i) {
-				runave[i] =
-					rmscoef * runave[i - 1] +
-					(1 - rmscoef) *
-						powf(samples[chan][i], 2.0f);
-				env_in[i] = sqrtf(runave[i]);
-			}
-		} else if (cd->detector == PEAK_DETECT) {
-			for (uint32_t i = 0; i < num_samples; ++i) {
-				runave[i] = powf(samples[chan][i], 2);
-				env_in[i] = fabsf(samples[chan][i]);
-			}
-		}
-
-		cd->runave[chan] = runave[num_samples - 1];
-		for (uint32_t i = 0; i < num_samples; ++i)
-			envelope_buf[i] = fmaxf(envelope_buf[i], env_in[i]);
-		cd->envelope[chan] = cd->envelope_buf[chan][num_samples - 1];
+		if (samples[chan])
+			cd->envelope[chan] =
+				cd->envelope_buf[chan][num_samples - 1];
 	}
 }
 
@@ -522,7 +465,7 @@ static obs_properties_t *expander_properties(void *data)
 struct obs_source_info expander_filter = {
 	.id = "expander_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_AUDIO,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_AUDIO_TILEABLE,
 	.get_name = expander_name,
 	.create = expander_create,
 	.destroy = expander_destroy,
@@ -535,7 +478,7 @@ struct obs_source_info expander_filter = {
 struct obs_source_info upward_compressor_filter = {
 	.id = "upward_compressor_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_AUDIO,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_AUDIO_TILEABLE,
 	.get_name = upward_compressor_name,
 	.create = upward_compressor_create,
 	.destroy = expander_destroy,
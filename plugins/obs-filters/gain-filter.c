@@ -87,7 +87,7 @@ static obs_properties_t *gain_properties(void *data)
 struct obs_source_info gain_filter = {
 	.id = "gain_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_AUDIO,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_AUDIO_TILEABLE,
 	.get_name = gain_name,
 	.create = gain_create,
 	.destroy = gain_destroy,
@@ -41,7 +41,7 @@ invert_polarity_filter_audio(void *unused, struct obs_audio_data *audio)
 struct obs_source_info invert_polarity_filter = {
 	.id = "invert_polarity_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_AUDIO,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_AUDIO_TILEABLE,
 	.get_name = invert_polarity_name,
 	.create = invert_polarity_create,
 	.destroy = invert_polarity_destroy,
@@ -6,6 +6,8 @@
 #include <media-io/audio-math.h>
 #include <util/platform.h>
 
+#include "audio-lanes.h"
+
 /* -------------------------------------------------------- */
 
 #define do_log(level, format, ...)             \
@@ -133,27 +135,8 @@ static void analyze_envelope(struct limiter_data *cd, float **samples,
 		resize_env_buffer(cd, num_samples);
 	}
 
-	const float attack_gain = cd->attack_gain;
-	const float release_gain = cd->release_gain;
-
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!samples[chan])
-			continue;
-
-		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
-		for (uint32_t i = 0; i < num_samples; ++i) {
-			const float env_in = fabsf(samples[chan][i]);
-			if (env < env_in) {
-				env = env_in + attack_gain * (env - env_in);
-			} else {
-				env = env_in + release_gain * (env - env_in);
-			}
-			envelope_buf[i] = fmaxf(envelope_buf[i], env);
-		}
-	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
+	peak_envelope(samples, cd->num_channels, num_samples, cd->attack_gain,
+		      cd->release_gain, &cd->envelope, cd->envelope_buf);
 }
 
 static inline void process_compression(const struct limiter_data *cd,
@@ -164,12 +147,10 @@ static inline void process_compression(const struct limiter_data *cd,
 		float gain = cd->slope * (cd->threshold - env_db);
 		gain = db_to_mul(fminf(0, gain));
 
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
-		}
+		cd->envelope_buf[i] = gain * cd->output_gain;
 	}
+
+	apply_gain(samples, cd->num_channels, num_samples, cd->envelope_buf);
 }
 
 static struct obs_audio_data *limiter_filter_audio(void *data,
@@ -364,6 +364,23 @@ static inline void process_speexdsp(struct noise_suppress_data *ng)
 #endif
 }
 
+#ifdef LIBRNNOISE_ENABLED
+/* Scales the last len samples of src into dst, padding the front with zeroes
+ * if src is shorter. Kept free of branches so that it vectorizes. */
+static inline void copy_scaled(float *dst, size_t len, const float *src,
+			       size_t src_len, float scale)
+{
+	size_t pad = len > src_len ? len - src_len : 0;
+
+	memset(dst, 0, pad * sizeof(float));
+	dst += pad;
+	src += src_len - (len - pad);
+
+	for (size_t i = 0; i < len - pad; i++)
+		dst[i] = src[i] * scale;
+}
+#endif
+
 static inline void process_rnnoise(struct noise_suppress_data *ng)
 {
 #ifdef LIBRNNOISE_ENABLED
@@ -377,33 +394,29 @@ static inline void process_rnnoise(struct noise_suppress_data *ng)
 					 (const uint8_t **)ng->copy_buffers,
 					 (uint32_t)ng->frames);
 
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (ssize_t j = 0, k = (ssize_t)out_frames -
-						RNNOISE_FRAME_SIZE;
-			     j < RNNOISE_FRAME_SIZE; ++j, ++k) {
-				if (k >= 0) {
-					ng->rnn_segment_buffers[i][j] =
-						output[i][k] * 32768.0f;
-				} else {
-					ng->rnn_segment_buffers[i][j] = 0;
-				}
-			}
-		}
+		for (size_t i = 0; i < ng->channels; i++)
+			copy_scaled(ng->rnn_segment_buffers[i],
+				    RNNOISE_FRAME_SIZE, output[i], out_frames,
+				    32768.0f);
 	} else {
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (size_t j = 0; j < RNNOISE_FRAME_SIZE; ++j) {
-				ng->rnn_segment_buffers[i][j] =
-					ng->copy_buffers[i][j] * 32768.0f;
-			}
-		}
+		for (size_t i = 0; i < ng->channels; i++)
+			copy_scaled(ng->rnn_segment_buffers[i],
+				    RNNOISE_FRAME_SIZE, ng->copy_buffers[i],
+				    RNNOISE_FRAME_SIZE, 32768.0f);
 	}
 
-	/* Execute */
+	/* Execute, all channels at once if the library supports it */
+#ifdef RNNOISE_HAS_PROCESS_FRAMES
+	rnnoise_process_frames(ng->rnn_states, ng->rnn_segment_buffers,
+			       (const float **)ng->rnn_segment_buffers, NULL,
+			       (int)ng->channels);
+#else
 	for (size_t i = 0; i < ng->channels; i++) {
 		rnnoise_process_frame(ng->rnn_states[i],
 				      ng->rnn_segment_buffers[i],
 				      ng->rnn_segment_buffers[i]);
 	}
+#endif
 
 	/* Revert signal level adjustment, resample back if necessary */
 	if (ng->rnn_resampler) {
@@ -415,26 +428,14 @@ static inline void process_rnnoise(struct noise_suppress_data *ng)
 			&ts_offset, (const uint8_t **)ng->rnn_segment_buffers,
 			RNNOISE_FRAME_SIZE);
 
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (ssize_t j = 0,
-				     k = (ssize_t)out_frames - ng->frames;
-			     j < (ssize_t)ng->frames; ++j, ++k) {
-				if (k >= 0) {
-					ng->copy_buffers[i][j] =
-						output[i][k] / 32768.0f;
-				} else {
-					ng->copy_buffers[i][j] = 0;
-				}
-			}
-		}
+		for (size_t i = 0; i < ng->channels; i++)
+			copy_scaled(ng->copy_buffers[i], ng->frames, output[i],
+				    out_frames, 1.0f / 32768.0f);
 	} else {
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (size_t j = 0; j < RNNOISE_FRAME_SIZE; ++j) {
-				ng->copy_buffers[i][j] =
-					ng->rnn_segment_buffers[i][j] /
-					32768.0f;
-			}
-		}
+		for (size_t i = 0; i < ng->channels; i++)
+			copy_scaled(ng->copy_buffers[i], RNNOISE_FRAME_SIZE,
+				    ng->rnn_segment_buffers[i],
+				    RNNOISE_FRAME_SIZE, 1.0f / 32768.0f);
 	}
 #else
 	UNUSED_PARAMETER(ng);
@@ -61,6 +61,12 @@ RNNOISE_EXPORT void rnnoise_destroy(DenoiseState *st);
 
 RNNOISE_EXPORT float rnnoise_process_frame(DenoiseState *st, float *out, const float *in);
 
+/* Processes one frame for each of count independent states, e.g. one per
+ * channel. Frames of states sharing a model run through the network as a
+ * batch. out[i] may be the same buffer as in[i], vad_prob may be NULL. */
+#define RNNOISE_HAS_PROCESS_FRAMES 1
+RNNOISE_EXPORT void rnnoise_process_frames(DenoiseState **st, float **out, const float **in, float *vad_prob, int count);
+
 RNNOISE_EXPORT RNNModel *rnnoise_model_from_file(FILE *f);
 
 RNNOISE_EXPORT void rnnoise_model_free(RNNModel *model);
@@ -67,6 +67,14 @@ static OPUS_INLINE void _celt_fatal(const char *str, const char *file, int line)
 #define celt_assert2(cond, message)
 #endif
 
+/* SSE2 is part of the x86-64 baseline, other targets use the C code */
+#if !defined(FIXED_POINT) && (defined(__SSE2__) || \
+    (defined(_M_X64) && !defined(_M_ARM64EC)) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RNN_SSE2
+#include <emmintrin.h>
+#endif
+
 #define IMUL32(a,b) ((a)*(b))
 
 #define MIN16(a,b) ((a) < (b) ? (a) : (b))   /**< Minimum 16-bit value.   */
@@ -97,6 +97,16 @@ struct DenoiseState {
   float mem_hp_x[2];
   float lastg[NB_BANDS];
   RNNState rnn;
+  /* Per-frame scratch, kept here so that batches of frames don't need
+     several copies of it on the stack */
+  kiss_fft_cpx X[FREQ_SIZE];
+  kiss_fft_cpx P[WINDOW_SIZE];
+  float Ex[NB_BANDS], Ep[NB_BANDS];
+  float Exp[NB_BANDS];
+  float features[NB_FEATURES];
+  float g[NB_BANDS];
+  float vad_prob;
+  int silence;
 };
 
 void compute_band_energy(float *bandE, const kiss_fft_cpx *X) {
@@ -453,26 +463,23 @@ void pitch_filter(kiss_fft_cpx *X, const kiss_fft_cpx *P, const float *Ex, const
   }
 }
 
-float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
-  int i;
-  kiss_fft_cpx X[FREQ_SIZE];
-  kiss_fft_cpx P[WINDOW_SIZE];
+static void analyze_frame(DenoiseState *st, const float *in) {
   float x[FRAME_SIZE];
-  float Ex[NB_BANDS], Ep[NB_BANDS];
-  float Exp[NB_BANDS];
-  float features[NB_FEATURES];
-  float g[NB_BANDS];
-  float gf[FREQ_SIZE]={1};
-  float vad_prob = 0;
-  int silence;
   static const float a_hp[2] = {-1.99599f, 0.99600f};
   static const float b_hp[2] = {-2, 1};
   biquad(x, st->mem_hp_x, in, b_hp, a_hp, FRAME_SIZE);
-  silence = compute_frame_features(st, X, P, Ex, Ep, Exp, features, x);
+  st->silence = compute_frame_features(st, st->X, st->P, st->Ex, st->Ep, st->Exp, st->features, x);
+  st->vad_prob = 0;
+}
 
-  if (!silence) {
-    compute_rnn(&st->rnn, g, &vad_prob, features);
-    pitch_filter(X, P, Ex, Ep, Exp, g);
+static void synthesize_frame(DenoiseState *st, float *out) {
+  int i;
+  kiss_fft_cpx *X = st->X;
+  float *g = st->g;
+  float gf[FREQ_SIZE]={1};
+
+  if (!st->silence) {
+    pitch_filter(X, st->P, st->Ex, st->Ep, st->Exp, g);
     for (i=0;i<NB_BANDS;i++) {
       float alpha = .6f;
       g[i] = MAX16(g[i], alpha*st->lastg[i]);
@@ -488,6 +495,55 @@ float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
   }
 
   frame_synthesis(st, out, X);
+}
+
+static void run_rnn_batch(DenoiseState **st, int count) {
+  int b;
+  RNNState *rnn[RNN_MAX_BATCH];
+  float *gains[RNN_MAX_BATCH];
+  float *vad[RNN_MAX_BATCH];
+  const float *features[RNN_MAX_BATCH];
+  for (b=0;b<count;b++) {
+    rnn[b] = &st[b]->rnn;
+    gains[b] = st[b]->g;
+    vad[b] = &st[b]->vad_prob;
+    features[b] = st[b]->features;
+  }
+  compute_rnn_batch(rnn, gains, vad, features, count);
+}
+
+void rnnoise_process_frames(DenoiseState **st, float **out, const float **in, float *vad_prob, int count) {
+  int i;
+  int batch_size = 0;
+  DenoiseState *batch[RNN_MAX_BATCH];
+
+  for (i=0;i<count;i++)
+    analyze_frame(st[i], in[i]);
+
+  /* Frames sharing a model go through the network together */
+  for (i=0;i<count;i++) {
+    if (st[i]->silence)
+      continue;
+    if (batch_size == RNN_MAX_BATCH ||
+        (batch_size && batch[0]->rnn.model != st[i]->rnn.model)) {
+      run_rnn_batch(batch, batch_size);
+      batch_size = 0;
+    }
+    batch[batch_size++] = st[i];
+  }
+  if (batch_size)
+    run_rnn_batch(batch, batch_size);
+
+  for (i=0;i<count;i++) {
+    synthesize_frame(st[i], out[i]);
+    if (vad_prob)
+      vad_prob[i] = st[i]->vad_prob;
+  }
+}
+
+float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
+  float vad_prob;
+  rnnoise_process_frames(&st, &out, &in, &vad_prob, 1);
   return vad_prob;
 }
 
@@ -98,6 +98,61 @@ static void kf_bfly2(
    }
 }
 
+#ifdef RNN_SSE2
+/* Two complex products at once, same rounding as C_MUL() */
+static OPUS_INLINE __m128 cmul_sse2(__m128 a, __m128 b)
+{
+   const __m128 sign = _mm_set_ps(0.f, -0.f, 0.f, -0.f);
+   __m128 br = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2,2,0,0));
+   __m128 bi = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,3,1,1));
+   __m128 aswap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+   return _mm_add_ps(_mm_mul_ps(a, br),
+                     _mm_xor_ps(_mm_mul_ps(aswap, bi), sign));
+}
+
+static OPUS_INLINE __m128 load_twiddles_sse2(const kiss_twiddle_cpx *tw,
+                                              size_t stride)
+{
+   __m128 v = _mm_setzero_ps();
+   v = _mm_loadl_pi(v, (const __m64 *)tw);
+   return _mm_loadh_pi(v, (const __m64 *)(tw + stride));
+}
+
+/* Radix-4 butterflies for Fout[0] and Fout[1], see kf_bfly4() */
+static OPUS_INLINE void kf_bfly4_sse2(kiss_fft_cpx *Fout,
+                                      const kiss_twiddle_cpx *tw1,
+                                      const kiss_twiddle_cpx *tw2,
+                                      const kiss_twiddle_cpx *tw3,
+                                      size_t fstride, int m)
+{
+   const __m128 rot_sign = _mm_set_ps(-0.f, 0.f, -0.f, 0.f);
+   float *f0 = (float *)Fout;
+   float *f1 = (float *)(Fout + m);
+   float *f2 = (float *)(Fout + 2*m);
+   float *f3 = (float *)(Fout + 3*m);
+   __m128 scratch0, scratch1, scratch2, scratch3, scratch4, scratch5;
+   __m128 out0, rot;
+
+   scratch0 = cmul_sse2(_mm_loadu_ps(f1), load_twiddles_sse2(tw1, fstride));
+   scratch1 = cmul_sse2(_mm_loadu_ps(f2), load_twiddles_sse2(tw2, fstride*2));
+   scratch2 = cmul_sse2(_mm_loadu_ps(f3), load_twiddles_sse2(tw3, fstride*3));
+
+   out0 = _mm_loadu_ps(f0);
+   scratch5 = _mm_sub_ps(out0, scratch1);
+   out0 = _mm_add_ps(out0, scratch1);
+   scratch3 = _mm_add_ps(scratch0, scratch2);
+   scratch4 = _mm_sub_ps(scratch0, scratch2);
+   _mm_storeu_ps(f2, _mm_sub_ps(out0, scratch3));
+   _mm_storeu_ps(f0, _mm_add_ps(out0, scratch3));
+
+   /* (scratch4.i, -scratch4.r) */
+   rot = _mm_shuffle_ps(scratch4, scratch4, _MM_SHUFFLE(2,3,0,1));
+   rot = _mm_xor_ps(rot, rot_sign);
+   _mm_storeu_ps(f1, _mm_add_ps(scratch5, rot));
+   _mm_storeu_ps(f3, _mm_sub_ps(scratch5, rot));
+}
+#endif
+
 static void kf_bfly4(
                      kiss_fft_cpx * Fout,
                      const size_t fstride,
@@ -140,8 +195,19 @@ static void kf_bfly4(
       {
          Fout = Fout_beg + i*mm;
          tw3 = tw2 = tw1 = st->twiddles;
+         j = 0;
+#ifdef RNN_SSE2
+         for (;j<m-1;j+=2)
+         {
+            kf_bfly4_sse2(Fout, tw1, tw2, tw3, fstride, m);
+            tw1 += fstride*2;
+            tw2 += fstride*4;
+            tw3 += fstride*6;
+            Fout += 2;
+         }
+#endif
          /* m is guaranteed to be a multiple of 4. */
-         for (j=0;j<m;j++)
+         for (;j<m;j++)
          {
             C_MUL(scratch[0],Fout[m] , *tw1 );
             C_MUL(scratch[1],Fout[m2] , *tw2 );
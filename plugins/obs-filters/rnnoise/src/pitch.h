@@ -50,6 +50,22 @@ opus_val16 remove_doubling(opus_val16 *x, int maxperiod, int minperiod,
 
 /* OPT: This is the kernel you really want to optimize. It gets used a lot
    by the prefilter and by the PLC. */
+#ifdef RNN_SSE2
+/* One lane per lag, each accumulated in the same order as the C version */
+static OPUS_INLINE void xcorr_kernel(const opus_val16 * x, const opus_val16 * y, opus_val32 sum[4], int len)
+{
+   int j;
+   __m128 xsum = _mm_loadu_ps(sum);
+   celt_assert(len>=3);
+   for (j=0;j<len;j++)
+   {
+      __m128 x0 = _mm_set1_ps(x[j]);
+      __m128 y0 = _mm_loadu_ps(y+j);
+      xsum = _mm_add_ps(xsum, _mm_mul_ps(x0, y0));
+   }
+   _mm_storeu_ps(sum, xsum);
+}
+#else
 static OPUS_INLINE void xcorr_kernel(const opus_val16 * x, const opus_val16 * y, opus_val32 sum[4], int len)
 {
    int j;
@@ -115,6 +131,7 @@ static OPUS_INLINE void xcorr_kernel(const opus_val16 * x, const opus_val16 * y,
       sum[3] = MAC16_16(sum[3],tmp,y_1);
    }
 }
+#endif
 
 static OPUS_INLINE void dual_inner_prod(const opus_val16 *x, const opus_val16 *y01, const opus_val16 *y02,
       int N, opus_val32 *xy1, opus_val32 *xy2)
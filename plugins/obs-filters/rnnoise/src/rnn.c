@@ -37,6 +37,7 @@
 #include "rnn.h"
 #include "rnn_data.h"
 #include <stdio.h>
+#include <string.h>
 
 static OPUS_INLINE float tansig_approx(float x)
 {
@@ -76,103 +77,206 @@ static OPUS_INLINE float relu(float x)
    return x < 0 ? 0 : x;
 }
 
-static void compute_dense(const DenseLayer *layer, float *output, const float *input)
+#ifdef RNN_SSE2
+/* Four consecutive int8 weights as floats */
+static OPUS_INLINE __m128 load_weights_sse2(const rnn_weight *w)
 {
-   int i, j;
-   int N, M;
-   int stride;
-   M = layer->nb_inputs;
-   N = layer->nb_neurons;
-   stride = N;
-   for (i=0;i<N;i++)
+   int packed;
+   __m128i v;
+   memcpy(&packed, w, sizeof(packed));
+   v = _mm_cvtsi32_si128(packed);
+   v = _mm_unpacklo_epi8(v, v);
+   v = _mm_unpacklo_epi16(v, v);
+   v = _mm_srai_epi32(v, 24);
+   return _mm_cvtepi32_ps(v);
+}
+#endif
+
+/* sum[b][i] += weights[j*stride + i]*input[b][j] (*scale[b][j] if given)
+   for all neurons i < N, all inputs j < M and all batch entries b. Every
+   sum is accumulated in the order of j like the original scalar loops, so
+   batching does not change the results. The weight matrix is only walked
+   once for the whole batch. */
+static void accumulate(float sum[][MAX_NEURONS], const rnn_weight *weights,
+      int stride, const float *const *input, const float *const *scale,
+      int M, int N, int count)
+{
+   int i, j, b;
+   i = 0;
+#ifdef RNN_SSE2
+   for (;i<N-3;i+=4)
    {
-      /* Compute update gate. */
-      float sum = layer->bias[i];
+      __m128 acc[RNN_MAX_BATCH];
+      for (b=0;b<count;b++)
+         acc[b] = _mm_loadu_ps(&sum[b][i]);
       for (j=0;j<M;j++)
-         sum += layer->input_weights[j*stride + i]*input[j];
-      output[i] = WEIGHTS_SCALE*sum;
+      {
+         __m128 w = load_weights_sse2(&weights[j*stride + i]);
+         for (b=0;b<count;b++)
+         {
+            __m128 t = _mm_mul_ps(w, _mm_set1_ps(input[b][j]));
+            if (scale)
+               t = _mm_mul_ps(t, _mm_set1_ps(scale[b][j]));
+            acc[b] = _mm_add_ps(acc[b], t);
+         }
+      }
+      for (b=0;b<count;b++)
+         _mm_storeu_ps(&sum[b][i], acc[b]);
    }
-   if (layer->activation == ACTIVATION_SIGMOID) {
-      for (i=0;i<N;i++)
-         output[i] = sigmoid_approx(output[i]);
-   } else if (layer->activation == ACTIVATION_TANH) {
+#endif
+   /* Remaining neurons, with the weights walked row by row */
+   if (i == N)
+      return;
+   for (b=0;b<count;b++)
+   {
+      float *acc = sum[b];
+      for (j=0;j<M;j++)
+      {
+         const rnn_weight *w = &weights[j*stride];
+         float in = input[b][j];
+         int k;
+         if (scale) {
+            float sc = scale[b][j];
+            for (k=i;k<N;k++)
+               acc[k] += w[k]*in*sc;
+         } else {
+            for (k=i;k<N;k++)
+               acc[k] += w[k]*in;
+         }
+      }
+   }
+}
+
+static OPUS_INLINE float activation(int type, float x)
+{
+   if (type == ACTIVATION_SIGMOID) return sigmoid_approx(x);
+   else if (type == ACTIVATION_TANH) return tansig_approx(x);
+   else if (type == ACTIVATION_RELU) return relu(x);
+   *(int*)0=0;
+   return 0;
+}
+
+static void compute_dense_batch(const DenseLayer *layer, float **output,
+      const float *const *input, int count)
+{
+   int i, b;
+   int N, M;
+   float sum[RNN_MAX_BATCH][MAX_NEURONS];
+   M = layer->nb_inputs;
+   N = layer->nb_neurons;
+   for (b=0;b<count;b++)
       for (i=0;i<N;i++)
-         output[i] = tansig_approx(output[i]);
-   } else if (layer->activation == ACTIVATION_RELU) {
+         sum[b][i] = layer->bias[i];
+   accumulate(sum, layer->input_weights, N, input, NULL, M, N, count);
+   for (b=0;b<count;b++)
       for (i=0;i<N;i++)
-         output[i] = relu(output[i]);
-   } else {
-     *(int*)0=0;
-   }
+         output[b][i] = activation(layer->activation, WEIGHTS_SCALE*sum[b][i]);
 }
 
-static void compute_gru(const GRULayer *gru, float *state, const float *input)
+static void compute_gru_batch(const GRULayer *gru, float **state,
+      const float *const *input, int count)
 {
-   int i, j;
+   int i, b;
    int N, M;
    int stride;
-   float z[MAX_NEURONS];
-   float r[MAX_NEURONS];
-   float h[MAX_NEURONS];
+   float sum[RNN_MAX_BATCH][MAX_NEURONS];
+   float z[RNN_MAX_BATCH][MAX_NEURONS];
+   float r[RNN_MAX_BATCH][MAX_NEURONS];
+   const float *cstate[RNN_MAX_BATCH];
+   const float *cr[RNN_MAX_BATCH];
    M = gru->nb_inputs;
    N = gru->nb_neurons;
    stride = 3*N;
-   for (i=0;i<N;i++)
-   {
-      /* Compute update gate. */
-      float sum = gru->bias[i];
-      for (j=0;j<M;j++)
-         sum += gru->input_weights[j*stride + i]*input[j];
-      for (j=0;j<N;j++)
-         sum += gru->recurrent_weights[j*stride + i]*state[j];
-      z[i] = sigmoid_approx(WEIGHTS_SCALE*sum);
-   }
-   for (i=0;i<N;i++)
+   for (b=0;b<RNN_MAX_BATCH;b++)
    {
-      /* Compute reset gate. */
-      float sum = gru->bias[N + i];
-      for (j=0;j<M;j++)
-         sum += gru->input_weights[N + j*stride + i]*input[j];
-      for (j=0;j<N;j++)
-         sum += gru->recurrent_weights[N + j*stride + i]*state[j];
-      r[i] = sigmoid_approx(WEIGHTS_SCALE*sum);
+      cstate[b] = b < count ? state[b] : NULL;
+      cr[b] = r[b];
    }
-   for (i=0;i<N;i++)
+
+   /* Compute update gate. */
+   for (b=0;b<count;b++)
+      for (i=0;i<N;i++)
+         sum[b][i] = gru->bias[i];
+   accumulate(sum, gru->input_weights, stride, input, NULL, M, N, count);
+   accumulate(sum, gru->recurrent_weights, stride, cstate, NULL, N, N, count);
+   for (b=0;b<count;b++)
+      for (i=0;i<N;i++)
+         z[b][i] = sigmoid_approx(WEIGHTS_SCALE*sum[b][i]);
+
+   /* Compute reset gate. */
+   for (b=0;b<count;b++)
+      for (i=0;i<N;i++)
+         sum[b][i] = gru->bias[N + i];
+   accumulate(sum, gru->input_weights + N, stride, input, NULL, M, N, count);
+   accumulate(sum, gru->recurrent_weights + N, stride, cstate, NULL, N, N, count);
+   for (b=0;b<count;b++)
+      for (i=0;i<N;i++)
+         r[b][i] = sigmoid_approx(WEIGHTS_SCALE*sum[b][i]);
+
+   /* Compute output. */
+   for (b=0;b<count;b++)
+      for (i=0;i<N;i++)
+         sum[b][i] = gru->bias[2*N + i];
+   accumulate(sum, gru->input_weights + 2*N, stride, input, NULL, M, N, count);
+   accumulate(sum, gru->recurrent_weights + 2*N, stride, cstate, cr, N, N, count);
+   for (b=0;b<count;b++)
    {
-      /* Compute output. */
-      float sum = gru->bias[2*N + i];
-      for (j=0;j<M;j++)
-         sum += gru->input_weights[2*N + j*stride + i]*input[j];
-      for (j=0;j<N;j++)
-         sum += gru->recurrent_weights[2*N + j*stride + i]*state[j]*r[j];
-      if (gru->activation == ACTIVATION_SIGMOID) sum = sigmoid_approx(WEIGHTS_SCALE*sum);
-      else if (gru->activation == ACTIVATION_TANH) sum = tansig_approx(WEIGHTS_SCALE*sum);
-      else if (gru->activation == ACTIVATION_RELU) sum = relu(WEIGHTS_SCALE*sum);
-      else *(int*)0=0;
-      h[i] = z[i]*state[i] + (1-z[i])*sum;
+      for (i=0;i<N;i++)
+      {
+         float h = activation(gru->activation, WEIGHTS_SCALE*sum[b][i]);
+         sum[b][i] = z[b][i]*state[b][i] + (1-z[b][i])*h;
+      }
+      for (i=0;i<N;i++)
+         state[b][i] = sum[b][i];
    }
-   for (i=0;i<N;i++)
-      state[i] = h[i];
 }
 
 #define INPUT_SIZE 42
 
+void compute_rnn_batch(RNNState **rnn, float **gains, float **vad,
+      const float *const *input, int count) {
+  int i, b;
+  const RNNModel *model = rnn[0]->model;
+  float dense_out[RNN_MAX_BATCH][MAX_NEURONS];
+  float noise_input[RNN_MAX_BATCH][MAX_NEURONS*3];
+  float denoise_input[RNN_MAX_BATCH][MAX_NEURONS*3];
+  float *dense_ptr[RNN_MAX_BATCH];
+  const float *noise_ptr[RNN_MAX_BATCH];
+  const float *denoise_ptr[RNN_MAX_BATCH];
+  float *vad_state[RNN_MAX_BATCH] = {0};
+  float *noise_state[RNN_MAX_BATCH] = {0};
+  float *denoise_state[RNN_MAX_BATCH] = {0};
+  celt_assert(count > 0 && count <= RNN_MAX_BATCH);
+  for (b=0;b<RNN_MAX_BATCH;b++) {
+    dense_ptr[b] = dense_out[b];
+    noise_ptr[b] = noise_input[b];
+    denoise_ptr[b] = denoise_input[b];
+  }
+  for (b=0;b<count;b++) {
+    celt_assert(rnn[b]->model == model);
+    vad_state[b] = rnn[b]->vad_gru_state;
+    noise_state[b] = rnn[b]->noise_gru_state;
+    denoise_state[b] = rnn[b]->denoise_gru_state;
+  }
+  compute_dense_batch(model->input_dense, dense_ptr, input, count);
+  compute_gru_batch(model->vad_gru, vad_state, (const float *const *)dense_ptr, count);
+  compute_dense_batch(model->vad_output, vad, (const float *const *)vad_state, count);
+  for (b=0;b<count;b++) {
+    for (i=0;i<model->input_dense_size;i++) noise_input[b][i] = dense_out[b][i];
+    for (i=0;i<model->vad_gru_size;i++) noise_input[b][i+model->input_dense_size] = vad_state[b][i];
+    for (i=0;i<INPUT_SIZE;i++) noise_input[b][i+model->input_dense_size+model->vad_gru_size] = input[b][i];
+  }
+  compute_gru_batch(model->noise_gru, noise_state, noise_ptr, count);
+
+  for (b=0;b<count;b++) {
+    for (i=0;i<model->vad_gru_size;i++) denoise_input[b][i] = vad_state[b][i];
+    for (i=0;i<model->noise_gru_size;i++) denoise_input[b][i+model->vad_gru_size] = noise_state[b][i];
+    for (i=0;i<INPUT_SIZE;i++) denoise_input[b][i+model->vad_gru_size+model->noise_gru_size] = input[b][i];
+  }
+  compute_gru_batch(model->denoise_gru, denoise_state, denoise_ptr, count);
+  compute_dense_batch(model->denoise_output, gains, (const float *const *)denoise_state, count);
+}
+
 void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input) {
-  int i;
-  float dense_out[MAX_NEURONS];
-  float noise_input[MAX_NEURONS*3];
-  float denoise_input[MAX_NEURONS*3];
-  compute_dense(rnn->model->input_dense, dense_out, input);
-  compute_gru(rnn->model->vad_gru, rnn->vad_gru_state, dense_out);
-  compute_dense(rnn->model->vad_output, vad, rnn->vad_gru_state);
-  for (i=0;i<rnn->model->input_dense_size;i++) noise_input[i] = dense_out[i];
-  for (i=0;i<rnn->model->vad_gru_size;i++) noise_input[i+rnn->model->input_dense_size] = rnn->vad_gru_state[i];
-  for (i=0;i<INPUT_SIZE;i++) noise_input[i+rnn->model->input_dense_size+rnn->model->vad_gru_size] = input[i];
-  compute_gru(rnn->model->noise_gru, rnn->noise_gru_state, noise_input);
-
-  for (i=0;i<rnn->model->vad_gru_size;i++) denoise_input[i] = rnn->vad_gru_state[i];
-  for (i=0;i<rnn->model->noise_gru_size;i++) denoise_input[i+rnn->model->vad_gru_size] = rnn->noise_gru_state[i];
-  for (i=0;i<INPUT_SIZE;i++) denoise_input[i+rnn->model->vad_gru_size+rnn->model->noise_gru_size] = input[i];
-  compute_gru(rnn->model->denoise_gru, rnn->denoise_gru_state, denoise_input);
-  compute_dense(rnn->model->denoise_output, gains, rnn->denoise_gru_state);
+  compute_rnn_batch(&rnn, &gains, &vad, &input, 1);
 }
@@ -60,6 +60,13 @@ typedef struct {
 
 typedef struct RNNState RNNState;
 
+/* Maximum number of frames run through the network together */
+#define RNN_MAX_BATCH 8
+
 void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input);
 
+/* Same as compute_rnn() for several states sharing the same model. */
+void compute_rnn_batch(RNNState **rnn, float **gains, float **vad,
+      const float *const *input, int count);
+
 #endif /* _MLP_H_ */
@@ -0,0 +1,587 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "mp4-mux.h"
+#include "hls-playlist.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include <util/file-serializer.h>
+
+#define do_log(level, format, ...)                     \
+	blog(level, "[cmaf hls output: '%s'] " format, \
+	     obs_output_get_name(out->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+/* Box fields are gathered in the stdio buffer rather than written one by one,
+ * sample data that doesn't fit is usually written straight from the encoder
+ * packet. The file is flushed at the end of each part, before the part is
+ * announced in the playlist. */
+#define SEGMENT_FILE_BUFFER_SIZE (256 * 1024)
+
+struct segment_file {
+	FILE *file;
+	int64_t pos;
+};
+
+struct cmaf_hls_output {
+	obs_output_t *output;
+
+	volatile bool active;
+	volatile bool stopping;
+	uint64_t stop_ts;
+
+	uint64_t total_bytes;
+
+	pthread_mutex_t mutex;
+
+	struct mp4_mux *muxer;
+	struct serializer dummy;
+	bool failed;
+
+	/* Playlist path and file name prefix for init/media segments */
+	struct dstr path;
+	struct dstr dir;
+	struct dstr base_name;
+
+	struct serializer init_serializer;
+	bool init_open;
+
+	struct serializer seg_serializer;
+	struct segment_file seg_file;
+
+	int64_t part_duration;
+	int64_t segment_duration;
+	bool delete_segments;
+
+	struct hls_part cur_part;
+	struct hls_playlist playlist;
+	bool warned_keyint;
+};
+
+static inline bool stopping(struct cmaf_hls_output *out)
+{
+	return os_atomic_load_bool(&out->stopping);
+}
+
+static inline bool active(struct cmaf_hls_output *out)
+{
+	return os_atomic_load_bool(&out->active);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Segment file serializer                                                   */
+
+static size_t segment_file_write(void *data, const void *ptr, size_t size)
+{
+	struct segment_file *sf = data;
+	size_t written = fwrite(ptr, 1, size, sf->file);
+	sf->pos += (int64_t)written;
+	return written;
+}
+
+static int64_t segment_file_seek(void *data, int64_t offset,
+				 enum serialize_seek_type seek_type)
+{
+	struct segment_file *sf = data;
+	int origin = SEEK_SET;
+
+	switch (seek_type) {
+	case SERIALIZE_SEEK_START:
+		origin = SEEK_SET;
+		break;
+	case SERIALIZE_SEEK_CURRENT:
+		origin = SEEK_CUR;
+		break;
+	case SERIALIZE_SEEK_END:
+		origin = SEEK_END;
+		break;
+	}
+
+	if (os_fseeki64(sf->file, offset, origin) == -1)
+		return -1;
+
+	sf->pos = os_ftelli64(sf->file);
+	return sf->pos;
+}
+
+static int64_t segment_file_get_pos(void *data)
+{
+	struct segment_file *sf = data;
+	return sf->pos;
+}
+
+static bool segment_file_open(struct serializer *s, struct segment_file *sf,
+			      const char *path)
+{
+	sf->file = os_fopen(path, "wb");
+	if (!sf->file)
+		return false;
+
+	setvbuf(sf->file, NULL, _IOFBF, SEGMENT_FILE_BUFFER_SIZE);
+	sf->pos = 0;
+
+	s->data = sf;
+	s->read = NULL;
+	s->write = segment_file_write;
+	s->seek = segment_file_seek;
+	s->get_pos = segment_file_get_pos;
+	return true;
+}
+
+static void segment_file_close(struct segment_file *sf)
+{
+	if (sf->file)
+		fclose(sf->file);
+	sf->file = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Playlist                                                                  */
+
+static void segment_filename(struct cmaf_hls_output *out, struct dstr *dst,
+			     uint64_t sequence)
+{
+	dstr_copy_dstr(dst, &out->dir);
+	hls_segment_filename(dst, out->base_name.array, sequence);
+}
+
+static void init_filename(struct cmaf_hls_output *out, struct dstr *dst)
+{
+	dstr_copy_dstr(dst, &out->dir);
+	hls_init_filename(dst, out->base_name.array);
+}
+
+static void write_playlist(struct cmaf_hls_output *out, bool ended)
+{
+	struct dstr pl = {0};
+
+	hls_playlist_write(&out->playlist, &pl, out->base_name.array, ended);
+
+	if (!os_quick_write_utf8_file_safe(out->path.array, pl.array, pl.len,
+					   false, "tmp", NULL))
+		warn("Failed to write playlist '%s'", out->path.array);
+
+	dstr_free(&pl);
+}
+
+static void prune_segments(struct cmaf_hls_output *out)
+{
+	struct hls_segment seg;
+
+	while (hls_playlist_pop_expired(&out->playlist, &seg)) {
+		if (out->delete_segments) {
+			struct dstr path = {0};
+			segment_filename(out, &path, seg.sequence);
+			os_unlink(path.array);
+			dstr_free(&path);
+		}
+
+		da_free(seg.parts);
+	}
+}
+
+static void complete_segment(struct cmaf_hls_output *out)
+{
+	if (!out->seg_file.file)
+		return;
+
+	segment_file_close(&out->seg_file);
+	hls_playlist_complete_segment(&out->playlist);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Muxer callbacks                                                           */
+
+static struct serializer *cmaf_init_segment(void *param)
+{
+	struct cmaf_hls_output *out = param;
+	struct dstr path = {0};
+
+	init_filename(out, &path);
+	out->init_open = file_output_serializer_init(&out->init_serializer,
+						     path.array);
+	if (!out->init_open) {
+		warn("Unable to open init segment '%s'", path.array);
+		out->failed = true;
+		dstr_free(&path);
+		return &out->dummy;
+	}
+
+	dstr_free(&path);
+	return &out->init_serializer;
+}
+
+static struct serializer *cmaf_fragment_start(void *param, bool independent)
+{
+	struct cmaf_hls_output *out = param;
+
+	if (out->init_open) {
+		file_output_serializer_free(&out->init_serializer);
+		out->init_open = false;
+	}
+
+	if (!out->seg_file.file ||
+	    hls_playlist_needs_segment(&out->playlist, independent)) {
+		struct dstr path = {0};
+
+		if (out->seg_file.file && !independent &&
+		    out->playlist.independent_segments && !out->warned_keyint) {
+			warn("Keyframe interval exceeded, starting segments "
+			     "without a keyframe");
+			out->warned_keyint = true;
+		}
+
+		complete_segment(out);
+		prune_segments(out);
+
+		struct hls_segment *seg =
+			hls_playlist_start_segment(&out->playlist);
+
+		segment_filename(out, &path, seg->sequence);
+		if (!segment_file_open(&out->seg_serializer, &out->seg_file,
+				       path.array)) {
+			warn("Unable to open segment '%s'", path.array);
+			out->failed = true;
+			dstr_free(&path);
+			return &out->dummy;
+		}
+
+		dstr_free(&path);
+	}
+
+	out->cur_part.offset = (uint64_t)out->seg_file.pos;
+	out->cur_part.independent = independent;
+	return &out->seg_serializer;
+}
+
+static void cmaf_fragment_end(void *param, int64_t duration_usec)
+{
+	struct cmaf_hls_output *out = param;
+
+	if (!out->seg_file.file)
+		return;
+
+	if (fflush(out->seg_file.file) != 0) {
+		warn("Failed to write part to segment file");
+		out->failed = true;
+		return;
+	}
+
+	out->cur_part.size = (uint64_t)out->seg_file.pos - out->cur_part.offset;
+	out->cur_part.duration_usec = duration_usec;
+	hls_playlist_add_part(&out->playlist, &out->cur_part);
+
+	write_playlist(out, false);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *cmaf_hls_output_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("CMAFHLSOutput");
+}
+
+static void cmaf_hls_output_destroy(void *data)
+{
+	struct cmaf_hls_output *out = data;
+
+	pthread_mutex_destroy(&out->mutex);
+	dstr_free(&out->path);
+	dstr_free(&out->dir);
+	dstr_free(&out->base_name);
+	bfree(out);
+}
+
+static size_t dummy_write(void *data, const void *ptr, size_t size)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(ptr);
+	return size;
+}
+
+static int64_t dummy_get_pos(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return -1;
+}
+
+static void *cmaf_hls_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct cmaf_hls_output *out = bzalloc(sizeof(struct cmaf_hls_output));
+	out->output = output;
+	pthread_mutex_init(&out->mutex, NULL);
+
+	/* Swallows writes if a segment could not be opened, the error is
+	 * picked up after the packet has been submitted. */
+	out->dummy.write = dummy_write;
+	out->dummy.get_pos = dummy_get_pos;
+
+	UNUSED_PARAMETER(settings);
+	return out;
+}
+
+static void split_path(struct cmaf_hls_output *out)
+{
+	dstr_copy_dstr(&out->dir, &out->path);
+	dstr_replace(&out->dir, "\\", "/");
+
+	const char *slash = strrchr(out->dir.array, '/');
+	const char *name = slash ? slash + 1 : out->dir.array;
+	const char *ext = strrchr(name, '.');
+
+	if (ext)
+		dstr_ncopy(&out->base_name, name, ext - name);
+	else
+		dstr_copy(&out->base_name, name);
+
+	if (slash)
+		dstr_resize(&out->dir, slash - out->dir.array + 1);
+	else
+		dstr_free(&out->dir);
+}
+
+/* Longest keyframe interval of the video tracks, 0 if any of them isn't
+ * known, or -1 without video */
+static int64_t get_sync_interval(struct cmaf_hls_output *out)
+{
+	int64_t interval = -1;
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		obs_encoder_t *enc =
+			obs_output_get_video_encoder2(out->output, i);
+		if (!enc)
+			continue;
+
+		obs_data_t *settings = obs_encoder_get_settings(enc);
+		int64_t keyint = obs_data_get_int(settings, "keyint_sec");
+		obs_data_release(settings);
+
+		if (keyint <= 0)
+			return 0;
+		if (keyint * 1000000 > interval)
+			interval = keyint * 1000000;
+	}
+
+	return interval;
+}
+
+static bool cmaf_hls_output_start(void *data)
+{
+	struct cmaf_hls_output *out = data;
+
+	if (!obs_output_can_begin_data_capture(out->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(out->output, 0))
+		return false;
+
+	os_atomic_set_bool(&out->stopping, false);
+
+	obs_data_t *settings = obs_output_get_settings(out->output);
+	dstr_copy(&out->path, obs_data_get_string(settings, "path"));
+	out->part_duration =
+		obs_data_get_int(settings, "part_duration_ms") * 1000;
+	out->segment_duration =
+		obs_data_get_int(settings, "segment_duration_ms") * 1000;
+	size_t playlist_size =
+		(size_t)obs_data_get_int(settings, "playlist_size");
+	out->delete_segments = obs_data_get_bool(settings, "delete_segments");
+	obs_data_release(settings);
+
+	if (dstr_is_empty(&out->path)) {
+		warn("No playlist path specified");
+		return false;
+	}
+
+	if (out->part_duration <= 0) {
+		warn("Invalid part duration");
+		return false;
+	}
+
+	split_path(out);
+	if (!dstr_is_empty(&out->dir))
+		os_mkdirs(out->dir.array);
+
+	out->failed = false;
+	out->warned_keyint = false;
+	out->total_bytes = 0;
+
+	hls_playlist_init(&out->playlist, out->part_duration,
+			  out->segment_duration, get_sync_interval(out),
+			  playlist_size);
+
+	struct mp4_mux_segment_callbacks cb = {
+		.param = out,
+		.init_segment = cmaf_init_segment,
+		.fragment_start = cmaf_fragment_start,
+		.fragment_end = cmaf_fragment_end,
+	};
+
+	out->muxer = mp4_mux_create(out->output, &out->dummy,
+				    MP4_USE_NEGATIVE_CTS);
+	mp4_mux_set_segment_callbacks(out->muxer, &cb, out->part_duration);
+
+	os_atomic_set_bool(&out->active, true);
+	obs_output_begin_data_capture(out->output, 0);
+
+	info("Writing LL-HLS playlist '%s' (part duration: %" PRId64
+	     " ms, segment duration: %" PRId64 " ms)",
+	     out->path.array, out->part_duration / 1000,
+	     out->segment_duration / 1000);
+	return true;
+}
+
+static void cmaf_hls_output_stop(void *data, uint64_t ts)
+{
+	struct cmaf_hls_output *out = data;
+	out->stop_ts = ts / 1000;
+	os_atomic_set_bool(&out->stopping, true);
+}
+
+static void mp4_mux_destroy_task(void *ptr)
+{
+	struct mp4_mux *muxer = ptr;
+	mp4_mux_destroy(muxer);
+}
+
+static void cmaf_hls_output_actual_stop(struct cmaf_hls_output *out, int code)
+{
+	os_atomic_set_bool(&out->active, false);
+
+	mp4_mux_finalise(out->muxer);
+
+	if (code) {
+		obs_output_signal_stop(out->output, code);
+	} else {
+		obs_output_end_data_capture(out->output);
+	}
+
+	if (out->init_open) {
+		file_output_serializer_free(&out->init_serializer);
+		out->init_open = false;
+	}
+
+	bool had_segment = out->seg_file.file != NULL;
+	complete_segment(out);
+	if (had_segment)
+		write_playlist(out, true);
+
+	/* Segments are left on disk for the VOD playlist */
+	hls_playlist_free(&out->playlist);
+
+	obs_queue_task(OBS_TASK_DESTROY, mp4_mux_destroy_task, out->muxer,
+		       false);
+	out->muxer = NULL;
+
+	info("LL-HLS output stopped");
+}
+
+static void cmaf_hls_output_packet(void *data, struct encoder_packet *packet)
+{
+	struct cmaf_hls_output *out = data;
+
+	pthread_mutex_lock(&out->mutex);
+
+	if (!active(out))
+		goto unlock;
+
+	if (!packet) {
+		cmaf_hls_output_actual_stop(out, OBS_OUTPUT_ENCODE_ERROR);
+		goto unlock;
+	}
+
+	if (stopping(out)) {
+		if (packet->sys_dts_usec >= (int64_t)out->stop_ts) {
+			cmaf_hls_output_actual_stop(out, 0);
+			goto unlock;
+		}
+	}
+
+	out->total_bytes += packet->size;
+	mp4_mux_submit_packet(out->muxer, packet);
+
+	/* Segment or init segment could not be opened/written */
+	if (out->failed || (out->seg_file.file && ferror(out->seg_file.file)))
+		cmaf_hls_output_actual_stop(out, OBS_OUTPUT_ERROR);
+
+unlock:
+	pthread_mutex_unlock(&out->mutex);
+}
+
+static void cmaf_hls_output_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, "part_duration_ms", 500);
+	obs_data_set_default_int(defaults, "segment_duration_ms", 2000);
+	obs_data_set_default_int(defaults, "playlist_size", 6);
+	obs_data_set_default_bool(defaults, "delete_segments", true);
+}
+
+static obs_properties_t *cmaf_hls_output_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_text(props, "path",
+				obs_module_text("CMAFHLSOutput.PlaylistPath"),
+				OBS_TEXT_DEFAULT);
+	obs_properties_add_int(props, "part_duration_ms",
+			       obs_module_text("CMAFHLSOutput.PartDuration"),
+			       100, 5000, 50);
+	obs_properties_add_int(props, "segment_duration_ms",
+			       obs_module_text("CMAFHLSOutput.SegmentDuration"),
+			       500, 30000, 100);
+	obs_properties_add_int(props, "playlist_size",
+			       obs_module_text("CMAFHLSOutput.PlaylistSize"), 0,
+			       100, 1);
+	obs_properties_add_bool(
+		props, "delete_segments",
+		obs_module_text("CMAFHLSOutput.DeleteSegments"));
+	return props;
+}
+
+static uint64_t cmaf_hls_output_total_bytes(void *data)
+{
+	struct cmaf_hls_output *out = data;
+	return out->total_bytes;
+}
+
+struct obs_output_info cmaf_hls_output_info = {
+	.id = "cmaf_hls_output",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED |
+		 OBS_OUTPUT_MULTI_TRACK_AV,
+	.encoded_video_codecs = "h264;hevc;av1",
+	.encoded_audio_codecs = "aac",
+	.get_name = cmaf_hls_output_name,
+	.create = cmaf_hls_output_create,
+	.destroy = cmaf_hls_output_destroy,
+	.start = cmaf_hls_output_start,
+	.stop = cmaf_hls_output_stop,
+	.encoded_packet = cmaf_hls_output_packet,
+	.get_defaults = cmaf_hls_output_defaults,
+	.get_properties = cmaf_hls_output_properties,
+	.get_total_bytes = cmaf_hls_output_total_bytes,
+};
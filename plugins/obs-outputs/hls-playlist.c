@@ -0,0 +1,226 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "hls-playlist.h"
+
+#include <inttypes.h>
+
+/* Partial segments are only listed for the last few target durations */
+#define PART_WINDOW_TARGET_DURATIONS 3
+
+/* Part durations are rounded to microseconds, don't let that push a
+ * keyframe that lands on the segment duration into the next segment */
+#define ROUNDING_SLACK_USEC 1000
+
+static inline double usec_to_sec(int64_t usec)
+{
+	return (double)usec / 1000000.0;
+}
+
+static int64_t longest_segment(int64_t part_duration,
+			       int64_t segment_duration, int64_t sync_interval)
+{
+	/* Any part can start a segment, the last one may overshoot */
+	if (sync_interval < 0)
+		return segment_duration + part_duration;
+
+	/* Segments end on the first keyframe past the segment duration */
+	if (sync_interval > 0)
+		return (segment_duration + sync_interval - 1) / sync_interval *
+		       sync_interval;
+
+	/* Segments are cut at the target duration regardless */
+	return segment_duration;
+}
+
+void hls_playlist_init(struct hls_playlist *pl, int64_t part_duration_usec,
+		       int64_t segment_duration_usec,
+		       int64_t sync_interval_usec, size_t size)
+{
+	int64_t longest = longest_segment(part_duration_usec,
+					  segment_duration_usec,
+					  sync_interval_usec);
+
+	memset(pl, 0, sizeof(*pl));
+	pl->part_duration = part_duration_usec;
+	pl->segment_duration = segment_duration_usec;
+	pl->independent_segments = sync_interval_usec != 0;
+	pl->size = size;
+
+	/* EXTINF rounded to the nearest integer must not exceed this */
+	pl->target_duration = (int)((longest + 500000) / 1000000);
+	if (pl->target_duration < 1)
+		pl->target_duration = 1;
+}
+
+void hls_playlist_free(struct hls_playlist *pl)
+{
+	for (size_t i = 0; i < pl->segments.num; i++)
+		da_free(pl->segments.array[i].parts);
+	da_free(pl->segments);
+}
+
+bool hls_playlist_needs_segment(const struct hls_playlist *pl,
+				bool independent)
+{
+	const struct hls_segment *seg;
+	int64_t limit = (int64_t)pl->target_duration * 1000000 + 500000;
+
+	if (!pl->segments.num)
+		return true;
+
+	seg = &pl->segments.array[pl->segments.num - 1];
+	if (seg->complete)
+		return true;
+	if (independent && seg->duration_usec + ROUNDING_SLACK_USEC >=
+				   pl->segment_duration)
+		return true;
+
+	/* The next part might take the segment past the target duration */
+	return seg->parts.num &&
+	       seg->duration_usec + pl->part_duration >= limit;
+}
+
+struct hls_segment *hls_playlist_start_segment(struct hls_playlist *pl)
+{
+	struct hls_segment *seg;
+
+	hls_playlist_complete_segment(pl);
+
+	seg = da_push_back_new(pl->segments);
+	seg->sequence = pl->next_sequence++;
+	return seg;
+}
+
+void hls_playlist_complete_segment(struct hls_playlist *pl)
+{
+	if (pl->segments.num)
+		pl->segments.array[pl->segments.num - 1].complete = true;
+}
+
+void hls_playlist_add_part(struct hls_playlist *pl,
+			   const struct hls_part *part)
+{
+	struct hls_segment *seg = &pl->segments.array[pl->segments.num - 1];
+
+	da_push_back(seg->parts, part);
+	seg->duration_usec += part->duration_usec;
+}
+
+bool hls_playlist_pop_expired(struct hls_playlist *pl,
+			      struct hls_segment *seg)
+{
+	size_t complete = 0;
+
+	if (!pl->size)
+		return false;
+
+	for (size_t i = 0; i < pl->segments.num; i++) {
+		if (pl->segments.array[i].complete)
+			complete++;
+	}
+
+	if (complete <= pl->size)
+		return false;
+
+	*seg = pl->segments.array[0];
+	da_erase(pl->segments, 0);
+	return true;
+}
+
+void hls_segment_filename(struct dstr *dst, const char *base_name,
+			  uint64_t sequence)
+{
+	dstr_catf(dst, "%s_%" PRIu64 ".m4s", base_name, sequence);
+}
+
+void hls_init_filename(struct dstr *dst, const char *base_name)
+{
+	dstr_catf(dst, "%s_init.mp4", base_name);
+}
+
+void hls_playlist_write(const struct hls_playlist *pl, struct dstr *dst,
+			const char *base_name, bool ended)
+{
+	struct dstr uri = {0};
+
+	dstr_cat(dst, "#EXTM3U\n");
+	dstr_cat(dst, "#EXT-X-VERSION:9\n");
+	dstr_catf(dst, "#EXT-X-TARGETDURATION:%d\n", pl->target_duration);
+	dstr_catf(dst, "#EXT-X-PART-INF:PART-TARGET=%.3f\n",
+		  usec_to_sec(pl->part_duration));
+	dstr_catf(dst, "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%.3f\n",
+		  usec_to_sec(pl->part_duration * 3));
+	dstr_catf(dst, "#EXT-X-MEDIA-SEQUENCE:%" PRIu64 "\n",
+		  pl->segments.num ? pl->segments.array[0].sequence : 0);
+	if (pl->independent_segments)
+		dstr_cat(dst, "#EXT-X-INDEPENDENT-SEGMENTS\n");
+
+	hls_init_filename(&uri, base_name);
+	dstr_catf(dst, "#EXT-X-MAP:URI=\"%s\"\n", uri.array);
+
+	/* Find first segment that is close enough to the live edge to have
+	 * its partial segments listed. */
+	int64_t part_window = (int64_t)pl->target_duration * 1000000 *
+			      PART_WINDOW_TARGET_DURATIONS;
+	int64_t remaining = 0;
+	size_t first_part_seg = pl->segments.num;
+
+	while (first_part_seg > 0) {
+		struct hls_segment *seg =
+			&pl->segments.array[first_part_seg - 1];
+		if (remaining + seg->duration_usec > part_window)
+			break;
+
+		remaining += seg->duration_usec;
+		first_part_seg--;
+	}
+
+	for (size_t i = 0; i < pl->segments.num; i++) {
+		struct hls_segment *seg = &pl->segments.array[i];
+
+		dstr_free(&uri);
+		hls_segment_filename(&uri, base_name, seg->sequence);
+
+		if (i >= first_part_seg && !ended) {
+			for (size_t j = 0; j < seg->parts.num; j++) {
+				struct hls_part *part = &seg->parts.array[j];
+
+				dstr_catf(dst,
+					  "#EXT-X-PART:DURATION=%.5f,"
+					  "URI=\"%s\",BYTERANGE=\"%" PRIu64
+					  "@%" PRIu64 "\"%s\n",
+					  usec_to_sec(part->duration_usec),
+					  uri.array, part->size, part->offset,
+					  part->independent
+						  ? ",INDEPENDENT=YES"
+						  : "");
+			}
+		}
+
+		if (seg->complete) {
+			dstr_catf(dst, "#EXTINF:%.5f,\n",
+				  usec_to_sec(seg->duration_usec));
+			dstr_catf(dst, "%s\n", uri.array);
+		}
+	}
+
+	if (ended)
+		dstr_cat(dst, "#EXT-X-ENDLIST\n");
+
+	dstr_free(&uri);
+}
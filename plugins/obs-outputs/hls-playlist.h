@@ -0,0 +1,91 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+
+struct hls_part {
+	uint64_t offset;
+	uint64_t size;
+	int64_t duration_usec;
+	bool independent;
+};
+
+struct hls_segment {
+	uint64_t sequence;
+	int64_t duration_usec;
+	bool complete;
+	DARRAY(struct hls_part) parts;
+};
+
+/*
+ * Segment list of an LL-HLS media playlist.
+ *
+ * The target duration is fixed when the playlist is created, as it must not
+ * change while the stream is live. It is derived from the longest segment
+ * that cutting on sync points can produce: segments start on the first
+ * independent part once they have reached the segment duration, which for
+ * video is the next keyframe. If the keyframe interval isn't known, or the
+ * encoder doesn't stick to it, segments are cut before they would exceed the
+ * target duration even if that means starting on a dependent part.
+ */
+struct hls_playlist {
+	int64_t part_duration;
+	int64_t segment_duration;
+	int target_duration;
+	bool independent_segments;
+
+	/* Completed segments kept in the playlist, 0 keeps all of them */
+	size_t size;
+
+	uint64_t next_sequence;
+	DARRAY(struct hls_segment) segments;
+};
+
+/* sync_interval_usec is the keyframe interval of the video tracks (0 if
+ * unknown), or -1 for audio-only playlists where every part is
+ * independent. */
+void hls_playlist_init(struct hls_playlist *pl, int64_t part_duration_usec,
+		       int64_t segment_duration_usec,
+		       int64_t sync_interval_usec, size_t size);
+void hls_playlist_free(struct hls_playlist *pl);
+
+/* Whether a part that is about to be written has to start a new segment */
+bool hls_playlist_needs_segment(const struct hls_playlist *pl,
+				bool independent);
+
+/* Completes the current segment, if any, and starts the next one */
+struct hls_segment *hls_playlist_start_segment(struct hls_playlist *pl);
+void hls_playlist_complete_segment(struct hls_playlist *pl);
+void hls_playlist_add_part(struct hls_playlist *pl,
+			   const struct hls_part *part);
+
+/* Removes the oldest segment into seg if there are more completed segments
+ * than the playlist size. The caller frees the parts of seg. */
+bool hls_playlist_pop_expired(struct hls_playlist *pl,
+			      struct hls_segment *seg);
+
+void hls_segment_filename(struct dstr *dst, const char *base_name,
+			  uint64_t sequence);
+void hls_init_filename(struct dstr *dst, const char *base_name);
+
+/* Media playlist text, partial segments are only listed while live */
+void hls_playlist_write(const struct hls_playlist *pl, struct dstr *dst,
+			const char *base_name, bool ended);
@@ -18,10 +18,13 @@
 #pragma once
 
 #include "mp4-mux.h"
+#include "mp4-sample-table.h"
 
 #include <util/darray.h>
 #include <util/deque.h>
 #include <util/serializer.h>
+#include <util/threading.h>
+#include <util/array-serializer.h>
 
 /* Flavour for target compatibility */
 enum mp4_flavour {
@@ -107,30 +110,65 @@ struct mp4_track {
 
 	/* deque of encoder_packet belonging to this track */
 	struct deque packets;
+	/* Sample sizes of the H.264/HEVC packets above once converted from
+	 * Annex B, one uint32_t per packet */
+	struct deque annexb_sizes;
 
 	/* Sample sizes (fixed for PCM) */
 	uint32_t sample_size;
-	DARRAY(uint32_t) sample_sizes;
+	struct mp4_sample_table sample_sizes;
 	/* Data chunks in file containing samples for this track */
 	DARRAY(struct chunk) chunks;
-	/* Time delta between samples */
-	DARRAY(struct sample_delta) deltas;
+	/* Time delta between samples, stored as (count, delta) pairs. The
+	 * last run is kept in cur_delta until it ends. */
+	struct mp4_sample_table deltas;
+	struct sample_delta cur_delta;
 
-	/* Sample CT-DT offset, i.e. DTS-PTS offset (Video only) */
+	/* Sample CT-DT offset, i.e. DTS-PTS offset (Video only), stored as
+	 * (count, offset) pairs with the last run in cur_offset. */
 	bool needs_ctts;
 	int32_t dts_offset;
-	DARRAY(struct sample_offset) offsets;
+	struct mp4_sample_table offsets;
+	struct sample_offset cur_offset;
 	/* Sync samples, i.e. keyframes (Video only) */
-	DARRAY(uint32_t) sync_samples;
+	struct mp4_sample_table sync_samples;
 
 	/* Temporary array with information about the samples to be included
 	 * in the next fragment. */
 	DARRAY(struct fragment_sample) fragment_samples;
 };
 
+enum deferred_table_type {
+	DEFERRED_STTS,
+	DEFERRED_STSS,
+	DEFERRED_CTTS,
+	DEFERRED_STSZ,
+};
+
+/* Sample table payload that is left out of the in-memory moov and streamed
+ * to the output when the moov is written. */
+struct deferred_table {
+	enum deferred_table_type type;
+	struct mp4_track *track;
+	/* Position in the moov buffer and in the logical (full) moov */
+	size_t buf_pos;
+	uint64_t pos;
+	uint64_t size;
+};
+
+struct moov_output {
+	struct serializer buf_serializer;
+	struct array_output_data buf;
+	/* Bytes left out of buf */
+	uint64_t deferred_bytes;
+	DARRAY(struct deferred_table) tables;
+};
+
 struct mp4_mux {
 	obs_output_t *output;
 	struct serializer *serializer;
+	/* Set while writing the final moov */
+	struct moov_output *moov_out;
 
 	/* Target format compatibility */
 	enum mp4_flavour mode;
@@ -141,6 +179,24 @@ struct mp4_mux {
 	uint32_t fragments_written;
 	/* PTS where next fragmentation should take place */
 	int64_t next_frag_pts;
+	/* PTS where the current fragment started */
+	int64_t frag_start_pts;
+
+	/* Segmented (CMAF) output */
+	struct mp4_mux_segment_callbacks segment_cb;
+	int64_t part_duration;
+
+	/* Background fragment writer, only used with MP4_ASYNC_FRAGMENTS */
+	bool worker_active;
+	pthread_t worker_thread;
+	pthread_mutex_t queue_mutex;
+	os_sem_t *queue_sem;
+	/* Free queue slots, submitting blocks once the queue is full */
+	os_sem_t *space_sem;
+	/* Queued packets and the track they belong to */
+	struct deque queue;
+	size_t max_queue_depth;
+	size_t queue_full_count;
 
 	/* Creation time (seconds since Jan 1 1904) */
 	uint64_t creation_time;
@@ -27,6 +27,7 @@
 #include <util/platform.h>
 #include <util/array-serializer.h>
 
+#include <inttypes.h>
 #include <time.h>
 
 /*
@@ -44,6 +45,10 @@
 #define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
 #define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
 
+/* Packets the fragment writer may fall behind by before submitting blocks,
+ * about four seconds of 60 FPS video plus audio. */
+#define MAX_QUEUED_PACKETS 512
+
 /* Helper to overwrite placeholder size and return total size. */
 static inline size_t write_box_size(struct serializer *s, int64_t start)
 {
@@ -1129,6 +1134,122 @@ static size_t mp4_write_stsd(struct mp4_mux *mux, struct mp4_track *track)
 	return write_box_size(s, start);
 }
 
+/* ========================================================================== */
+/* Final moov output with deferred sample tables                              */
+
+static size_t moov_output_write(void *opaque, const void *data, size_t size)
+{
+	struct moov_output *mo = opaque;
+	return s_write(&mo->buf_serializer, data, size);
+}
+
+static int64_t moov_output_get_pos(void *opaque)
+{
+	struct moov_output *mo = opaque;
+	return serializer_get_pos(&mo->buf_serializer) +
+	       (int64_t)mo->deferred_bytes;
+}
+
+static int64_t moov_output_seek(void *opaque, int64_t offset,
+				enum serialize_seek_type seek_type)
+{
+	struct moov_output *mo = opaque;
+
+	/* The muxer only ever seeks to box starts, which cannot be inside
+	 * a deferred table. */
+	if (seek_type != SERIALIZE_SEEK_START)
+		return -1;
+
+	int64_t buf_offset = offset;
+
+	for (size_t i = 0; i < mo->tables.num; i++) {
+		struct deferred_table *dt = &mo->tables.array[i];
+		if ((uint64_t)offset >= dt->pos + dt->size)
+			buf_offset -= (int64_t)dt->size;
+	}
+
+	if (serializer_seek(&mo->buf_serializer, buf_offset,
+			    SERIALIZE_SEEK_START) < 0)
+		return -1;
+
+	return offset;
+}
+
+static void moov_output_init(struct serializer *s, struct moov_output *mo)
+{
+	memset(s, 0, sizeof(struct serializer));
+	memset(mo, 0, sizeof(struct moov_output));
+	array_output_serializer_init(&mo->buf_serializer, &mo->buf);
+
+	s->data = mo;
+	s->write = moov_output_write;
+	s->get_pos = moov_output_get_pos;
+	s->seek = moov_output_seek;
+}
+
+static void moov_output_free(struct moov_output *mo)
+{
+	array_output_serializer_free(&mo->buf);
+	da_free(mo->tables);
+}
+
+/* Reserve space for a sample table in the moov without buffering it */
+static void defer_table(struct mp4_mux *mux, struct mp4_track *track,
+			enum deferred_table_type type, uint64_t size)
+{
+	struct moov_output *mo = mux->moov_out;
+	struct deferred_table *dt = da_push_back_new(mo->tables);
+
+	dt->type = type;
+	dt->track = track;
+	dt->buf_pos = mo->buf.bytes.num;
+	dt->pos = dt->buf_pos + mo->deferred_bytes;
+	dt->size = size;
+
+	mo->deferred_bytes += size;
+}
+
+static void write_deferred_table(struct serializer *s,
+				 struct deferred_table *dt)
+{
+	struct mp4_track *track = dt->track;
+
+	switch (dt->type) {
+	case DEFERRED_STTS:
+		mp4_sample_table_write(&track->deltas, s, MP4_TABLE_DELTAS,
+				       track->timescale, track->timebase_den);
+		break;
+	case DEFERRED_STSS:
+		mp4_sample_table_write(&track->sync_samples, s,
+				       MP4_TABLE_VALUES, 0, 0);
+		break;
+	case DEFERRED_CTTS:
+		mp4_sample_table_write(&track->offsets, s, MP4_TABLE_OFFSETS,
+				       track->timescale, track->timebase_den);
+		break;
+	case DEFERRED_STSZ:
+		mp4_sample_table_write(&track->sample_sizes, s,
+				       MP4_TABLE_VALUES, 0, 0);
+		break;
+	}
+}
+
+static void moov_output_write_to(struct moov_output *mo, struct serializer *s)
+{
+	uint8_t *data = mo->buf.bytes.array;
+	size_t pos = 0;
+
+	for (size_t i = 0; i < mo->tables.num; i++) {
+		struct deferred_table *dt = &mo->tables.array[i];
+
+		s_write(s, data + pos, dt->buf_pos - pos);
+		write_deferred_table(s, dt);
+		pos = dt->buf_pos;
+	}
+
+	s_write(s, data + pos, mo->buf.bytes.num - pos);
+}
+
 /// 8.6.1.2 Decoding Time to Sample Box
 static size_t mp4_write_stts(struct mp4_mux *mux, struct mp4_track *track,
 			     bool fragmented)
@@ -1141,32 +1262,25 @@ static size_t mp4_write_stts(struct mp4_mux *mux, struct mp4_track *track,
 		return 16;
 	}
 
-	int64_t start = serializer_get_pos(s);
-	struct sample_delta *arr = track->deltas.array;
-	size_t num = track->deltas.num;
-
-	write_fullbox(s, 0, "stts", 0, 0);
-
-	s_wb32(s, (uint32_t)num); // entry_count
+	/* Entries are (count, delta) pairs */
+	uint32_t num = (uint32_t)(mp4_sample_table_count(&track->deltas) / 2);
 
-	for (size_t idx = 0; idx < num; idx++) {
-		struct sample_delta *smp = &arr[idx];
+	/* 16 byte FullBox header + 8-bytes (u32+u32) per delta entry */
+	uint32_t size = 16 + 8 * num;
+	write_fullbox(s, size, "stts", 0, 0);
 
-		uint64_t delta = util_mul_div64(smp->delta, track->timescale,
-						track->timebase_den);
+	s_wb32(s, num); // entry_count
 
-		s_wb32(s, smp->count);      // sample_count
-		s_wb32(s, (uint32_t)delta); // sample_delta
-	}
+	defer_table(mux, track, DEFERRED_STTS, 8 * (uint64_t)num);
 
-	return write_box_size(s, start);
+	return size;
 }
 
 /// 8.6.2 Sync Sample Box
 static size_t mp4_write_stss(struct mp4_mux *mux, struct mp4_track *track)
 {
 	struct serializer *s = mux->serializer;
-	uint32_t num = (uint32_t)track->sync_samples.num;
+	uint32_t num = (uint32_t)mp4_sample_table_count(&track->sync_samples);
 
 	if (!num)
 		return 0;
@@ -1177,8 +1291,7 @@ static size_t mp4_write_stss(struct mp4_mux *mux, struct mp4_track *track)
 	write_fullbox(s, size, "stss", 0, 0);
 	s_wb32(s, num); // entry_count
 
-	for (size_t idx = 0; idx < num; idx++)
-		s_wb32(s, track->sync_samples.array[idx]); // sample_number
+	defer_table(mux, track, DEFERRED_STSS, 4 * (uint64_t)num);
 
 	return size;
 }
@@ -1187,7 +1300,8 @@ static size_t mp4_write_stss(struct mp4_mux *mux, struct mp4_track *track)
 static size_t mp4_write_ctts(struct mp4_mux *mux, struct mp4_track *track)
 {
 	struct serializer *s = mux->serializer;
-	uint32_t num = (uint32_t)track->offsets.num;
+	/* Entries are (count, offset) pairs */
+	uint32_t num = (uint32_t)(mp4_sample_table_count(&track->offsets) / 2);
 
 	uint8_t version = mux->flags & MP4_USE_NEGATIVE_CTS ? 1 : 0;
 
@@ -1197,14 +1311,7 @@ static size_t mp4_write_ctts(struct mp4_mux *mux, struct mp4_track *track)
 
 	s_wb32(s, num); // entry_count
 
-	for (size_t idx = 0; idx < num; idx++) {
-		int64_t offset = (int64_t)track->offsets.array[idx].offset *
-				 (int64_t)track->timescale /
-				 (int64_t)track->timebase_den;
-
-		s_wb32(s, track->offsets.array[idx].count); // sample_count
-		s_wb32(s, (uint32_t)offset);                // sample_offset
-	}
+	defer_table(mux, track, DEFERRED_CTTS, 8 * (uint64_t)num);
 
 	return size;
 }
@@ -1278,8 +1385,6 @@ static size_t mp4_write_stsz(struct mp4_mux *mux, struct mp4_track *track,
 		return 20;
 	}
 
-	int64_t start = serializer_get_pos(s);
-
 	/* This should only ever happen when recording > 24 hours of
 	 * 48 kHz PCM audio or 828 days of 60 FPS video. */
 	if (track->samples > UINT32_MAX) {
@@ -1289,22 +1394,28 @@ static size_t mp4_write_stsz(struct mp4_mux *mux, struct mp4_track *track,
 		     track->track_id);
 	}
 
-	write_fullbox(s, 0, "stsz", 0, 0);
-
 	if (track->sample_size) {
 		/* Fixed size samples mean we don't need an array */
+		write_fullbox(s, 20, "stsz", 0, 0);
 		s_wb32(s, track->sample_size);       // sample_size
 		s_wb32(s, (uint32_t)track->samples); // sample_count
-	} else {
-		s_wb32(s, 0);                                 // sample_size
-		s_wb32(s, (uint32_t)track->sample_sizes.num); // sample_count
 
-		for (size_t idx = 0; idx < track->sample_sizes.num; idx++) {
-			s_wb32(s, track->sample_sizes.array[idx]); // entry_size
-		}
+		return 20;
 	}
 
-	return write_box_size(s, start);
+	uint32_t num =
+		(uint32_t)mp4_sample_table_count(&track->sample_sizes);
+
+	/* 20 byte header + 4-bytes (u32) per sample */
+	uint32_t size = 20 + 4 * num;
+	write_fullbox(s, size, "stsz", 0, 0);
+
+	s_wb32(s, 0);   // sample_size
+	s_wb32(s, num); // sample_count
+
+	defer_table(mux, track, DEFERRED_STSZ, 4 * (uint64_t)num);
+
+	return size;
 }
 
 /// 8.7.5 Chunk Offset Box
@@ -1405,16 +1516,23 @@ static size_t mp4_write_sbgp_sbgp_opus(struct mp4_mux *mux,
 	uint16_t preroll_count = 0;
 	int64_t preroll_remaining = opus_preroll;
 
-	for (size_t i = 0; i < track->deltas.num && preroll_remaining > 0;
-	     i++) {
-		for (uint32_t j = 0;
-		     j < track->deltas.array[i].count && preroll_remaining > 0;
-		     j++) {
-			preroll_remaining -= track->deltas.array[i].delta;
+	struct mp4_sample_table_reader reader;
+	uint32_t count;
+	uint32_t delta;
+
+	mp4_sample_table_reader_init(&reader, &track->deltas);
+
+	while (preroll_remaining > 0 &&
+	       mp4_sample_table_read(&reader, &count) &&
+	       mp4_sample_table_read(&reader, &delta)) {
+		for (uint32_t j = 0; j < count && preroll_remaining > 0; j++) {
+			preroll_remaining -= delta;
 			preroll_count++;
 		}
 	}
 
+	mp4_sample_table_reader_free(&reader);
+
 	s_wb32(s, 1); // entry_count
 	/// 10.1 AudioRollRecoveryEntry
 	s_wb16(s, -preroll_count); // roll_distance
@@ -1643,9 +1761,8 @@ static size_t mp4_write_elst(struct mp4_mux *mux, struct mp4_track *track)
 		 * using b-frames). */
 		int64_t dts_offset = 0;
 
-		if (track->offsets.num) {
-			struct sample_offset sample = track->offsets.array[0];
-			dts_offset = sample.offset;
+		if (track->samples) {
+			dts_offset = track->dts_offset;
 		} else if (track->packets.size) {
 			/* If no offset data exists yet (i.e. when writing the
 			 * incomplete moov in a fragmented file) use the raw
@@ -2044,8 +2161,13 @@ static size_t mp4_write_tfhd(struct mp4_mux *mux, struct mp4_track *track,
 	struct serializer *s = mux->serializer;
 	int64_t start = serializer_get_pos(s);
 
-	uint32_t flags = BASE_DATA_OFFSET_PRESENT |
-			 DEFAULT_SAMPLE_FLAGS_PRESENT;
+	uint32_t flags = DEFAULT_SAMPLE_FLAGS_PRESENT;
+
+	/* Segments are separate files, so offsets have to be relative */
+	if (mux->segment_cb.fragment_start)
+		flags |= DEFAULT_BASE_IS_MOOF;
+	else
+		flags |= BASE_DATA_OFFSET_PRESENT;
 
 	/* Add default size/duration if all samples match. */
 	bool durations_match = true;
@@ -2079,7 +2201,8 @@ static size_t mp4_write_tfhd(struct mp4_mux *mux, struct mp4_track *track,
 	write_fullbox(s, 0, "tfhd", 0, flags);
 
 	s_wb32(s, track->track_id); // track_ID
-	s_wb64(s, moof_start);      // base_data_offset
+	if (flags & BASE_DATA_OFFSET_PRESENT)
+		s_wb64(s, moof_start); // base_data_offset
 
 	// default_sample_duration
 	if (durations_match) {
@@ -2172,8 +2295,13 @@ static size_t mp4_write_trun(struct mp4_mux *mux, struct mp4_track *track,
 	if (track->sample_size)
 		return write_box_size(s, start);
 
-	if (track->type == TRACK_VIDEO)
-		s_wb32(s, SAMPLE_FLAG_DEPENDS_NO); // first_sample_flags
+	if (track->type == TRACK_VIDEO) {
+		/* Partial fragments may start in between keyframes */
+		struct encoder_packet *first = deque_data(&track->packets, 0);
+		s_wb32(s, first->keyframe ? SAMPLE_FLAG_DEPENDS_NO
+					  : SAMPLE_FLAG_DEPENDS_YES |
+						    SAMPLE_FLAG_IS_NON_SYNC);
+	}
 
 	for (size_t idx = 0; idx < sample_count; idx++) {
 		struct fragment_sample *smp =
@@ -2291,6 +2419,93 @@ static inline struct encoder_packet *get_pkt_at(struct deque *dq, size_t idx)
 	return deque_data(dq, idx * sizeof(struct encoder_packet));
 }
 
+static inline bool track_is_annexb(struct mp4_track *track)
+{
+	return track->codec == CODEC_H264 || track->codec == CODEC_HEVC;
+}
+
+static inline bool is_keyframe_nal(struct mp4_track *track, uint8_t header)
+{
+	if (track->codec == CODEC_H264)
+		return (header & 0x1F) == OBS_NAL_SLICE_IDR;
+
+	const uint8_t type = (header & 0x7F) >> 1;
+	return type >= OBS_HEVC_NAL_BLA_W_LP &&
+	       type <= OBS_HEVC_NAL_RSV_IRAP_VCL23;
+}
+
+/* Computes the size of the sample once start codes are converted to 32-bit
+ * NAL unit sizes, and marks the packet as keyframe if it contains any IDR
+ * (IRAP for HEVC) NAL unit, same as obs_parse_avc_packet() and
+ * obs_parse_hevc_packet(). */
+static uint32_t scan_annexb_sample(struct mp4_track *track,
+				   struct encoder_packet *pkt)
+{
+	const uint8_t *const end = pkt->data + pkt->size;
+	const uint8_t *nal_start = obs_nal_find_startcode(pkt->data, end);
+	size_t sample_size = 0;
+
+	while (true) {
+		while (nal_start < end && !*(nal_start++))
+			;
+
+		if (nal_start == end)
+			break;
+
+		if (is_keyframe_nal(track, nal_start[0]))
+			pkt->keyframe = true;
+
+		const uint8_t *const nal_end =
+			obs_nal_find_startcode(nal_start, end);
+
+		sample_size += nal_end - nal_start + 4;
+		nal_start = nal_end;
+	}
+
+	return (uint32_t)sample_size;
+}
+
+/* Writes directly from the encoder's buffer, see scan_annexb_sample() */
+static void write_annexb_sample(struct serializer *s, const uint8_t *data,
+				size_t size)
+{
+	const uint8_t *const end = data + size;
+	const uint8_t *nal_start = obs_nal_find_startcode(data, end);
+
+	while (true) {
+		while (nal_start < end && !*(nal_start++))
+			;
+
+		if (nal_start == end)
+			break;
+
+		const uint8_t *const nal_end =
+			obs_nal_find_startcode(nal_start, end);
+		const size_t nal_size = nal_end - nal_start;
+		const uint8_t len[4] = {
+			(uint8_t)(nal_size >> 24),
+			(uint8_t)(nal_size >> 16),
+			(uint8_t)(nal_size >> 8),
+			(uint8_t)nal_size,
+		};
+
+		/* one write for the length prefix rather than four s_w8() */
+		s_write(s, len, sizeof(len));
+		s_write(s, nal_start, nal_size);
+		nal_start = nal_end;
+	}
+}
+
+static inline uint32_t get_sample_data_size(struct mp4_track *track,
+					    size_t idx)
+{
+	if (track_is_annexb(track))
+		return *(uint32_t *)deque_data(&track->annexb_sizes,
+					       idx * sizeof(uint32_t));
+
+	return (uint32_t)get_pkt_at(&track->packets, idx)->size;
+}
+
 static inline uint64_t get_longest_track_duration(struct mp4_mux *mux)
 {
 	uint64_t dur = 0;
@@ -2307,6 +2522,27 @@ static inline uint64_t get_longest_track_duration(struct mp4_mux *mux)
 	return dur;
 }
 
+static void track_commit_delta(struct mp4_track *track)
+{
+	if (!track->cur_delta.count)
+		return;
+
+	mp4_sample_table_push(&track->deltas, track->cur_delta.count);
+	mp4_sample_table_push(&track->deltas, track->cur_delta.delta);
+	track->cur_delta.count = 0;
+}
+
+static void track_commit_offset(struct mp4_track *track)
+{
+	if (!track->cur_offset.count)
+		return;
+
+	mp4_sample_table_push(&track->offsets, track->cur_offset.count);
+	mp4_sample_table_push(&track->offsets,
+			      (uint32_t)track->cur_offset.offset);
+	track->cur_offset.count = 0;
+}
+
 static void process_packets(struct mp4_mux *mux, struct mp4_track *track,
 			    uint64_t *mdat_size)
 {
@@ -2330,17 +2566,17 @@ static void process_packets(struct mp4_mux *mux, struct mp4_track *track,
 		/* Duration is just distance between current and next DTS. */
 		uint32_t duration = (uint32_t)(next->dts - pkt->dts);
 		uint32_t sample_count = 1;
-		uint32_t size = (uint32_t)pkt->size;
+		uint32_t size = get_sample_data_size(track, i);
 		int32_t offset = (int32_t)(pkt->pts - pkt->dts);
 
+		/* Remember initial DTS-PTS offset for edit list */
+		if (track->type == TRACK_VIDEO && !track->samples)
+			track->dts_offset = offset;
+
 		/* When using negative CTS, subtract DTS-PTS offset. */
 		if (track->type == TRACK_VIDEO &&
-		    mux->flags & MP4_USE_NEGATIVE_CTS) {
-			if (!track->offsets.num)
-				track->dts_offset = offset;
-
+		    mux->flags & MP4_USE_NEGATIVE_CTS)
 			offset -= track->dts_offset;
-		}
 
 		/* Create temporary sample information for moof */
 		struct fragment_sample *smp =
@@ -2365,44 +2601,40 @@ static void process_packets(struct mp4_mux *mux, struct mp4_track *track,
 
 		track->samples += sample_count;
 
-		/* If delta (duration) matche sprevious, increment counter,
-		 * otherwise create a new entry. */
-		if (track->deltas.num == 0 ||
-		    track->deltas.array[track->deltas.num - 1].delta !=
-			    duration) {
-			struct sample_delta *new =
-				da_push_back_new(track->deltas);
-			new->delta = duration;
-			new->count = sample_count;
+		/* If delta (duration) matches previous, increment counter,
+		 * otherwise start a new entry. */
+		if (track->cur_delta.count &&
+		    track->cur_delta.delta == duration) {
+			track->cur_delta.count += sample_count;
 		} else {
-			track->deltas.array[track->deltas.num - 1].count +=
-				sample_count;
+			track_commit_delta(track);
+			track->cur_delta.delta = duration;
+			track->cur_delta.count = sample_count;
 		}
 
 		if (!track->sample_size)
-			da_push_back(track->sample_sizes, &size);
+			mp4_sample_table_push(&track->sample_sizes, size);
 
 		if (track->type != TRACK_VIDEO)
 			continue;
 
 		if (pkt->keyframe)
-			da_push_back(track->sync_samples, &track->samples);
+			mp4_sample_table_push(&track->sync_samples,
+					      (uint32_t)track->samples);
 
 		/* Only require ctts box if offet is non-zero */
 		if (offset && !track->needs_ctts)
 			track->needs_ctts = true;
 
-		/* If dts-pts offset matche sprevious, increment counter,
-		 * otherwise create a new entry. */
-		if (track->offsets.num == 0 ||
-		    track->offsets.array[track->offsets.num - 1].offset !=
-			    offset) {
-			struct sample_offset *new =
-				da_push_back_new(track->offsets);
-			new->offset = offset;
-			new->count = 1;
+		/* If dts-pts offset matches previous, increment counter,
+		 * otherwise start a new entry. */
+		if (track->cur_offset.count &&
+		    track->cur_offset.offset == offset) {
+			track->cur_offset.count += 1;
 		} else {
-			track->offsets.array[track->offsets.num - 1].count += 1;
+			track_commit_offset(track);
+			track->cur_offset.offset = offset;
+			track->cur_offset.count = 1;
 		}
 	}
 }
@@ -2424,7 +2656,13 @@ static void write_packets(struct mp4_mux *mux, struct mp4_track *track)
 		struct encoder_packet pkt;
 		deque_pop_front(&track->packets, &pkt,
 				sizeof(struct encoder_packet));
-		s_write(s, pkt.data, pkt.size);
+		if (track_is_annexb(track)) {
+			deque_pop_front(&track->annexb_sizes, NULL,
+					sizeof(uint32_t));
+			write_annexb_sample(s, pkt.data, pkt.size);
+		} else {
+			s_write(s, pkt.data, pkt.size);
+		}
 		obs_encoder_packet_release(&pkt);
 	}
 
@@ -2437,16 +2675,60 @@ static void write_packets(struct mp4_mux *mux, struct mp4_track *track)
 	da_clear(track->fragment_samples);
 }
 
+static inline uint64_t get_track_duration_usec(struct mp4_track *track)
+{
+	return util_mul_div64(track->duration, 1000000, track->timebase_den);
+}
+
+/* Track that parts are timed and cut by: the first video track, or the first
+ * audio track for audio-only output */
+static struct mp4_track *get_part_track(struct mp4_mux *mux)
+{
+	for (size_t i = 0; i < mux->tracks.num; i++) {
+		struct mp4_track *track = &mux->tracks.array[i];
+		if (track->type == TRACK_VIDEO)
+			return track;
+	}
+
+	return mux->tracks.num ? mux->tracks.array : NULL;
+}
+
+static bool fragment_is_independent(struct mp4_mux *mux)
+{
+	/* Every video track has to start on a keyframe, audio-only
+	 * fragments can always be decoded on their own */
+	for (size_t i = 0; i < mux->tracks.num; i++) {
+		struct mp4_track *track = &mux->tracks.array[i];
+		if (track->type != TRACK_VIDEO)
+			continue;
+		if (!track->packets.size ||
+		    !get_pkt_at(&track->packets, 0)->keyframe)
+			return false;
+	}
+
+	return true;
+}
+
 static void mp4_flush_fragment(struct mp4_mux *mux)
 {
+	struct mp4_mux_segment_callbacks *cb = &mux->segment_cb;
+	bool segmented = cb->fragment_start != NULL;
+	struct serializer *header_s = mux->serializer;
 	struct serializer *s = mux->serializer;
 
 	// Write file header if not already done
 	if (!mux->fragments_written) {
+		if (segmented)
+			header_s = cb->init_segment(cb->param);
+
+		mux->serializer = header_s;
 		mp4_write_ftyp(mux, true);
-		/* Placeholder to write mdat header during soft-remux */
-		mux->placeholder_offset = serializer_get_pos(s);
-		mp4_write_free(mux);
+
+		if (!segmented) {
+			/* Placeholder to write mdat header during soft-remux */
+			mux->placeholder_offset = serializer_get_pos(s);
+			mp4_write_free(mux);
+		}
 	}
 
 	// Array output as temporary buffer to avoid sending seeks to disk
@@ -2458,10 +2740,20 @@ static void mp4_flush_fragment(struct mp4_mux *mux)
 	// Write initial incomplete moov (because fragmentation)
 	if (!mux->fragments_written) {
 		mp4_write_moov(mux, true);
-		s_write(s, aod.bytes.array, aod.bytes.num);
+		s_write(header_s, aod.bytes.array, aod.bytes.num);
 		array_output_serializer_reset(&aod);
 	}
 
+	/* In segmented mode every fragment goes to its own serializer */
+	if (segmented)
+		s = cb->fragment_start(cb->param,
+				       fragment_is_independent(mux));
+
+	struct mp4_track *part_track = get_part_track(mux);
+	uint64_t prev_duration = 0;
+	if (segmented && part_track)
+		prev_duration = get_track_duration_usec(part_track);
+
 	mux->fragments_written++;
 
 	/* --------------------------------------------------------- */
@@ -2520,6 +2812,17 @@ static void mp4_flush_fragment(struct mp4_mux *mux)
 	if (!mux->next_frag_pts && mux->chapter_track)
 		write_packets(mux, mux->chapter_track);
 
+	if (segmented) {
+		int64_t duration = 0;
+		if (part_track)
+			duration = (int64_t)(get_track_duration_usec(
+						     part_track) -
+					     prev_duration);
+
+		cb->fragment_end(cb->param, duration);
+	}
+
+	mux->frag_start_pts = mux->next_frag_pts;
 	mux->next_frag_pts = 0;
 }
 
@@ -2623,6 +2926,12 @@ static inline void add_track(struct mp4_mux *mux, obs_encoder_t *enc)
 	/* Set sample size (if fixed) */
 	if (track->type == TRACK_AUDIO)
 		track->sample_size = get_sample_size(track);
+
+	bool spill = (mux->flags & MP4_SPILL_SAMPLE_TABLES) != 0;
+	mp4_sample_table_init(&track->sample_sizes, spill);
+	mp4_sample_table_init(&track->deltas, spill);
+	mp4_sample_table_init(&track->offsets, spill);
+	mp4_sample_table_init(&track->sync_samples, spill);
 }
 
 static inline void add_chapter_track(struct mp4_mux *mux)
@@ -2656,15 +2965,167 @@ static inline void free_track(struct mp4_track *track)
 
 	free_packets(&track->packets);
 	deque_free(&track->packets);
+	deque_free(&track->annexb_sizes);
 
-	da_free(track->sample_sizes);
+	mp4_sample_table_free(&track->sample_sizes);
 	da_free(track->chunks);
-	da_free(track->deltas);
-	da_free(track->offsets);
-	da_free(track->sync_samples);
+	mp4_sample_table_free(&track->deltas);
+	mp4_sample_table_free(&track->offsets);
+	mp4_sample_table_free(&track->sync_samples);
 	da_free(track->fragment_samples);
 }
 
+/* ========================================================================== */
+/* Packet processing and background fragment writer                          */
+
+static int64_t get_frame_duration_usec(struct mp4_track *track)
+{
+	int64_t frames = track->timebase_num;
+
+	/* Audio time bases are in samples */
+	if (track->type == TRACK_AUDIO) {
+		frames *= (int64_t)obs_encoder_get_frame_size(track->encoder);
+		if (!frames)
+			frames = 1024;
+	}
+
+	return frames * 1000000 / track->timebase_den;
+}
+
+/* Takes over the reference held by pkt */
+static void mux_process_packet(struct mp4_mux *mux, struct mp4_track *track,
+			       struct encoder_packet *pkt)
+{
+	struct encoder_packet parsed_packet;
+	enum obs_encoder_type type = pkt->type;
+	bool fragment_ready = mux->next_frag_pts > 0;
+
+	for (size_t i = 0; i < mux->tracks.num; i++) {
+		struct mp4_track *tmp = &mux->tracks.array[i];
+
+		fragment_ready = fragment_ready &&
+				 tmp->last_pts_usec >= mux->next_frag_pts;
+	}
+
+	/* If all tracks have caught up to the keyframe we want to fragment on,
+	 * flush the current fragment to disk. */
+	if (fragment_ready)
+		mp4_flush_fragment(mux);
+
+	if (type == OBS_ENCODER_AUDIO) {
+		parsed_packet = *pkt;
+	} else {
+		/* H.264/HEVC data is kept as-is and converted while writing,
+		 * see write_annexb_sample(). */
+		if (track_is_annexb(track)) {
+			uint32_t size;
+
+			parsed_packet = *pkt;
+			size = scan_annexb_sample(track, &parsed_packet);
+			deque_push_back(&track->annexb_sizes, &size,
+					sizeof(size));
+		} else if (track->codec == CODEC_AV1) {
+			obs_parse_av1_packet(&parsed_packet, pkt);
+			obs_encoder_packet_release(pkt);
+		}
+
+		/* Set fragmentation PTS if packet is keyframe and PTS > 0 */
+		if (parsed_packet.keyframe && parsed_packet.pts > 0)
+			mux->next_frag_pts = packet_pts_usec(&parsed_packet);
+	}
+
+	if (mux->part_duration && !mux->next_frag_pts &&
+	    track == get_part_track(mux)) {
+		/* Cut partial fragment before it would exceed the part
+		 * duration once this frame is included. */
+		int64_t pts = packet_pts_usec(&parsed_packet);
+
+		if (pts > 0 && pts + get_frame_duration_usec(track) >
+				       mux->frag_start_pts + mux->part_duration)
+			mux->next_frag_pts = pts;
+	}
+
+	track_insert_packet(track, &parsed_packet);
+}
+
+struct queued_packet {
+	struct mp4_track *track;
+	struct encoder_packet pkt;
+};
+
+static void *mp4_mux_worker(void *data)
+{
+	struct mp4_mux *mux = data;
+
+	os_set_thread_name("mp4-mux: fragment writer");
+
+	/* Semaphore is posted once per packet and once more to shut down */
+	while (os_sem_wait(mux->queue_sem) == 0) {
+		struct queued_packet qp;
+
+		pthread_mutex_lock(&mux->queue_mutex);
+		bool empty = !mux->queue.size;
+		if (!empty)
+			deque_pop_front(&mux->queue, &qp, sizeof(qp));
+		pthread_mutex_unlock(&mux->queue_mutex);
+
+		if (empty)
+			break;
+
+		mux_process_packet(mux, qp.track, &qp.pkt);
+		os_sem_post(mux->space_sem);
+	}
+
+	return NULL;
+}
+
+static bool start_worker(struct mp4_mux *mux)
+{
+	if (pthread_mutex_init(&mux->queue_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&mux->queue_sem, 0) != 0)
+		goto fail_queue_sem;
+	if (os_sem_init(&mux->space_sem, MAX_QUEUED_PACKETS) != 0)
+		goto fail_space_sem;
+	if (pthread_create(&mux->worker_thread, NULL, mp4_mux_worker, mux) !=
+	    0)
+		goto fail_thread;
+
+	mux->worker_active = true;
+	return true;
+
+fail_thread:
+	os_sem_destroy(mux->space_sem);
+fail_space_sem:
+	os_sem_destroy(mux->queue_sem);
+fail_queue_sem:
+	pthread_mutex_destroy(&mux->queue_mutex);
+	return false;
+}
+
+/* Waits for all queued packets to be processed */
+static void stop_worker(struct mp4_mux *mux)
+{
+	if (!mux->worker_active)
+		return;
+
+	os_sem_post(mux->queue_sem);
+	pthread_join(mux->worker_thread, NULL);
+
+	os_sem_destroy(mux->queue_sem);
+	os_sem_destroy(mux->space_sem);
+	pthread_mutex_destroy(&mux->queue_mutex);
+	deque_free(&mux->queue);
+	mux->worker_active = false;
+
+	info("Maximum fragment writer queue depth: %zu packets",
+	     mux->max_queue_depth);
+	if (mux->queue_full_count)
+		warn("Fragment writer queue was full %zu times, "
+		     "encoder output was held back",
+		     mux->queue_full_count);
+}
+
 /* ===========================================================================*/
 /* API */
 
@@ -2694,11 +3155,17 @@ struct mp4_mux *mp4_mux_create(obs_output_t *output,
 		add_track(mux, enc);
 	}
 
+	if (flags & MP4_ASYNC_FRAGMENTS && !start_worker(mux))
+		warn("Failed to start fragment writer thread, "
+		     "writing fragments synchronously");
+
 	return mux;
 }
 
 void mp4_mux_destroy(struct mp4_mux *mux)
 {
+	stop_worker(mux);
+
 	for (size_t i = 0; i < mux->tracks.num; i++)
 		free_track(&mux->tracks.array[i]);
 
@@ -2708,60 +3175,78 @@ void mp4_mux_destroy(struct mp4_mux *mux)
 	bfree(mux);
 }
 
-bool mp4_mux_submit_packet(struct mp4_mux *mux, struct encoder_packet *pkt)
+static bool submit_packet(struct mp4_mux *mux, struct encoder_packet *pkt,
+			  bool owned)
 {
 	struct mp4_track *track = NULL;
-	struct encoder_packet parsed_packet;
-	enum obs_encoder_type type = pkt->type;
-	bool fragment_ready = mux->next_frag_pts > 0;
 
 	for (size_t i = 0; i < mux->tracks.num; i++) {
 		struct mp4_track *tmp = &mux->tracks.array[i];
-
-		fragment_ready = fragment_ready &&
-				 tmp->last_pts_usec >= mux->next_frag_pts;
-
-		if (tmp->encoder == pkt->encoder)
+		if (tmp->encoder == pkt->encoder) {
 			track = tmp;
+			break;
+		}
 	}
 
 	if (!track) {
 		warn("Could not find track for packet of type %s with "
 		     "track id %zu!",
-		     type == OBS_ENCODER_VIDEO ? "video" : "audio",
+		     pkt->type == OBS_ENCODER_VIDEO ? "video" : "audio",
 		     pkt->track_idx);
+		if (owned)
+			obs_encoder_packet_release(pkt);
 		return false;
 	}
 
-	/* If all tracks have caught up to the keyframe we want to fragment on,
-	 * flush the current fragment to disk. */
-	if (fragment_ready)
-		mp4_flush_fragment(mux);
-
-	if (type == OBS_ENCODER_AUDIO) {
-		obs_encoder_packet_ref(&parsed_packet, pkt);
-	} else {
-		if (track->codec == CODEC_H264)
-			obs_parse_avc_packet(&parsed_packet, pkt);
-		else if (track->codec == CODEC_HEVC)
-			obs_parse_hevc_packet(&parsed_packet, pkt);
-		else if (track->codec == CODEC_AV1)
-			obs_parse_av1_packet(&parsed_packet, pkt);
+	/* This is the only reference the muxer takes, it is held until the
+	 * packet data has been written out. */
+	struct queued_packet qp = {.track = track};
+	if (owned)
+		qp.pkt = *pkt;
+	else
+		obs_encoder_packet_ref(&qp.pkt, pkt);
 
-		/* Set fragmentation PTS if packet is keyframe and PTS > 0 */
-		if (parsed_packet.keyframe && parsed_packet.pts > 0) {
-			mux->next_frag_pts = packet_pts_usec(&parsed_packet);
-		}
+	if (!mux->worker_active) {
+		mux_process_packet(mux, track, &qp.pkt);
+		return true;
 	}
 
-	track_insert_packet(track, &parsed_packet);
+	/* Parsing and fragment assembly happen on the worker thread. If it
+	 * falls too far behind (e.g. on a stalled disk) wait for it, rather
+	 * than holding on to an unbounded amount of packet data. */
+	os_sem_wait(mux->space_sem);
+
+	pthread_mutex_lock(&mux->queue_mutex);
+	deque_push_back(&mux->queue, &qp, sizeof(qp));
+	size_t depth = mux->queue.size / sizeof(qp);
+	pthread_mutex_unlock(&mux->queue_mutex);
 
+	if (depth > mux->max_queue_depth)
+		mux->max_queue_depth = depth;
+	if (depth == MAX_QUEUED_PACKETS)
+		mux->queue_full_count++;
+
+	os_sem_post(mux->queue_sem);
 	return true;
 }
 
+bool mp4_mux_submit_packet(struct mp4_mux *mux, struct encoder_packet *pkt)
+{
+	return submit_packet(mux, pkt, false);
+}
+
+bool mp4_mux_submit_packet_owned(struct mp4_mux *mux,
+				 struct encoder_packet *pkt)
+{
+	return submit_packet(mux, pkt, true);
+}
+
 bool mp4_mux_add_chapter(struct mp4_mux *mux, int64_t dts_usec,
 			 const char *name)
 {
+	/* Chapters are only added right before finalisation */
+	stop_worker(mux);
+
 	if (dts_usec < 0)
 		return false;
 	if (!mux->chapter_track)
@@ -2782,8 +3267,19 @@ bool mp4_mux_add_chapter(struct mp4_mux *mux, int64_t dts_usec,
 	return true;
 }
 
+void mp4_mux_set_segment_callbacks(struct mp4_mux *mux,
+				   const struct mp4_mux_segment_callbacks *cb,
+				   int64_t part_duration_usec)
+{
+	mux->segment_cb = *cb;
+	mux->part_duration = part_duration_usec;
+}
+
 bool mp4_mux_finalise(struct mp4_mux *mux)
 {
+	/* Process remaining queued packets first */
+	stop_worker(mux);
+
 	struct serializer *s = mux->serializer;
 
 	/* Flush remaining audio/video samples as final fragment. */
@@ -2796,6 +3292,10 @@ bool mp4_mux_finalise(struct mp4_mux *mux)
 
 	info("Number of fragments: %u", mux->fragments_written);
 
+	/* Segments are self-contained, there is no file to finalise */
+	if (mux->segment_cb.fragment_start)
+		return true;
+
 	if (mux->flags & MP4_SKIP_FINALISATION) {
 		warn("Skipping MP4 finalization!");
 		return true;
@@ -2803,23 +3303,38 @@ bool mp4_mux_finalise(struct mp4_mux *mux)
 
 	int64_t data_end = serializer_get_pos(s);
 
+	for (size_t i = 0; i < mux->tracks.num; i++) {
+		track_commit_delta(&mux->tracks.array[i]);
+		track_commit_offset(&mux->tracks.array[i]);
+	}
+
+	if (mux->chapter_track)
+		track_commit_delta(mux->chapter_track);
+
 	/* ---------------------------------------- */
 	/* Write full moov box                      */
 
-	/* Use array serializer for moov data as this will do a lot
-	 * of seeks to write size values of variable-size boxes. */
+	/* Use an in-memory buffer for moov data as this will do a lot
+	 * of seeks to write size values of variable-size boxes. The
+	 * sample tables are left out of it and streamed separately. */
 	struct serializer fs;
-	struct array_output_data ao;
-	array_output_serializer_init(&fs, &ao);
+	struct moov_output mo;
+	moov_output_init(&fs, &mo);
 
 	mux->serializer = &fs;
+	mux->moov_out = &mo;
 
 	mp4_write_moov(mux, false);
-	s_write(s, ao.bytes.array, ao.bytes.num);
-	info("Full moov size: %zu KiB", ao.bytes.num / 1024);
 
 	mux->serializer = s; // restore real serializer
-	array_output_serializer_free(&ao);
+	mux->moov_out = NULL;
+
+	moov_output_write_to(&mo, s);
+	info("Full moov size: %" PRIu64 " KiB (%zu KiB buffered)",
+	     (mo.buf.bytes.num + mo.deferred_bytes) / 1024,
+	     mo.buf.bytes.num / 1024);
+
+	moov_output_free(&mo);
 
 	/* ---------------------------------------- */
 	/* Overwrite file header (ftyp + free/moov) */
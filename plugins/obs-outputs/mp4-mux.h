@@ -31,6 +31,27 @@ enum mp4_mux_flags {
 	MP4_SKIP_FINALISATION = 1 << 2,
 	/* Use negative CTS instead of edit lists */
 	MP4_USE_NEGATIVE_CTS = 1 << 3,
+	/* Move sample tables to temporary files instead of keeping them in
+	 * memory until finalisation */
+	MP4_SPILL_SAMPLE_TABLES = 1 << 4,
+	/* Assemble and write fragments on a background thread so that
+	 * submitting packets does not block on fragment flushes, unless the
+	 * writer falls behind by more than a few seconds of packets */
+	MP4_ASYNC_FRAGMENTS = 1 << 5,
+};
+
+/* Callbacks for writing the initialisation segment (ftyp + moov) and each
+ * fragment (moof + mdat) to separate serializers instead of a single file. */
+struct mp4_mux_segment_callbacks {
+	void *param;
+
+	/* Returns serializer for the initialisation segment, called once */
+	struct serializer *(*init_segment)(void *param);
+	/* Returns serializer for the next fragment, independent fragments
+	 * start with a video keyframe */
+	struct serializer *(*fragment_start)(void *param, bool independent);
+	/* Called once a fragment has been written completely */
+	void (*fragment_end)(void *param, int64_t duration_usec);
 };
 
 struct mp4_mux *mp4_mux_create(obs_output_t *output,
@@ -38,6 +59,15 @@ struct mp4_mux *mp4_mux_create(obs_output_t *output,
 			       enum mp4_mux_flags flags);
 void mp4_mux_destroy(struct mp4_mux *mux);
 bool mp4_mux_submit_packet(struct mp4_mux *mux, struct encoder_packet *pkt);
+/* Same as above, but takes over the caller's reference to the packet */
+bool mp4_mux_submit_packet_owned(struct mp4_mux *mux,
+				 struct encoder_packet *pkt);
 bool mp4_mux_add_chapter(struct mp4_mux *mux, int64_t dts_usec,
 			 const char *name);
 bool mp4_mux_finalise(struct mp4_mux *mux);
+/* Switches the muxer to segmented output, must be called before the first
+ * packet is submitted. If part_duration_usec is non-zero fragments are also
+ * cut between keyframes once they reach that duration. */
+void mp4_mux_set_segment_callbacks(struct mp4_mux *mux,
+				   const struct mp4_mux_segment_callbacks *cb,
+				   int64_t part_duration_usec);
@@ -56,6 +56,7 @@ struct mp4_output {
 
 	struct mp4_mux *muxer;
 	int flags;
+	int io_flags;
 
 	int64_t last_dts_usec;
 	DARRAY(struct chapter) chapters;
@@ -146,6 +147,10 @@ static void mp4_output_destory(void *data)
 		bfree(out->chapters.array[i].name);
 	da_free(out->chapters);
 
+	for (size_t i = 0; i < out->split_buffer.num; i++)
+		obs_encoder_packet_release(&out->split_buffer.array[i]);
+	da_free(out->split_buffer);
+
 	pthread_mutex_destroy(&out->mutex);
 	dstr_free(&out->path);
 	bfree(out);
@@ -219,9 +224,10 @@ static inline void apply_flag(int *flags, const char *value, int flag_value)
 		*flags &= ~flag_value;
 }
 
-static int parse_custom_options(const char *opts_str)
+static int parse_custom_options(const char *opts_str, int *io_flags)
 {
-	int flags = MP4_USE_NEGATIVE_CTS;
+	int flags = MP4_USE_NEGATIVE_CTS | MP4_ASYNC_FRAGMENTS;
+	*io_flags = 0;
 
 	struct obs_options opts = obs_parse_options(opts_str);
 
@@ -236,6 +242,15 @@ static int parse_custom_options(const char *opts_str)
 			apply_flag(&flags, opt.value, MP4_USE_MDTA_KEY_VALUE);
 		} else if (strcmp(opt.name, "use_negative_cts") == 0) {
 			apply_flag(&flags, opt.value, MP4_USE_NEGATIVE_CTS);
+		} else if (strcmp(opt.name, "spill_sample_tables") == 0) {
+			apply_flag(&flags, opt.value, MP4_SPILL_SAMPLE_TABLES);
+		} else if (strcmp(opt.name, "async_fragments") == 0) {
+			apply_flag(&flags, opt.value, MP4_ASYNC_FRAGMENTS);
+		} else if (strcmp(opt.name, "io_uring") == 0) {
+			apply_flag(io_flags, opt.value, BUFFERED_FILE_IO_URING);
+		} else if (strcmp(opt.name, "direct_io") == 0) {
+			apply_flag(io_flags, opt.value,
+				   BUFFERED_FILE_DIRECT_IO);
 		} else {
 			blog(LOG_WARNING, "Unknown muxer option: %s = %s",
 			     opt.name, opt.value);
@@ -272,12 +287,12 @@ static bool mp4_output_start(void *data)
 	/* Allow skipping the remux step for debugging purposes. */
 	const char *muxer_settings =
 		obs_data_get_string(settings, "muxer_settings");
-	out->flags = parse_custom_options(muxer_settings);
+	out->flags = parse_custom_options(muxer_settings, &out->io_flags);
 
 	obs_data_release(settings);
 
-	if (!buffered_file_serializer_init_defaults(&out->serializer,
-						    out->path.array)) {
+	if (!buffered_file_serializer_init_ex(&out->serializer, out->path.array,
+					      0, 0, out->io_flags)) {
 		warn("Unable to open MP4 file '%s'", out->path.array);
 		return false;
 	}
@@ -406,8 +421,8 @@ static bool change_file(struct mp4_output *out, struct encoder_packet *pkt)
 	generate_filename(out, &out->path, out->allow_overwrite);
 	info("Changing output file to '%s'", out->path.array);
 
-	if (!buffered_file_serializer_init_defaults(&out->serializer,
-						    out->path.array)) {
+	if (!buffered_file_serializer_init_ex(&out->serializer, out->path.array,
+					      0, 0, out->io_flags)) {
 		warn("Unable to open MP4 file '%s'", out->path.array);
 		return false;
 	}
@@ -485,13 +500,15 @@ static void push_back_packet(struct mp4_output *out,
 	da_push_back(out->split_buffer, &pkt);
 }
 
+/* If owned is set the muxer takes over the packet reference */
 static inline bool submit_packet(struct mp4_output *out,
-				 struct encoder_packet *pkt)
+				 struct encoder_packet *pkt, bool owned)
 {
 	out->total_bytes += pkt->size;
 
 	if (!out->split_file_enabled)
-		return mp4_mux_submit_packet(out->muxer, pkt);
+		return owned ? mp4_mux_submit_packet_owned(out->muxer, pkt)
+			     : mp4_mux_submit_packet(out->muxer, pkt);
 
 	out->cur_size += pkt->size;
 
@@ -506,7 +523,8 @@ static inline bool submit_packet(struct mp4_output *out,
 		modified.pts -= out->audio_dts_offsets[modified.track_idx];
 	}
 
-	return mp4_mux_submit_packet(out->muxer, &modified);
+	return owned ? mp4_mux_submit_packet_owned(out->muxer, &modified)
+		     : mp4_mux_submit_packet(out->muxer, &modified);
 }
 
 static void mp4_output_packet(void *data, struct encoder_packet *packet)
@@ -561,11 +579,11 @@ static void mp4_output_packet(void *data, struct encoder_packet *packet)
 			struct encoder_packet *pkt =
 				&out->split_buffer.array[i];
 			ts_offset_update(out, pkt);
-			submit_packet(out, pkt);
-			obs_encoder_packet_release(pkt);
+			submit_packet(out, pkt, true);
 		}
 
-		da_free(out->split_buffer);
+		/* Keep allocation around for the next split */
+		da_clear(out->split_buffer);
 		out->split_file_ready = false;
 		os_atomic_set_bool(&out->manual_split, false);
 	}
@@ -577,7 +595,7 @@ static void mp4_output_packet(void *data, struct encoder_packet *packet)
 	if (packet->type == OBS_ENCODER_VIDEO && packet->track_idx == 0)
 		out->last_dts_usec = packet->dts_usec - out->start_time;
 
-	submit_packet(out, packet);
+	submit_packet(out, packet, false);
 
 	if (serializer_get_pos(&out->serializer) == -1)
 		mp4_output_actual_stop(out, OBS_OUTPUT_ERROR);
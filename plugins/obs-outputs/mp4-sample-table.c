@@ -0,0 +1,255 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "mp4-sample-table.h"
+
+#include <stdlib.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+
+/* Amount of encoded data kept in memory before moving it to disk */
+#define SPILL_THRESHOLD (1024 * 1024)
+#define READ_BUFFER_SIZE (64 * 1024)
+
+static FILE *open_spill_file(void)
+{
+#ifdef _WIN32
+	/* tmpfile() on Windows creates files in the root directory, which
+	 * usually is not writable. */
+	char *name = _tempnam(NULL, "obs-mp4-");
+	if (!name)
+		return NULL;
+
+	/* T = temporary (avoid flushing to disk), D = delete on close */
+	FILE *file = fopen(name, "w+bTD");
+	free(name);
+	return file;
+#else
+	return tmpfile();
+#endif
+}
+
+void mp4_sample_table_init(struct mp4_sample_table *table, bool spill)
+{
+	memset(table, 0, sizeof(*table));
+	table->spill_threshold = spill ? SPILL_THRESHOLD : 0;
+}
+
+void mp4_sample_table_free(struct mp4_sample_table *table)
+{
+	if (table->spill_file)
+		fclose(table->spill_file);
+
+	da_free(table->data);
+	memset(table, 0, sizeof(*table));
+}
+
+static void spill(struct mp4_sample_table *table)
+{
+	if (!table->spill_file) {
+		table->spill_file = open_spill_file();
+		if (!table->spill_file) {
+			blog(LOG_WARNING, "[mp4 muxer] Failed to create "
+					  "temporary file for sample table, "
+					  "keeping it in memory");
+			table->spill_failed = true;
+			return;
+		}
+	}
+
+	size_t written = fwrite(table->data.array, 1, table->data.num,
+				table->spill_file);
+	if (written != table->data.num) {
+		blog(LOG_WARNING, "[mp4 muxer] Failed to write sample table "
+				  "to temporary file, keeping it in memory");
+
+		/* Anything past spilled_bytes is ignored when reading */
+		os_fseeki64(table->spill_file, (int64_t)table->spilled_bytes,
+			    SEEK_SET);
+		table->spill_failed = true;
+		return;
+	}
+
+	table->spilled_bytes += written;
+	da_clear(table->data);
+}
+
+void mp4_sample_table_push(struct mp4_sample_table *table, uint32_t val)
+{
+	/* Zigzag encoding maps small negative deltas to small numbers */
+	int32_t delta = (int32_t)(val - table->last);
+	uint32_t zz = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+
+	uint8_t bytes[5];
+	size_t len = 0;
+
+	while (zz >= 0x80) {
+		bytes[len++] = (uint8_t)(zz | 0x80);
+		zz >>= 7;
+	}
+	bytes[len++] = (uint8_t)zz;
+
+	da_push_back_array(table->data, bytes, len);
+
+	table->last = val;
+	table->count++;
+
+	if (table->spill_threshold && !table->spill_failed &&
+	    table->data.num >= table->spill_threshold)
+		spill(table);
+}
+
+void mp4_sample_table_reader_init(struct mp4_sample_table_reader *reader,
+				  struct mp4_sample_table *table)
+{
+	memset(reader, 0, sizeof(*reader));
+	reader->table = table;
+
+	if (table->spilled_bytes) {
+		reader->buf = bmalloc(READ_BUFFER_SIZE);
+		os_fseeki64(table->spill_file, 0, SEEK_SET);
+	}
+}
+
+void mp4_sample_table_reader_free(struct mp4_sample_table_reader *reader)
+{
+	struct mp4_sample_table *table = reader->table;
+
+	/* Restore write position in case more data gets spilled later */
+	if (table->spill_file)
+		os_fseeki64(table->spill_file, (int64_t)table->spilled_bytes,
+			    SEEK_SET);
+
+	bfree(reader->buf);
+	reader->buf = NULL;
+}
+
+static inline bool read_byte(struct mp4_sample_table_reader *reader,
+			     uint8_t *byte)
+{
+	struct mp4_sample_table *table = reader->table;
+
+	if (reader->buf_pos == reader->buf_len &&
+	    reader->file_pos < table->spilled_bytes) {
+		size_t size = READ_BUFFER_SIZE;
+		if (table->spilled_bytes - reader->file_pos < size)
+			size = (size_t)(table->spilled_bytes -
+					reader->file_pos);
+
+		reader->buf_len =
+			fread(reader->buf, 1, size, table->spill_file);
+		reader->buf_pos = 0;
+		reader->file_pos += reader->buf_len;
+
+		if (reader->buf_len != size) {
+			blog(LOG_ERROR, "[mp4 muxer] Failed to read sample "
+					"table from temporary file");
+			reader->file_pos = table->spilled_bytes;
+		}
+	}
+
+	if (reader->buf_pos < reader->buf_len) {
+		*byte = reader->buf[reader->buf_pos++];
+		return true;
+	}
+
+	if (reader->mem_pos < table->data.num) {
+		*byte = table->data.array[reader->mem_pos++];
+		return true;
+	}
+
+	return false;
+}
+
+bool mp4_sample_table_read(struct mp4_sample_table_reader *reader,
+			   uint32_t *val)
+{
+	uint32_t zz = 0;
+	uint8_t byte;
+
+	for (unsigned shift = 0; shift < 35; shift += 7) {
+		if (!read_byte(reader, &byte))
+			return false;
+
+		zz |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			break;
+	}
+
+	int32_t delta = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+	reader->last += (uint32_t)delta;
+	*val = reader->last;
+	return true;
+}
+
+static inline uint8_t *put_wb32(uint8_t *dst, uint32_t val)
+{
+	dst[0] = (uint8_t)(val >> 24);
+	dst[1] = (uint8_t)(val >> 16);
+	dst[2] = (uint8_t)(val >> 8);
+	dst[3] = (uint8_t)val;
+	return dst + 4;
+}
+
+void mp4_sample_table_write(struct mp4_sample_table *table,
+			    struct serializer *s,
+			    enum mp4_table_entries entries, uint32_t timescale,
+			    uint32_t timebase_den)
+{
+	struct mp4_sample_table_reader reader;
+	mp4_sample_table_reader_init(&reader, table);
+
+	/* Batch entries to avoid per-byte serializer calls */
+	uint8_t buf[8192];
+	uint8_t *ptr = buf;
+	uint8_t *end = buf + sizeof(buf);
+
+	uint32_t val;
+	while (mp4_sample_table_read(&reader, &val)) {
+		if (entries != MP4_TABLE_VALUES) {
+			uint32_t count = val;
+			if (!mp4_sample_table_read(&reader, &val))
+				break;
+
+			ptr = put_wb32(ptr, count); // sample_count
+
+			if (entries == MP4_TABLE_DELTAS) {
+				val = (uint32_t)util_mul_div64(val, timescale,
+							       timebase_den);
+			} else {
+				val = (uint32_t)((int64_t)(int32_t)val *
+						 (int64_t)timescale /
+						 (int64_t)timebase_den);
+			}
+		}
+
+		ptr = put_wb32(ptr, val);
+
+		if (end - ptr < 8) {
+			s_write(s, buf, ptr - buf);
+			ptr = buf;
+		}
+	}
+
+	if (ptr != buf)
+		s_write(s, buf, ptr - buf);
+
+	mp4_sample_table_reader_free(&reader);
+}
@@ -0,0 +1,97 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+#include <util/c99defs.h>
+#include <util/darray.h>
+#include <util/serializer.h>
+
+/*
+ * Append-only table of 32-bit values used for the per-sample data of the
+ * final moov (sample sizes, sync samples, run-length coded stts/ctts).
+ *
+ * Values are stored as zigzag varint encoded deltas to the previous value,
+ * which brings most entries down to one or two bytes. If spilling is enabled
+ * the encoded data is moved to a temporary file once the in-memory part
+ * exceeds a threshold, bounding memory use for arbitrarily long recordings.
+ */
+struct mp4_sample_table {
+	DARRAY(uint8_t) data;
+	uint64_t count;
+	uint32_t last;
+
+	size_t spill_threshold;
+	FILE *spill_file;
+	uint64_t spilled_bytes;
+	bool spill_failed;
+};
+
+struct mp4_sample_table_reader {
+	struct mp4_sample_table *table;
+	uint32_t last;
+
+	uint64_t file_pos;
+	size_t mem_pos;
+
+	uint8_t *buf;
+	size_t buf_pos;
+	size_t buf_len;
+};
+
+/* A zeroed table is valid and never spills */
+void mp4_sample_table_init(struct mp4_sample_table *table, bool spill);
+void mp4_sample_table_free(struct mp4_sample_table *table);
+void mp4_sample_table_push(struct mp4_sample_table *table, uint32_t val);
+
+static inline uint64_t
+mp4_sample_table_count(const struct mp4_sample_table *table)
+{
+	return table->count;
+}
+
+static inline size_t
+mp4_sample_table_mem_size(const struct mp4_sample_table *table)
+{
+	return table->data.capacity;
+}
+
+/* Only one reader may be active per table, and the table must not be
+ * modified while it is. */
+void mp4_sample_table_reader_init(struct mp4_sample_table_reader *reader,
+				  struct mp4_sample_table *table);
+bool mp4_sample_table_read(struct mp4_sample_table_reader *reader,
+			   uint32_t *val);
+void mp4_sample_table_reader_free(struct mp4_sample_table_reader *reader);
+
+enum mp4_table_entries {
+	/* One u32 per entry (stsz, stss) */
+	MP4_TABLE_VALUES,
+	/* (count, delta) pairs (stts) */
+	MP4_TABLE_DELTAS,
+	/* (count, offset) pairs with signed offsets (ctts) */
+	MP4_TABLE_OFFSETS,
+};
+
+/* Writes the entries of the box the table belongs to as big endian u32s.
+ * Deltas and offsets are converted from 1/timebase_den to the timescale. */
+void mp4_sample_table_write(struct mp4_sample_table *table,
+			    struct serializer *s,
+			    enum mp4_table_entries entries, uint32_t timescale,
+			    uint32_t timebase_den);
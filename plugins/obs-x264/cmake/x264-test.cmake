@@ -9,3 +9,15 @@ target_link_libraries(obs-x264-test PRIVATE OBS::opts-parser)
 add_test(NAME obs-x264-test COMMAND obs-x264-test)
 
 set_target_properties(obs-x264-test PROPERTIES FOLDER plugins/obs-x264)
+
+option(ENABLE_TEST_BENCHMARKS "Build benchmark variants of the unit tests (not run by ctest)" OFF)
+
+if(ENABLE_TEST_BENCHMARKS)
+  add_executable(obs-x264-benchmark)
+
+  target_sources(obs-x264-benchmark PRIVATE obs-x264-benchmark.c obs-x264-threading.c)
+
+  target_link_libraries(obs-x264-benchmark PRIVATE Libx264::Libx264)
+
+  set_target_properties(obs-x264-benchmark PROPERTIES FOLDER plugins/obs-x264)
+endif()
@@ -0,0 +1,166 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "obs-x264-threading.h"
+
+/* Encodes synthetic 720p30 content with each threading profile as it would
+ * be set up for several core counts, and prints the speed along with the
+ * pipeline latency, estimated and measured */
+
+#define WIDTH 1280
+#define HEIGHT 720
+#define FPS 30
+#define FRAMES 300
+
+static const int core_counts[] = {1, 2, 4, 8, 16};
+
+static const enum obs_x264_threading profiles[] = {
+	OBS_X264_THREADING_AUTO,
+	OBS_X264_THREADING_THROUGHPUT,
+	OBS_X264_THREADING_LATENCY,
+};
+
+static inline double get_time(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+/* A gradient scrolling past a moving block of noise, which gives motion
+ * search and rate control something to do */
+static void fill_frame(x264_picture_t *pic, int frame)
+{
+	uint8_t *y = pic->img.plane[0];
+	uint32_t seed = (uint32_t)frame * 2654435761u;
+	int block_x = (frame * 7) % (WIDTH - 256);
+	int block_y = (frame * 3) % (HEIGHT - 256);
+
+	for (int row = 0; row < HEIGHT; row++) {
+		uint8_t *line = y + row * pic->img.i_stride[0];
+
+		for (int col = 0; col < WIDTH; col++)
+			line[col] = (uint8_t)(col + row + frame * 4);
+	}
+
+	for (int row = block_y; row < block_y + 256; row++) {
+		uint8_t *line = y + row * pic->img.i_stride[0];
+
+		for (int col = block_x; col < block_x + 256; col++) {
+			seed = seed * 1664525u + 1013904223u;
+			line[col] = (uint8_t)(seed >> 24);
+		}
+	}
+
+	for (int plane = 1; plane < 3; plane++) {
+		for (int row = 0; row < HEIGHT / 2; row++) {
+			uint8_t *line = pic->img.plane[plane] +
+					row * pic->img.i_stride[plane];
+			memset(line, 128 + (row + frame) % 32 - 16, WIDTH / 2);
+		}
+	}
+}
+
+static void run(enum obs_x264_threading threading, int cores)
+{
+	x264_param_t params;
+	x264_param_t actual;
+	x264_picture_t pic, pic_out;
+	x264_nal_t *nals;
+	int nal_count;
+	int frames_in = 0;
+	int latency = -1;
+	double start;
+
+	x264_param_default_preset(&params, "veryfast", NULL);
+	params.i_width = WIDTH;
+	params.i_height = HEIGHT;
+	params.i_fps_num = FPS;
+	params.i_fps_den = 1;
+	params.i_timebase_num = 1;
+	params.i_timebase_den = FPS;
+	params.i_csp = X264_CSP_I420;
+	params.b_vfr_input = 0;
+	params.rc.i_rc_method = X264_RC_ABR;
+	params.rc.i_bitrate = 4000;
+	params.rc.i_vbv_max_bitrate = 4000;
+	params.rc.i_vbv_buffer_size = 4000;
+	params.i_log_level = X264_LOG_ERROR;
+
+	obs_x264_apply_threading(&params, threading, cores);
+
+	x264_t *context = x264_encoder_open(&params);
+	if (!context) {
+		fprintf(stderr, "failed to open encoder\n");
+		exit(1);
+	}
+
+	x264_encoder_parameters(context, &actual);
+	x264_picture_alloc(&pic, X264_CSP_I420, WIDTH, HEIGHT);
+
+	start = get_time();
+
+	for (int i = 0; i < FRAMES; i++) {
+		fill_frame(&pic, i);
+		pic.i_pts = i;
+
+		if (x264_encoder_encode(context, &nals, &nal_count, &pic,
+					&pic_out) < 0) {
+			fprintf(stderr, "encode failed\n");
+			exit(1);
+		}
+
+		frames_in++;
+		if (nal_count && latency < 0)
+			latency = frames_in - 1;
+	}
+
+	while (x264_encoder_delayed_frames(context)) {
+		if (x264_encoder_encode(context, &nals, &nal_count, NULL,
+					&pic_out) < 0)
+			break;
+	}
+
+	double elapsed = get_time() - start;
+
+	printf("%-10s %5d %7d %-5s %9.1f %9d %9d\n",
+	       obs_x264_threading_name(threading), cores, actual.i_threads,
+	       actual.b_sliced_threads ? "slice" : "frame",
+	       (double)FRAMES / elapsed, obs_x264_pipeline_latency(&actual),
+	       latency);
+
+	x264_picture_clean(&pic);
+	x264_encoder_close(context);
+}
+
+int main(void)
+{
+	printf("%-10s %5s %7s %-5s %9s %9s %9s\n", "profile", "cores",
+	       "threads", "type", "fps", "estimated", "measured");
+
+	for (size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++) {
+		for (size_t c = 0;
+		     c < sizeof(core_counts) / sizeof(core_counts[0]); c++)
+			run(profiles[p], core_counts[c]);
+	}
+
+	return 0;
+}
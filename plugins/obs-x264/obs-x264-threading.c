@@ -0,0 +1,113 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+#include "obs-x264-threading.h"
+
+/* Past this many slices per frame, the bits spent at slice boundaries cost
+ * more quality than the extra threads make up for */
+#define MAX_SLICE_THREADS 8
+
+/* Frame threads stop paying off well before the x264 limit, while each one
+ * still adds a frame of delay */
+#define MAX_FRAME_THREADS 16
+
+static const char *const threading_names[] = {"auto", "throughput", "latency"};
+
+enum obs_x264_threading obs_x264_threading_from_name(const char *name)
+{
+	for (int i = 0; name && i < 3; i++) {
+		if (strcmp(name, threading_names[i]) == 0)
+			return (enum obs_x264_threading)i;
+	}
+
+	return OBS_X264_THREADING_AUTO;
+}
+
+const char *obs_x264_threading_name(enum obs_x264_threading threading)
+{
+	return threading_names[threading];
+}
+
+static inline int clamp_threads(int threads, int max)
+{
+	if (threads > max)
+		threads = max;
+	return threads < 1 ? 1 : threads;
+}
+
+void obs_x264_apply_threading(x264_param_t *params,
+			      enum obs_x264_threading threading, int cores)
+{
+	int mb_rows = (params->i_height + 15) / 16;
+	int threads;
+
+	if (cores < 1)
+		cores = 1;
+
+	switch (threading) {
+	case OBS_X264_THREADING_THROUGHPUT:
+		/* One and a half frame threads per core keeps every core busy
+		 * while frames wait on the rows they reference.  A frame
+		 * thread needs a few rows to itself to get anywhere before it
+		 * has to wait. */
+		threads = clamp_threads(cores + cores / 2, MAX_FRAME_THREADS);
+		threads = clamp_threads(threads, mb_rows / 4);
+
+		params->b_sliced_threads = 0;
+		params->i_threads = threads;
+		params->i_lookahead_threads =
+			clamp_threads(threads / 6, threads);
+		params->i_sync_lookahead = X264_SYNC_LOOKAHEAD_AUTO;
+		break;
+
+	case OBS_X264_THREADING_LATENCY:
+		/* Slices of the same frame are encoded at the same time, so no
+		 * frame waits on another.  Lookahead past the B-frames would
+		 * only hold frames back, and the lookahead runs on the slice
+		 * threads, not threads of its own. */
+		threads = clamp_threads(cores, MAX_SLICE_THREADS);
+		threads = clamp_threads(threads, mb_rows);
+
+		params->b_sliced_threads = 1;
+		params->i_threads = threads;
+		params->i_lookahead_threads = 1;
+		params->i_sync_lookahead = 0;
+		if (params->rc.i_lookahead > params->i_bframe)
+			params->rc.i_lookahead = params->i_bframe;
+		break;
+
+	case OBS_X264_THREADING_AUTO:
+		break;
+	}
+}
+
+int obs_x264_pipeline_latency(const x264_param_t *params)
+{
+	int frame_threads = params->b_sliced_threads ? 1 : params->i_threads;
+	int delay = params->i_bframe;
+
+	/* Same as the delay x264 sets itself up with when it opens */
+	if ((params->rc.b_mb_tree || params->rc.i_vbv_buffer_size) &&
+	    params->rc.i_lookahead > delay)
+		delay = params->rc.i_lookahead;
+
+	delay += frame_threads - 1;
+	delay += params->i_sync_lookahead;
+	delay += params->b_vfr_input;
+	return delay;
+}
@@ -0,0 +1,57 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef _STDINT_H_INCLUDED
+#define _STDINT_H_INCLUDED
+#endif
+
+#include <x264.h>
+
+/*
+ * Threading profiles, which set the slice threads, frame threads and
+ * lookahead threads of x264 together for the cores there are:
+ *
+ * - Throughput uses frame threads, which scale best but each add a frame
+ *   of delay, and keeps the lookahead of the preset.
+ * - Latency uses slice threads, which split up every frame and add no
+ *   delay, and cuts the lookahead down to what the B-frames need.
+ *
+ * Auto leaves threading to x264 and the preset.
+ */
+
+enum obs_x264_threading {
+	OBS_X264_THREADING_AUTO,
+	OBS_X264_THREADING_THROUGHPUT,
+	OBS_X264_THREADING_LATENCY,
+};
+
+extern enum obs_x264_threading obs_x264_threading_from_name(const char *name);
+extern const char *obs_x264_threading_name(enum obs_x264_threading threading);
+
+/* Applies a threading profile to params whose preset, size and rate control
+ * are already set */
+extern void obs_x264_apply_threading(x264_param_t *params,
+				     enum obs_x264_threading threading,
+				     int cores);
+
+/* Frames x264 holds before it outputs the first packet, for the params of
+ * an open encoder as returned by x264_encoder_parameters() */
+extern int obs_x264_pipeline_latency(const x264_param_t *params);
@@ -24,11 +24,7 @@
 #include <obs-module.h>
 #include <opts-parser.h>
 
-#ifndef _STDINT_H_INCLUDED
-#define _STDINT_H_INCLUDED
-#endif
-
-#include <x264.h>
+#include "obs-x264-threading.h"
 
 #define do_log_enc(level, encoder, format, ...)     \
 	blog(level, "[x264 encoder: '%s'] " format, \
@@ -64,6 +60,11 @@ struct obs_x264 {
 
 	uint32_t roi_increment;
 	float *quant_offsets;
+
+	/* Frames in before the first packet out, once it is out */
+	int pipeline_latency;
+	int frames_in;
+	bool latency_measured;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -115,6 +116,7 @@ static void obs_x264_defaults(obs_data_t *settings)
 	obs_data_set_default_string(settings, "preset", "veryfast");
 	obs_data_set_default_string(settings, "profile", "");
 	obs_data_set_default_string(settings, "tune", "");
+	obs_data_set_default_string(settings, "threading", "auto");
 	obs_data_set_default_string(settings, "x264opts", "");
 	obs_data_set_default_bool(settings, "repeat_headers", false);
 }
@@ -138,6 +140,10 @@ static inline void add_strings(obs_property_t *list, const char *const *strings)
 #define TEXT_PROFILE obs_module_text("Profile")
 #define TEXT_TUNE obs_module_text("Tune")
 #define TEXT_NONE obs_module_text("None")
+#define TEXT_THREADING obs_module_text("Threading")
+#define TEXT_THREADING_AUTO obs_module_text("Threading.Auto")
+#define TEXT_THREADING_THROUGHPUT obs_module_text("Threading.Throughput")
+#define TEXT_THREADING_LATENCY obs_module_text("Threading.Latency")
 #define TEXT_X264_OPTS obs_module_text("EncoderOptions")
 
 static bool use_bufsize_modified(obs_properties_t *ppts, obs_property_t *p,
@@ -225,6 +231,14 @@ static obs_properties_t *obs_x264_props(void *unused)
 	obs_property_list_add_string(list, TEXT_NONE, "");
 	add_strings(list, x264_tune_names);
 
+	list = obs_properties_add_list(props, "threading", TEXT_THREADING,
+				       OBS_COMBO_TYPE_LIST,
+				       OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(list, TEXT_THREADING_AUTO, "auto");
+	obs_property_list_add_string(list, TEXT_THREADING_THROUGHPUT,
+				     "throughput");
+	obs_property_list_add_string(list, TEXT_THREADING_LATENCY, "latency");
+
 #ifdef ENABLE_VFR
 	obs_properties_add_bool(props, "vfr", TEXT_VFR);
 #endif
@@ -408,6 +422,8 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 	int bf = (int)obs_data_get_int(settings, "bf");
 	bool use_bufsize = obs_data_get_bool(settings, "use_bufsize");
 	bool cbr_override = obs_data_get_bool(settings, "cbr");
+	enum obs_x264_threading threading = obs_x264_threading_from_name(
+		obs_data_get_string(settings, "threading"));
 	enum rate_control rc;
 
 #ifdef ENABLE_VFR
@@ -531,6 +547,12 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 	else
 		obsx264->params.i_csp = X264_CSP_NV12;
 
+	/* Threads are fixed once the encoder is open, and the x264 options
+	 * still override the profile */
+	if (!obsx264->context)
+		obs_x264_apply_threading(&obsx264->params, threading,
+					 os_get_logical_cores());
+
 	for (size_t i = 0; i < options->ignored_word_count; ++i)
 		warn("ignoring invalid x264 option: %s",
 		     options->ignored_words[i]);
@@ -547,11 +569,13 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 		     "\tfps_den:      %d\n"
 		     "\twidth:        %d\n"
 		     "\theight:       %d\n"
-		     "\tkeyint:       %d\n",
+		     "\tkeyint:       %d\n"
+		     "\tthreading:    %s\n",
 		     rate_control, obsx264->params.rc.i_vbv_max_bitrate,
 		     obsx264->params.rc.i_vbv_buffer_size,
 		     (int)obsx264->params.rc.f_rf_constant, voi->fps_num,
-		     voi->fps_den, width, height, obsx264->params.i_keyint_max);
+		     voi->fps_den, width, height, obsx264->params.i_keyint_max,
+		     obs_x264_threading_name(threading));
 	}
 }
 
@@ -682,6 +706,45 @@ static void load_headers(struct obs_x264 *obsx264)
 	obsx264->sei_size = sei.num;
 }
 
+static void report_pipeline_latency(struct obs_x264 *obsx264)
+{
+	x264_param_t params;
+
+	/* The open encoder has the threads and lookahead x264 settled on */
+	x264_encoder_parameters(obsx264->context, &params);
+	obsx264->pipeline_latency = obs_x264_pipeline_latency(&params);
+
+	info("threads: %d %s, %d lookahead, pipeline latency: %d frames",
+	     params.i_threads, params.b_sliced_threads ? "slice" : "frame",
+	     params.i_lookahead_threads, obsx264->pipeline_latency);
+
+	obs_encoder_set_pipeline_latency(obsx264->encoder,
+					 (uint32_t)obsx264->pipeline_latency);
+}
+
+/* The frames held back before the first packet are the latency as it really
+ * is, which is what gets reported from then on */
+static void measure_pipeline_latency(struct obs_x264 *obsx264,
+				     bool received_packet)
+{
+	if (obsx264->latency_measured)
+		return;
+
+	obsx264->frames_in++;
+	if (!received_packet)
+		return;
+
+	obsx264->latency_measured = true;
+	if (obsx264->frames_in - 1 == obsx264->pipeline_latency)
+		return;
+
+	obsx264->pipeline_latency = obsx264->frames_in - 1;
+	info("measured pipeline latency: %d frames",
+	     obsx264->pipeline_latency);
+	obs_encoder_set_pipeline_latency(obsx264->encoder,
+					 (uint32_t)obsx264->pipeline_latency);
+}
+
 static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 {
 	video_t *video = obs_encoder_video(encoder);
@@ -716,10 +779,12 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 	if (update_settings(obsx264, settings, false)) {
 		obsx264->context = x264_encoder_open(&obsx264->params);
 
-		if (obsx264->context == NULL)
+		if (obsx264->context == NULL) {
 			warn("x264 failed to load");
-		else
+		} else {
 			load_headers(obsx264);
+			report_pipeline_latency(obsx264);
+		}
 	} else {
 		warn("bad settings specified");
 	}
@@ -867,6 +932,7 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 
 	*received_packet = (nal_count != 0);
 	parse_packet(obsx264, packet, nals, nal_count, &pic_out);
+	measure_pipeline_latency(obsx264, *received_packet);
 
 	return true;
 }
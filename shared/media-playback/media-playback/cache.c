@@ -14,8 +14,17 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <sys/stat.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
 #include <media-io/audio-io.h>
 #include <util/platform.h>
+#include <util/dstr.h>
 
 #include "media-playback.h"
 #include "cache.h"
@@ -32,8 +41,166 @@ static bool mp_cache_reset(mp_cache_t *c);
 
 static int64_t base_sys_ts = 0;
 
-#define v_eof(c) (c->cur_v_idx == c->video_frames.num)
-#define a_eof(c) (c->cur_a_idx == c->audio_segments.num)
+/* ------------------------------------------------------------------------- */
+/* Decoded media is shared by every cache that plays the same file with the
+ * same options, so that a file shown by several sources is only decoded and
+ * held in memory once.  The first cache decodes it on its thread, and the
+ * others wait for that to finish. */
+
+struct mp_cache_data {
+	char *key;
+	long refs;
+
+	os_event_t *decoded;
+	bool success;
+
+	bool has_video;
+	bool has_audio;
+	int64_t media_duration;
+	int64_t start_time;
+
+	DARRAY(struct obs_source_frame) video_frames;
+	DARRAY(struct obs_source_audio) audio_segments;
+
+	int64_t final_v_duration;
+	int64_t final_a_duration;
+};
+
+static pthread_mutex_t shared_data_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct mp_cache_data *) shared_data = {0};
+
+/* Gets the size and modification time of a file, the latter at the finest
+ * resolution the platform has so that a file written again within the same
+ * second gets a different key */
+static bool get_file_version(const char *path, int64_t *size, int64_t *mtime)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	wchar_t *w_path = NULL;
+	bool success;
+
+	os_utf8_to_wcs_ptr(path, 0, &w_path);
+	success = w_path &&
+		  GetFileAttributesExW(w_path, GetFileExInfoStandard, &attr);
+	bfree(w_path);
+
+	if (!success)
+		return false;
+
+	*size = ((int64_t)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+	/* In 100 ns units, which is fine as it's only compared */
+	*mtime = ((int64_t)attr.ftLastWriteTime.dwHighDateTime << 32) |
+		 attr.ftLastWriteTime.dwLowDateTime;
+	return true;
+#else
+	struct stat st;
+
+	if (os_stat(path, &st) != 0)
+		return false;
+
+	*size = (int64_t)st.st_size;
+#ifdef __APPLE__
+	*mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000LL +
+		 st.st_mtimespec.tv_nsec;
+#else
+	*mtime = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+	return true;
+#endif
+}
+
+/* Files that can't be looked up get a key of NULL, and aren't shared */
+static char *make_data_key(const struct mp_media_info *info)
+{
+	struct dstr key = {0};
+	int64_t size;
+	int64_t mtime;
+
+	if (!info->path || !get_file_version(info->path, &size, &mtime))
+		return NULL;
+
+	dstr_printf(&key, "%s|%lld|%lld|%s|%s|%d|%d|%d|%d", info->path,
+		    (long long)mtime, (long long)size,
+		    info->format ? info->format : "",
+		    info->ffmpeg_options ? info->ffmpeg_options : "",
+		    info->speed, (int)info->force_range,
+		    (int)info->is_linear_alpha, (int)info->hardware_decoding);
+	return key.array;
+}
+
+/* Call with shared_data_mutex held */
+static struct mp_cache_data *find_data(const char *key)
+{
+	if (!key)
+		return NULL;
+
+	for (size_t i = 0; i < shared_data.num; i++) {
+		struct mp_cache_data *data = shared_data.array[i];
+		if (strcmp(data->key, key) == 0)
+			return data;
+	}
+
+	return NULL;
+}
+
+static struct mp_cache_data *acquire_data(const char *key)
+{
+	struct mp_cache_data *data;
+
+	pthread_mutex_lock(&shared_data_mutex);
+	data = find_data(key);
+	if (data)
+		data->refs++;
+	pthread_mutex_unlock(&shared_data_mutex);
+
+	return data;
+}
+
+/* Stops new caches from using data that failed to decode */
+static void unshare_data(struct mp_cache_data *data)
+{
+	pthread_mutex_lock(&shared_data_mutex);
+	da_erase_item(shared_data, &data);
+	pthread_mutex_unlock(&shared_data_mutex);
+}
+
+static void release_data(struct mp_cache_data *data)
+{
+	if (!data)
+		return;
+
+	pthread_mutex_lock(&shared_data_mutex);
+	bool last = --data->refs == 0;
+	if (last) {
+		da_erase_item(shared_data, &data);
+		if (!shared_data.num)
+			da_free(shared_data);
+	}
+	pthread_mutex_unlock(&shared_data_mutex);
+
+	if (!last)
+		return;
+
+	for (size_t i = 0; i < data->video_frames.num; i++) {
+		struct obs_source_frame *f = &data->video_frames.array[i];
+		obs_source_frame_free(f);
+	}
+	for (size_t i = 0; i < data->audio_segments.num; i++) {
+		struct obs_source_audio *a = &data->audio_segments.array[i];
+		bfree((void *)a->data[0]);
+	}
+	da_free(data->video_frames);
+	da_free(data->audio_segments);
+
+	os_event_destroy(data->decoded);
+	bfree(data->key);
+	bfree(data);
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define v_eof(c) (c->cur_v_idx == c->data->video_frames.num)
+#define a_eof(c) (c->cur_a_idx == c->data->audio_segments.num)
 
 static inline int64_t mp_cache_get_next_min_pts(mp_cache_t *c)
 {
@@ -132,15 +299,49 @@ bool mp_cache_decode(mp_cache_t *c)
 
 	success = true;
 
-	c->start_time = c->m.fmt->start_time;
-	if (c->start_time == AV_NOPTS_VALUE)
-		c->start_time = 0;
+	c->data->start_time = c->m.fmt->start_time;
+	if (c->data->start_time == AV_NOPTS_VALUE)
+		c->data->start_time = 0;
 
 fail:
 	mp_media_free(m);
 	return success;
 }
 
+#define DATA_WAIT_MS 100
+
+static bool mp_cache_killed(mp_cache_t *c)
+{
+	pthread_mutex_lock(&c->mutex);
+	bool kill = c->kill;
+	pthread_mutex_unlock(&c->mutex);
+
+	return kill;
+}
+
+/* Returns false if the data failed to decode, or if the cache was killed
+ * while waiting on another cache to decode it */
+static bool mp_cache_wait_for_data(mp_cache_t *c)
+{
+	struct mp_cache_data *data = c->data;
+
+	if (c->decodes) {
+		data->success = mp_cache_decode(c);
+		if (!data->success)
+			unshare_data(data);
+		os_event_signal(data->decoded);
+	} else {
+		while (os_event_timedwait(data->decoded, DATA_WAIT_MS) ==
+		       ETIMEDOUT) {
+			if (mp_cache_killed(c))
+				return false;
+		}
+	}
+
+	c->start_time = data->start_time;
+	return data->success;
+}
+
 static void seek_to(mp_cache_t *c, int64_t pos)
 {
 	size_t new_v_idx = 0;
@@ -154,8 +355,8 @@ static void seek_to(mp_cache_t *c, int64_t pos)
 	if (c->has_video) {
 		struct obs_source_frame *v;
 
-		for (size_t i = 0; i < c->video_frames.num; i++) {
-			v = &c->video_frames.array[i];
+		for (size_t i = 0; i < c->data->video_frames.num; i++) {
+			v = &c->data->video_frames.array[i];
 			new_v_idx = i;
 			if ((int64_t)v->timestamp >= pos) {
 				break;
@@ -163,19 +364,19 @@ static void seek_to(mp_cache_t *c, int64_t pos)
 		}
 
 		size_t next_idx = new_v_idx + 1;
-		if (next_idx == c->video_frames.num) {
-			c->next_v_ts =
-				(int64_t)v->timestamp + c->final_v_duration;
+		if (next_idx == c->data->video_frames.num) {
+			c->next_v_ts = (int64_t)v->timestamp +
+				       c->data->final_v_duration;
 		} else {
 			struct obs_source_frame *next =
-				&c->video_frames.array[next_idx];
+				&c->data->video_frames.array[next_idx];
 			c->next_v_ts = (int64_t)next->timestamp;
 		}
 	}
 	if (c->has_audio) {
 		struct obs_source_audio *a;
-		for (size_t i = 0; i < c->audio_segments.num; i++) {
-			a = &c->audio_segments.array[i];
+		for (size_t i = 0; i < c->data->audio_segments.num; i++) {
+			a = &c->data->audio_segments.array[i];
 			new_a_idx = i;
 			if ((int64_t)a->timestamp >= pos) {
 				break;
@@ -183,12 +384,12 @@ static void seek_to(mp_cache_t *c, int64_t pos)
 		}
 
 		size_t next_idx = new_a_idx + 1;
-		if (next_idx == c->audio_segments.num) {
-			c->next_a_ts =
-				(int64_t)a->timestamp + c->final_a_duration;
+		if (next_idx == c->data->audio_segments.num) {
+			c->next_a_ts = (int64_t)a->timestamp +
+				       c->data->final_a_duration;
 		} else {
 			struct obs_source_audio *next =
-				&c->audio_segments.array[next_idx];
+				&c->data->audio_segments.array[next_idx];
 			c->next_a_ts = (int64_t)next->timestamp;
 		}
 	}
@@ -215,12 +416,12 @@ static inline bool mp_media_can_play_audio(mp_cache_t *c)
 static inline void calc_next_v_ts(mp_cache_t *c, struct obs_source_frame *frame)
 {
 	int64_t offset;
-	if (c->next_v_idx < c->video_frames.num) {
+	if (c->next_v_idx < c->data->video_frames.num) {
 		struct obs_source_frame *next =
-			&c->video_frames.array[c->next_v_idx];
+			&c->data->video_frames.array[c->next_v_idx];
 		offset = (int64_t)(next->timestamp - frame->timestamp);
 	} else {
-		offset = c->final_v_duration;
+		offset = c->data->final_v_duration;
 	}
 
 	c->next_v_ts += offset;
@@ -229,12 +430,12 @@ static inline void calc_next_v_ts(mp_cache_t *c, struct obs_source_frame *frame)
 static inline void calc_next_a_ts(mp_cache_t *c, struct obs_source_audio *audio)
 {
 	int64_t offset;
-	if (c->next_a_idx < c->audio_segments.num) {
+	if (c->next_a_idx < c->data->audio_segments.num) {
 		struct obs_source_audio *next =
-			&c->audio_segments.array[c->next_a_idx];
+			&c->data->audio_segments.array[c->next_a_idx];
 		offset = (int64_t)(next->timestamp - audio->timestamp);
 	} else {
-		offset = c->final_a_duration;
+		offset = c->data->final_a_duration;
 	}
 
 	c->next_a_ts += offset;
@@ -243,13 +444,14 @@ static inline void calc_next_a_ts(mp_cache_t *c, struct obs_source_audio *audio)
 static void mp_cache_next_video(mp_cache_t *c, bool preload)
 {
 	/* eof check */
-	if (c->next_v_idx == c->video_frames.num) {
+	if (c->next_v_idx == c->data->video_frames.num) {
 		if (mp_media_can_play_video(c))
 			c->cur_v_idx = c->next_v_idx;
 		return;
 	}
 
-	struct obs_source_frame *frame = &c->video_frames.array[c->next_v_idx];
+	struct obs_source_frame *frame =
+		&c->data->video_frames.array[c->next_v_idx];
 	struct obs_source_frame dup = *frame;
 
 	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
@@ -278,7 +480,7 @@ static void mp_cache_next_video(mp_cache_t *c, bool preload)
 static void mp_cache_next_audio(mp_cache_t *c)
 {
 	/* eof check */
-	if (c->next_a_idx == c->audio_segments.num) {
+	if (c->next_a_idx == c->data->audio_segments.num) {
 		if (mp_media_can_play_audio(c))
 			c->cur_a_idx = c->next_a_idx;
 		return;
@@ -288,7 +490,7 @@ static void mp_cache_next_audio(mp_cache_t *c)
 		return;
 
 	struct obs_source_audio *audio =
-		&c->audio_segments.array[c->next_a_idx];
+		&c->data->audio_segments.array[c->next_a_idx];
 	struct obs_source_audio dup = *audio;
 
 	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
@@ -324,14 +526,14 @@ static bool mp_cache_reset(mp_cache_t *c)
 	pthread_mutex_unlock(&c->mutex);
 
 	if (c->has_video) {
-		size_t next_idx = c->video_frames.num > 1 ? 1 : 0;
+		size_t next_idx = c->data->video_frames.num > 1 ? 1 : 0;
 		c->cur_v_idx = c->next_v_idx = 0;
-		c->next_v_ts = c->video_frames.array[next_idx].timestamp;
+		c->next_v_ts = c->data->video_frames.array[next_idx].timestamp;
 	}
 	if (c->has_audio) {
-		size_t next_idx = c->audio_segments.num > 1 ? 1 : 0;
+		size_t next_idx = c->data->audio_segments.num > 1 ? 1 : 0;
 		c->cur_a_idx = c->next_a_idx = 0;
-		c->next_a_ts = c->audio_segments.array[next_idx].timestamp;
+		c->next_a_ts = c->data->audio_segments.array[next_idx].timestamp;
 	}
 
 	if (active) {
@@ -381,8 +583,9 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 {
 	os_set_thread_name("mp_cache_thread");
 
-	if (!mp_cache_decode(c)) {
-		return false;
+	/* Being killed isn't a failure to report through stop_cb */
+	if (!mp_cache_wait_for_data(c)) {
+		return mp_cache_killed(c);
 	}
 
 	for (;;) {
@@ -446,7 +649,8 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 			continue;
 
 		if (preload_frame)
-			c->v_preload_cb(c->opaque, &c->video_frames.array[0]);
+			c->v_preload_cb(c->opaque,
+					&c->data->video_frames.array[0]);
 
 		/* frames are ready */
 		if (is_active && !timeout) {
@@ -488,9 +692,9 @@ static void fill_video(void *data, struct obs_source_frame *frame)
 
 	dup.timestamp = frame->timestamp;
 
-	c->final_v_duration = c->m.v.last_duration;
+	c->data->final_v_duration = c->m.v.last_duration;
 
-	da_push_back(c->video_frames, &dup);
+	da_push_back(c->data->video_frames, &dup);
 }
 
 static void fill_audio(void *data, struct obs_source_audio *audio)
@@ -518,9 +722,9 @@ static void fill_audio(void *data, struct obs_source_audio *audio)
 		memcpy((uint8_t *)dup.data[0], audio->data[0], size);
 	}
 
-	c->final_a_duration = c->m.a.last_duration;
+	c->data->final_a_duration = c->m.a.last_duration;
 
-	da_push_back(c->audio_segments, &dup);
+	da_push_back(c->data->audio_segments, &dup);
 }
 
 static inline bool mp_cache_init_internal(mp_cache_t *c,
@@ -547,9 +751,14 @@ static inline bool mp_cache_init_internal(mp_cache_t *c,
 	return true;
 }
 
-bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
+/* Opens the file to find out what it has, and sets up data to decode it
+ * into.  If another cache started on the same file in the meantime, its
+ * data is used instead. */
+static bool mp_cache_open(mp_cache_t *c, const struct mp_media_info *info,
+			  char *key)
 {
 	struct mp_media_info info2 = *info;
+	struct mp_cache_data *data;
 
 	info2.opaque = c;
 	info2.v_cb = fill_video;
@@ -561,13 +770,57 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 
 	mp_media_t *m = &c->m;
 
-	pthread_mutex_init_value(&c->mutex);
-
 	if (!mp_media_init(m, &info2)) {
-		mp_cache_free(c);
+		bfree(key);
 		return false;
 	}
 	if (!mp_media_init2(m)) {
+		bfree(key);
+		return false;
+	}
+
+	data = bzalloc(sizeof(*data));
+	data->key = key;
+	data->refs = 1;
+	data->has_video = m->has_video;
+	data->has_audio = m->has_audio;
+	data->media_duration = m->fmt->duration;
+
+	if (os_event_init(&data->decoded, OS_EVENT_TYPE_MANUAL) != 0) {
+		release_data(data);
+		return false;
+	}
+
+	pthread_mutex_lock(&shared_data_mutex);
+	c->data = find_data(key);
+	if (c->data) {
+		c->data->refs++;
+	} else {
+		c->data = data;
+		c->decodes = true;
+		if (key)
+			da_push_back(shared_data, &data);
+	}
+	pthread_mutex_unlock(&shared_data_mutex);
+
+	if (!c->decodes) {
+		mp_media_free(m);
+		release_data(data);
+	}
+
+	return true;
+}
+
+bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
+{
+	char *key = make_data_key(info);
+
+	pthread_mutex_init_value(&c->mutex);
+
+	c->data = acquire_data(key);
+	if (c->data) {
+		bfree(key);
+	} else if (!mp_cache_open(c, info, key)) {
 		mp_cache_free(c);
 		return false;
 	}
@@ -581,10 +834,10 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 	c->v_preload_cb = info->v_preload_cb;
 	c->request_preload = info->request_preload;
 	c->speed = info->speed;
-	c->media_duration = m->fmt->duration;
+	c->media_duration = c->data->media_duration;
 
-	c->has_video = m->has_video;
-	c->has_audio = m->has_audio;
+	c->has_video = c->data->has_video;
+	c->has_audio = c->data->has_audio;
 
 	if (!base_sys_ts)
 		base_sys_ts = (int64_t)os_gettime_ns();
@@ -620,16 +873,13 @@ void mp_cache_free(mp_cache_t *c)
 	if (c->m.fmt)
 		mp_media_free(&c->m);
 
-	for (size_t i = 0; i < c->video_frames.num; i++) {
-		struct obs_source_frame *f = &c->video_frames.array[i];
-		obs_source_frame_free(f);
+	/* Nothing is going to decode the data, so others shouldn't wait */
+	if (c->decodes && !c->thread_valid) {
+		unshare_data(c->data);
+		os_event_signal(c->data->decoded);
 	}
-	for (size_t i = 0; i < c->audio_segments.num; i++) {
-		struct obs_source_audio *a = &c->audio_segments.array[i];
-		bfree((void *)a->data[0]);
-	}
-	da_free(c->video_frames);
-	da_free(c->audio_segments);
+
+	release_data(c->data);
 
 	bfree(c->path);
 	bfree(c->format_name);
@@ -707,7 +957,7 @@ void mp_cache_seek(mp_cache_t *c, int64_t pos)
 
 int64_t mp_cache_get_frames(mp_cache_t *c)
 {
-	return c->video_frames.num;
+	return c->data->video_frames.num;
 }
 
 int64_t mp_cache_get_duration(mp_cache_t *c)
@@ -51,8 +51,10 @@ struct mp_cache {
 	bool thread_valid;
 	pthread_t thread;
 
-	DARRAY(struct obs_source_frame) video_frames;
-	DARRAY(struct obs_source_audio) audio_segments;
+	/* Decoded media, which this cache decodes into if it is the first to
+	 * play the file */
+	struct mp_cache_data *data;
+	bool decodes;
 
 	size_t cur_v_idx;
 	size_t cur_a_idx;
@@ -61,9 +63,6 @@ struct mp_cache {
 	int64_t next_v_ts;
 	int64_t next_a_ts;
 
-	int64_t final_v_duration;
-	int64_t final_a_duration;
-
 	int64_t play_sys_ts;
 	int64_t next_pts_ns;
 	uint64_t next_ns;
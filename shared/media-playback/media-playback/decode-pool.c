@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2026 OBS Studio contributors
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <util/platform.h>
+#include <util/darray.h>
+
+#include "decode-pool.h"
+
+/* Serializes starting and stopping the threads, which happens outside of
+ * pool_mutex as the threads take it themselves */
+static pthread_mutex_t join_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(pthread_t) threads = {0};
+static os_sem_t *work_sem = NULL;
+static volatile bool stopping = false;
+static size_t joined = 0;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct mp_decode_slot *) waiting = {0};
+
+/* Call with pool_mutex held */
+static struct mp_decode_slot *next_waiting(void)
+{
+	struct mp_decode_slot *next = NULL;
+	size_t idx = 0;
+
+	for (size_t i = 0; i < waiting.num; i++) {
+		struct mp_decode_slot *slot = waiting.array[i];
+		long priority = os_atomic_load_long(&slot->priority);
+
+		if (!next || priority > os_atomic_load_long(&next->priority)) {
+			next = slot;
+			idx = i;
+		}
+	}
+
+	if (next)
+		da_erase(waiting, idx);
+	return next;
+}
+
+static void update_stats(struct mp_decode_slot *slot, uint64_t end)
+{
+	struct mp_decode_stats *stats = &slot->stats;
+	uint64_t wait = slot->decode_start - slot->wait_start;
+	uint64_t latency = end - slot->wait_start;
+
+	pthread_mutex_lock(&slot->stats_mutex);
+	stats->frames++;
+	slot->total_wait += wait;
+	slot->total_latency += latency;
+	if (latency > stats->max_latency_ns)
+		stats->max_latency_ns = latency;
+	pthread_mutex_unlock(&slot->stats_mutex);
+}
+
+static void *decode_thread(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	os_set_thread_name("mp_decode_pool");
+
+	while (os_sem_wait(work_sem) == 0) {
+		struct mp_decode_slot *slot;
+		bool got_frame = false;
+
+		if (os_atomic_load_bool(&stopping))
+			break;
+
+		pthread_mutex_lock(&pool_mutex);
+		slot = next_waiting();
+		pthread_mutex_unlock(&pool_mutex);
+
+		if (!slot)
+			continue;
+
+		slot->decode_start = os_gettime_ns();
+		slot->result = slot->job(slot->param, &got_frame);
+		if (got_frame)
+			update_stats(slot, os_gettime_ns());
+
+		os_sem_post(slot->sem);
+	}
+
+	return NULL;
+}
+
+/* Call with join_mutex held */
+static void stop_threads(void)
+{
+	os_atomic_set_bool(&stopping, true);
+	for (size_t i = 0; i < threads.num; i++)
+		os_sem_post(work_sem);
+	for (size_t i = 0; i < threads.num; i++)
+		pthread_join(threads.array[i], NULL);
+	os_atomic_set_bool(&stopping, false);
+
+	da_free(threads);
+	da_free(waiting);
+	os_sem_destroy(work_sem);
+	work_sem = NULL;
+}
+
+/* Call with join_mutex held */
+static bool start_threads(void)
+{
+	int count = os_get_logical_cores();
+
+	if (os_sem_init(&work_sem, 0) != 0)
+		return false;
+
+	for (int i = 0; i < (count < 1 ? 1 : count); i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, decode_thread, NULL) != 0)
+			break;
+		da_push_back(threads, &thread);
+	}
+
+	if (!threads.num) {
+		stop_threads();
+		return false;
+	}
+
+	return true;
+}
+
+bool mp_decode_pool_join(struct mp_decode_slot *slot)
+{
+	bool success;
+
+	memset(slot, 0, sizeof(*slot));
+
+	if (os_sem_init(&slot->sem, 0) != 0)
+		return false;
+
+	pthread_mutex_init_value(&slot->stats_mutex);
+	if (pthread_mutex_init(&slot->stats_mutex, NULL) != 0) {
+		os_sem_destroy(slot->sem);
+		return false;
+	}
+
+	pthread_mutex_lock(&join_mutex);
+	success = joined || start_threads();
+	if (success)
+		joined++;
+	pthread_mutex_unlock(&join_mutex);
+
+	if (!success) {
+		pthread_mutex_destroy(&slot->stats_mutex);
+		os_sem_destroy(slot->sem);
+		return false;
+	}
+
+	slot->joined = true;
+	return true;
+}
+
+void mp_decode_pool_leave(struct mp_decode_slot *slot)
+{
+	if (!slot->joined)
+		return;
+
+	/* every job of the slot has been waited for, so nothing is left of
+	 * it in the queue */
+	pthread_mutex_lock(&join_mutex);
+	if (--joined == 0)
+		stop_threads();
+	pthread_mutex_unlock(&join_mutex);
+
+	pthread_mutex_destroy(&slot->stats_mutex);
+	os_sem_destroy(slot->sem);
+	slot->joined = false;
+}
+
+bool mp_decode_pool_run(struct mp_decode_slot *slot, mp_decode_job_t job,
+			void *param)
+{
+	if (!slot->joined) {
+		bool got_frame;
+		return job(param, &got_frame);
+	}
+
+	slot->job = job;
+	slot->param = param;
+	slot->wait_start = os_gettime_ns();
+
+	pthread_mutex_lock(&pool_mutex);
+	da_push_back(waiting, &slot);
+	pthread_mutex_unlock(&pool_mutex);
+
+	os_sem_post(work_sem);
+	os_sem_wait(slot->sem);
+
+	return slot->result;
+}
+
+void mp_decode_pool_get_stats(struct mp_decode_slot *slot,
+			      struct mp_decode_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	if (!slot->joined)
+		return;
+
+	pthread_mutex_lock(&slot->stats_mutex);
+	*stats = slot->stats;
+	if (stats->frames) {
+		stats->avg_wait_ns = slot->total_wait / stats->frames;
+		stats->avg_latency_ns = slot->total_latency / stats->frames;
+	}
+	pthread_mutex_unlock(&slot->stats_mutex);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2026 OBS Studio contributors
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "media-playback.h"
+
+#include <util/threading.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pool of decode threads shared by all media in the process.
+ *
+ * There is one thread per logical core.  A media thread hands the decoding
+ * of each video frame to the pool and waits for it, so no more frames are
+ * decoded at once than there are cores however many media are playing.
+ * Waiting decodes go to media with high priority first, and in the order
+ * they were handed over otherwise.  The threads are started when the first
+ * media joins the pool, and stopped when the last one leaves.
+ *
+ * Decoders keep the frame and slice threads libavcodec gives them, as it
+ * can't run those on threads of ours.
+ */
+
+enum mp_decode_priority {
+	MP_DECODE_PRIORITY_LOW,
+	MP_DECODE_PRIORITY_HIGH,
+};
+
+/* Returns false on failure, and sets got_frame if a frame was decoded */
+typedef bool (*mp_decode_job_t)(void *param, bool *got_frame);
+
+struct mp_decode_slot {
+	os_sem_t *sem;
+	volatile long priority;
+	bool joined;
+
+	mp_decode_job_t job;
+	void *param;
+	bool result;
+
+	pthread_mutex_t stats_mutex;
+	struct mp_decode_stats stats;
+	uint64_t total_wait;
+	uint64_t total_latency;
+	uint64_t wait_start;
+	uint64_t decode_start;
+};
+
+extern bool mp_decode_pool_join(struct mp_decode_slot *slot);
+extern void mp_decode_pool_leave(struct mp_decode_slot *slot);
+
+/* Runs job on a thread of the pool, and returns its result once it's done */
+extern bool mp_decode_pool_run(struct mp_decode_slot *slot,
+			       mp_decode_job_t job, void *param);
+
+static inline void mp_decode_pool_set_priority(struct mp_decode_slot *slot,
+					       enum mp_decode_priority priority)
+{
+	os_atomic_set_long(&slot->priority, (long)priority);
+}
+
+extern void mp_decode_pool_get_stats(struct mp_decode_slot *slot,
+				     struct mp_decode_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
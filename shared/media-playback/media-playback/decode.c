@@ -343,17 +343,12 @@ static int decode_packet(struct mp_decode *d, int *got_frame)
 	return ret;
 }
 
-bool mp_decode_next(struct mp_decode *d)
+static bool decode_next(struct mp_decode *d)
 {
 	bool eof = d->m->eof;
 	int got_frame;
 	int ret;
 
-	d->frame_ready = false;
-
-	if (!eof && !d->packets.size)
-		return true;
-
 	while (!d->frame_ready) {
 		if (!d->packet_pending) {
 			if (!d->packets.size) {
@@ -442,6 +437,29 @@ bool mp_decode_next(struct mp_decode *d)
 	return true;
 }
 
+static bool decode_job(void *param, bool *got_frame)
+{
+	struct mp_decode *d = param;
+	bool success = decode_next(d);
+
+	*got_frame = d->frame_ready;
+	return success;
+}
+
+bool mp_decode_next(struct mp_decode *d)
+{
+	d->frame_ready = false;
+
+	if (!d->m->eof && !d->packets.size)
+		return true;
+
+	/* hardware decoders and audio don't take up cores worth sharing */
+	if (d->audio || d->hw)
+		return decode_next(d);
+
+	return mp_decode_pool_run(&d->m->decode_slot, decode_job, d);
+}
+
 void mp_decode_flush(struct mp_decode *d)
 {
 	avcodec_flush_buffers(d->decoder);
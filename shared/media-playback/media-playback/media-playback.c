@@ -175,3 +175,23 @@ bool media_playback_has_audio(media_playback_t *mp)
 	else
 		return mp->media.has_audio;
 }
+
+void media_playback_set_visible(media_playback_t *mp, bool visible)
+{
+	/* cached media is decoded up front, at low priority */
+	if (!mp || mp->is_cached)
+		return;
+
+	mp_media_set_visible(&mp->media, visible);
+}
+
+void media_playback_get_decode_stats(media_playback_t *mp,
+				     struct mp_decode_stats *stats)
+{
+	if (!mp || mp->is_cached) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	mp_media_get_decode_stats(&mp->media, stats);
+}
@@ -48,6 +48,15 @@ struct mp_media_info {
 	bool full_decode;
 };
 
+/* Times are in nanoseconds.  Latency is from when a video frame is asked
+ * for to when it has been decoded, including the wait for a decode thread. */
+struct mp_decode_stats {
+	uint64_t frames;
+	uint64_t avg_wait_ns;
+	uint64_t avg_latency_ns;
+	uint64_t max_latency_ns;
+};
+
 extern media_playback_t *
 media_playback_create(const struct mp_media_info *info);
 extern void media_playback_destroy(media_playback_t *mp);
@@ -66,3 +75,6 @@ extern int64_t media_playback_get_frames(media_playback_t *mp);
 extern int64_t media_playback_get_duration(media_playback_t *mp);
 extern bool media_playback_has_video(media_playback_t *mp);
 extern bool media_playback_has_audio(media_playback_t *mp);
+extern void media_playback_set_visible(media_playback_t *mp, bool visible);
+extern void media_playback_get_decode_stats(media_playback_t *mp,
+					    struct mp_decode_stats *stats);
@@ -20,6 +20,7 @@
 
 #include "media-playback.h"
 #include "media.h"
+#include "seek-ahead.h"
 #include "closest-format.h"
 
 #include <libavdevice/avdevice.h>
@@ -534,6 +535,57 @@ static void mp_media_calc_next_ns(mp_media_t *m)
 	m->next_pts_ns = min_next_ns;
 }
 
+/* Shows the frame at pos if the seek thread has already decoded it */
+static inline bool seek_ahead_output(mp_media_t *m, int64_t pos)
+{
+	mp_seek_ahead_t *sa;
+
+	pthread_mutex_lock(&m->mutex);
+	sa = m->seek_ahead;
+	pthread_mutex_unlock(&m->mutex);
+
+	return sa && m->v_seek_cb &&
+	       mp_seek_ahead_output(sa, pos, m->v_seek_cb, m->opaque);
+}
+
+static void seek_ahead_ready(void *param, int64_t pos)
+{
+	mp_media_t *m = param;
+
+	pthread_mutex_lock(&m->mutex);
+	m->seek_ahead_ready = true;
+	m->seek_ahead_ready_pos = pos;
+	pthread_mutex_unlock(&m->mutex);
+
+	os_sem_post(m->sem);
+}
+
+/* The seek thread opens the file a second time, and reads all of it when
+ * the container has no index, so it is only started on the first paused
+ * seek.  Call with mutex held. */
+static mp_seek_ahead_t *get_seek_ahead(mp_media_t *m)
+{
+	if (m->seek_ahead || m->seek_ahead_failed)
+		return m->seek_ahead;
+	if (!m->is_local_file || !m->v_seek_cb || m->full_decode)
+		return NULL;
+
+	struct mp_media_info info = {
+		.path = m->path,
+		.format = m->format_name,
+		.ffmpeg_options = m->ffmpeg_options,
+		.buffering = m->buffering,
+		.speed = m->speed,
+		.force_range = m->force_range,
+		.is_linear_alpha = m->is_linear_alpha,
+		.is_local_file = m->is_local_file,
+	};
+
+	m->seek_ahead = mp_seek_ahead_create(&info, seek_ahead_ready, m);
+	m->seek_ahead_failed = !m->seek_ahead;
+	return m->seek_ahead;
+}
+
 static void seek_to(mp_media_t *m, int64_t pos)
 {
 	AVStream *stream = m->fmt->streams[0];
@@ -560,9 +612,12 @@ static void seek_to(mp_media_t *m, int64_t pos)
 
 	if (m->has_video && m->is_local_file) {
 		mp_decode_flush(&m->v);
-		if (m->seek_next_ts && m->pause && m->v_preload_cb &&
-		    mp_media_prepare_frames(m))
-			mp_media_next_video(m, true);
+		if (m->seek_next_ts && m->pause && m->v_preload_cb) {
+			m->seek_ahead_pos = pos;
+			if (!seek_ahead_output(m, pos) &&
+			    mp_media_prepare_frames(m))
+				mp_media_next_video(m, true);
+		}
 	}
 	if (m->has_audio && m->is_local_file)
 		mp_decode_flush(&m->a);
@@ -777,8 +832,8 @@ static inline bool mp_media_thread(mp_media_t *m)
 
 	for (;;) {
 		bool reset, kill, is_active, seek, pause, reset_time,
-			preload_frame;
-		int64_t seek_pos;
+			preload_frame, seek_ready, visible;
+		int64_t seek_pos, seek_ready_pos;
 		bool timeout = false;
 
 		pthread_mutex_lock(&m->mutex);
@@ -807,12 +862,23 @@ static inline bool mp_media_thread(mp_media_t *m)
 		seek_pos = m->seek_pos;
 		seek = m->seek;
 		reset_time = m->reset_ts;
+		visible = m->visible;
+		seek_ready = m->seek_ahead_ready;
+		seek_ready_pos = m->seek_ahead_ready_pos;
 		m->preload_frame = false;
 		m->seek = false;
 		m->reset_ts = false;
+		m->seek_ahead_ready = false;
 
 		pthread_mutex_unlock(&m->mutex);
 
+		/* frames of hidden and preloading media are decoded when
+		 * no visible media is waiting to decode */
+		mp_decode_pool_set_priority(&m->decode_slot,
+					    visible && is_active
+						    ? MP_DECODE_PRIORITY_HIGH
+						    : MP_DECODE_PRIORITY_LOW);
+
 		if (kill) {
 			break;
 		}
@@ -832,6 +898,11 @@ static inline bool mp_media_thread(mp_media_t *m)
 			continue;
 		}
 
+		/* the exact frame of the last seek, which replaces the
+		 * keyframe shown while it was being decoded */
+		if (seek_ready && pause && seek_ready_pos == m->seek_ahead_pos)
+			seek_ahead_output(m, seek_ready_pos);
+
 		if (pause)
 			continue;
 
@@ -889,6 +960,11 @@ static inline bool mp_media_init_internal(mp_media_t *m,
 	m->format_name = info->format ? bstrdup(info->format) : NULL;
 	m->hw = info->hardware_decoding;
 
+	if (!mp_decode_pool_join(&m->decode_slot)) {
+		blog(LOG_WARNING, "MP: Failed to join decode pool");
+		return false;
+	}
+
 	if (info->full_decode)
 		return true;
 
@@ -960,8 +1036,10 @@ void mp_media_free(mp_media_t *media)
 
 	mp_media_stop(media);
 	mp_kill_thread(media);
+	mp_seek_ahead_destroy(media->seek_ahead);
 	mp_decode_free(&media->v);
 	mp_decode_free(&media->a);
+	mp_decode_pool_leave(&media->decode_slot);
 	for (size_t i = 0; i < media->packet_pool.num; i++)
 		av_packet_free(&media->packet_pool.array[i]);
 	da_free(media->packet_pool);
@@ -1073,12 +1151,35 @@ int64_t mp_media_get_duration(mp_media_t *m)
 
 void mp_media_seek(mp_media_t *m, int64_t pos)
 {
+	mp_seek_ahead_t *sa = NULL;
+
 	pthread_mutex_lock(&m->mutex);
 	if (m->active) {
 		m->seek = true;
 		m->seek_pos = pos * 1000;
+
+		/* only paused seeks show the exact frame, playback
+		 * carries on from the keyframe */
+		if (m->pause)
+			sa = get_seek_ahead(m);
 	}
 	pthread_mutex_unlock(&m->mutex);
 
+	/* start decoding the frame before the media thread gets to it */
+	if (sa)
+		mp_seek_ahead_request(sa, pos * 1000);
+
 	os_sem_post(m->sem);
 }
+
+void mp_media_set_visible(mp_media_t *m, bool visible)
+{
+	pthread_mutex_lock(&m->mutex);
+	m->visible = visible;
+	pthread_mutex_unlock(&m->mutex);
+}
+
+void mp_media_get_decode_stats(mp_media_t *m, struct mp_decode_stats *stats)
+{
+	mp_decode_pool_get_stats(&m->decode_slot, stats);
+}
@@ -18,6 +18,7 @@
 
 #include <obs.h>
 #include "decode.h"
+#include "decode-pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -98,11 +99,20 @@ struct mp_media {
 	bool thread_valid;
 	pthread_t thread;
 
+	bool visible;
+	struct mp_decode_slot decode_slot;
+
 	bool pause;
 	bool reset_ts;
 	bool seek;
 	bool seek_next_ts;
 	int64_t seek_pos;
+
+	struct mp_seek_ahead *seek_ahead;
+	int64_t seek_ahead_pos;
+	int64_t seek_ahead_ready_pos;
+	bool seek_ahead_ready;
+	bool seek_ahead_failed;
 };
 
 typedef struct mp_media mp_media_t;
@@ -118,6 +128,9 @@ extern int64_t mp_media_get_current_time(mp_media_t *m);
 extern int64_t mp_media_get_frames(mp_media_t *m);
 extern int64_t mp_media_get_duration(mp_media_t *m);
 extern void mp_media_seek(mp_media_t *m, int64_t pos);
+extern void mp_media_set_visible(mp_media_t *m, bool visible);
+extern void mp_media_get_decode_stats(mp_media_t *m,
+				      struct mp_decode_stats *stats);
 
 /* #define DETAILED_DEBUG_INFO */
 
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2026 OBS Studio contributors
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <util/platform.h>
+
+#include "seek-ahead.h"
+#include "media.h"
+
+extern bool mp_media_init2(mp_media_t *m);
+extern bool mp_media_prepare_frames(mp_media_t *m);
+extern void mp_media_next_video(mp_media_t *m, bool preload);
+
+#define MAX_SEEK_FRAMES 8
+
+#define NO_GOP INT64_MIN
+
+struct seek_frame {
+	struct obs_source_frame *frame;
+	int64_t pos;
+	int64_t pts;
+	int64_t duration;
+	uint64_t last_used;
+};
+
+struct mp_seek_ahead {
+	mp_media_t m;
+	struct mp_media_info info;
+	char *path;
+	char *format;
+	char *ffmpeg_options;
+	int speed;
+
+	mp_seek_ready_cb ready_cb;
+	void *param;
+
+	pthread_t thread;
+	bool thread_valid;
+	os_sem_t *sem;
+	volatile bool stop;
+	volatile bool pending;
+
+	pthread_mutex_t mutex;
+	bool has_request;
+	int64_t request;
+	struct seek_frame frames[MAX_SEEK_FRAMES];
+	uint64_t use_count;
+
+	/* Only used by the seek thread.  Keyframes are in the time base of
+	 * the video stream, and are known up to indexed_until. */
+	DARRAY(int64_t) keyframes;
+	int64_t indexed_until;
+	int64_t gop;
+	int64_t cur_pos;
+};
+
+/* Decoded frames are timed in nanoseconds, scaled by the speed */
+static inline int64_t pos_to_pts(const mp_seek_ahead_t *sa, int64_t pos)
+{
+	return pos * 1000 * 100 / sa->speed;
+}
+
+/* Call with mutex held */
+static struct seek_frame *find_frame(mp_seek_ahead_t *sa, int64_t pos)
+{
+	int64_t pts = pos_to_pts(sa, pos);
+
+	for (size_t i = 0; i < MAX_SEEK_FRAMES; i++) {
+		struct seek_frame *f = &sa->frames[i];
+
+		if (!f->frame)
+			continue;
+		if (f->pos == pos)
+			return f;
+		if (pts >= f->pts && pts < f->pts + f->duration)
+			return f;
+	}
+
+	return NULL;
+}
+
+static void store_frame(void *opaque, struct obs_source_frame *frame)
+{
+	mp_seek_ahead_t *sa = opaque;
+	struct seek_frame *slot = NULL;
+	struct obs_source_frame *copy;
+
+	copy = obs_source_frame_create(frame->format, frame->width,
+				       frame->height);
+	obs_source_frame_copy(copy, frame);
+
+	pthread_mutex_lock(&sa->mutex);
+
+	for (size_t i = 0; i < MAX_SEEK_FRAMES; i++) {
+		struct seek_frame *f = &sa->frames[i];
+
+		if (!f->frame) {
+			slot = f;
+			break;
+		}
+		if (!slot || f->last_used < slot->last_used)
+			slot = f;
+	}
+
+	obs_source_frame_destroy(slot->frame);
+	slot->frame = copy;
+	slot->pos = sa->cur_pos;
+	slot->pts = (int64_t)frame->timestamp;
+	slot->duration = sa->m.v.last_duration;
+	slot->last_used = ++sa->use_count;
+
+	pthread_mutex_unlock(&sa->mutex);
+}
+
+static void index_from_container(mp_seek_ahead_t *sa)
+{
+	AVStream *stream = sa->m.v.stream;
+	int count = avformat_index_get_entries_count(stream);
+
+	for (int i = 0; i < count; i++) {
+		const AVIndexEntry *entry = avformat_index_get_entry(stream, i);
+
+		if (entry->flags & AVINDEX_KEYFRAME)
+			da_push_back(sa->keyframes, &entry->timestamp);
+	}
+
+	if (sa->keyframes.num)
+		sa->indexed_until = INT64_MAX;
+}
+
+/* Reads through the file for keyframes without decoding anything.  Stops
+ * early when a seek comes in, leaving the rest of the file unindexed. */
+static void index_from_packets(mp_seek_ahead_t *sa)
+{
+	mp_media_t *m = &sa->m;
+	AVPacket *pkt = av_packet_alloc();
+
+	while (!os_atomic_load_bool(&sa->stop) &&
+	       !os_atomic_load_bool(&sa->pending)) {
+		if (av_read_frame(m->fmt, pkt) < 0) {
+			sa->indexed_until = INT64_MAX;
+			break;
+		}
+
+		if (pkt->stream_index == m->v.stream->index) {
+			int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts
+								: pkt->dts;
+
+			if (ts != AV_NOPTS_VALUE) {
+				if (pkt->flags & AV_PKT_FLAG_KEY)
+					da_push_back(sa->keyframes, &ts);
+				if (ts > sa->indexed_until)
+					sa->indexed_until = ts;
+			}
+		}
+
+		av_packet_unref(pkt);
+	}
+
+	av_packet_free(&pkt);
+}
+
+static int64_t find_gop(mp_seek_ahead_t *sa, int64_t target)
+{
+	int64_t gop = NO_GOP;
+
+	if (target > sa->indexed_until)
+		return NO_GOP;
+
+	for (size_t i = 0; i < sa->keyframes.num; i++) {
+		int64_t keyframe = sa->keyframes.array[i];
+		if (keyframe <= target && keyframe > gop)
+			gop = keyframe;
+	}
+
+	return gop;
+}
+
+static bool has_frame(mp_seek_ahead_t *sa, int64_t pos)
+{
+	struct seek_frame *f;
+
+	pthread_mutex_lock(&sa->mutex);
+	f = find_frame(sa, pos);
+	if (f)
+		f->last_used = ++sa->use_count;
+	pthread_mutex_unlock(&sa->mutex);
+
+	return f != NULL;
+}
+
+static void decode_request(mp_seek_ahead_t *sa, int64_t pos)
+{
+	mp_media_t *m = &sa->m;
+	struct mp_decode *d = &m->v;
+	AVRational time_base = d->stream->time_base;
+	int64_t target = av_rescale_q(pos, AV_TIME_BASE_Q, time_base);
+	int64_t pts = pos_to_pts(sa, pos);
+	int64_t gop = find_gop(sa, target);
+
+	if (has_frame(sa, pos)) {
+		sa->ready_cb(sa->param, pos);
+		return;
+	}
+
+	/* Further along in the GOP being decoded, so carry on from there
+	 * rather than seeking back to its keyframe */
+	if (gop == NO_GOP || gop != sa->gop || d->frame_pts > pts) {
+		int64_t seek_ts = gop != NO_GOP ? gop : target;
+
+		sa->gop = NO_GOP;
+		if (av_seek_frame(m->fmt, d->stream->index, seek_ts,
+				  AVSEEK_FLAG_BACKWARD) < 0)
+			return;
+
+		mp_decode_flush(d);
+		m->eof = false;
+		sa->gop = gop;
+	}
+
+	sa->cur_pos = pos;
+
+	while (!os_atomic_load_bool(&sa->stop) &&
+	       !os_atomic_load_bool(&sa->pending)) {
+		if (!mp_media_prepare_frames(m)) {
+			sa->gop = NO_GOP;
+			return;
+		}
+		if (!d->frame_ready)
+			return;
+
+		if (d->frame_pts + d->last_duration > pts) {
+			mp_media_next_video(m, false);
+			if (has_frame(sa, pos))
+				sa->ready_cb(sa->param, pos);
+			return;
+		}
+
+		d->frame_ready = false;
+	}
+}
+
+static void *seek_thread(void *opaque)
+{
+	mp_seek_ahead_t *sa = opaque;
+	mp_media_t *m = &sa->m;
+
+	os_set_thread_name("mp_seek_thread");
+
+	if (!mp_media_init(m, &sa->info))
+		return NULL;
+	if (!mp_media_init2(m) || !m->has_video)
+		goto finish;
+
+	/* Audio packets are dropped as they're read */
+	m->has_audio = false;
+
+	index_from_container(sa);
+	if (!sa->keyframes.num)
+		index_from_packets(sa);
+
+	while (os_sem_wait(sa->sem) == 0) {
+		bool has_request;
+		int64_t pos;
+
+		if (os_atomic_load_bool(&sa->stop))
+			break;
+
+		pthread_mutex_lock(&sa->mutex);
+		has_request = sa->has_request;
+		pos = sa->request;
+		sa->has_request = false;
+		os_atomic_set_bool(&sa->pending, false);
+		pthread_mutex_unlock(&sa->mutex);
+
+		if (has_request)
+			decode_request(sa, pos);
+	}
+
+finish:
+	mp_media_free(m);
+	return NULL;
+}
+
+mp_seek_ahead_t *mp_seek_ahead_create(const struct mp_media_info *info,
+				      mp_seek_ready_cb ready_cb, void *param)
+{
+	mp_seek_ahead_t *sa = bzalloc(sizeof(*sa));
+
+	sa->path = bstrdup(info->path);
+	sa->format = info->format ? bstrdup(info->format) : NULL;
+	sa->ffmpeg_options =
+		info->ffmpeg_options ? bstrdup(info->ffmpeg_options) : NULL;
+	sa->speed = info->speed < 1 || info->speed > 200 ? 100 : info->speed;
+	sa->ready_cb = ready_cb;
+	sa->param = param;
+	sa->indexed_until = INT64_MIN;
+	sa->gop = NO_GOP;
+
+	sa->info = *info;
+	sa->info.opaque = sa;
+	sa->info.path = sa->path;
+	sa->info.format = sa->format;
+	sa->info.ffmpeg_options = sa->ffmpeg_options;
+	sa->info.v_cb = store_frame;
+	sa->info.v_preload_cb = NULL;
+	sa->info.v_seek_cb = NULL;
+	sa->info.a_cb = NULL;
+	sa->info.stop_cb = NULL;
+	sa->info.hardware_decoding = false;
+	sa->info.request_preload = false;
+	sa->info.full_decode = true;
+
+	pthread_mutex_init_value(&sa->mutex);
+	if (pthread_mutex_init(&sa->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&sa->sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&sa->thread, NULL, seek_thread, sa) != 0)
+		goto fail;
+
+	sa->thread_valid = true;
+	return sa;
+
+fail:
+	blog(LOG_WARNING, "MP: Failed to start seek thread");
+	mp_seek_ahead_destroy(sa);
+	return NULL;
+}
+
+void mp_seek_ahead_destroy(mp_seek_ahead_t *sa)
+{
+	if (!sa)
+		return;
+
+	if (sa->thread_valid) {
+		os_atomic_set_bool(&sa->stop, true);
+		os_sem_post(sa->sem);
+		pthread_join(sa->thread, NULL);
+	}
+
+	for (size_t i = 0; i < MAX_SEEK_FRAMES; i++)
+		obs_source_frame_destroy(sa->frames[i].frame);
+
+	da_free(sa->keyframes);
+	os_sem_destroy(sa->sem);
+	pthread_mutex_destroy(&sa->mutex);
+	bfree(sa->path);
+	bfree(sa->format);
+	bfree(sa->ffmpeg_options);
+	bfree(sa);
+}
+
+void mp_seek_ahead_request(mp_seek_ahead_t *sa, int64_t pos)
+{
+	pthread_mutex_lock(&sa->mutex);
+	sa->request = pos;
+	sa->has_request = true;
+	os_atomic_set_bool(&sa->pending, true);
+	pthread_mutex_unlock(&sa->mutex);
+
+	os_sem_post(sa->sem);
+}
+
+bool mp_seek_ahead_output(mp_seek_ahead_t *sa, int64_t pos, mp_video_cb cb,
+			  void *opaque)
+{
+	struct seek_frame *f;
+
+	pthread_mutex_lock(&sa->mutex);
+	f = find_frame(sa, pos);
+	if (f) {
+		f->last_used = ++sa->use_count;
+		cb(opaque, f->frame);
+	}
+	pthread_mutex_unlock(&sa->mutex);
+
+	return f != NULL;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2026 OBS Studio contributors
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "media-playback.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Decodes the frames that seeks land on ahead of time, on a thread with a
+ * demuxer and decoder of its own.
+ *
+ * Once started, the thread builds an index of the keyframes of the file,
+ * from the index of the container when it has one.  A seek request then
+ * decodes the GOP of the target up to the target frame, carrying on from
+ * where the last request left off when the target is further along in the
+ * same GOP.  The last few frames decoded this way are kept, so seeking back
+ * and forth between them is instant.
+ */
+
+struct mp_seek_ahead;
+typedef struct mp_seek_ahead mp_seek_ahead_t;
+
+/* Called from the seek thread once the frame at pos is ready */
+typedef void (*mp_seek_ready_cb)(void *param, int64_t pos);
+
+extern mp_seek_ahead_t *mp_seek_ahead_create(const struct mp_media_info *info,
+					     mp_seek_ready_cb ready_cb,
+					     void *param);
+extern void mp_seek_ahead_destroy(mp_seek_ahead_t *sa);
+
+/* Starts decoding the frame at pos, in microseconds, replacing any request
+ * that hasn't been started yet */
+extern void mp_seek_ahead_request(mp_seek_ahead_t *sa, int64_t pos);
+
+/* Calls cb with the frame at pos if it has been decoded */
+extern bool mp_seek_ahead_output(mp_seek_ahead_t *sa, int64_t pos,
+				 mp_video_cb cb, void *opaque);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,315 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+
+#define CHANNELS 2
+#define SOURCES 32
+#define BLOCKS 2000
+#define BLOCK_FRAMES 1024
+
+/* Built from the obs-filters sources */
+extern struct obs_source_info gain_filter;
+extern struct obs_source_info noise_gate_filter;
+extern struct obs_source_info eq_filter;
+extern struct obs_source_info expander_filter;
+extern struct obs_source_info upward_compressor_filter;
+extern struct obs_source_info invert_polarity_filter;
+
+/* Every tileable filter, with settings that make each of them change the
+ * signal */
+static const struct {
+	struct obs_source_info *info;
+	const char *settings;
+} chain[] = {
+	{&gain_filter, "{\"db\": -6.0}"},
+	{&noise_gate_filter, NULL},
+	{&eq_filter, "{\"low\": 4.0, \"mid\": -3.0, \"high\": 6.0}"},
+	{&expander_filter, NULL},
+	{&upward_compressor_filter, NULL},
+	{&invert_polarity_filter, NULL},
+};
+
+#define CHAIN_LENGTH (sizeof(chain) / sizeof(chain[0]))
+
+/* Same filters registered without OBS_SOURCE_AUDIO_TILEABLE */
+static char untiled_ids[CHAIN_LENGTH][64];
+
+struct capture_filter {
+	float *data[CHANNELS];
+	size_t frames;
+};
+
+const char *obs_module_text(const char *lookup_string)
+{
+	return lookup_string;
+}
+
+static const char *test_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "test";
+}
+
+static void *test_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void test_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static void *capture_filter_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(source);
+	return bzalloc(sizeof(struct capture_filter));
+}
+
+static void capture_filter_destroy(void *data)
+{
+	struct capture_filter *cf = data;
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(cf->data[c]);
+	bfree(cf);
+}
+
+static struct obs_audio_data *capture_filter_audio(void *data,
+						   struct obs_audio_data *audio)
+{
+	struct capture_filter *cf = data;
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		cf->data[c] = brealloc(cf->data[c],
+				       (cf->frames + audio->frames) *
+					       sizeof(float));
+		memcpy(cf->data[c] + cf->frames, audio->data[c],
+		       audio->frames * sizeof(float));
+	}
+
+	cf->frames += audio->frames;
+	return audio;
+}
+
+static int setup(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	struct obs_audio_info oai = {.samples_per_sec = 48000,
+				     .speakers = SPEAKERS_STEREO};
+	if (!obs_reset_audio(&oai))
+		return -1;
+
+	struct obs_source_info source = {
+		.id = "test_audio_source",
+		.type = OBS_SOURCE_TYPE_INPUT,
+		.output_flags = OBS_SOURCE_AUDIO,
+		.get_name = test_name,
+		.create = test_source_create,
+		.destroy = test_source_destroy,
+	};
+	obs_register_source(&source);
+
+	struct obs_source_info capture = {
+		.id = "test_capture",
+		.type = OBS_SOURCE_TYPE_FILTER,
+		.output_flags = OBS_SOURCE_AUDIO,
+		.get_name = test_name,
+		.create = capture_filter_create,
+		.destroy = capture_filter_destroy,
+		.filter_audio = capture_filter_audio,
+	};
+	obs_register_source(&capture);
+
+	for (size_t i = 0; i < CHAIN_LENGTH; i++) {
+		struct obs_source_info untiled = *chain[i].info;
+
+		if (!(untiled.output_flags & OBS_SOURCE_AUDIO_TILEABLE))
+			return -1;
+
+		snprintf(untiled_ids[i], sizeof(untiled_ids[i]), "%s_untiled",
+			 untiled.id);
+		untiled.id = untiled_ids[i];
+		untiled.output_flags &= ~OBS_SOURCE_AUDIO_TILEABLE;
+
+		obs_register_source(chain[i].info);
+		obs_register_source(&untiled);
+	}
+
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+	obs_shutdown();
+	return 0;
+}
+
+static obs_source_t *create_chain(bool tiled, obs_source_t **capture)
+{
+	obs_source_t *source = obs_source_create_private("test_audio_source",
+							 "source", NULL);
+
+	for (size_t i = 0; i < CHAIN_LENGTH; i++) {
+		const char *id = tiled ? chain[i].info->id : untiled_ids[i];
+		obs_data_t *settings =
+			chain[i].settings
+				? obs_data_create_from_json(chain[i].settings)
+				: NULL;
+
+		obs_source_t *filter =
+			obs_source_create_private(id, "filter", settings);
+		obs_source_filter_add(source, filter);
+		obs_source_release(filter);
+		obs_data_release(settings);
+	}
+
+	if (capture) {
+		*capture = obs_source_create_private("test_capture", "capture",
+						     NULL);
+		obs_source_filter_add(source, *capture);
+	}
+
+	return source;
+}
+
+/* Tones alternating between loud and quiet every half second, so that the
+ * gate, expander and upward compressor move between their states */
+static void fill_block(float *planes[CHANNELS], uint32_t frames,
+		       uint64_t *pos)
+{
+	for (uint32_t i = 0; i < frames; i++, (*pos)++) {
+		float t = (float)*pos / 48000.0f;
+		float env = (*pos / 24000) % 2 ? 0.5f : 0.0005f;
+		planes[0][i] = env * sinf(t * 440.0f * 6.2831853f);
+		planes[1][i] = env * sinf(t * 660.0f * 6.2831853f);
+	}
+}
+
+static void output_block(obs_source_t *source, float *planes[CHANNELS],
+			 uint32_t frames, uint64_t ts)
+{
+	struct obs_source_audio audio = {
+		.frames = frames,
+		.speakers = SPEAKERS_STEREO,
+		.format = AUDIO_FORMAT_FLOAT_PLANAR,
+		.samples_per_sec = 48000,
+		.timestamp = ts,
+	};
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio.data[c] = (const uint8_t *)planes[c];
+
+	obs_source_output_audio(source, &audio);
+}
+
+/* Output of the fused filters has to match running them one after another,
+ * including for blocks that are not a multiple of the tile size. */
+static void fused_chain_bit_identical_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static const uint32_t sizes[] = {1024, 480, 333, 1, 4096, 127};
+	obs_source_t *capture[2];
+	obs_source_t *sources[2] = {create_chain(false, &capture[0]),
+				    create_chain(true, &capture[1])};
+
+	float *planes[CHANNELS];
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bmalloc(4096 * sizeof(float));
+
+	for (size_t s = 0; s < 2; s++) {
+		uint64_t pos = 0;
+		for (size_t b = 0; b < 60; b++) {
+			uint32_t frames = sizes[b % 6];
+			uint64_t ts = util_mul_div64(pos, 1000000000ULL, 48000);
+
+			fill_block(planes, frames, &pos);
+			output_block(sources[s], planes, frames, ts);
+		}
+	}
+
+	struct capture_filter *seq = obs_obj_get_data(capture[0]);
+	struct capture_filter *fused = obs_obj_get_data(capture[1]);
+
+	assert_true(seq->frames > 0);
+	assert_true(seq->frames == fused->frames);
+	for (size_t c = 0; c < CHANNELS; c++)
+		assert_memory_equal(seq->data[c], fused->data[c],
+				    seq->frames * sizeof(float));
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+	for (size_t s = 0; s < 2; s++) {
+		obs_source_release(capture[s]);
+		obs_source_release(sources[s]);
+	}
+}
+
+#ifdef ENABLE_BENCHMARKS
+/* 32 sources with the whole filter chain each, run sequentially and fused */
+static void fused_chain_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	float *planes[CHANNELS];
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bmalloc(BLOCK_FRAMES * sizeof(float));
+
+	for (size_t tiled = 0; tiled < 2; tiled++) {
+		obs_source_t *sources[SOURCES];
+		for (size_t s = 0; s < SOURCES; s++)
+			sources[s] = create_chain(tiled, NULL);
+
+		uint64_t pos = 0;
+		uint64_t elapsed = 0;
+
+		for (size_t b = 0; b < BLOCKS; b++) {
+			uint64_t ts = util_mul_div64(pos, 1000000000ULL, 48000);
+			fill_block(planes, BLOCK_FRAMES, &pos);
+
+			uint64_t start = os_gettime_ns();
+			for (size_t s = 0; s < SOURCES; s++)
+				output_block(sources[s], planes, BLOCK_FRAMES,
+					     ts);
+			elapsed += os_gettime_ns() - start;
+		}
+
+		printf("%d sources x %zu filters (%s): %.2f us per block\n",
+		       SOURCES, CHAIN_LENGTH, tiled ? "fused" : "sequential",
+		       (double)elapsed / 1000.0 / BLOCKS);
+
+		for (size_t s = 0; s < SOURCES; s++)
+			obs_source_release(sources[s]);
+	}
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(fused_chain_bit_identical_test),
+#ifdef ENABLE_BENCHMARKS
+		cmocka_unit_test(fused_chain_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,347 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#include "audio-lanes.h"
+
+#define MAX_CHANNELS 8
+#define MAX_FRAMES 4096
+#define BENCH_BLOCKS 2000
+#define BENCH_FRAMES 1024
+
+static const uint32_t block_sizes[] = {1024, 480, 333, 1, 4096, 127, 4, 7};
+#define NUM_BLOCK_SIZES (sizeof(block_sizes) / sizeof(block_sizes[0]))
+
+struct planes {
+	float *data[MAX_CHANNELS];
+};
+
+static void planes_init(struct planes *p, size_t channels)
+{
+	for (size_t c = 0; c < MAX_CHANNELS; c++)
+		p->data[c] = c < channels ? bmalloc(MAX_FRAMES * sizeof(float))
+					  : NULL;
+}
+
+static void planes_free(struct planes *p)
+{
+	for (size_t c = 0; c < MAX_CHANNELS; c++)
+		bfree(p->data[c]);
+}
+
+static void planes_copy(struct planes *dst, const struct planes *src,
+			size_t channels, uint32_t frames)
+{
+	for (size_t c = 0; c < channels; c++) {
+		if (src->data[c])
+			memcpy(dst->data[c], src->data[c],
+			       frames * sizeof(float));
+	}
+}
+
+/* Different tone and loudness per channel, with bursts so that both attack
+ * and release paths of the envelope followers are taken */
+static void fill(struct planes *p, size_t channels, uint32_t frames,
+		 uint64_t *pos)
+{
+	for (uint32_t i = 0; i < frames; i++, (*pos)++) {
+		float t = (float)*pos / 48000.0f;
+		float env = (*pos / 2400) % 3 ? 0.6f : 0.001f;
+
+		for (size_t c = 0; c < channels; c++) {
+			if (!p->data[c])
+				continue;
+
+			float freq = 110.0f * (float)(c + 1);
+			float gain = env / (float)(c + 1);
+			p->data[c][i] = gain * sinf(t * freq * 6.2831853f);
+		}
+	}
+}
+
+/* SIMD and scalar code may round differently where the compiler contracts
+ * multiply-adds, so allow a few ulp of difference */
+static void assert_close(const float *a, const float *b, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		float tolerance = 1e-5f * fmaxf(1.0f, fabsf(b[i]));
+		if (fabsf(a[i] - b[i]) > tolerance)
+			fail_msg("sample %zu: %g != %g", i, a[i], b[i]);
+	}
+}
+
+static void eq_lanes_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const struct eq_coeffs eq = {
+		.lf = 2.0f * sinf(M_PI * 800.0f / 48000.0f),
+		.hf = 2.0f * sinf(M_PI * 5000.0f / 48000.0f),
+		.low_gain = 1.5f,
+		.mid_gain = 0.5f,
+		.high_gain = 2.0f,
+	};
+
+	for (size_t channels = 1; channels <= MAX_CHANNELS; channels++) {
+		struct eq_channel_state scalar_state[MAX_CHANNELS] = {0};
+		struct eq_channel_state lanes_state[MAX_CHANNELS] = {0};
+		struct planes scalar, lanes;
+		uint64_t pos = 0;
+
+		planes_init(&scalar, channels);
+		planes_init(&lanes, channels);
+
+		for (size_t b = 0; b < NUM_BLOCK_SIZES * 2; b++) {
+			uint32_t frames = block_sizes[b % NUM_BLOCK_SIZES];
+
+			fill(&scalar, channels, frames, &pos);
+			planes_copy(&lanes, &scalar, channels, frames);
+
+			eq_process_scalar(&eq, scalar_state, scalar.data,
+					  channels, frames);
+			eq_process_lanes(&eq, lanes_state, lanes.data,
+					 channels, frames);
+
+			for (size_t c = 0; c < channels; c++)
+				assert_close(lanes.data[c], scalar.data[c],
+					     frames);
+		}
+
+		for (size_t c = 0; c < channels; c++)
+			assert_close(&lanes_state[c].lf_delay0,
+				     &scalar_state[c].lf_delay0,
+				     sizeof(struct eq_channel_state) /
+					     sizeof(float));
+
+		planes_free(&scalar);
+		planes_free(&lanes);
+	}
+}
+
+static void peak_envelope_lanes_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const float attack_gain = expf(-1.0f / (48000.0f * 0.006f));
+	const float release_gain = expf(-1.0f / (48000.0f * 0.06f));
+
+	float *scalar_env = bmalloc(MAX_FRAMES * sizeof(float));
+	float *lanes_env = bmalloc(MAX_FRAMES * sizeof(float));
+
+	for (size_t channels = 1; channels <= MAX_CHANNELS; channels++) {
+		struct planes p;
+		float scalar_envelope = 0.0f;
+		float lanes_envelope = 0.0f;
+		uint64_t pos = 0;
+
+		planes_init(&p, channels);
+
+		/* Unused channels have to be skipped */
+		if (channels > 2) {
+			bfree(p.data[1]);
+			p.data[1] = NULL;
+		}
+
+		for (size_t b = 0; b < NUM_BLOCK_SIZES * 2; b++) {
+			uint32_t frames = block_sizes[b % NUM_BLOCK_SIZES];
+
+			fill(&p, channels, frames, &pos);
+
+			peak_envelope_scalar(p.data, channels, frames,
+					     attack_gain, release_gain,
+					     &scalar_envelope, scalar_env);
+			peak_envelope_lanes(p.data, channels, frames,
+					    attack_gain, release_gain,
+					    &lanes_envelope, lanes_env);
+
+			assert_close(lanes_env, scalar_env, frames);
+			assert_close(&lanes_envelope, &scalar_envelope, 1);
+		}
+
+		planes_free(&p);
+	}
+
+	bfree(scalar_env);
+	bfree(lanes_env);
+}
+
+static void level_detect_lanes_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const float rmscoef = exp2f(-100.0f / 48000.0f);
+
+	for (int rms = 0; rms < 2; rms++) {
+		for (size_t channels = 1; channels <= MAX_CHANNELS;
+		     channels++) {
+			float scalar_ave[MAX_CHANNELS] = {0};
+			float lanes_ave[MAX_CHANNELS] = {0};
+			struct planes p, scalar_env, lanes_env;
+			uint64_t pos = 0;
+
+			planes_init(&p, channels);
+			planes_init(&scalar_env, channels);
+			planes_init(&lanes_env, channels);
+
+			if (channels > 4) {
+				bfree(p.data[4]);
+				p.data[4] = NULL;
+			}
+
+			for (size_t b = 0; b < NUM_BLOCK_SIZES * 2; b++) {
+				uint32_t frames =
+					block_sizes[b % NUM_BLOCK_SIZES];
+
+				fill(&p, channels, frames, &pos);
+
+				level_detect_scalar(p.data, channels, frames,
+						    rms, rmscoef, scalar_ave,
+						    scalar_env.data);
+				level_detect_lanes(p.data, channels, frames,
+						   rms, rmscoef, lanes_ave,
+						   lanes_env.data);
+
+				for (size_t c = 0; c < channels; c++)
+					assert_close(lanes_env.data[c],
+						     scalar_env.data[c],
+						     frames);
+				assert_close(lanes_ave, scalar_ave, channels);
+			}
+
+			planes_free(&p);
+			planes_free(&scalar_env);
+			planes_free(&lanes_env);
+		}
+	}
+}
+
+static void level_and_gain_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const size_t channels = 6;
+	const uint32_t frames = 1023;
+	float *level = bmalloc(frames * sizeof(float));
+	float *gain = bmalloc(frames * sizeof(float));
+	struct planes p, expected;
+	uint64_t pos = 0;
+
+	planes_init(&p, channels);
+	planes_init(&expected, channels);
+	fill(&p, channels, frames, &pos);
+	planes_copy(&expected, &p, channels, frames);
+
+	peak_level(p.data, channels, frames, level);
+
+	for (uint32_t i = 0; i < frames; i++) {
+		float max = 0.0f;
+		for (size_t c = 0; c < channels; c++)
+			max = fmaxf(max, fabsf(p.data[c][i]));
+		assert_true(level[i] == max);
+
+		gain[i] = (float)i / (float)frames;
+		for (size_t c = 0; c < channels; c++)
+			expected.data[c][i] *= gain[i];
+	}
+
+	apply_gain(p.data, channels, frames, gain);
+
+	for (size_t c = 0; c < channels; c++)
+		assert_memory_equal(p.data[c], expected.data[c],
+				    frames * sizeof(float));
+
+	planes_free(&p);
+	planes_free(&expected);
+	bfree(level);
+	bfree(gain);
+}
+
+#ifdef ENABLE_BENCHMARKS
+/* EQ followed by the peak envelope follower, as a stereo, 5.1 and 7.1
+ * source would run them */
+static void audio_lanes_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static const size_t layouts[] = {2, 6, 8};
+	const struct eq_coeffs eq = {
+		.lf = 2.0f * sinf(M_PI * 800.0f / 48000.0f),
+		.hf = 2.0f * sinf(M_PI * 5000.0f / 48000.0f),
+		.low_gain = 1.0f,
+		.mid_gain = 1.0f,
+		.high_gain = 1.0f,
+	};
+	float *env_buf = bmalloc(BENCH_FRAMES * sizeof(float));
+
+	for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+		const size_t channels = layouts[l];
+		uint64_t elapsed[2] = {0};
+		struct planes p;
+		uint64_t pos = 0;
+
+		planes_init(&p, channels);
+		fill(&p, channels, BENCH_FRAMES, &pos);
+
+		for (size_t lanes = 0; lanes < 2; lanes++) {
+			struct eq_channel_state eq_state[MAX_CHANNELS] = {0};
+			float envelope = 0.0f;
+			uint64_t start = os_gettime_ns();
+
+			for (size_t b = 0; b < BENCH_BLOCKS; b++) {
+				if (lanes) {
+					eq_process_lanes(&eq, eq_state, p.data,
+							 channels,
+							 BENCH_FRAMES);
+					peak_envelope_lanes(p.data, channels,
+							    BENCH_FRAMES, 0.99f,
+							    0.999f, &envelope,
+							    env_buf);
+				} else {
+					eq_process_scalar(&eq, eq_state, p.data,
+							  channels,
+							  BENCH_FRAMES);
+					peak_envelope_scalar(p.data, channels,
+							     BENCH_FRAMES,
+							     0.99f, 0.999f,
+							     &envelope,
+							     env_buf);
+				}
+			}
+
+			elapsed[lanes] = os_gettime_ns() - start;
+		}
+
+		printf("%zu channels: scalar %.2f us, lanes %.2f us per "
+		       "block (%.2fx)\n",
+		       channels, (double)elapsed[0] / 1000.0 / BENCH_BLOCKS,
+		       (double)elapsed[1] / 1000.0 / BENCH_BLOCKS,
+		       (double)elapsed[0] / (double)elapsed[1]);
+
+		planes_free(&p);
+	}
+
+	bfree(env_buf);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(eq_lanes_test),
+		cmocka_unit_test(peak_envelope_lanes_test),
+		cmocka_unit_test(level_detect_lanes_test),
+		cmocka_unit_test(level_and_gain_test),
+#ifdef ENABLE_BENCHMARKS
+		cmocka_unit_test(audio_lanes_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,152 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-resampler.h>
+
+#define BLOCK_FRAMES 1024
+#define BLOCKS 500
+#define SOURCES 16
+
+static const uint32_t rate_pairs[][2] = {
+	{44100, 48000},
+	{48000, 44100},
+	{48000, 96000},
+	{96000, 48000},
+};
+#define NUM_RATE_PAIRS (sizeof(rate_pairs) / sizeof(rate_pairs[0]))
+
+/* A 1 kHz tone at half scale on the left, silence on the right */
+static void fill(int16_t *block, uint32_t rate, uint64_t *pos)
+{
+	for (size_t i = 0; i < BLOCK_FRAMES; i++, (*pos)++) {
+		double t = (double)*pos / (double)rate;
+		double v = sin(2.0 * M_PI * 1000.0 * t);
+
+		block[i * 2] = (int16_t)(16384.0 * v);
+		block[i * 2 + 1] = 0;
+	}
+}
+
+/* Resampled output has to be the same tone at the new rate, in time with
+ * the input, for the rate pairs with a native path */
+static void resample_tone_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	int16_t *block = bmalloc(BLOCK_FRAMES * 2 * sizeof(int16_t));
+
+	for (size_t p = 0; p < NUM_RATE_PAIRS; p++) {
+		struct resample_info src = {rate_pairs[p][0],
+					    AUDIO_FORMAT_16BIT,
+					    SPEAKERS_STEREO};
+		struct resample_info dst = {rate_pairs[p][1],
+					    AUDIO_FORMAT_FLOAT_PLANAR,
+					    SPEAKERS_STEREO};
+		audio_resampler_t *rs = audio_resampler_create(&dst, &src);
+		double err = 0.0;
+		uint64_t in_pos = 0;
+		uint64_t out_pos = 0;
+
+		assert_non_null(rs);
+
+		for (size_t b = 0; b < 50; b++) {
+			const uint8_t *input[1] = {(const uint8_t *)block};
+			uint8_t *output[MAX_AV_PLANES];
+			uint32_t frames;
+			uint64_t ts_offset;
+
+			fill(block, src.samples_per_sec, &in_pos);
+			assert_true(audio_resampler_resample(
+				rs, output, &frames, &ts_offset, input,
+				BLOCK_FRAMES));
+
+			const float *left = (const float *)output[0];
+			const float *right = (const float *)output[1];
+
+			for (uint32_t i = 0; i < frames; i++, out_pos++) {
+				double t = (double)out_pos /
+					   (double)dst.samples_per_sec;
+				double e = left[i] -
+					   0.5 * sin(2.0 * M_PI * 1000.0 * t);
+
+				/* Skip the start of the filter */
+				if (out_pos > 100)
+					err = fmax(err, fabs(e));
+				assert_true(right[i] == 0.0f);
+			}
+		}
+
+		/* Within 0.1% of full scale, and no more than one block of
+		 * output missing to the filter delay */
+		assert_true(err < 1e-3);
+		assert_true(in_pos * dst.samples_per_sec / src.samples_per_sec -
+				    out_pos <
+			    BLOCK_FRAMES);
+
+		audio_resampler_destroy(rs);
+	}
+
+	bfree(block);
+}
+
+#ifdef ENABLE_BENCHMARKS
+/* 16 sources at 44.1 kHz going into a 48 kHz mix */
+static void resample_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct resample_info src = {44100, AUDIO_FORMAT_16BIT, SPEAKERS_STEREO};
+	struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	audio_resampler_t *rs[SOURCES];
+	int16_t *block = bmalloc(BLOCK_FRAMES * 2 * sizeof(int16_t));
+	uint64_t pos = 0;
+	uint64_t elapsed = 0;
+
+	for (size_t s = 0; s < SOURCES; s++)
+		rs[s] = audio_resampler_create(&dst, &src);
+
+	for (size_t b = 0; b < BLOCKS; b++) {
+		fill(block, src.samples_per_sec, &pos);
+
+		uint64_t start = os_gettime_ns();
+		for (size_t s = 0; s < SOURCES; s++) {
+			const uint8_t *input[1] = {(const uint8_t *)block};
+			uint8_t *output[MAX_AV_PLANES];
+			uint32_t frames;
+			uint64_t ts_offset;
+
+			audio_resampler_resample(rs[s], output, &frames,
+						 &ts_offset, input,
+						 BLOCK_FRAMES);
+		}
+		elapsed += os_gettime_ns() - start;
+	}
+
+	printf("%d sources 44.1 -> 48 kHz: %.2f us per block\n", SOURCES,
+	       (double)elapsed / 1000.0 / BLOCKS);
+
+	for (size_t s = 0; s < SOURCES; s++)
+		audio_resampler_destroy(rs[s]);
+	bfree(block);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(resample_tone_test),
+#ifdef ENABLE_BENCHMARKS
+		cmocka_unit_test(resample_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,246 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/platform.h>
+
+#define WIDTH 3840
+#define HEIGHT 2160
+#define BENCH_FRAMES 240
+#define BENCH_FLUSH 8
+
+static long released = 0;
+static long released_at_destroy = -1;
+
+static const char *borrowed_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "borrowed_source";
+}
+
+static void *borrowed_source_create(obs_data_t *settings,
+				    obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void borrowed_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+	released_at_destroy = released;
+}
+
+static void async_filter_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_frame *
+async_filter_video(void *data, struct obs_source_frame *frame)
+{
+	UNUSED_PARAMETER(data);
+	return frame;
+}
+
+static int setup(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	struct obs_source_info source = {
+		.id = "borrowed_source",
+		.type = OBS_SOURCE_TYPE_INPUT,
+		.output_flags = OBS_SOURCE_ASYNC_VIDEO,
+		.get_name = borrowed_source_name,
+		.create = borrowed_source_create,
+		.destroy = borrowed_source_destroy,
+	};
+	obs_register_source(&source);
+
+	struct obs_source_info filter = {
+		.id = "async_filter",
+		.type = OBS_SOURCE_TYPE_FILTER,
+		.output_flags = OBS_SOURCE_ASYNC_VIDEO,
+		.get_name = borrowed_source_name,
+		.create = borrowed_source_create,
+		.destroy = async_filter_destroy,
+		.filter_video = async_filter_video,
+	};
+	obs_register_source(&filter);
+
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+	obs_shutdown();
+	return 0;
+}
+
+static void release_frame(void *param)
+{
+	long *count = param;
+	(*count)++;
+	released++;
+}
+
+static void init_frame(struct obs_source_frame *frame, uint8_t *data,
+		       uint64_t timestamp)
+{
+	memset(frame, 0, sizeof(*frame));
+	frame->format = VIDEO_FORMAT_NV12;
+	frame->width = WIDTH;
+	frame->height = HEIGHT;
+	frame->timestamp = timestamp;
+	frame->data[0] = data;
+	frame->data[1] = data + WIDTH * HEIGHT;
+	frame->linesize[0] = WIDTH;
+	frame->linesize[1] = WIDTH;
+}
+
+/* Frames are held until libobs lets go of them, which happens when they
+ * pile up or the source is deactivated, and at the latest before the source
+ * is destroyed */
+static void held_until_dropped_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_source_t *source =
+		obs_source_create_private("borrowed_source", "camera", NULL);
+	uint8_t *data = bzalloc(WIDTH * HEIGHT * 3 / 2);
+	struct obs_source_frame frame;
+	long count = 0;
+
+	for (uint64_t i = 0; i < 5; i++) {
+		init_frame(&frame, data, i * 16666667);
+		obs_source_output_video_borrowed(source, &frame, release_frame,
+						 &count);
+	}
+	assert_int_equal(count, 0);
+
+	obs_source_output_video(source, NULL);
+	assert_int_equal(count, 5);
+
+	/* The frame after the last one that fits drops them all */
+	count = 0;
+	for (uint64_t i = 0; i < 31; i++) {
+		init_frame(&frame, data, i * 16666667);
+		obs_source_output_video_borrowed(source, &frame, release_frame,
+						 &count);
+	}
+	assert_int_equal(count, 31);
+
+	count = 0;
+	for (uint64_t i = 0; i < 3; i++) {
+		init_frame(&frame, data, i * 16666667);
+		obs_source_output_video_borrowed(source, &frame, release_frame,
+						 &count);
+	}
+
+	released = 0;
+	obs_source_release(source);
+	obs_wait_for_destroy_queue();
+
+	assert_int_equal(count, 3);
+	assert_int_equal(released_at_destroy, 3);
+
+	bfree(data);
+}
+
+/* With an async filter, frames are copied and given back right away */
+static void async_filter_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_source_t *source =
+		obs_source_create_private("borrowed_source", "filtered", NULL);
+	obs_source_t *filter =
+		obs_source_create_private("async_filter", "filter", NULL);
+	uint8_t *data = bzalloc(WIDTH * HEIGHT * 3 / 2);
+	struct obs_source_frame frame;
+	long count = 0;
+
+	obs_source_filter_add(source, filter);
+
+	init_frame(&frame, data, 0);
+	obs_source_output_video_borrowed(source, &frame, release_frame, &count);
+	assert_int_equal(count, 1);
+
+	obs_source_filter_remove(source, filter);
+
+	init_frame(&frame, data, 16666667);
+	obs_source_output_video_borrowed(source, &frame, release_frame, &count);
+	assert_int_equal(count, 1);
+
+	obs_source_release(filter);
+	obs_source_release(source);
+	obs_wait_for_destroy_queue();
+	assert_int_equal(count, 2);
+
+	bfree(data);
+}
+
+#ifdef ENABLE_BENCHMARKS
+/* Cost of handing a 4K frame to libobs, copied and borrowed */
+static void output_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint8_t *data = bzalloc(WIDTH * HEIGHT * 3 / 2);
+
+	for (int borrow = 0; borrow < 2; borrow++) {
+		obs_source_t *source = obs_source_create_private(
+			"borrowed_source", "bench", NULL);
+		struct obs_source_frame frame;
+		uint64_t elapsed = 0;
+		long count = 0;
+
+		for (uint64_t i = 0; i < BENCH_FRAMES; i++) {
+			uint64_t start = os_gettime_ns();
+
+			init_frame(&frame, data, i * 16666667);
+			if (borrow)
+				obs_source_output_video_borrowed(
+					source, &frame, release_frame, &count);
+			else
+				obs_source_output_video(source, &frame);
+
+			elapsed += os_gettime_ns() - start;
+
+			if (i % BENCH_FLUSH == BENCH_FLUSH - 1)
+				obs_source_output_video(source, NULL);
+		}
+
+		printf("%s: %.1f us per 4K frame\n",
+		       borrow ? "borrowed" : "copied",
+		       (double)elapsed / 1000.0 / BENCH_FRAMES);
+
+		obs_source_release(source);
+		obs_wait_for_destroy_queue();
+	}
+
+	bfree(data);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(held_until_dropped_test),
+		cmocka_unit_test(async_filter_test),
+#ifdef ENABLE_BENCHMARKS
+		cmocka_unit_test(output_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,450 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <media-io/video-frame.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define TIMEOUT_MS 5000
+#define WIDTH 64
+#define HEIGHT 64
+#define MAX_FRAMES 64
+
+/* Long enough for the audio to fill the ring of blocks of a blocked
+ * encoder */
+#define FILL_MS 600
+
+static audio_t *audio;
+static video_t *video;
+static uint64_t next_frame = 1;
+
+/* Encodes wait for the gate while it is reset, and the encode numbered
+ * fail_at returns an error */
+static os_event_t *encode_gate;
+static volatile long encoded = 0;
+static volatile long fail_at = 0;
+static volatile long packets = 0;
+
+static bool audio_input(void *param, uint64_t start_ts, uint64_t end_ts,
+			uint64_t *new_ts, uint32_t active_mixers,
+			struct audio_output_data *mixes)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(end_ts);
+	UNUSED_PARAMETER(active_mixers);
+	UNUSED_PARAMETER(mixes);
+
+	*new_ts = start_ts;
+	return true;
+}
+
+static const char *test_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "test";
+}
+
+/* The planes each video frame was encoded from, and the value they were
+ * filled with, by pts */
+struct test_encoder {
+	obs_encoder_t *encoder;
+	const uint8_t *planes[MAX_FRAMES];
+	int values[MAX_FRAMES];
+};
+
+static void *test_encoder_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	struct test_encoder *te = bzalloc(sizeof(*te));
+
+	UNUSED_PARAMETER(settings);
+	te->encoder = encoder;
+	return te;
+}
+
+static void test_encoder_destroy(void *data)
+{
+	bfree(data);
+}
+
+static bool test_encoder_encode(void *data, struct encoder_frame *frame,
+				struct encoder_packet *packet,
+				bool *received_packet)
+{
+	static uint8_t payload[16];
+	struct test_encoder *te = data;
+	obs_encoder_t *encoder = te->encoder;
+
+	os_event_wait(encode_gate);
+
+	if (os_atomic_inc_long(&encoded) == os_atomic_load_long(&fail_at))
+		return false;
+
+	if (obs_encoder_get_type(encoder) == OBS_ENCODER_VIDEO &&
+	    frame->pts < MAX_FRAMES) {
+		te->planes[frame->pts] = frame->data[0];
+		te->values[frame->pts] = frame->data[0][0];
+	}
+
+	packet->data = payload;
+	packet->size = sizeof(payload);
+	packet->pts = frame->pts;
+	packet->dts = frame->pts;
+	packet->keyframe = true;
+	packet->type = obs_encoder_get_type(encoder);
+	*received_packet = true;
+	return true;
+}
+
+static size_t test_encoder_frame_size(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return 1024;
+}
+
+static void *test_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	UNUSED_PARAMETER(settings);
+	return output;
+}
+
+static void test_output_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool test_output_start(void *data)
+{
+	obs_output_t *output = data;
+
+	return obs_output_initialize_encoders(output, 0) &&
+	       obs_output_begin_data_capture(output, 0);
+}
+
+static void test_output_stop(void *data, uint64_t ts)
+{
+	UNUSED_PARAMETER(ts);
+	obs_output_end_data_capture(data);
+}
+
+static void test_output_packet(void *data, struct encoder_packet *packet)
+{
+	UNUSED_PARAMETER(data);
+
+	if (packet)
+		os_atomic_inc_long(&packets);
+}
+
+static int setup(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	struct obs_encoder_info audio_encoder = {
+		.id = "test_audio_encoder",
+		.type = OBS_ENCODER_AUDIO,
+		.codec = "aac",
+		.get_name = test_name,
+		.create = test_encoder_create,
+		.destroy = test_encoder_destroy,
+		.encode = test_encoder_encode,
+		.get_frame_size = test_encoder_frame_size,
+	};
+	obs_register_encoder(&audio_encoder);
+
+	struct obs_encoder_info video_encoder = {
+		.id = "test_video_encoder",
+		.type = OBS_ENCODER_VIDEO,
+		.codec = "h264",
+		.get_name = test_name,
+		.create = test_encoder_create,
+		.destroy = test_encoder_destroy,
+		.encode = test_encoder_encode,
+	};
+	obs_register_encoder(&video_encoder);
+
+	struct obs_output_info output = {
+		.id = "test_audio_output",
+		.flags = OBS_OUTPUT_AUDIO | OBS_OUTPUT_ENCODED,
+		.get_name = test_name,
+		.create = test_output_create,
+		.destroy = test_output_destroy,
+		.start = test_output_start,
+		.stop = test_output_stop,
+		.encoded_packet = test_output_packet,
+	};
+	obs_register_output(&output);
+
+	output.id = "test_video_output";
+	output.flags = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED;
+	obs_register_output(&output);
+
+	struct audio_output_info aoi = {
+		.name = "test",
+		.samples_per_sec = 48000,
+		.format = AUDIO_FORMAT_FLOAT_PLANAR,
+		.speakers = SPEAKERS_STEREO,
+		.input_callback = audio_input,
+	};
+	if (audio_output_open(&audio, &aoi) != AUDIO_OUTPUT_SUCCESS)
+		return -1;
+
+	struct video_output_info voi = {
+		.name = "test",
+		.format = VIDEO_FORMAT_I420,
+		.fps_num = 30,
+		.fps_den = 1,
+		.width = WIDTH,
+		.height = HEIGHT,
+		.cache_size = 16,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+	if (video_output_open(&video, &voi) != VIDEO_OUTPUT_SUCCESS)
+		return -1;
+
+	if (os_event_init(&encode_gate, OS_EVENT_TYPE_MANUAL) != 0)
+		return -1;
+	os_event_signal(encode_gate);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	audio_output_close(audio);
+	video_output_close(video);
+	os_event_destroy(encode_gate);
+	obs_shutdown();
+	return 0;
+}
+
+static void reset_counts(long fail)
+{
+	os_atomic_set_long(&encoded, 0);
+	os_atomic_set_long(&packets, 0);
+	os_atomic_set_long(&fail_at, fail);
+}
+
+static bool wait_for_packets(long count)
+{
+	for (int ms = 0; ms < TIMEOUT_MS; ms += 10) {
+		if (os_atomic_load_long(&packets) >= count)
+			return true;
+		os_sleep_ms(10);
+	}
+	return false;
+}
+
+static bool wait_for_stop(obs_output_t *output)
+{
+	for (int ms = 0; ms < TIMEOUT_MS; ms += 10) {
+		if (!obs_output_active(output))
+			return true;
+		os_sleep_ms(10);
+	}
+	return false;
+}
+
+static obs_output_t *create_audio_output(obs_encoder_t **encoder)
+{
+	obs_output_t *output = obs_output_create("test_audio_output",
+						 "output", NULL, NULL);
+
+	*encoder = obs_audio_encoder_create("test_audio_encoder", "audio",
+					    NULL, 0, NULL);
+	obs_encoder_set_audio(*encoder, audio);
+	obs_output_set_audio_encoder(output, *encoder, 0);
+	return output;
+}
+
+/* Stopping has to get through while the audio thread waits for a free
+ * block of an encoder that is a whole ring behind */
+static void audio_encode_stop_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_encoder_t *encoder;
+	obs_output_t *output = create_audio_output(&encoder);
+
+	reset_counts(0);
+	assert_true(obs_output_start(output));
+	assert_true(wait_for_packets(10));
+	obs_output_stop(output);
+	assert_true(wait_for_stop(output));
+
+	reset_counts(0);
+	os_event_reset(encode_gate);
+	assert_true(obs_output_start(output));
+	os_sleep_ms(FILL_MS);
+	obs_output_stop(output);
+	os_sleep_ms(100);
+	os_event_signal(encode_gate);
+	assert_true(wait_for_stop(output));
+
+	obs_output_release(output);
+	obs_encoder_release(encoder);
+}
+
+/* An encode error stops the encoder from its own thread while the audio
+ * thread is waiting for it, and the encoder can be started again */
+static void audio_encode_error_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_encoder_t *encoder;
+	obs_output_t *output = create_audio_output(&encoder);
+
+	reset_counts(5);
+	os_event_reset(encode_gate);
+	assert_true(obs_output_start(output));
+	os_sleep_ms(FILL_MS);
+	os_event_signal(encode_gate);
+	assert_true(wait_for_stop(output));
+	assert_int_equal(os_atomic_load_long(&packets), 4);
+
+	reset_counts(0);
+	assert_true(obs_output_start(output));
+	assert_true(wait_for_packets(10));
+	obs_output_stop(output);
+	assert_true(wait_for_stop(output));
+
+	obs_output_release(output);
+	obs_encoder_release(encoder);
+}
+
+static obs_output_t *create_video_output(obs_encoder_t **encoder)
+{
+	obs_output_t *output = obs_output_create("test_video_output",
+						 "output", NULL, NULL);
+
+	*encoder = obs_video_encoder_create("test_video_encoder", "video",
+					    NULL, NULL);
+	obs_encoder_set_video(*encoder, video);
+	obs_output_set_video_encoder(output, *encoder);
+	return output;
+}
+
+/* Frames filled with the number of the frame, from the start of the pts of
+ * a newly started encoder */
+static void output_frames(int count)
+{
+	uint64_t frame_time = video_output_get_frame_time(video);
+
+	for (int i = 0; i < count; i++) {
+		struct video_frame frame;
+
+		if (video_output_lock_frame(video, &frame, 1,
+					    next_frame++ * frame_time)) {
+			memset(frame.data[0], i, frame.linesize[0] * HEIGHT);
+			video_output_unlock_frame(video);
+		}
+		os_sleep_ms(5);
+	}
+}
+
+static struct test_encoder *get_test_encoder(obs_encoder_t *encoder)
+{
+	return obs_obj_get_data(encoder);
+}
+
+/* Encoders that receive the same frames share one copy of each frame */
+static void video_encode_shared_frames_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_encoder_t *encoders[2];
+	obs_output_t *outputs[2] = {create_video_output(&encoders[0]),
+				    create_video_output(&encoders[1])};
+	struct test_encoder *te[2];
+
+	reset_counts(0);
+	os_event_reset(encode_gate);
+	for (size_t i = 0; i < 2; i++)
+		assert_true(obs_output_start(outputs[i]));
+
+	/* Fewer frames than the queue holds, so they are all queued by both
+	 * encoders at the same time */
+	output_frames(6);
+	os_sleep_ms(100);
+	for (size_t i = 0; i < 2; i++)
+		assert_int_equal(obs_encoder_get_queued_frames(encoders[i]), 6);
+
+	os_event_signal(encode_gate);
+	assert_true(wait_for_packets(12));
+
+	for (size_t i = 0; i < 2; i++)
+		te[i] = get_test_encoder(encoders[i]);
+
+	for (int k = 0; k < 6; k++) {
+		assert_non_null(te[0]->planes[k]);
+		assert_ptr_equal(te[0]->planes[k], te[1]->planes[k]);
+		assert_int_equal(te[0]->values[k], k);
+		assert_int_equal(te[1]->values[k], k);
+		if (k)
+			assert_ptr_not_equal(te[0]->planes[k],
+					     te[0]->planes[k - 1]);
+	}
+
+	for (size_t i = 0; i < 2; i++) {
+		obs_output_stop(outputs[i]);
+		assert_true(wait_for_stop(outputs[i]));
+		assert_int_equal(obs_encoder_get_skipped_frames(encoders[i]),
+				 0);
+		obs_output_release(outputs[i]);
+		obs_encoder_release(encoders[i]);
+	}
+}
+
+/* A blocked encoder skips the frames it has no room for, and an encode
+ * error leaves frames queued that go back to the pool when it stops */
+static void video_encode_error_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_encoder_t *encoder;
+	obs_output_t *output = create_video_output(&encoder);
+
+	reset_counts(3);
+	os_event_reset(encode_gate);
+	assert_true(obs_output_start(output));
+
+	output_frames(12);
+	os_sleep_ms(100);
+	assert_int_equal(obs_encoder_get_queued_frames(encoder), 8);
+	assert_int_equal(obs_encoder_get_skipped_frames(encoder), 4);
+
+	os_event_signal(encode_gate);
+	assert_true(wait_for_stop(output));
+	assert_int_equal(os_atomic_load_long(&packets), 2);
+
+	reset_counts(0);
+	assert_true(obs_output_start(output));
+	output_frames(10);
+	assert_true(wait_for_packets(10));
+	obs_output_stop(output);
+	assert_true(wait_for_stop(output));
+
+	obs_output_release(output);
+	obs_encoder_release(encoder);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(audio_encode_stop_test),
+		cmocka_unit_test(audio_encode_error_test),
+		cmocka_unit_test(video_encode_shared_frames_test),
+		cmocka_unit_test(video_encode_error_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
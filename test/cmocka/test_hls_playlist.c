@@ -0,0 +1,244 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "hls-playlist.h"
+
+#define SEC 1000000LL
+
+/* Feeds parts the way the muxer cuts them: at keyframes, and before a part
+ * would exceed the part duration. keyint is in frames, 0 for no keyframes
+ * past the first one, or -1 if every frame is a sync sample (audio). */
+static void feed(struct hls_playlist *pl, int64_t frame_duration,
+		 int keyint, int frames)
+{
+	int64_t part_duration = 0;
+	uint64_t offset = 0;
+	bool independent = true;
+
+	for (int i = 0; i < frames; i++) {
+		bool keyframe = i == 0 || (keyint > 0 && i % keyint == 0);
+		bool cut = keyframe || part_duration + frame_duration >
+					       pl->part_duration;
+
+		if (i && cut) {
+			struct hls_part part = {offset, 1000, part_duration,
+						independent};
+
+			if (hls_playlist_needs_segment(pl, independent)) {
+				hls_playlist_start_segment(pl);
+				part.offset = offset = 0;
+			}
+
+			hls_playlist_add_part(pl, &part);
+			offset += part.size;
+			part_duration = 0;
+			independent = keyframe || keyint < 0;
+		}
+
+		part_duration += frame_duration;
+	}
+}
+
+static void check_segments(const struct hls_playlist *pl,
+			   bool check_independent)
+{
+	for (size_t i = 0; i < pl->segments.num; i++) {
+		const struct hls_segment *seg = &pl->segments.array[i];
+
+		assert_true(seg->parts.num > 0);
+
+		if (check_independent)
+			assert_true(seg->parts.array[0].independent);
+
+		/* EXTINF rounded to the nearest integer */
+		if (seg->complete)
+			assert_true((seg->duration_usec + SEC / 2) / SEC <=
+				    pl->target_duration);
+	}
+}
+
+static void check_target_line(const struct hls_playlist *pl, int target)
+{
+	struct dstr text = {0};
+	char line[64];
+
+	snprintf(line, sizeof(line), "#EXT-X-TARGETDURATION:%d\n", target);
+
+	hls_playlist_write(pl, &text, "live", false);
+	assert_non_null(strstr(text.array, line));
+	assert_true(!!strstr(text.array, "#EXT-X-INDEPENDENT-SEGMENTS\n") ==
+		    pl->independent_segments);
+	dstr_free(&text);
+}
+
+static void hls_keyint_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct hls_playlist pl;
+
+	/* 2 s keyframe interval matching the segment duration */
+	hls_playlist_init(&pl, SEC / 2, 2 * SEC, 2 * SEC, 0);
+	assert_int_equal(pl.target_duration, 2);
+	feed(&pl, SEC / 30, 60, 30 * 60);
+	check_segments(&pl, pl.independent_segments);
+	check_target_line(&pl, 2);
+	hls_playlist_free(&pl);
+
+	/* Segments end on the first keyframe past the segment duration */
+	hls_playlist_init(&pl, SEC / 2, 2 * SEC, 3 * SEC, 0);
+	assert_int_equal(pl.target_duration, 3);
+	feed(&pl, SEC / 30, 90, 30 * 60);
+	check_segments(&pl, pl.independent_segments);
+	check_target_line(&pl, 3);
+	hls_playlist_free(&pl);
+}
+
+/* The target duration stays the same when the encoder doesn't stick to its
+ * keyframe interval, segments are cut in between keyframes instead */
+static void hls_long_gop_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct hls_playlist pl;
+
+	hls_playlist_init(&pl, SEC / 2, 2 * SEC, 0, 0);
+	assert_int_equal(pl.target_duration, 2);
+	assert_false(pl.independent_segments);
+	feed(&pl, SEC / 30, 300, 30 * 60);
+	check_segments(&pl, pl.independent_segments);
+	check_target_line(&pl, 2);
+	hls_playlist_free(&pl);
+
+	hls_playlist_init(&pl, SEC / 2, 2 * SEC, 2 * SEC, 0);
+	feed(&pl, SEC / 30, 0, 30 * 60);
+	check_segments(&pl, false);
+	check_target_line(&pl, 2);
+	hls_playlist_free(&pl);
+}
+
+/* Every AAC frame is a sync sample, parts are cut on frame boundaries */
+static void hls_audio_only_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct hls_playlist pl;
+
+	hls_playlist_init(&pl, SEC / 2, 2 * SEC, -1, 0);
+	assert_true(pl.independent_segments);
+	feed(&pl, 1024 * SEC / 48000, -1, 48000 * 60 / 1024);
+	check_segments(&pl, pl.independent_segments);
+	check_target_line(&pl, pl.target_duration);
+	hls_playlist_free(&pl);
+}
+
+static void add_part(struct hls_playlist *pl, uint64_t offset, uint64_t size,
+		     int64_t duration, bool independent)
+{
+	struct hls_part part = {offset, size, duration, independent};
+
+	if (hls_playlist_needs_segment(pl, independent))
+		hls_playlist_start_segment(pl);
+	hls_playlist_add_part(pl, &part);
+}
+
+static void hls_playlist_text_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct hls_playlist pl;
+	struct dstr text = {0};
+
+	hls_playlist_init(&pl, SEC / 2, SEC, SEC, 0);
+	add_part(&pl, 0, 1500, SEC / 2, true);
+	add_part(&pl, 1500, 700, SEC / 2, false);
+	add_part(&pl, 0, 1200, SEC / 2, true);
+
+	hls_playlist_write(&pl, &text, "live", false);
+	assert_string_equal(
+		text.array,
+		"#EXTM3U\n"
+		"#EXT-X-VERSION:9\n"
+		"#EXT-X-TARGETDURATION:1\n"
+		"#EXT-X-PART-INF:PART-TARGET=0.500\n"
+		"#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=1.500\n"
+		"#EXT-X-MEDIA-SEQUENCE:0\n"
+		"#EXT-X-INDEPENDENT-SEGMENTS\n"
+		"#EXT-X-MAP:URI=\"live_init.mp4\"\n"
+		"#EXT-X-PART:DURATION=0.50000,URI=\"live_0.m4s\","
+		"BYTERANGE=\"1500@0\",INDEPENDENT=YES\n"
+		"#EXT-X-PART:DURATION=0.50000,URI=\"live_0.m4s\","
+		"BYTERANGE=\"700@1500\"\n"
+		"#EXTINF:1.00000,\n"
+		"live_0.m4s\n"
+		"#EXT-X-PART:DURATION=0.50000,URI=\"live_1.m4s\","
+		"BYTERANGE=\"1200@0\",INDEPENDENT=YES\n");
+	dstr_free(&text);
+
+	hls_playlist_complete_segment(&pl);
+	hls_playlist_write(&pl, &text, "live", true);
+	assert_string_equal(text.array,
+			    "#EXTM3U\n"
+			    "#EXT-X-VERSION:9\n"
+			    "#EXT-X-TARGETDURATION:1\n"
+			    "#EXT-X-PART-INF:PART-TARGET=0.500\n"
+			    "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=1.500\n"
+			    "#EXT-X-MEDIA-SEQUENCE:0\n"
+			    "#EXT-X-INDEPENDENT-SEGMENTS\n"
+			    "#EXT-X-MAP:URI=\"live_init.mp4\"\n"
+			    "#EXTINF:1.00000,\n"
+			    "live_0.m4s\n"
+			    "#EXTINF:0.50000,\n"
+			    "live_1.m4s\n"
+			    "#EXT-X-ENDLIST\n");
+	dstr_free(&text);
+
+	hls_playlist_free(&pl);
+}
+
+static void hls_prune_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct hls_playlist pl;
+	struct hls_segment seg;
+	struct dstr text = {0};
+	uint64_t expired = 0;
+
+	hls_playlist_init(&pl, SEC / 2, SEC, SEC, 2);
+
+	for (int i = 0; i < 10; i++) {
+		add_part(&pl, 0, 100, SEC / 2, true);
+		add_part(&pl, 100, 100, SEC / 2, false);
+
+		while (hls_playlist_pop_expired(&pl, &seg)) {
+			assert_int_equal(seg.sequence, expired++);
+			da_free(seg.parts);
+		}
+	}
+
+	/* Two complete segments plus the one being written */
+	assert_int_equal(pl.segments.num, 3);
+	assert_int_equal(pl.segments.array[0].sequence, 7);
+
+	hls_playlist_write(&pl, &text, "live", false);
+	assert_non_null(strstr(text.array, "#EXT-X-MEDIA-SEQUENCE:7\n"));
+	dstr_free(&text);
+
+	hls_playlist_free(&pl);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(hls_keyint_test),
+		cmocka_unit_test(hls_long_gop_test),
+		cmocka_unit_test(hls_audio_only_test),
+		cmocka_unit_test(hls_playlist_text_test),
+		cmocka_unit_test(hls_prune_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,240 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+
+#include "pulseaudio-mixer.h"
+
+#define RATE 48000
+#define CHANNELS 2
+#define LATENCY 25000000ULL
+#define SOURCES 32
+#define BLOCKS 2000
+#define BLOCK_FRAMES 1024
+
+static inline uint64_t frames_to_ns(uint64_t frames)
+{
+	return util_mul_div64(frames, 1000000000ULL, RATE);
+}
+
+static void add_block(struct monitor_mixer *mixer, float *planes[CHANNELS],
+		      uint32_t frames, uint64_t pos, float vol)
+{
+	struct audio_data audio = {.frames = frames,
+				   .timestamp = 1000000000ULL +
+						frames_to_ns(pos)};
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio.data[c] = (uint8_t *)planes[c];
+
+	monitor_mixer_add(mixer, &audio, vol);
+}
+
+static void fill(float *planes[CHANNELS], uint32_t frames, uint64_t pos,
+		 float freq)
+{
+	for (uint32_t i = 0; i < frames; i++) {
+		float t = (float)(pos + i) / (float)RATE;
+		planes[0][i] = sinf(t * freq * 6.2831853f);
+		planes[1][i] = -planes[0][i];
+	}
+}
+
+/* Two sources with different block sizes have to come out as one mix, in
+ * time with each other */
+static void premix_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct monitor_mixer mixer;
+	float *planes[CHANNELS];
+	const float *out[MAX_AUDIO_CHANNELS];
+	float *expected = bzalloc(RATE * sizeof(float));
+	uint64_t pos[2] = {0};
+	size_t taken = 0;
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bmalloc(BLOCK_FRAMES * sizeof(float));
+
+	monitor_mixer_init(&mixer, RATE, CHANNELS, LATENCY);
+
+	while (pos[0] < RATE / 2) {
+		fill(planes, 1024, pos[0], 440.0f);
+		for (uint32_t i = 0; i < 1024; i++)
+			expected[pos[0] + i] += planes[0][i];
+		add_block(&mixer, planes, 1024, pos[0], 1.0f);
+		pos[0] += 1024;
+
+		while (pos[1] < pos[0]) {
+			fill(planes, 480, pos[1], 1000.0f);
+			for (uint32_t i = 0; i < 480; i++)
+				expected[pos[1] + i] += 0.5f * planes[0][i];
+			add_block(&mixer, planes, 480, pos[1], 0.5f);
+			pos[1] += 480;
+		}
+
+		/* Everything up to the start of the next block is complete */
+		uint64_t now = 1000000000ULL + frames_to_ns(pos[0]) + mixer.hold;
+		int64_t sink_latency = (int64_t)mixer.sink_target;
+		size_t frames =
+			monitor_mixer_take(&mixer, now, sink_latency, out);
+
+		assert_true(taken + frames <= pos[0]);
+		for (size_t i = 0; i < frames; i++) {
+			if (fabsf(out[0][i] - expected[taken + i]) > 1e-6f)
+				fail_msg("frame %zu: %g != %g", taken + i,
+					 out[0][i], expected[taken + i]);
+			assert_true(out[1][i] == -out[0][i]);
+		}
+		taken += frames;
+	}
+
+	assert_true(taken + 1024 >= pos[0]);
+	assert_int_equal(mixer.late_frames, 0);
+	assert_true(mixer.ratio == 1.0);
+
+	monitor_mixer_free(&mixer);
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+	bfree(expected);
+}
+
+/* A sink that plays 0.05% faster or slower than the OBS clock has to be
+ * kept at its share of the latency by adjusting the playback rate */
+static void drift_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static const double speeds[] = {1.0005, 0.9995};
+
+	float *planes[CHANNELS];
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bzalloc(BLOCK_FRAMES * sizeof(float));
+
+	for (size_t s = 0; s < 2; s++) {
+		struct monitor_mixer mixer;
+		const float *out[MAX_AUDIO_CHANNELS];
+		double queued;
+		uint64_t pos = 0;
+
+		monitor_mixer_init(&mixer, RATE, CHANNELS, LATENCY);
+		queued = (double)RATE * (double)mixer.sink_target / 1e9;
+
+		for (size_t b = 0; b < BLOCKS; b++) {
+			add_block(&mixer, planes, BLOCK_FRAMES, pos, 1.0f);
+			pos += BLOCK_FRAMES;
+
+			uint64_t now = 1000000000ULL + frames_to_ns(pos) +
+				       mixer.hold;
+			int64_t latency = (int64_t)(queued * 1e9 / RATE);
+
+			queued += (double)monitor_mixer_take(&mixer, now,
+							     latency, out);
+			queued -= BLOCK_FRAMES * speeds[s];
+		}
+
+		double latency = queued * 1e9 / RATE;
+		double target = (double)mixer.sink_target;
+		assert_true(fabs(latency - target) < target / 4);
+		assert_true(s == 0 ? mixer.ratio < 1.0 : mixer.ratio > 1.0);
+
+		monitor_mixer_free(&mixer);
+	}
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+}
+
+/* Audio that arrives after its frames have been taken is dropped, the last
+ * two frames due stay in the mix for interpolation */
+static void late_audio_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct monitor_mixer mixer;
+	const float *out[MAX_AUDIO_CHANNELS];
+	float *planes[CHANNELS];
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bzalloc(BLOCK_FRAMES * sizeof(float));
+
+	monitor_mixer_init(&mixer, RATE, CHANNELS, LATENCY);
+
+	add_block(&mixer, planes, BLOCK_FRAMES, 0, 1.0f);
+	add_block(&mixer, planes, BLOCK_FRAMES, BLOCK_FRAMES, 1.0f);
+	size_t taken = monitor_mixer_take(
+		&mixer,
+		1000000000ULL + frames_to_ns(BLOCK_FRAMES) + mixer.hold, -1,
+		out);
+	assert_int_equal(taken, BLOCK_FRAMES - 2);
+
+	add_block(&mixer, planes, BLOCK_FRAMES, BLOCK_FRAMES / 2, 1.0f);
+	assert_int_equal(mixer.late_frames, taken - BLOCK_FRAMES / 2);
+
+	monitor_mixer_free(&mixer);
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+}
+
+#ifdef ENABLE_BENCHMARKS
+/* 32 monitored sources premixed into one stream */
+static void premix_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct monitor_mixer mixer;
+	const float *out[MAX_AUDIO_CHANNELS];
+	float *planes[CHANNELS];
+	uint64_t elapsed = 0;
+	uint64_t pos = 0;
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bmalloc(BLOCK_FRAMES * sizeof(float));
+	fill(planes, BLOCK_FRAMES, 0, 440.0f);
+
+	monitor_mixer_init(&mixer, RATE, CHANNELS, LATENCY);
+
+	for (size_t b = 0; b < BLOCKS; b++) {
+		uint64_t now = 1000000000ULL +
+			       frames_to_ns(pos + BLOCK_FRAMES) + mixer.hold;
+		uint64_t start = os_gettime_ns();
+
+		for (size_t s = 0; s < SOURCES; s++) {
+			add_block(&mixer, planes, BLOCK_FRAMES, pos, 0.5f);
+			monitor_mixer_take(&mixer, now,
+					   (int64_t)mixer.sink_target, out);
+		}
+
+		elapsed += os_gettime_ns() - start;
+		pos += BLOCK_FRAMES;
+	}
+
+	printf("%d sources premixed: %.2f us per block\n", SOURCES,
+	       (double)elapsed / 1000.0 / BLOCKS);
+
+	monitor_mixer_free(&mixer);
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(premix_test),
+		cmocka_unit_test(drift_test),
+		cmocka_unit_test(late_audio_test),
+#ifdef ENABLE_BENCHMARKS
+		cmocka_unit_test(premix_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
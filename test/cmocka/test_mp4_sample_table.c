@@ -0,0 +1,217 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+#include <util/array-serializer.h>
+
+#include "mp4-sample-table.h"
+
+static uint32_t next_value(uint64_t idx)
+{
+	/* Roughly resembles video frame sizes with a keyframe every 2 s,
+	 * plus occasional outliers to exercise large deltas. */
+	if (idx % 1000 == 7)
+		return (uint32_t)rand() * 2654435761u;
+	if (idx % 120 == 0)
+		return 200000 + rand() % 50000;
+
+	return 20000 + rand() % 20000;
+}
+
+static void check_table(uint64_t count, bool spill)
+{
+	struct mp4_sample_table table;
+	mp4_sample_table_init(&table, spill);
+
+	srand(1);
+	for (uint64_t i = 0; i < count; i++)
+		mp4_sample_table_push(&table, next_value(i));
+
+	assert_true(mp4_sample_table_count(&table) == count);
+
+	struct mp4_sample_table_reader reader;
+	mp4_sample_table_reader_init(&reader, &table);
+
+	srand(1);
+	uint64_t read = 0;
+	uint32_t val;
+	while (mp4_sample_table_read(&reader, &val))
+		assert_int_equal(val, next_value(read++));
+
+	mp4_sample_table_reader_free(&reader);
+	assert_true(read == count);
+
+	mp4_sample_table_free(&table);
+}
+
+static void sample_table_roundtrip_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	check_table(0, false);
+	check_table(1, false);
+	check_table(100000, false);
+}
+
+static void sample_table_spill_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	check_table(1, true);
+	check_table(2000000, true);
+}
+
+static void check_written(struct mp4_sample_table *table,
+			  enum mp4_table_entries entries, uint32_t timescale,
+			  uint32_t timebase_den, const uint32_t *expected,
+			  size_t num)
+{
+	struct array_output_data output;
+	struct serializer s;
+
+	array_output_serializer_init(&s, &output);
+	mp4_sample_table_write(table, &s, entries, timescale, timebase_den);
+
+	assert_int_equal(output.bytes.num, num * 4);
+	for (size_t i = 0; i < num; i++) {
+		const uint8_t *p = output.bytes.array + i * 4;
+		uint32_t val = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+			       (uint32_t)p[2] << 8 | (uint32_t)p[3];
+		assert_int_equal(val, expected[i]);
+	}
+
+	array_output_serializer_free(&output);
+}
+
+/* Entries as the muxer writes them into stts/ctts/stsz/stss */
+static void sample_table_write_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct mp4_sample_table table;
+
+	/* 29.97 FPS in a 1/30000 time base, written with a 90 kHz timescale */
+	const uint32_t stts[] = {3, 3003, 1, 6006};
+	mp4_sample_table_init(&table, false);
+	mp4_sample_table_push(&table, 3);
+	mp4_sample_table_push(&table, 1001);
+	mp4_sample_table_push(&table, 1);
+	mp4_sample_table_push(&table, 2002);
+	check_written(&table, MP4_TABLE_DELTAS, 90000, 30000, stts, 4);
+	mp4_sample_table_free(&table);
+
+	/* Negative offsets stay negative after scaling */
+	const uint32_t ctts[] = {2, (uint32_t)-3003, 1, 0, 5, 3003};
+	mp4_sample_table_init(&table, false);
+	mp4_sample_table_push(&table, 2);
+	mp4_sample_table_push(&table, (uint32_t)-1001);
+	mp4_sample_table_push(&table, 1);
+	mp4_sample_table_push(&table, 0);
+	mp4_sample_table_push(&table, 5);
+	mp4_sample_table_push(&table, 1001);
+	check_written(&table, MP4_TABLE_OFFSETS, 90000, 30000, ctts, 6);
+	mp4_sample_table_free(&table);
+
+	const uint32_t stsz[] = {250000, 31000, 0, UINT32_MAX, 12};
+	mp4_sample_table_init(&table, false);
+	for (size_t i = 0; i < 5; i++)
+		mp4_sample_table_push(&table, stsz[i]);
+	check_written(&table, MP4_TABLE_VALUES, 0, 0, stsz, 5);
+	mp4_sample_table_free(&table);
+}
+
+/* Spilled tables large enough to be written in several batches */
+static void sample_table_write_spilled_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const size_t count = 1000000;
+	uint32_t *expected = bmalloc(count * sizeof(uint32_t));
+	struct mp4_sample_table table;
+
+	mp4_sample_table_init(&table, true);
+
+	srand(2);
+	for (size_t i = 0; i < count; i++) {
+		expected[i] = next_value(i);
+		mp4_sample_table_push(&table, expected[i]);
+	}
+
+	assert_true(table.spilled_bytes > 0);
+	check_written(&table, MP4_TABLE_VALUES, 0, 0, expected, count);
+
+	/* Writing again gives the same result */
+	check_written(&table, MP4_TABLE_VALUES, 0, 0, expected, count);
+
+	mp4_sample_table_free(&table);
+	bfree(expected);
+}
+
+#ifdef ENABLE_BENCHMARKS
+/* Simulates the sample tables of a 24 hour recording with one 60 FPS video
+ * track and six AAC tracks, then streams them back like the final moov. */
+static void sample_table_24h_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const uint64_t video_samples = 24ULL * 3600 * 60;
+	const uint64_t audio_samples = 24ULL * 3600 * 48000 / 1024;
+	struct mp4_sample_table tables[7];
+
+	for (size_t spill = 0; spill < 2; spill++) {
+		uint64_t start = os_gettime_ns();
+		size_t mem = 0;
+
+		srand(1);
+		for (size_t t = 0; t < 7; t++) {
+			uint64_t count = t ? audio_samples : video_samples;
+
+			mp4_sample_table_init(&tables[t], spill);
+			for (uint64_t i = 0; i < count; i++)
+				mp4_sample_table_push(&tables[t],
+						      next_value(i));
+
+			mem += mp4_sample_table_mem_size(&tables[t]);
+		}
+
+		uint64_t mid = os_gettime_ns();
+
+		for (size_t t = 0; t < 7; t++) {
+			struct mp4_sample_table_reader reader;
+			uint32_t val;
+
+			mp4_sample_table_reader_init(&reader, &tables[t]);
+			while (mp4_sample_table_read(&reader, &val))
+				;
+			mp4_sample_table_reader_free(&reader);
+			mp4_sample_table_free(&tables[t]);
+		}
+
+		uint64_t end = os_gettime_ns();
+
+		printf("24h recording (spill: %s): %zu KiB in memory, "
+		       "append %.1f ms, stream %.1f ms\n",
+		       spill ? "yes" : "no", mem / 1024,
+		       (double)(mid - start) / 1e6, (double)(end - mid) / 1e6);
+	}
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(sample_table_roundtrip_test),
+		cmocka_unit_test(sample_table_spill_test),
+		cmocka_unit_test(sample_table_write_test),
+		cmocka_unit_test(sample_table_write_spilled_test),
+#ifdef ENABLE_BENCHMARKS
+		cmocka_unit_test(sample_table_24h_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,148 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#include <rnnoise.h>
+
+#define CHANNELS 8
+#define FRAME_SIZE 480
+#define TEST_FRAMES 500
+#define BENCH_FRAMES 2000
+
+/* Tone bursts over white noise, at the int16 scale RNNoise expects */
+static void fill(float *frame, size_t channel, uint64_t frame_idx,
+		 uint32_t *seed)
+{
+	for (size_t i = 0; i < FRAME_SIZE; i++) {
+		uint64_t t = frame_idx * FRAME_SIZE + i;
+		float tone = (t / 24000) % 2 ? 8000.0f : 0.0f;
+
+		*seed = *seed * 1103515245 + 12345;
+		float noise = (float)((*seed >> 16) & 0x7fff) / 32768.0f - 0.5f;
+
+		frame[i] = tone * sinf((float)t * 0.03f * (float)(channel + 1)) +
+			   2000.0f * noise;
+	}
+}
+
+struct channels {
+	DenoiseState *st[CHANNELS];
+	float *frames[CHANNELS];
+};
+
+static void channels_init(struct channels *c)
+{
+	for (size_t i = 0; i < CHANNELS; i++) {
+		c->st[i] = rnnoise_create(NULL);
+		c->frames[i] = bmalloc(FRAME_SIZE * sizeof(float));
+	}
+}
+
+static void channels_free(struct channels *c)
+{
+	for (size_t i = 0; i < CHANNELS; i++) {
+		rnnoise_destroy(c->st[i]);
+		bfree(c->frames[i]);
+	}
+}
+
+/* Running the channels as one batch must not change the output */
+static void batch_matches_single_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct channels single, batch;
+	uint32_t seed = 1;
+
+	channels_init(&single);
+	channels_init(&batch);
+
+	for (uint64_t f = 0; f < TEST_FRAMES; f++) {
+		float single_vad[CHANNELS];
+		float batch_vad[CHANNELS];
+
+		for (size_t c = 0; c < CHANNELS; c++) {
+			fill(single.frames[c], c, f, &seed);
+			memcpy(batch.frames[c], single.frames[c],
+			       FRAME_SIZE * sizeof(float));
+		}
+
+		for (size_t c = 0; c < CHANNELS; c++)
+			single_vad[c] = rnnoise_process_frame(
+				single.st[c], single.frames[c],
+				single.frames[c]);
+
+		rnnoise_process_frames(batch.st, batch.frames,
+				       (const float **)batch.frames, batch_vad,
+				       CHANNELS);
+
+		for (size_t c = 0; c < CHANNELS; c++)
+			assert_memory_equal(single.frames[c], batch.frames[c],
+					    FRAME_SIZE * sizeof(float));
+		assert_memory_equal(single_vad, batch_vad, sizeof(single_vad));
+	}
+
+	channels_free(&single);
+	channels_free(&batch);
+}
+
+#ifdef ENABLE_BENCHMARKS
+/* Frames per second on a single core, one channel at a time and batched */
+static void rnnoise_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	for (int batched = 0; batched < 2; batched++) {
+		struct channels ch;
+		uint32_t seed = 1;
+		uint64_t elapsed = 0;
+
+		channels_init(&ch);
+
+		for (uint64_t f = 0; f < BENCH_FRAMES; f++) {
+			for (size_t c = 0; c < CHANNELS; c++)
+				fill(ch.frames[c], c, f, &seed);
+
+			uint64_t start = os_gettime_ns();
+			if (batched) {
+				rnnoise_process_frames(
+					ch.st, ch.frames,
+					(const float **)ch.frames, NULL,
+					CHANNELS);
+			} else {
+				for (size_t c = 0; c < CHANNELS; c++)
+					rnnoise_process_frame(ch.st[c],
+							      ch.frames[c],
+							      ch.frames[c]);
+			}
+			elapsed += os_gettime_ns() - start;
+		}
+
+		printf("%d channels (%s): %.0f frames/s per core\n", CHANNELS,
+		       batched ? "batched" : "one at a time",
+		       (double)(BENCH_FRAMES * CHANNELS) * 1e9 /
+			       (double)elapsed);
+
+		channels_free(&ch);
+	}
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(batch_matches_single_test),
+#ifdef ENABLE_BENCHMARKS
+		cmocka_unit_test(rnnoise_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,298 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+
+#define CHANNELS 2
+#define READERS 8
+#define BLOCKS 2000
+#define BLOCK_FRAMES 1024
+
+static const char *sidechain_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "sidechain_source";
+}
+
+static void *sidechain_source_create(obs_data_t *settings,
+				     obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void sidechain_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static int setup(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	struct obs_audio_info oai = {.samples_per_sec = 48000,
+				     .speakers = SPEAKERS_STEREO};
+	if (!obs_reset_audio(&oai))
+		return -1;
+
+	struct obs_source_info source = {
+		.id = "sidechain_source",
+		.type = OBS_SOURCE_TYPE_INPUT,
+		.output_flags = OBS_SOURCE_AUDIO,
+		.get_name = sidechain_source_name,
+		.create = sidechain_source_create,
+		.destroy = sidechain_source_destroy,
+	};
+	obs_register_source(&source);
+
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+	obs_shutdown();
+	return 0;
+}
+
+static inline float sample(uint64_t pos, size_t channel)
+{
+	return (float)((pos * (channel + 1)) % 1000) / 1000.0f;
+}
+
+static void output_block(obs_source_t *source, float *planes[CHANNELS],
+			 uint64_t *pos, uint32_t frames)
+{
+	struct obs_source_audio audio = {
+		.frames = frames,
+		.speakers = SPEAKERS_STEREO,
+		.format = AUDIO_FORMAT_FLOAT_PLANAR,
+		.samples_per_sec = 48000,
+		.timestamp = util_mul_div64(*pos, 1000000000ULL, 48000),
+	};
+
+	for (uint32_t i = 0; i < frames; i++, (*pos)++) {
+		for (size_t c = 0; c < CHANNELS; c++)
+			planes[c][i] = sample(*pos, c);
+	}
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio.data[c] = (const uint8_t *)planes[c];
+
+	obs_source_output_audio(source, &audio);
+}
+
+static inline uint64_t frames_to_ns(uint64_t frames)
+{
+	return util_mul_div64(frames, 1000000000ULL, 48000);
+}
+
+/* Timestamps are rebased by the source, so the expected audio is found
+ * from the timestamp relative to the one of the first frame */
+static void check_block(const struct obs_sidechain_data *data,
+			uint64_t first_ts)
+{
+	uint64_t pos = util_mul_div64(data->timestamp - first_ts + 10000,
+				      48000, 1000000000ULL);
+
+	for (uint32_t i = 0; i < data->frames; i++) {
+		for (size_t c = 0; c < CHANNELS; c++)
+			assert_true(data->data[c][i] == sample(pos + i, c));
+	}
+}
+
+/* Every reader sees the same audio with the timestamps of the source, and
+ * the audio stays readable while readers come and go */
+static void shared_readers_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_source_t *source =
+		obs_source_create_private("sidechain_source", "music", NULL);
+	obs_sidechain_reader_t *readers[3] = {
+		obs_sidechain_reader_create(source),
+		obs_sidechain_reader_create(source),
+		NULL,
+	};
+	float *planes[CHANNELS];
+	uint64_t pos = 0;
+	uint64_t first_ts = 0;
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bmalloc(BLOCK_FRAMES * sizeof(float));
+
+	struct obs_sidechain_data data[3];
+
+	/* Readers start at the audio still to come */
+	output_block(source, planes, &pos, BLOCK_FRAMES);
+	for (size_t r = 0; r < 2; r++)
+		assert_false(obs_sidechain_reader_read(readers[r], BLOCK_FRAMES,
+						       &data[r]));
+
+	for (size_t b = 1; b < 20; b++) {
+		output_block(source, planes, &pos, BLOCK_FRAMES);
+
+		if (b == 5)
+			readers[2] = obs_sidechain_reader_create(source);
+
+		for (size_t r = 0; r < 3; r++) {
+			if (!readers[r])
+				continue;
+			if (r == 2 && b == 5) {
+				assert_false(obs_sidechain_reader_read(
+					readers[r], BLOCK_FRAMES, &data[r]));
+				continue;
+			}
+
+			assert_true(obs_sidechain_reader_read(
+				readers[r], BLOCK_FRAMES, &data[r]));
+			assert_int_equal(data[r].frames, BLOCK_FRAMES);
+		}
+
+		if (b == 1)
+			first_ts = data[0].timestamp -
+				   frames_to_ns(BLOCK_FRAMES);
+
+		assert_int_equal(data[0].timestamp - first_ts,
+				 frames_to_ns(b * BLOCK_FRAMES));
+		check_block(&data[0], first_ts);
+
+		if (readers[1]) {
+			assert_ptr_not_equal(data[0].data[0], data[1].data[0]);
+			assert_memory_equal(data[0].data[0], data[1].data[0],
+					    BLOCK_FRAMES * sizeof(float));
+		}
+		if (b > 5) {
+			assert_memory_equal(data[0].data[1], data[2].data[1],
+					    BLOCK_FRAMES * sizeof(float));
+			assert_int_equal(data[0].timestamp, data[2].timestamp);
+		}
+
+		if (b == 10) {
+			obs_sidechain_reader_destroy(readers[1]);
+			readers[1] = NULL;
+		}
+	}
+
+	for (size_t r = 0; r < 3; r++)
+		obs_sidechain_reader_destroy(readers[r]);
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+	obs_source_release(source);
+}
+
+/* Odd block sizes wrap around the ring, a reader that stops reading skips
+ * ahead, and a reader outliving its source is left without audio */
+static void wrap_and_catch_up_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_source_t *source =
+		obs_source_create_private("sidechain_source", "voice", NULL);
+	obs_sidechain_reader_t *reader = obs_sidechain_reader_create(source);
+	struct obs_sidechain_data data;
+	float *planes[CHANNELS];
+	uint64_t pos = 0;
+	uint64_t first_ts = 0;
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bmalloc(BLOCK_FRAMES * sizeof(float));
+
+	output_block(source, planes, &pos, 480);
+	assert_false(obs_sidechain_reader_read(reader, 480, &data));
+
+	for (size_t b = 0; b < 200; b++) {
+		output_block(source, planes, &pos, 480);
+		assert_true(obs_sidechain_reader_read(reader, 480, &data));
+		if (!b)
+			first_ts = data.timestamp - frames_to_ns(480);
+		check_block(&data, first_ts);
+	}
+
+	for (size_t b = 0; b < 100; b++)
+		output_block(source, planes, &pos, 480);
+
+	/* Two reads behind the latest audio */
+	assert_true(obs_sidechain_reader_read(reader, 480, &data));
+	assert_int_equal(data.timestamp - first_ts, frames_to_ns(pos - 960));
+	check_block(&data, first_ts);
+
+	obs_source_release(source);
+
+	assert_true(obs_sidechain_reader_read(reader, 480, &data));
+	assert_false(obs_sidechain_reader_read(reader, 480, &data));
+	obs_sidechain_reader_destroy(reader);
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+}
+
+#ifdef ENABLE_BENCHMARKS
+/* Cost of one source keying one and several compressors */
+static void shared_readers_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	float *planes[CHANNELS];
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bmalloc(BLOCK_FRAMES * sizeof(float));
+
+	for (size_t count = 1; count <= READERS; count *= READERS) {
+		obs_source_t *source = obs_source_create_private(
+			"sidechain_source", "bench", NULL);
+		obs_sidechain_reader_t *readers[READERS];
+		struct obs_sidechain_data data;
+		uint64_t pos = 0;
+		uint64_t elapsed = 0;
+		double sum = 0.0;
+
+		for (size_t i = 0; i < count; i++)
+			readers[i] = obs_sidechain_reader_create(source);
+
+		for (size_t b = 0; b < BLOCKS; b++) {
+			uint64_t start = os_gettime_ns();
+			output_block(source, planes, &pos, BLOCK_FRAMES);
+			for (size_t i = 0; i < count; i++) {
+				if (obs_sidechain_reader_read(readers[i],
+							      BLOCK_FRAMES,
+							      &data))
+					sum += data.data[0][0];
+			}
+			elapsed += os_gettime_ns() - start;
+		}
+
+		printf("%zu reader(s): %.2f us per block (%.0f)\n", count,
+		       (double)elapsed / 1000.0 / BLOCKS, sum);
+
+		for (size_t i = 0; i < count; i++)
+			obs_sidechain_reader_destroy(readers[i]);
+		obs_source_release(source);
+	}
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(shared_readers_test),
+		cmocka_unit_test(wrap_and_catch_up_test),
+#ifdef ENABLE_BENCHMARKS
+		cmocka_unit_test(shared_readers_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,236 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+
+#define CHANNELS 2
+#define VOLMETERS 8
+#define BLOCKS 2000
+#define BLOCK_FRAMES 1024
+
+struct levels {
+	size_t updates;
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS];
+	float input_peak[MAX_AUDIO_CHANNELS];
+};
+
+static const char *meter_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "meter_source";
+}
+
+static void *meter_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void meter_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static int setup(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	struct obs_audio_info oai = {.samples_per_sec = 48000,
+				     .speakers = SPEAKERS_STEREO};
+	if (!obs_reset_audio(&oai))
+		return -1;
+
+	struct obs_source_info source = {
+		.id = "meter_source",
+		.type = OBS_SOURCE_TYPE_INPUT,
+		.output_flags = OBS_SOURCE_AUDIO,
+		.get_name = meter_source_name,
+		.create = meter_source_create,
+		.destroy = meter_source_destroy,
+	};
+	obs_register_source(&source);
+
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+	obs_shutdown();
+	return 0;
+}
+
+static void levels_updated(void *param,
+			   const float magnitude[MAX_AUDIO_CHANNELS],
+			   const float peak[MAX_AUDIO_CHANNELS],
+			   const float input_peak[MAX_AUDIO_CHANNELS])
+{
+	struct levels *levels = param;
+
+	levels->updates++;
+	memcpy(levels->magnitude, magnitude, sizeof(levels->magnitude));
+	memcpy(levels->peak, peak, sizeof(levels->peak));
+	memcpy(levels->input_peak, input_peak, sizeof(levels->input_peak));
+}
+
+/* A quarter of the sample rate at a 45 degree phase offset only ever hits
+ * 1/sqrt(2) of its amplitude on a sample, so the true peak stands out */
+static void output_block(obs_source_t *source, float *planes[CHANNELS],
+			 uint64_t *pos)
+{
+	struct obs_source_audio audio = {
+		.frames = BLOCK_FRAMES,
+		.speakers = SPEAKERS_STEREO,
+		.format = AUDIO_FORMAT_FLOAT_PLANAR,
+		.samples_per_sec = 48000,
+		.timestamp = util_mul_div64(*pos, 1000000000ULL, 48000),
+	};
+
+	for (uint32_t i = 0; i < BLOCK_FRAMES; i++, (*pos)++) {
+		planes[0][i] = 0.5f * sinf((float)*pos * (float)M_PI_2 +
+					   (float)M_PI_4);
+		planes[1][i] = 0.25f * sinf((float)*pos * 0.01f);
+	}
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio.data[c] = (const uint8_t *)planes[c];
+
+	obs_source_output_audio(source, &audio);
+}
+
+static obs_volmeter_t *create_volmeter(obs_source_t *source,
+				       enum obs_peak_meter_type type,
+				       struct levels *levels)
+{
+	obs_volmeter_t *volmeter = obs_volmeter_create(OBS_FADER_LOG);
+	obs_volmeter_set_peak_meter_type(volmeter, type);
+	obs_volmeter_add_callback(volmeter, levels_updated, levels);
+	obs_volmeter_attach_source(volmeter, source);
+	return volmeter;
+}
+
+/* Volmeters sharing a source have to see the same levels as a volmeter on
+ * its own, for either kind of peak meter */
+static void shared_levels_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_source_t *sources[2] = {
+		obs_source_create_private("meter_source", "shared", NULL),
+		obs_source_create_private("meter_source", "single", NULL),
+	};
+	struct levels shared[3] = {0};
+	struct levels single = {0};
+	obs_volmeter_t *volmeters[3] = {
+		create_volmeter(sources[0], SAMPLE_PEAK_METER, &shared[0]),
+		create_volmeter(sources[0], TRUE_PEAK_METER, &shared[1]),
+		create_volmeter(sources[0], SAMPLE_PEAK_METER, &shared[2]),
+	};
+	obs_volmeter_t *single_volmeter =
+		create_volmeter(sources[1], TRUE_PEAK_METER, &single);
+
+	float *planes[CHANNELS];
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bmalloc(BLOCK_FRAMES * sizeof(float));
+
+	for (size_t b = 0; b < 10; b++) {
+		uint64_t pos = b * BLOCK_FRAMES;
+		output_block(sources[0], planes, &pos);
+		pos = b * BLOCK_FRAMES;
+		output_block(sources[1], planes, &pos);
+
+		/* Volmeters can come and go while the source is playing */
+		if (b == 5) {
+			obs_volmeter_destroy(volmeters[2]);
+			volmeters[2] = NULL;
+		}
+	}
+
+	assert_int_equal(shared[0].updates, 10);
+	assert_int_equal(shared[1].updates, 10);
+	assert_int_equal(shared[2].updates, 6);
+	assert_int_equal(single.updates, 10);
+
+	assert_memory_equal(shared[1].peak, single.peak, sizeof(single.peak));
+	assert_memory_equal(shared[1].magnitude, single.magnitude,
+			    sizeof(single.magnitude));
+	assert_memory_equal(shared[0].magnitude, single.magnitude,
+			    sizeof(single.magnitude));
+
+	/* -9 dB on the samples, the true peak is at least 3 dB above that */
+	assert_true(fabsf(shared[0].input_peak[0] + 9.03f) < 0.1f);
+	assert_true(shared[1].input_peak[0] > shared[0].input_peak[0] + 2.9f);
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+	for (size_t i = 0; i < 3; i++)
+		obs_volmeter_destroy(volmeters[i]);
+	obs_volmeter_destroy(single_volmeter);
+	obs_source_release(sources[0]);
+	obs_source_release(sources[1]);
+}
+
+#ifdef ENABLE_BENCHMARKS
+/* Cost of metering a source with one volmeter and with a volmeter per dock,
+ * projector and plugin that shows it */
+static void shared_levels_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	float *planes[CHANNELS];
+	for (size_t c = 0; c < CHANNELS; c++)
+		planes[c] = bmalloc(BLOCK_FRAMES * sizeof(float));
+
+	for (size_t count = 1; count <= VOLMETERS; count *= VOLMETERS) {
+		obs_source_t *source = obs_source_create_private(
+			"meter_source", "bench", NULL);
+		obs_volmeter_t *volmeters[VOLMETERS];
+		struct levels levels[VOLMETERS] = {0};
+		uint64_t pos = 0;
+		uint64_t elapsed = 0;
+
+		for (size_t i = 0; i < count; i++)
+			volmeters[i] = create_volmeter(source, TRUE_PEAK_METER,
+						       &levels[i]);
+
+		for (size_t b = 0; b < BLOCKS; b++) {
+			uint64_t start = os_gettime_ns();
+			output_block(source, planes, &pos);
+			elapsed += os_gettime_ns() - start;
+		}
+
+		printf("%zu volmeter(s): %.2f us per block\n", count,
+		       (double)elapsed / 1000.0 / BLOCKS);
+
+		for (size_t i = 0; i < count; i++)
+			obs_volmeter_destroy(volmeters[i]);
+		obs_source_release(source);
+	}
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(planes[c]);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(shared_levels_test),
+#ifdef ENABLE_BENCHMARKS
+		cmocka_unit_test(shared_levels_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
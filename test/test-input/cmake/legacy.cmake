@@ -9,6 +9,7 @@ target_sources(
           test-sinewave.c
           sync-async-source.c
           sync-audio-buffering.c
+          sync-jitter-source.c
           sync-pair-vid.c
           sync-pair-aud.c
           test-random.c)
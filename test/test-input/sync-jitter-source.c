@@ -0,0 +1,199 @@
+#include <stdlib.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <obs.h>
+
+/* Outputs 60 FPS video whose timestamps are perfectly even, but which
+ * arrives in bursts at random times, from a clock that runs off from the
+ * real one.  A bar moves by the same amount every frame, so any frame that
+ * is dropped or shown twice makes it stutter. */
+
+#define WIDTH 240
+#define HEIGHT 40
+#define BAR_WIDTH 8
+#define BAR_COLOR 0xFFFFFFFF
+#define BG_COLOR 0xFF202020
+#define FRAME_INTERVAL 16666667ULL
+#define STATS_INTERVAL 5.0f
+
+struct jitter_test {
+	obs_source_t *source;
+	os_event_t *stop_signal;
+	pthread_t thread;
+	bool initialized;
+
+	volatile long jitter_ms;
+	volatile long burst;
+	volatile long drift_ppm;
+
+	float stats_time;
+};
+
+static const char *jt_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Sync Test (Jittery Async Video)";
+}
+
+static void jt_destroy(void *data)
+{
+	struct jitter_test *jt = data;
+
+	if (jt->initialized) {
+		os_event_signal(jt->stop_signal);
+		pthread_join(jt->thread, NULL);
+	}
+
+	os_event_destroy(jt->stop_signal);
+	bfree(jt);
+}
+
+static void fill_frame(uint32_t *pixels, uint64_t index)
+{
+	size_t bar = (size_t)(index * 2 % (WIDTH - BAR_WIDTH));
+
+	for (size_t y = 0; y < HEIGHT; y++) {
+		for (size_t x = 0; x < WIDTH; x++) {
+			bool on_bar = x >= bar && x < bar + BAR_WIDTH;
+			pixels[y * WIDTH + x] = on_bar ? BAR_COLOR : BG_COLOR;
+		}
+	}
+}
+
+static void *video_thread(void *data)
+{
+	struct jitter_test *jt = data;
+	uint32_t *pixels = bmalloc(WIDTH * HEIGHT * sizeof(uint32_t));
+	uint64_t start_time = os_gettime_ns();
+	uint64_t index = 0;
+	double real_time = 0.0;
+
+	struct obs_source_frame frame = {
+		.data = {[0] = (uint8_t *)pixels},
+		.linesize = {[0] = WIDTH * 4},
+		.width = WIDTH,
+		.height = HEIGHT,
+		.format = VIDEO_FORMAT_BGRX,
+	};
+
+	while (os_event_try(jt->stop_signal) == EAGAIN) {
+		long jitter_ms = os_atomic_load_long(&jt->jitter_ms);
+		long burst = os_atomic_load_long(&jt->burst);
+		double drift = (double)os_atomic_load_long(&jt->drift_ppm);
+		uint64_t jitter = 0;
+
+		if (burst < 1)
+			burst = 1;
+		if (jitter_ms > 0)
+			jitter = (uint64_t)(rand() % (jitter_ms * 1000)) * 1000;
+
+		/* Frames take as long to come in as the source clock says,
+		 * which is a little more or less in real time */
+		real_time += (double)(FRAME_INTERVAL * burst) *
+			     (1.0 + drift / 1000000.0);
+		os_sleepto_ns(start_time + (uint64_t)real_time + jitter);
+
+		for (long i = 0; i < burst; i++) {
+			fill_frame(pixels, index);
+			frame.timestamp = index * FRAME_INTERVAL;
+			obs_source_output_video(jt->source, &frame);
+			index++;
+		}
+	}
+
+	bfree(pixels);
+	return NULL;
+}
+
+static void jt_update(void *data, obs_data_t *settings)
+{
+	struct jitter_test *jt = data;
+
+	os_atomic_set_long(&jt->jitter_ms,
+			   (long)obs_data_get_int(settings, "jitter"));
+	os_atomic_set_long(&jt->burst,
+			   (long)obs_data_get_int(settings, "burst"));
+	os_atomic_set_long(&jt->drift_ppm,
+			   (long)obs_data_get_int(settings, "drift"));
+
+	obs_source_set_async_jitter_buffer(
+		jt->source, obs_data_get_bool(settings, "jitter_buffer"));
+}
+
+static void *jt_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct jitter_test *jt = bzalloc(sizeof(struct jitter_test));
+	jt->source = source;
+
+	jt_update(jt, settings);
+
+	if (os_event_init(&jt->stop_signal, OS_EVENT_TYPE_MANUAL) != 0) {
+		jt_destroy(jt);
+		return NULL;
+	}
+
+	if (pthread_create(&jt->thread, NULL, video_thread, jt) != 0) {
+		jt_destroy(jt);
+		return NULL;
+	}
+
+	jt->initialized = true;
+	return jt;
+}
+
+static void jt_video_tick(void *data, float seconds)
+{
+	struct jitter_test *jt = data;
+	struct obs_source_async_stats stats;
+
+	jt->stats_time += seconds;
+	if (jt->stats_time < STATS_INTERVAL)
+		return;
+	jt->stats_time = 0.0f;
+
+	if (!obs_source_get_async_stats(jt->source, &stats))
+		return;
+
+	blog(LOG_INFO,
+	     "jitter test: late %llu, dropped %llu, duplicated %llu, "
+	     "queued %u, delay %.1f ms, drift %.0f ppm",
+	     (unsigned long long)stats.late_frames,
+	     (unsigned long long)stats.dropped_frames,
+	     (unsigned long long)stats.duplicated_frames, stats.queued_frames,
+	     (double)stats.target_delay / 1000000.0, stats.clock_drift_ppm);
+}
+
+static void jt_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "jitter", 20);
+	obs_data_set_default_int(settings, "burst", 1);
+	obs_data_set_default_int(settings, "drift", 0);
+	obs_data_set_default_bool(settings, "jitter_buffer", true);
+}
+
+static obs_properties_t *jt_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_int(props, "jitter", "Jitter (ms)", 0, 200, 1);
+	obs_properties_add_int(props, "burst", "Frames per burst", 1, 8, 1);
+	obs_properties_add_int(props, "drift", "Clock drift (ppm)", -5000,
+			       5000, 100);
+	obs_properties_add_bool(props, "jitter_buffer", "Jitter buffer");
+	return props;
+}
+
+struct obs_source_info jitter_sync_test = {
+	.id = "jitter_sync_test",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_ASYNC_VIDEO,
+	.get_name = jt_getname,
+	.create = jt_create,
+	.destroy = jt_destroy,
+	.update = jt_update,
+	.video_tick = jt_video_tick,
+	.get_defaults = jt_defaults,
+	.get_properties = jt_properties,
+};
@@ -7,6 +7,7 @@ extern struct obs_source_info test_sinewave;
 extern struct obs_source_info test_filter;
 extern struct obs_source_info async_sync_test;
 extern struct obs_source_info buffering_async_sync_test;
+extern struct obs_source_info jitter_sync_test;
 extern struct obs_source_info sync_video;
 extern struct obs_source_info sync_audio;
 
@@ -17,6 +18,7 @@ bool obs_module_load(void)
 	obs_register_source(&test_filter);
 	obs_register_source(&async_sync_test);
 	obs_register_source(&buffering_async_sync_test);
+	obs_register_source(&jitter_sync_test);
 	obs_register_source(&sync_video);
 	obs_register_source(&sync_audio);
 	return true;